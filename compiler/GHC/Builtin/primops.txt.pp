@@ -1538,19 +1538,21 @@ section "Small Arrays"
         {Operations on {\tt SmallArray\#}. A {\tt SmallArray\#} works
          just like an {\tt Array\#}, but with different space use and
          performance characteristics (that are often useful with small
-         arrays). The {\tt SmallArray\#} and {\tt SmallMutableArray#}
-         lack a `card table'. The purpose of a card table is to avoid
-         having to scan every element of the array on each GC by
-         keeping track of which elements have changed since the last GC
-         and only scanning those that have changed. So the consequence
-         of there being no card table is that the representation is
-         somewhat smaller and the writes are somewhat faster (because
-         the card table does not need to be updated). The disadvantage
-         of course is that for a {\tt SmallMutableArray#} the whole
-         array has to be scanned on each GC. Thus it is best suited for
-         use cases where the mutable array is not long lived, e.g.
-         where a mutable array is initialised quickly and then frozen
-         to become an immutable {\tt SmallArray\#}.
+         arrays). A {\tt SmallArray\#} or {\tt SmallMutableArray#} of
+         fewer than 16 elements lacks a `card table'. The purpose of a
+         card table is to avoid having to scan every element of the
+         array on each GC by keeping track of which elements have
+         changed since the last GC and only scanning those that have
+         changed. So the consequence of there being no card table is
+         that the representation is somewhat smaller and the writes are
+         somewhat faster (because the card table does not need to be
+         updated). The disadvantage of course is that for such a
+         {\tt SmallMutableArray#} the whole array has to be scanned on
+         each GC. Thus it is best suited for use cases where the mutable
+         array is not long lived, e.g. where a mutable array is
+         initialised quickly and then frozen to become an immutable
+         {\tt SmallArray\#}. Larger small arrays have a card table
+         with finer cards than that of an {\tt Array\#}.
         }
 
 ------------------------------------------------------------------------
@@ -3021,6 +3023,16 @@ primop  ThreadStatusOp "threadStatus#" GenPrimOp
    out_of_line = True
    has_side_effects = True
 
+primop  ThreadAccountingOp "threadAccounting#" GenPrimOp
+   ThreadId# -> State# RealWorld -> (# State# RealWorld, Int#, INT64, INT64 #)
+   { Returns the number of bytes allocated by the given thread, and the CPU
+     time in nanoseconds it has spent running.  The first component is
+     zero, as are the counts, unless the RTS was started with
+     {\tt +RTS --thread-accounting}. }
+   with
+   out_of_line = True
+   has_side_effects = True
+
 ------------------------------------------------------------------------
 section "Weak pointers"
 ------------------------------------------------------------------------
@@ -456,6 +456,8 @@ assembleI platform i = case i of
   RETURN                   -> emit bci_RETURN []
   RETURN_UNLIFTED rep      -> emit (return_unlifted rep) []
   RETURN_TUPLE             -> emit bci_RETURN_T []
+  PUSH_L_ENTER o1          -> emit bci_PUSH_L_ENTER [SmallOp o1]
+  SLIDE_ENTER n by         -> emit bci_SLIDE_ENTER [SmallOp n, SmallOp by]
   CCALL off m_addr i       -> do np <- addr m_addr
                                  emit bci_CCALL [SmallOp off, Op np, SmallOp i]
   BRK_FUN index uniq cc    -> do p1 <- ptr BCOPtrBreakArray
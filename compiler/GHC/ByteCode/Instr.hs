@@ -176,6 +176,11 @@ data BCInstr
    | RETURN_UNLIFTED ArgRep -- return an unlifted value, here's its rep
    | RETURN_TUPLE           -- return an unboxed tuple (info already on stack)
 
+   -- Superinstructions, made by the peephole optimisation in
+   -- GHC.StgToByteCode.mkProtoBCO
+   | PUSH_L_ENTER !Word16                -- PUSH_L o; ENTER
+   | SLIDE_ENTER  !Word16 !Word16        -- SLIDE n by; ENTER
+
    -- Breakpoints
    | BRK_FUN          Word16 Unique (RemotePtr CostCentre)
 
@@ -312,6 +317,8 @@ instance Outputable BCInstr where
    ppr RETURN                = text "RETURN"
    ppr (RETURN_UNLIFTED pk)  = text "RETURN_UNLIFTED  " <+> ppr pk
    ppr (RETURN_TUPLE)        = text "RETURN_TUPLE"
+   ppr (PUSH_L_ENTER offset) = text "PUSH_L_ENTER" <+> ppr offset
+   ppr (SLIDE_ENTER n d)     = text "SLIDE_ENTER " <+> ppr n <+> ppr d
    ppr (BRK_FUN index uniq _cc) = text "BRK_FUN" <+> ppr index <+> ppr uniq <+> text "<cc>"
 
 
@@ -392,6 +399,8 @@ bciStackUse ENTER{}               = 0
 bciStackUse RETURN{}              = 0
 bciStackUse RETURN_UNLIFTED{}     = 1 -- pushes stg_ret_X for some X
 bciStackUse RETURN_TUPLE{}        = 1 -- pushes stg_ret_t header
+bciStackUse PUSH_L_ENTER{}        = 1
+bciStackUse SLIDE_ENTER{}         = 0
 bciStackUse CCALL{}               = 0
 bciStackUse SWIZZLE{}             = 0
 bciStackUse BRK_FUN{}             = 0
@@ -42,7 +42,8 @@ module GHC.Runtime.Heap.Layout (
         aRG_GEN, aRG_GEN_BIG,
 
         -- ** Arrays
-        card, cardRoundUp, cardTableSizeB, cardTableSizeW
+        card, cardRoundUp, cardTableSizeB, cardTableSizeW,
+        smallArrHasCards, smallCard, smallCardTableSizeW
     ) where
 
 import GHC.Prelude
@@ -164,6 +165,7 @@ data SMRep
 
   | SmallArrayPtrsRep
         !WordOff        -- # ptr words
+        !WordOff        -- # card table words
 
   | ArrayWordsRep
         !WordOff        -- # bytes expressed in words, rounded up
@@ -231,8 +233,8 @@ indStaticRep = HeapRep True 1 0 IndStatic
 arrPtrsRep :: Platform -> WordOff -> SMRep
 arrPtrsRep platform elems = ArrayPtrsRep elems (cardTableSizeW platform elems)
 
-smallArrPtrsRep :: WordOff -> SMRep
-smallArrPtrsRep elems = SmallArrayPtrsRep elems
+smallArrPtrsRep :: Platform -> WordOff -> SMRep
+smallArrPtrsRep platform elems = SmallArrayPtrsRep elems (smallCardTableSizeW platform elems)
 
 arrWordsRep :: Platform -> ByteOff -> SMRep
 arrWordsRep platform bytes = ArrayWordsRep (bytesToWordsRoundUp platform bytes)
@@ -343,11 +345,11 @@ hdrSize :: Profile -> SMRep -> ByteOff
 hdrSize profile rep = wordsToBytes (profilePlatform profile) (hdrSizeW profile rep)
 
 hdrSizeW :: Profile -> SMRep -> WordOff
-hdrSizeW profile (HeapRep _ _ _ ty)    = closureTypeHdrSize profile ty
-hdrSizeW profile (ArrayPtrsRep _ _)    = arrPtrsHdrSizeW profile
-hdrSizeW profile (SmallArrayPtrsRep _) = smallArrPtrsHdrSizeW profile
-hdrSizeW profile (ArrayWordsRep _)     = arrWordsHdrSizeW profile
-hdrSizeW _ _                           = panic "GHC.Runtime.Heap.Layout.hdrSizeW"
+hdrSizeW profile (HeapRep _ _ _ ty)      = closureTypeHdrSize profile ty
+hdrSizeW profile (ArrayPtrsRep _ _)      = arrPtrsHdrSizeW profile
+hdrSizeW profile (SmallArrayPtrsRep _ _) = smallArrPtrsHdrSizeW profile
+hdrSizeW profile (ArrayWordsRep _)       = arrWordsHdrSizeW profile
+hdrSizeW _ _                             = panic "GHC.Runtime.Heap.Layout.hdrSizeW"
 
 nonHdrSize :: Platform -> SMRep -> ByteOff
 nonHdrSize platform rep = wordsToBytes platform (nonHdrSizeW rep)
@@ -355,7 +357,7 @@ nonHdrSize platform rep = wordsToBytes platform (nonHdrSizeW rep)
 nonHdrSizeW :: SMRep -> WordOff
 nonHdrSizeW (HeapRep _ p np _) = p + np
 nonHdrSizeW (ArrayPtrsRep elems ct) = elems + ct
-nonHdrSizeW (SmallArrayPtrsRep elems) = elems
+nonHdrSizeW (SmallArrayPtrsRep elems ct) = elems + ct
 nonHdrSizeW (ArrayWordsRep words) = words
 nonHdrSizeW (StackRep bs)      = length bs
 nonHdrSizeW (RTSRep _ rep)     = nonHdrSizeW rep
@@ -363,11 +365,11 @@ nonHdrSizeW (RTSRep _ rep)     = nonHdrSizeW rep
 -- | The total size of the closure, in words.
 heapClosureSizeW :: Profile -> SMRep -> WordOff
 heapClosureSizeW profile rep = case rep of
-   HeapRep _ p np ty       -> closureTypeHdrSize profile ty + p + np
-   ArrayPtrsRep elems ct   -> arrPtrsHdrSizeW profile + elems + ct
-   SmallArrayPtrsRep elems -> smallArrPtrsHdrSizeW profile + elems
-   ArrayWordsRep words     -> arrWordsHdrSizeW profile + words
-   _                       -> panic "GHC.Runtime.Heap.Layout.heapClosureSize"
+   HeapRep _ p np ty          -> closureTypeHdrSize profile ty + p + np
+   ArrayPtrsRep elems ct      -> arrPtrsHdrSizeW profile + elems + ct
+   SmallArrayPtrsRep elems ct -> smallArrPtrsHdrSizeW profile + elems + ct
+   ArrayWordsRep words        -> arrWordsHdrSizeW profile + words
+   _                          -> panic "GHC.Runtime.Heap.Layout.heapClosureSize"
 
 closureTypeHdrSize :: Profile -> ClosureTypeInfo -> WordOff
 closureTypeHdrSize profile ty = case ty of
@@ -403,6 +405,27 @@ cardTableSizeW :: Platform -> Int -> WordOff
 cardTableSizeW platform elems =
   bytesToWordsRoundUp platform (cardTableSizeB platform elems)
 
+-- | Whether a small array with the given number of elements has a card table.
+-- See Note [Card marking for small arrays] in rts/sm/Scav.c
+smallArrHasCards :: Platform -> Int -> Bool
+smallArrHasCards platform elems =
+  elems >= pc_SMALL_MUT_ARR_PTRS_CARD_THRESHOLD (platformConstants platform)
+
+-- | The byte offset into the card table of a small array of the card for a
+-- given element
+smallCard :: Platform -> Int -> Int
+smallCard platform i = i `shiftR` pc_SMALL_MUT_ARR_PTRS_CARD_BITS (platformConstants platform)
+
+-- | The size of the card table of a small array, in words
+smallCardTableSizeW :: Platform -> Int -> WordOff
+smallCardTableSizeW platform elems
+  | smallArrHasCards platform elems
+  = bytesToWordsRoundUp platform (smallCard platform (elems + (1 `shiftL` bits) - 1))
+  | otherwise
+  = 0
+  where
+    bits = pc_SMALL_MUT_ARR_PTRS_CARD_BITS (platformConstants platform)
+
 -----------------------------------------------------------------------------
 -- deriving the RTS closure type from an SMRep
 
@@ -522,7 +545,7 @@ instance Outputable SMRep where
 
    ppr (ArrayPtrsRep size _) = text "ArrayPtrsRep" <+> ppr size
 
-   ppr (SmallArrayPtrsRep size) = text "SmallArrayPtrsRep" <+> ppr size
+   ppr (SmallArrayPtrsRep size _) = text "SmallArrayPtrsRep" <+> ppr size
 
    ppr (ArrayWordsRep words) = text "ArrayWordsRep" <+> ppr words
 
@@ -256,13 +256,19 @@ mkProtoBCO platform nm instrs_ordlist origin arity bitmap_size bitmap is_ret ffi
         -- We assume that this sum doesn't wrap
         stack_usage = sum (map bciStackUse peep_d)
 
-        -- Merge local pushes
+        -- Merge local pushes, and fuse common pairs of instructions into
+        -- superinstructions (see Note [Threaded dispatch in the
+        -- interpreter] in rts/Interpreter.c)
         peep_d = peep (fromOL instrs_ordlist)
 
         peep (PUSH_L off1 : PUSH_L off2 : PUSH_L off3 : rest)
            = PUSH_LLL off1 (off2-1) (off3-2) : peep rest
         peep (PUSH_L off1 : PUSH_L off2 : rest)
            = PUSH_LL off1 (off2-1) : peep rest
+        peep (PUSH_L off : ENTER : rest)
+           = PUSH_L_ENTER off : peep rest
+        peep (SLIDE n by : ENTER : rest)
+           = SLIDE_ENTER n by : peep rest
         peep (i:rest)
            = i : peep rest
         peep []
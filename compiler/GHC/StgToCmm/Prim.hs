@@ -213,7 +213,7 @@ emitPrimOp dflags primop = case primop of
     [(CmmLit (CmmInt n w)), init]
       | wordsToBytes platform (asUnsigned w n) <= fromIntegral (maxInlineAllocSize dflags)
       -> opIntoRegs $ \ [res] ->
-        doNewArrayOp res (smallArrPtrsRep (fromInteger n)) mkSMAP_DIRTY_infoLabel
+        doNewArrayOp res (smallArrPtrsRep platform (fromInteger n)) mkSMAP_DIRTY_infoLabel
         [ (mkIntExpr platform (fromInteger n),
            fixedHdrSize profile + pc_OFFSET_StgSmallMutArrPtrs_ptrs (platformConstants platform))
         ]
@@ -1635,6 +1635,7 @@ emitPrimOp dflags primop = case primop of
   IsCurrentThreadBoundOp -> alwaysExternal
   NoDuplicateOp -> alwaysExternal
   ThreadStatusOp -> alwaysExternal
+  ThreadAccountingOp -> alwaysExternal
   MkWeakOp -> alwaysExternal
   MkWeakNoFinalizerOp -> alwaysExternal
   AddCFinalizerToWeakOp -> alwaysExternal
@@ -2200,6 +2201,11 @@ loadArrPtrsSize profile addr = CmmLoad (cmmOffsetB platform addr off) (bWord pla
  where off = fixedHdrSize profile + pc_OFFSET_StgMutArrPtrs_ptrs (profileConstants profile)
        platform = profilePlatform profile
 
+loadSmallArrPtrsSize :: Profile -> CmmExpr -> CmmExpr
+loadSmallArrPtrsSize profile addr = CmmLoad (cmmOffsetB platform addr off) (bWord platform)
+ where off = fixedHdrSize profile + pc_OFFSET_StgSmallMutArrPtrs_ptrs (profileConstants profile)
+       platform = profilePlatform profile
+
 mkBasicIndexedRead :: ByteOff      -- Initial offset in bytes
                    -> Maybe MachOp -- Optional result cast
                    -> CmmType      -- Type of element we are accessing
@@ -2809,7 +2815,7 @@ emitCopyArray copy src0 src_off dst0 dst_off0 n =
         dst_cards_p <- assignTempE $ cmmOffsetExprW platform dst_elems_p
                        (loadArrPtrsSize profile dst)
 
-        emitSetCards dst_off dst_cards_p n
+        emitSetCards (cardCmm platform) dst_off dst_cards_p n
 
 doCopySmallArrayOp :: CmmExpr -> CmmExpr -> CmmExpr -> CmmExpr -> WordOff
                    -> FCode ()
@@ -2870,6 +2876,16 @@ emitCopySmallArray copy src0 src_off dst0 dst_off n =
 
         copy src dst dst_p src_p bytes
 
+        -- Mark the cards of the destination, if it has a card table.
+        -- See Note [Card marking for small arrays] in rts/sm/Scav.c
+        dst_ptrs <- assignTempE $ loadSmallArrPtrsSize profile dst
+        set_cards <- getCode $ do
+            dst_cards_p <- assignTempE $ cmmOffsetExprW platform
+                           (cmmOffsetB platform dst (smallArrPtrsHdrSize profile))
+                           dst_ptrs
+            emitSetCards (smallCardCmm platform) dst_off dst_cards_p n
+        emit =<< mkCmmIfThen (smallArrHasCardsCmm platform dst_ptrs) set_cards
+
 -- | Takes an info table label, a register to return the newly
 -- allocated array in, a source array, an offset in the source array,
 -- and the number of elements to copy. Allocates a new array and
@@ -2922,7 +2938,7 @@ emitCloneSmallArray info_p res_r src src_off n = do
     platform <- getPlatform
 
     let info_ptr = mkLblExpr info_p
-        rep = smallArrPtrsRep n
+        rep = smallArrPtrsRep platform n
 
     tickyAllocPrim (mkIntExpr platform (smallArrPtrsHdrSize profile))
         (mkIntExpr platform (nonHdrSize platform rep))
@@ -2949,15 +2965,16 @@ emitCloneSmallArray info_p res_r src src_off n = do
 
     emit $ mkAssign (CmmLocal res_r) (CmmReg arr)
 
--- | Takes and offset in the destination array, the base address of
--- the card table, and the number of elements affected (*not* the
--- number of cards). The number of elements may not be zero.
--- Marks the relevant cards as dirty.
-emitSetCards :: CmmExpr -> CmmExpr -> WordOff -> FCode ()
-emitSetCards dst_start dst_cards_start n = do
+-- | Takes a function converting an element index to a card index, an
+-- offset in the destination array, the base address of the card table,
+-- and the number of elements affected (*not* the number of cards). The
+-- number of elements may not be zero. Marks the relevant cards as dirty.
+emitSetCards :: (CmmExpr -> CmmExpr) -> CmmExpr -> CmmExpr -> WordOff
+             -> FCode ()
+emitSetCards to_card dst_start dst_cards_start n = do
     platform <- getPlatform
-    start_card <- assignTempE $ cardCmm platform dst_start
-    let end_card = cardCmm platform
+    start_card <- assignTempE $ to_card dst_start
+    let end_card = to_card
                    (cmmSubWord platform
                     (cmmAddWord platform dst_start (mkIntExpr platform n))
                     (mkIntExpr platform 1))
@@ -2971,6 +2988,16 @@ cardCmm :: Platform -> CmmExpr -> CmmExpr
 cardCmm platform i =
     cmmUShrWord platform i (mkIntExpr platform (pc_MUT_ARR_PTRS_CARD_BITS (platformConstants platform)))
 
+-- Convert an element index of a small array to a card index
+smallCardCmm :: Platform -> CmmExpr -> CmmExpr
+smallCardCmm platform i =
+    cmmUShrWord platform i (mkIntExpr platform (pc_SMALL_MUT_ARR_PTRS_CARD_BITS (platformConstants platform)))
+
+-- Does a small array with the given number of elements have a card table?
+smallArrHasCardsCmm :: Platform -> CmmExpr -> CmmExpr
+smallArrHasCardsCmm platform n =
+    cmmUGeWord platform n (mkIntExpr platform (pc_SMALL_MUT_ARR_PTRS_CARD_THRESHOLD (platformConstants platform)))
+
 ------------------------------------------------------------------------------
 -- SmallArray PrimOp implementations
 
@@ -3002,6 +3029,16 @@ doWriteSmallPtrArrayOp addr idx val = do
     mkBasicIndexedWrite (smallArrPtrsHdrSize profile) Nothing addr ty idx val
     emit (setInfo addr (CmmLit (CmmLabel mkSMAP_DIRTY_infoLabel)))
 
+    -- Mark the card of the element, if the array has a card table.
+    -- See Note [Card marking for small arrays] in rts/sm/Scav.c
+    ptrs <- assignTempE $ loadSmallArrPtrsSize profile addr
+    let card_p = cmmOffsetExpr platform
+                   (cmmOffsetExprW platform
+                     (cmmOffsetB platform addr (smallArrPtrsHdrSize profile)) ptrs)
+                   (smallCardCmm platform idx)
+    emit =<< mkCmmIfThen (smallArrHasCardsCmm platform ptrs)
+                         (mkStore card_p (CmmLit (CmmInt 1 W8)))
+
 ------------------------------------------------------------------------------
 -- Atomic read-modify-write
 
@@ -335,6 +335,10 @@ rtsPackageArgs = package rts ? do
             -- inlining warnings happen in Compact
             , inputs ["**/Compact.c"] ? arg "-Wno-inline"
 
+            -- the jumptable of interpretBCO overrides its default entries
+            -- on purpose
+            , inputs ["**/Interpreter.c"] ? arg "-Wno-override-init"
+
             -- emits warnings about call-clobbered registers on x86_64
             , inputs [ "**/StgCRun.c"
                      , "**/win32/ConsoleHandler.c", "**/win32/ThrIOManager.c"] ? arg "-w"
@@ -49,6 +49,7 @@ module GHC.Conc
         , ThreadStatus(..), BlockReason(..)
         , threadStatus
         , threadCapability
+        , threadAccounting
 
         , newStablePtrPrimMVar, PrimMVar
 
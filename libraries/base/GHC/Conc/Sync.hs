@@ -56,6 +56,7 @@ module GHC.Conc.Sync
         , ThreadStatus(..), BlockReason(..)
         , threadStatus
         , threadCapability
+        , threadAccounting
 
         , newStablePtrPrimMVar, PrimMVar
 
@@ -601,6 +602,21 @@ threadCapability (ThreadId t) = IO $ \s ->
    case threadStatus# t s of
      (# s', _, cap#, locked# #) -> (# s', (I# cap#, isTrue# (locked# /=# 0#)) #)
 
+-- | Returns the number of bytes allocated by the thread so far, and the
+-- CPU time in nanoseconds it has spent running Haskell code, or 'Nothing'
+-- if the program was not run with the @+RTS --thread-accounting@ option.
+-- Time spent in safe foreign calls is not included.
+--
+-- The counts for a thread running on another capability only include its
+-- time slices that have finished.
+--
+-- @since 4.17.0.0
+threadAccounting :: ThreadId -> IO (Maybe (Int64, Int64))
+threadAccounting (ThreadId t) = IO $ \s ->
+   case threadAccounting# t s of
+     (# s', 0#, _, _ #) -> (# s', Nothing #)
+     (# s', _, alloc, cpu #) -> (# s', Just (I64# alloc, I64# cpu) #)
+
 -- | Make a weak pointer to a 'ThreadId'.  It can be important to do
 -- this if you want to hold a reference to a 'ThreadId' while still
 -- allowing the thread to receive the @BlockedIndefinitely@ family of
@@ -24,6 +24,8 @@ module GHC.Compact.Serialized(
   withSerializedCompact,
   importCompact,
   importCompactByteStrings,
+  writeCompactFile,
+  readCompactFile,
 ) where
 
 import GHC.Prim
@@ -34,11 +36,17 @@ import GHC.IO (unIO)
 import GHC.Ptr (Ptr(..), plusPtr)
 
 import Control.Concurrent
+import Control.Exception(finally)
 import qualified Data.ByteString as ByteString
 import Data.ByteString.Internal(toForeignPtr)
 import Data.IORef(newIORef, readIORef, writeIORef)
+import Foreign.C.Error(throwErrnoPath, throwErrnoPathIfMinus1_)
+import Foreign.C.String(CString, withCString)
+import Foreign.C.Types(CInt(..))
 import Foreign.ForeignPtr(withForeignPtr)
+import Foreign.Marshal.Alloc(alloca)
 import Foreign.Marshal.Utils(copyBytes)
+import Foreign.Storable(peek)
 
 import GHC.Compact
 
@@ -200,3 +208,71 @@ importCompactByteStrings serialized stringList =
             copyBytes to (from `plusPtr` off) (fromIntegral size)
           writeIORef state rest
     importCompact serialized filler
+
+data CompactFile
+
+foreign import ccall safe "compactFileWrite"
+  c_compactFileWrite :: Ptr () -> Ptr () -> CString -> IO CInt
+foreign import ccall safe "compactFileOpen"
+  c_compactFileOpen :: CString -> Ptr (Ptr CompactFile) -> IO CInt
+foreign import ccall unsafe "compactFileBlockCount"
+  c_compactFileBlockCount :: Ptr CompactFile -> IO Word
+foreign import ccall unsafe "compactFileBlockAddress"
+  c_compactFileBlockAddress :: Ptr CompactFile -> Word -> IO (Ptr ())
+foreign import ccall unsafe "compactFileBlockSize"
+  c_compactFileBlockSize :: Ptr CompactFile -> Word -> IO Word
+foreign import ccall unsafe "compactFileRoot"
+  c_compactFileRoot :: Ptr CompactFile -> IO (Ptr ())
+foreign import ccall safe "compactFileLoadBlock"
+  c_compactFileLoadBlock :: Ptr CompactFile -> Word -> Ptr b -> IO CInt
+foreign import ccall unsafe "compactFileClose"
+  c_compactFileClose :: Ptr CompactFile -> IO ()
+
+-- | Write a 'Compact' to a file, in a format that 'readCompactFile' can
+-- load back. As with the other functions of this module, the file can only
+-- be loaded by the same binary that wrote it.
+writeCompactFile :: FilePath -> Compact a -> IO ()
+writeCompactFile path c =
+  withSerializedCompact c $ \(SerializedCompact blocks root) ->
+    case blocks of
+      [] -> return ()
+      (firstBlock, _) : _ ->
+        withCString path $ \cpath ->
+          throwErrnoPathIfMinus1_ "writeCompactFile" path $
+            c_compactFileWrite firstBlock root cpath
+
+-- | Load a 'Compact' from a file written by 'writeCompactFile'. Where the
+-- platform allows it, the blocks of the 'Compact' are mapped from the file
+-- rather than read, so that their pages are only read from the file when
+-- they are used. The file must then not be truncated as long as the
+-- 'Compact' is alive, but it can be replaced (e.g. by renaming another file
+-- over it).
+--
+-- Returns 'Nothing' if the file was not written by this program, or its
+-- pointers could not be adjusted as with 'importCompact'. Throws an
+-- 'IOError' if the file cannot be read.
+readCompactFile :: FilePath -> IO (Maybe (Compact a))
+readCompactFile path =
+  withCString path $ \cpath ->
+  alloca $ \pfile -> do
+    r <- c_compactFileOpen cpath pfile
+    case r of
+      0 -> do
+        file <- peek pfile
+        load file `finally` c_compactFileClose file
+      1 -> return Nothing
+      _ -> throwErrnoPath "readCompactFile" path
+  where
+    load file = do
+      n <- c_compactFileBlockCount file
+      blocks <- mapM (\i -> (,) <$> c_compactFileBlockAddress file i
+                                 <*> c_compactFileBlockSize file i)
+                     [0 .. n - 1]
+      root <- c_compactFileRoot file
+      next <- newIORef 0
+      let filler to _ = do
+            i <- readIORef next
+            throwErrnoPathIfMinus1_ "readCompactFile" path $
+              c_compactFileLoadBlock file i to
+            writeIORef next (i + 1)
+      importCompact (SerializedCompact blocks root) filler
@@ -0,0 +1,47 @@
+import Data.Array
+import qualified Data.Array.Unboxed as U
+import Data.Maybe
+import qualified Data.Map as Map
+import GHC.Compact
+import GHC.Compact.Serialized
+import System.Mem
+
+main :: IO ()
+main = do
+  let m = Map.fromList [ (x, show x) | x <- [1 .. 100000 :: Int] ]
+  c <- compact m
+  writeCompactFile "compact_file.cnf" c
+
+  -- Use the loaded compact, add to it, and let the GC free it
+  loaded <- readCompactFile "compact_file.cnf"
+  case loaded of
+    Nothing -> putStrLn "could not load compact_file.cnf"
+    Just c' -> do
+      print (getCompact c' == m)
+      c'' <- compactAdd c' (Map.insert 0 "zero" (getCompact c'))
+      performMajorGC
+      print (Map.lookup 0 (getCompact c''), Map.size (getCompact c''))
+  performMajorGC
+
+  -- Blocks that are groups of several megablocks: large arrays, and a
+  -- compact with a large block size
+  let big = U.listArray (0, 999999) [0 ..] :: U.UArray Int Int
+      boxed = listArray (0, 299999) (map show [0 :: Int ..]) :: Array Int String
+  roundTrip "compact_file_big.cnf" big
+  roundTrip "compact_file_boxed.cnf" boxed
+  c3 <- compactSized (4 * 1024 * 1024) True m
+  writeCompactFile "compact_file_sized.cnf" c3
+  loaded3 <- readCompactFile "compact_file_sized.cnf"
+  print (fmap ((== m) . getCompact) loaded3)
+
+  writeFile "compact_file.txt" "not a compact region"
+  r <- readCompactFile "compact_file.txt" :: IO (Maybe (Compact ()))
+  print (isNothing r)
+
+roundTrip :: Eq a => FilePath -> a -> IO ()
+roundTrip path x = do
+  c <- compact x
+  writeCompactFile path c
+  loaded <- readCompactFile path
+  print (fmap ((== x) . getCompact) loaded)
+  performMajorGC
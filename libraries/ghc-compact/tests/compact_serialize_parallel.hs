@@ -0,0 +1,21 @@
+import Data.Bifunctor
+import Foreign.Ptr
+import qualified Data.ByteString as BS
+import qualified Data.ByteString.Unsafe as BS
+import qualified GHC.Compact as Compact
+import qualified GHC.Compact.Serialized as CompactSerialize
+
+-- | Import a compact region made of many blocks, so that its pointers are
+-- fixed up on several threads.
+main :: IO ()
+main = do
+  let xs = [ (i, show i) | i <- [1 .. 200000 :: Int] ]
+
+  region <- Compact.compact xs
+
+  Just deserialized <- CompactSerialize.withSerializedCompact region $ \s -> do
+    blks <- mapM (BS.unsafePackCStringLen . bimap castPtr fromIntegral) (CompactSerialize.serializedCompactBlockList s)
+    print (length blks > 16)
+    CompactSerialize.importCompactByteStrings s blks
+
+  print (Compact.getCompact deserialized == xs)
@@ -0,0 +1,33 @@
+import Control.Concurrent
+import Control.Exception
+import Control.Monad
+import GHC.Compact
+import System.Mem
+
+-- compactWithSharing a structure while another thread keeps running the
+-- garbage collector, so that the objects being compacted move while the
+-- compaction is in progress.
+main :: IO ()
+main = do
+  let shared = [1 .. 1000 :: Int]
+      xs = [ (i, shared) | i <- [1 .. 300000 :: Int] ]
+  _ <- evaluate (sum shared + sum (map fst xs))
+
+  done <- newEmptyMVar
+  _ <- forkIO $ do
+    let loop = do
+          performMinorGC
+          yield
+          finished <- not <$> isEmptyMVar done
+          unless finished loop
+    loop
+
+  c <- compactWithSharing xs
+  putMVar done ()
+
+  let ys = getCompact c
+  print (map fst ys == map fst xs)
+  print (all ((== shared) . snd) (take 10 ys))
+  -- Without sharing the copies of shared would take several gigabytes
+  size <- compactSize c
+  print (size < 64 * 1024 * 1024)
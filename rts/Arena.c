@@ -32,7 +32,9 @@ struct _Arena {
 };
 
 // We like to keep track of how many blocks we've allocated for
-// Storage.c:memInventory().
+// Storage.c:memInventory().  Arenas may be used by several threads at
+// once (see Note [Parallel heap census] in ProfHeap.c), so this is
+// updated atomically.
 static long arena_blocks = 0;
 
 // Begin a new arena
@@ -46,7 +48,7 @@ newArena( void )
     arena->current->link = NULL;
     arena->free = arena->current->start;
     arena->lim  = arena->current->start + BLOCK_SIZE_W;
-    arena_blocks++;
+    RELAXED_ADD(&arena_blocks, 1);
 
     return arena;
 }
@@ -82,7 +84,7 @@ arenaAlloc( Arena *arena, size_t size )
         // allocate a fresh block...
         req_blocks =  (W_)BLOCK_ROUND_UP(size) / BLOCK_SIZE;
         bd = allocGroup_lock(req_blocks);
-        arena_blocks += bd->blocks;
+        RELAXED_ADD(&arena_blocks, bd->blocks);
 
         bd->gen_no  = 0;
         bd->gen     = NULL;
@@ -105,8 +107,8 @@ arenaFree( Arena *arena )
 
     for (bd = arena->current; bd != NULL; bd = next) {
         next = bd->link;
-        arena_blocks -= bd->blocks;
-        ASSERT(arena_blocks >= 0);
+        RELAXED_ADD(&arena_blocks, -(long)bd->blocks);
+        ASSERT(RELAXED_LOAD(&arena_blocks) >= 0);
         freeGroup_lock(bd);
     }
     stgFree(arena);
@@ -115,7 +117,7 @@ arenaFree( Arena *arena )
 unsigned long
 arenaBlocks( void )
 {
-    return arena_blocks;
+    return RELAXED_LOAD(&arena_blocks);
 }
 
 #if defined(DEBUG)
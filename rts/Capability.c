@@ -272,6 +272,7 @@ initCapability (Capability *cap, uint32_t i)
     cap->inbox              = (Message*)END_TSO_QUEUE;
     cap->putMVars           = NULL;
     cap->sparks             = allocSparkPool();
+    cap->n_free_stable_ptrs = 0;
     cap->spark_stats.created    = 0;
     cap->spark_stats.dud        = 0;
     cap->spark_stats.overflowed = 0;
@@ -283,6 +284,16 @@ initCapability (Capability *cap, uint32_t i)
 #endif
 #endif
     cap->total_allocated        = 0;
+    cap->run_start_alloc_limit  = 0;
+    cap->run_start_cpu          = 0;
+    cap->ctxt_switch_quantum    = RtsFlags.ConcFlags.ctxtSwitchTicks;
+    cap->ticks_to_ctxt_switch   = cap->ctxt_switch_quantum;
+    cap->n_blocked              = 0;
+    cap->n_blocked_at_switch    = 0;
+    cap->n_stack_chunk_pool     = 0;
+    cap->stack_overflows        = 0;
+    cap->stack_underflows       = 0;
+    cap->stack_chunks_reused    = 0;
 
     cap->f.stgEagerBlackholeInfo = (W_)&__stg_EAGER_BLACKHOLE_info;
     cap->f.stgGCEnter1     = (StgFunPtr)__stg_gc_enter_1;
@@ -1328,6 +1339,9 @@ markCapability (evac_fn evac, void *user, Capability *cap,
 
     // Free STM structures for this Capability
     stmPreGCHook(cap);
+
+    // The pooled stack chunks are garbage, and are about to move or go
+    clearStackChunkPool(cap);
 }
 
 void
@@ -24,6 +24,8 @@
 #include "Task.h"
 #include "Sparks.h"
 #include "sm/NonMovingMark.h" // for MarkQueue
+#include "StablePtr.h" // for STABLE_PTR_CACHE_SIZE
+#include "Threads.h" // for STACK_CHUNK_POOL_SIZE
 
 #include "BeginPrivate.h"
 
@@ -123,6 +125,31 @@ struct Capability_ {
     // See Note [allocation accounting] in Storage.c
     uint64_t total_allocated;
 
+    // The allocation limit and CPU time of rCurrentTSO when it was last
+    // scheduled, used when +RTS --thread-accounting is on.
+    // See Note [Per-thread accounting] in Threads.c
+    StgInt64 run_start_alloc_limit;
+    Time run_start_cpu;
+
+    // The length of this Capability's time slice and the ticks left
+    // until its next context switch, written by the timer only, and the
+    // number of times one of its threads has blocked, and its value at
+    // the last context switch.
+    // See Note [Adaptive context switching] in Timer.c
+    int ctxt_switch_quantum;
+    int ticks_to_ctxt_switch;
+    StgWord n_blocked;
+    StgWord n_blocked_at_switch;
+
+    // Free stack chunks of the default size, and counts of stack
+    // overflows, underflows and reused chunks since rts start.
+    // See Note [Stack chunk pool] in Threads.c
+    StgStack *stack_chunk_pool[STACK_CHUNK_POOL_SIZE];
+    uint32_t n_stack_chunk_pool;
+    uint64_t stack_overflows;
+    uint64_t stack_underflows;
+    uint64_t stack_chunks_reused;
+
 #if defined(THREADED_RTS)
     // Worker Tasks waiting in the wings.  Singly-linked.
     Task *spare_workers;
@@ -157,6 +184,12 @@ struct Capability_ {
 
     // Stats on spark creation/conversion
     SparkCounters spark_stats;
+
+    // Free entries of the stable pointer table, used without locking by
+    // the running_task.
+    // See Note [Per-capability stable pointer caches] in StablePtr.c
+    StgWord free_stable_ptrs[STABLE_PTR_CACHE_SIZE];
+    uint32_t n_free_stable_ptrs;
 #if !defined(mingw32_HOST_OS)
     // IO manager for this cap
     int io_manager_control_wr_fd;
@@ -0,0 +1,605 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2022
+ *
+ * Writing compact regions to files, and loading them back
+ *
+ * ---------------------------------------------------------------------------*/
+
+// #include "rts/PosixSource.h" - mmap(MAP_ANON) is not POSIX
+#include "Rts.h"
+
+#include "CompactFile.h"
+#include "Hash.h"
+#include "LinkerInternals.h"
+#include "RtsUtils.h"
+#include "sm/OSMem.h"
+#include "xxhash.h"
+
+#include <fs_rts.h>
+#include <errno.h>
+#include <string.h>
+
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#if !defined(MAP_ANON)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#endif
+
+#if defined(OBJFORMAT_ELF)
+#include <link.h>
+#elif defined(mingw32_HOST_OS)
+#include <windows.h>
+#elif defined(HAVE_DLFCN_H)
+#include <dlfcn.h>
+#endif
+
+/* Note [Compact files]
+   ~~~~~~~~~~~~~~~~~~~~
+   compactFileWrite() writes a compact region to a file, which
+   compactFileOpen() and compactFileLoadBlock() load back through the usual
+   import path (importCompact in GHC.Compact.Serialized). The file consists
+   of
+
+     * a CompactFileHeader,
+
+     * a CompactFileBlock for each block of the compact, giving the address
+       and size the block had, and where its contents are in the file,
+
+     * a CompactFileInfo for each info table used by the objects in the
+       compact,
+
+     * and the contents of the blocks, each starting at an offset that is a
+       multiple of BLOCK_SIZE and padded to a multiple of BLOCK_SIZE.
+
+   Everything is in the byte order and word size of the program that wrote
+   the file. Like any serialized compact, the objects refer to their info
+   tables by address, so the file can only be loaded by the same binary,
+   loaded at the same address. compactFileOpen() checks this in two steps:
+
+     * The header records a fingerprint of the addresses of a few RTS info
+       tables (rtsFingerprint()). If the program differs, or was loaded
+       somewhere else, these almost certainly differ too, and we look no
+       further.
+
+     * Each CompactFileInfo records a hash of the contents of an info table
+       the compact uses, including the name of the constructor for
+       constructors, which must match the info table now at that address.
+       Before reading it, we check that the info table, and the name of a
+       constructor, are in the program, one of its shared libraries or an
+       object loaded by the RTS linker (infoTableMapped()), so that a
+       corrupt file doesn't make us read memory that isn't there.
+
+   A block of the compact may be a group of several megablocks, for large
+   objects or a compact created with a large block size (compactSized).  Its
+   memory is contiguous, so it is written and loaded like any other block.
+
+   compactFileLoadBlock() maps the contents of a block from the file with
+   mmap(MAP_PRIVATE | MAP_FIXED) over the memory of a block returned by
+   compactAllocateBlock(), hence the alignment of the blocks in the file.
+   The block is still ordinary heap as far as the block allocator and the GC
+   are concerned, but its pages are only read from the file when they are
+   first touched, and only copied when they are written. A mapped block is
+   flagged BF_COMPACT_MAPPED, and compactFree() gives it anonymous memory
+   again (compactFileUnmapBlock()) before freeing it, so that the memory
+   does not depend on the file once the compact is gone.
+
+   If the blocks could not be allocated at the addresses they were written
+   from, the pointers in the compact still need to be fixed up (see Note
+   [Compact Normal Forms] in sm/CNF.c), which reads every page of the
+   compact and writes those with pointers; but the pages are still read
+   straight from the page cache, and by several threads in the threaded
+   RTS. Where mmap() is not available, or pages are larger than blocks, the
+   blocks are read from the file instead.
+
+   The file must not be truncated while a compact mapped from it is alive,
+   since touching the pages that are gone would raise SIGBUS. Replacing the
+   file (e.g. by renaming a new file over it) is fine.
+*/
+
+#define COMPACT_FILE_MAGIC   "GHCCNF\0"
+#define COMPACT_FILE_VERSION 1
+
+typedef struct {
+    char magic[8];              // COMPACT_FILE_MAGIC
+    StgWord32 version;          // COMPACT_FILE_VERSION
+    StgWord32 word_size;        // sizeof(StgWord)
+    StgWord64 block_size;       // BLOCK_SIZE
+    StgWord64 fingerprint;      // rtsFingerprint()
+    StgWord64 root;             // address of the root
+    StgWord64 n_blocks;
+    StgWord64 n_infos;
+} CompactFileHeader;
+
+typedef struct {
+    StgWord64 address;          // address of the block when written
+    StgWord64 size;             // bytes used in the block
+    StgWord64 offset;           // offset of the contents in the file
+} CompactFileBlock;
+
+typedef struct {
+    StgWord64 address;          // info pointer
+    StgWord64 hash;             // infoTableHash()
+} CompactFileInfo;
+
+struct CompactFile_ {
+    FILE *file;
+    CompactFileHeader header;
+    CompactFileBlock *blocks;
+    bool can_map;               // map the blocks rather than reading them
+};
+
+static StgWord64
+roundUpToBlock (StgWord64 n)
+{
+    return (n + BLOCK_SIZE - 1) & ~(StgWord64)BLOCK_MASK;
+}
+
+static StgWord64
+rtsFingerprint (void)
+{
+    const StgInfoTable *infos[] = {
+        &stg_COMPACT_NFDATA_CLEAN_info,
+        &stg_COMPACT_NFDATA_DIRTY_info,
+        &stg_ARR_WORDS_info,
+        &stg_MUT_ARR_PTRS_FROZEN_CLEAN_info,
+        &stg_SMALL_MUT_ARR_PTRS_FROZEN_CLEAN_info,
+    };
+
+    return XXH64(infos, sizeof(infos), 0);
+}
+
+static StgWord64
+infoTableHash (const StgInfoTable *info)
+{
+    const StgInfoTable *itbl = INFO_PTR_TO_STRUCT(info);
+    StgWord64 hash = XXH64(itbl, sizeof(StgInfoTable), 0);
+
+    if (itbl->type >= CONSTR && itbl->type <= CONSTR_NOCAF) {
+        const char *desc = GET_CON_DESC(itbl_to_con_itbl(itbl));
+        hash = XXH64(desc, strlen(desc), hash);
+    }
+    return hash;
+}
+
+#if defined(OBJFORMAT_ELF)
+typedef struct {
+    const char *start;
+    size_t size;
+    bool found;
+} ImageRange;
+
+static int
+findImageRange (struct dl_phdr_info *info, size_t size STG_UNUSED, void *data)
+{
+    ImageRange *r = data;
+    int n;
+
+    for (n = 0; n < info->dlpi_phnum; n++) {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[n];
+        const char *start = (const char *)info->dlpi_addr + phdr->p_vaddr;
+
+        if (phdr->p_type == PT_LOAD && (phdr->p_flags & PF_R)
+            && r->start >= start
+            && r->start + r->size <= start + phdr->p_memsz) {
+            r->found = true;
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif
+
+// Is [p, p + size) in the program, one of its shared libraries or an object
+// loaded by the RTS linker?
+static bool
+inProgramImage (const void *p, size_t size)
+{
+#if defined(OBJFORMAT_ELF)
+    ImageRange r = { .start = p, .size = size, .found = false };
+    dl_iterate_phdr(findImageRange, &r);
+    if (r.found) {
+        return true;
+    }
+#elif defined(mingw32_HOST_OS)
+    MEMORY_BASIC_INFORMATION mbi;
+    if (VirtualQuery(p, &mbi, sizeof(mbi)) == sizeof(mbi)
+        && mbi.State == MEM_COMMIT && mbi.Type == MEM_IMAGE
+        && !(mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD))
+        && (const char *)p + size
+               <= (const char *)mbi.BaseAddress + mbi.RegionSize) {
+        return true;
+    }
+#elif defined(HAVE_DLFCN_H)
+    Dl_info first, last;
+    if (dladdr(p, &first) && dladdr((const char *)p + size - 1, &last)
+        && first.dli_fbase == last.dli_fbase) {
+        return true;
+    }
+#else
+    // we have no way of checking
+    return true;
+#endif
+    return isObjectCodeRange(p, size);
+}
+
+// Can infoTableHash() look at the info table at this address, which came
+// from a file?
+static bool
+infoTableMapped (const StgInfoTable *info)
+{
+    const StgInfoTable *itbl = INFO_PTR_TO_STRUCT(info);
+
+    if (!inProgramImage(itbl, sizeof(StgInfoTable))) {
+        return false;
+    }
+    if (itbl->type >= CONSTR && itbl->type <= CONSTR_NOCAF) {
+        const StgConInfoTable *con = itbl_to_con_itbl(itbl);
+        if (!inProgramImage(con, sizeof(StgConInfoTable)) ||
+            !inProgramImage(GET_CON_DESC(con), 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int
+seekFile (FILE *f, StgWord64 offset)
+{
+#if defined(mingw32_HOST_OS)
+    return _fseeki64(f, offset, SEEK_SET);
+#else
+    return fseeko(f, offset, SEEK_SET);
+#endif
+}
+
+static int
+getFileSize (FILE *f, StgWord64 *size)
+{
+#if defined(mingw32_HOST_OS)
+    __int64 end;
+    if (_fseeki64(f, 0, SEEK_END) != 0) return -1;
+    end = _ftelli64(f);
+#else
+    off_t end;
+    if (fseeko(f, 0, SEEK_END) != 0) return -1;
+    end = ftello(f);
+#endif
+    if (end < 0) return -1;
+    *size = end;
+    return seekFile(f, 0);
+}
+
+// Returns 0 on success, 1 at the end of the file, and -1 on error
+static int
+readFully (FILE *f, void *buf, size_t size)
+{
+    if (fread(buf, 1, size, f) == size) return 0;
+    return ferror(f) ? -1 : 1;
+}
+
+/* -----------------------------------------------------------------------------
+   Writing
+   -------------------------------------------------------------------------- */
+
+static void
+addInfoTables (HashTable *infos, StgCompactNFDataBlock *block)
+{
+    bdescr *bd = Bdescr((P_)block);
+    StgPtr p = (P_)block + sizeofW(StgCompactNFDataBlock);
+
+    while (p < bd->free) {
+        StgClosure *q = (StgClosure *)p;
+
+        insertHashTable(infos, (StgWord)q->header.info, q->header.info);
+        if (get_itbl(q)->type == COMPACT_NFDATA) {
+            p += sizeofW(StgCompactNFData);
+        } else {
+            p += closure_sizeW(q);
+        }
+    }
+}
+
+int
+compactFileWrite (StgCompactNFDataBlock *first, StgPtr root, const char *path)
+{
+    StgCompactNFData *str = first->owner;
+    StgCompactNFDataBlock *block;
+    CompactFileHeader header;
+    CompactFileBlock *blocks;
+    CompactFileInfo *infos;
+    HashTable *info_tables;
+    StgWord *info_ptrs;
+    StgWord n_blocks, n_infos, i;
+    StgWord64 offset;
+    FILE *f;
+    int ret = -1;
+
+    ASSERT(str->hash == NULL);
+
+    // Save the allocation pointer of the nursery, as
+    // stg_compactGetFirstBlockzh does, so that the sizes are right
+    Bdescr((P_)str->nursery)->free = str->hp;
+
+    n_blocks = 0;
+    for (block = first; block != NULL; block = block->next) {
+        n_blocks++;
+    }
+
+    blocks = stgMallocBytes(n_blocks * sizeof(CompactFileBlock),
+                            "compactFileWrite");
+    info_tables = allocHashTable();
+    for (block = first, i = 0; block != NULL; block = block->next, i++) {
+        bdescr *bd = Bdescr((P_)block);
+        blocks[i].address = (StgWord)block;
+        blocks[i].size = (StgWord)bd->free - (StgWord)bd->start;
+        addInfoTables(info_tables, block);
+    }
+
+    // There is at least the info table of the StgCompactNFData
+    n_infos = keyCountHashTable(info_tables);
+    info_ptrs = stgMallocBytes(n_infos * sizeof(StgWord), "compactFileWrite");
+    infos = stgMallocBytes(n_infos * sizeof(CompactFileInfo),
+                           "compactFileWrite");
+    keysHashTable(info_tables, info_ptrs, n_infos);
+    for (i = 0; i < n_infos; i++) {
+        infos[i].address = info_ptrs[i];
+        infos[i].hash = infoTableHash((const StgInfoTable *)info_ptrs[i]);
+    }
+    stgFree(info_ptrs);
+    freeHashTable(info_tables, NULL);
+
+    offset = roundUpToBlock(sizeof(CompactFileHeader)
+                            + n_blocks * sizeof(CompactFileBlock)
+                            + n_infos * sizeof(CompactFileInfo));
+    for (i = 0; i < n_blocks; i++) {
+        blocks[i].offset = offset;
+        offset += roundUpToBlock(blocks[i].size);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPACT_FILE_MAGIC, sizeof(header.magic));
+    header.version = COMPACT_FILE_VERSION;
+    header.word_size = sizeof(StgWord);
+    header.block_size = BLOCK_SIZE;
+    header.fingerprint = rtsFingerprint();
+    header.root = (StgWord)root;
+    header.n_blocks = n_blocks;
+    header.n_infos = n_infos;
+
+    f = __rts_fopen(path, "wb");
+    if (f == NULL) {
+        goto out;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+        fwrite(blocks, sizeof(CompactFileBlock), n_blocks, f) != n_blocks ||
+        fwrite(infos, sizeof(CompactFileInfo), n_infos, f) != n_infos) {
+        goto close;
+    }
+
+    for (block = first, i = 0; block != NULL; block = block->next, i++) {
+        if (seekFile(f, blocks[i].offset) != 0 ||
+            fwrite(block, 1, blocks[i].size, f) != blocks[i].size) {
+            goto close;
+        }
+    }
+
+    // Pad the last block, so that all of it can be mapped
+    if (seekFile(f, offset - 1) != 0 || fputc(0, f) == EOF) {
+        goto close;
+    }
+
+    ret = 0;
+
+close:
+    if (fclose(f) != 0) {
+        ret = -1;
+    }
+out:
+    stgFree(infos);
+    stgFree(blocks);
+    return ret;
+}
+
+/* -----------------------------------------------------------------------------
+   Loading
+   -------------------------------------------------------------------------- */
+
+// Returns 0 if the file looks like a compact written by this program, 1 if
+// it does not, and -1 on error.
+static int
+checkCompactFile (CompactFile *file, StgWord64 file_size)
+{
+    CompactFileHeader *header = &file->header;
+    CompactFileInfo info;
+    StgWord64 offset, i;
+    int r;
+
+    r = readFully(file->file, header, sizeof(CompactFileHeader));
+    if (r != 0) return r;
+
+    if (memcmp(header->magic, COMPACT_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != COMPACT_FILE_VERSION ||
+        header->word_size != sizeof(StgWord) ||
+        header->block_size != BLOCK_SIZE ||
+        header->fingerprint != rtsFingerprint()) {
+        return 1;
+    }
+
+    // Every block takes at least BLOCK_SIZE bytes of the file; this also
+    // keeps us from allocating silly amounts of memory for a corrupt file
+    if (header->n_blocks == 0 ||
+        header->n_blocks > file_size / BLOCK_SIZE ||
+        header->n_infos > file_size / sizeof(CompactFileInfo)) {
+        return 1;
+    }
+
+    file->blocks = stgMallocBytes(header->n_blocks * sizeof(CompactFileBlock),
+                                  "compactFileOpen");
+    r = readFully(file->file, file->blocks,
+                  header->n_blocks * sizeof(CompactFileBlock));
+    if (r != 0) return r;
+
+    offset = sizeof(CompactFileHeader)
+        + header->n_blocks * sizeof(CompactFileBlock)
+        + header->n_infos * sizeof(CompactFileInfo);
+    for (i = 0; i < header->n_blocks; i++) {
+        CompactFileBlock *b = &file->blocks[i];
+        StgWord64 min_size = sizeof(StgCompactNFDataBlock)
+            + (i == 0 ? sizeof(StgCompactNFData) : 0);
+
+        // The block may be a group of megablocks, see Note [Compact files]
+        if (b->size < min_size ||
+            b->size > file_size ||
+            b->address % BLOCK_SIZE != 0 ||
+            b->offset % BLOCK_SIZE != 0 ||
+            b->offset < offset ||
+            b->offset > file_size ||
+            roundUpToBlock(b->size) > file_size - b->offset) {
+            return 1;
+        }
+        offset = b->offset + roundUpToBlock(b->size);
+    }
+
+    for (i = 0; i < header->n_infos; i++) {
+        r = readFully(file->file, &info, sizeof(CompactFileInfo));
+        if (r != 0) return r;
+        if (!infoTableMapped((const StgInfoTable *)(StgWord)info.address) ||
+            infoTableHash((const StgInfoTable *)(StgWord)info.address)
+                != info.hash) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int
+compactFileOpen (const char *path, CompactFile **pfile)
+{
+    CompactFile *file;
+    StgWord64 file_size;
+    int r;
+
+    file = stgMallocBytes(sizeof(CompactFile), "compactFileOpen");
+    file->blocks = NULL;
+#if defined(HAVE_SYS_MMAN_H)
+    file->can_map = getPageSize() <= BLOCK_SIZE;
+#else
+    file->can_map = false;
+#endif
+
+    file->file = __rts_fopen(path, "rb");
+    if (file->file == NULL) {
+        stgFree(file);
+        return -1;
+    }
+
+    r = getFileSize(file->file, &file_size);
+    if (r == 0) {
+        r = checkCompactFile(file, file_size);
+    }
+    if (r != 0) {
+        int saved_errno = errno;
+        compactFileClose(file);
+        errno = saved_errno;
+        return r;
+    }
+
+    *pfile = file;
+    return 0;
+}
+
+StgWord
+compactFileBlockCount (CompactFile *file)
+{
+    return file->header.n_blocks;
+}
+
+StgPtr
+compactFileBlockAddress (CompactFile *file, StgWord i)
+{
+    ASSERT(i < file->header.n_blocks);
+    return (StgPtr)(StgWord)file->blocks[i].address;
+}
+
+StgWord
+compactFileBlockSize (CompactFile *file, StgWord i)
+{
+    ASSERT(i < file->header.n_blocks);
+    return file->blocks[i].size;
+}
+
+StgPtr
+compactFileRoot (CompactFile *file)
+{
+    return (StgPtr)(StgWord)file->header.root;
+}
+
+int
+compactFileLoadBlock (CompactFile *file, StgWord i,
+                      StgCompactNFDataBlock *block)
+{
+    CompactFileBlock *b = &file->blocks[i];
+    bdescr *bd = Bdescr((P_)block);
+
+    ASSERT(i < file->header.n_blocks);
+    // a group of megablocks may have more blocks than we need
+    ASSERT((StgWord)bd->blocks * BLOCK_SIZE >= roundUpToBlock(b->size));
+
+#if defined(HAVE_SYS_MMAN_H)
+    if (file->can_map) {
+        void *p = mmap(block, roundUpToBlock(b->size), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_FIXED, fileno(file->file),
+                       (off_t)b->offset);
+        if (p != MAP_FAILED) {
+            bd->flags |= BF_COMPACT_MAPPED;
+            return 0;
+        }
+
+        // A failed mmap(MAP_FIXED) may have removed the old mapping already.
+        // Read the blocks instead from now on.
+        compactFileUnmapBlock(bd);
+        file->can_map = false;
+    }
+#endif
+
+    if (seekFile(file->file, b->offset) != 0) {
+        return -1;
+    }
+    switch (readFully(file->file, block, b->size)) {
+    case 0:
+        return 0;
+    case 1:
+        // The file was truncated since we opened it
+        errno = EIO;
+        return -1;
+    default:
+        return -1;
+    }
+}
+
+void
+compactFileClose (CompactFile *file)
+{
+    // The mappings of the blocks stay valid after the file is closed
+    fclose(file->file);
+    stgFree(file->blocks);
+    stgFree(file);
+}
+
+void
+compactFileUnmapBlock (bdescr *bd)
+{
+#if defined(HAVE_SYS_MMAN_H)
+    void *p = mmap(bd->start, (W_)bd->blocks * BLOCK_SIZE,
+                   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_FIXED,
+                   -1, 0);
+    if (p == MAP_FAILED) {
+        barf("compactFileUnmapBlock: mmap failed: %s", strerror(errno));
+    }
+#endif
+    bd->flags &= ~BF_COMPACT_MAPPED;
+}
@@ -0,0 +1,13 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2022
+ *
+ * Writing compact regions to files, and loading them back
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+// Give the memory of a compact block that was mapped from a file back to the
+// block allocator as ordinary memory.
+RTS_PRIVATE void compactFileUnmapBlock(bdescr *bd);
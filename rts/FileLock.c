@@ -93,7 +93,8 @@ lockFile(StgWord64 id, StgWord64 dev, StgWord64 ino, int for_writing)
         lock->device = dev;
         lock->inode  = ino;
         lock->readers = for_writing ? -1 : 1;
-        insertHashTable_(obj_hash, (StgWord)lock, (void *)lock, hashLock);
+        insertHashTable_(obj_hash, (StgWord)lock, (void *)lock, hashLock,
+                         cmpLocks);
         insertHashTable(key_hash, id, lock);
         RELEASE_LOCK(&file_lock_mutex);
         return 0;
@@ -3,9 +3,8 @@
  * (c) The AQUA Project, Glasgow University, 1995-1998
  * (c) The GHC Team, 1999
  *
- * Dynamically expanding linear hash tables, as described in
- * Per-\AAke Larson, ``Dynamic Hash Tables,'' CACM 31(4), April 1988,
- * pp. 446 -- 457.
+ * Dynamically expanding open-addressing hash tables, in the style of
+ * "Swiss tables" (Abseil's flat_hash_map, see Note [Hash table layout]).
  * -------------------------------------------------------------------------- */
 
 #include "rts/PosixSource.h"
@@ -30,37 +29,73 @@
 
 #include <string.h>
 
-#define HSEGSIZE    1024    /* Size of a single hash table segment */
-                            /* Also the minimum size of a hash table */
-#define HDIRSIZE    1024    /* Size of the segment directory */
-                            /* Maximum hash table size is HSEGSIZE * HDIRSIZE */
-#define HLOAD       5       /* Maximum average load of a single hash bucket */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Note [Hash table layout]
+   ~~~~~~~~~~~~~~~~~~~~~~~~
+   A HashTable is a single array of `capacity` (key, data) slots, with
+   open addressing, plus an array of one control byte per slot:
+
+     EMPTY    0b10000000   the slot has never been used
+     DELETED  0b11111110   the slot held an entry that has been removed
+     full     0b0hhhhhhh   the slot is in use, and hhhhhhh are the low
+                           7 bits (H2) of the hash of its key
+
+   The other bits of the hash (H1) choose where probing starts. We probe a
+   whole group of GROUP_SIZE control bytes at a time: with SSE2 a group is
+   16 bytes compared in a couple of instructions, otherwise it is 8 bytes
+   compared with bit tricks on a 64-bit word. Only the slots whose control
+   byte matches H2 are compared with the key, so most lookups compare one
+   key and touch two cache lines, instead of chasing a bucket chain. A
+   lookup stops at the first group containing an EMPTY byte. Successive
+   groups are visited with growing strides (triangular probing), which
+   visits every group since the capacity is a power of two.
+
+   So that a group can start at any slot, the first GROUP_SIZE - 1 control
+   bytes are mirrored after the last one.
+
+   A removed entry leaves a DELETED byte behind if some lookup may have
+   probed past its slot, i.e. if the slot was ever in a run of GROUP_SIZE
+   non-EMPTY bytes, and an EMPTY one otherwise. Insertions reuse DELETED
+   slots. `growth_left` counts the EMPTY slots that may still be filled
+   while keeping the load (including DELETED slots) under 7/8; when it
+   runs out we rehash into a fresh array, twice as large if the table is
+   more than 7/16 full, or of the same size to get rid of DELETED slots
+   otherwise.
+
+   Keys are unique: inserting a key that is already present replaces its
+   entry (see Hash.h).
+*/
+
+#if defined(__SSE2__)
+#define GROUP_SIZE  16
+typedef uint32_t BitMask;   /* bit i is set for a match at slot i */
+#else
+#define GROUP_SIZE  8
+typedef uint64_t BitMask;   /* bit 8*i+7 is set for a match at slot i */
+#endif
+
+#define HMINSIZE    16      /* Minimum capacity of a hash table */
 
-#define HCHUNK      (1024 * sizeof(W_) / sizeof(HashList))
-                            /* Number of HashList cells to allocate in one go */
+#define CTRL_EMPTY   ((int8_t) -128)
+#define CTRL_DELETED ((int8_t) -2)
 
+#define H1(h)       ((h) >> 7)
+#define H2(h)       ((int8_t) ((h) & 0x7f))
 
-/* Linked list of (key, data) pairs for separate chaining */
-typedef struct hashlist {
+typedef struct {
     StgWord key;
     const void *data;
-    struct hashlist *next;  /* Next cell in bucket chain (same hash value) */
-} HashList;
-
-typedef struct chunklist {
-  struct chunklist *next;
-} HashListChunk;
+} HashSlot;
 
 struct hashtable {
-    int split;              /* Next bucket to split when expanding */
-    int max;                /* Max bucket of smaller table */
-    int mask1;              /* Mask for doing the mod of h_1 (smaller table) */
-    int mask2;              /* Mask for doing the mod of h_2 (larger table) */
+    HashSlot *slots;        /* capacity slots, followed by the control bytes */
+    int8_t *ctrl;           /* capacity + GROUP_SIZE - 1 control bytes */
+    StgWord mask;           /* capacity - 1 */
     int kcount;             /* Number of keys */
-    int bcount;             /* Number of buckets */
-    HashList **dir[HDIRSIZE];   /* Directory of segments */
-    HashList *freeList;         /* free list of HashLists */
-    HashListChunk *chunks;      /* list of HashListChunks so we can later free them */
+    int growth_left;        /* EMPTY slots we can fill before rehashing */
 };
 
 /* Create an identical structure, but is distinct on a type level,
@@ -70,46 +105,37 @@ struct hashtable {
 struct strhashtable { struct hashtable table; };
 
 /* -----------------------------------------------------------------------------
- * Hash first using the smaller table.  If the bucket is less than the
- * next bucket to be split, re-hash using the larger table.
+ * Hash functions. The table takes care of reducing the hash to a slot; both
+ * the low 7 bits and the rest should be well mixed.
  * -------------------------------------------------------------------------- */
 int
-hashWord(const HashTable *table, StgWord key)
+hashWord(const HashTable *table STG_UNUSED, StgWord key)
 {
-    int bucket;
-
-    /* Strip the boring zero bits */
-    key >>= sizeof(StgWord);
-
-    /* Mod the size of the hash table (a power of 2) */
-    bucket = key & table->mask1;
-
-    if (bucket < table->split) {
-        /* Mod the size of the expanded hash table (also a power of 2) */
-        bucket = key & table->mask2;
-    }
-    return bucket;
+#if SIZEOF_VOID_P == 8
+    /* Fibonacci hashing: the high half of the product depends on every bit
+       of the key. */
+    return (int) ((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+#else
+    /* The MurmurHash3 finaliser */
+    StgWord32 h = key;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return (int) h;
+#endif
 }
 
 int
-hashStr(const HashTable *table, StgWord w)
+hashStr(const HashTable *table STG_UNUSED, StgWord w)
 {
     const char *key = (char*) w;
 #if defined(x86_64_HOST_ARCH)
-    StgWord h = XXH64 (key, strlen(key), 1048583);
+    return (int) XXH64 (key, strlen(key), 1048583);
 #else
-    StgWord h = XXH32 (key, strlen(key), 1048583);
+    return (int) XXH32 (key, strlen(key), 1048583);
 #endif
-
-    /* Mod the size of the hash table (a power of 2) */
-    int bucket = h & table->mask1;
-
-    if (bucket < table->split) {
-        /* Mod the size of the expanded hash table (also a power of 2) */
-        bucket = h & table->mask2;
-    }
-
-    return bucket;
 }
 
 STATIC_INLINE int
@@ -124,102 +150,221 @@ compareStr(StgWord key1, StgWord key2)
     return (strcmp((char *)key1, (char *)key2) == 0);
 }
 
-
 /* -----------------------------------------------------------------------------
- * Allocate a new segment of the dynamically growing hash table.
+ * Probing a group of control bytes
  * -------------------------------------------------------------------------- */
 
-STATIC_INLINE void
-allocSegment(HashTable *table, int segment)
+#if defined(__SSE2__)
+
+STATIC_INLINE BitMask
+matchByte(const int8_t *ctrl, int8_t h2)
 {
-    table->dir[segment] = stgMallocBytes(HSEGSIZE * sizeof(HashList *),
-                                         "allocSegment");
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return (BitMask) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
 }
 
+STATIC_INLINE BitMask
+matchEmpty(const int8_t *ctrl)
+{
+    return matchByte(ctrl, CTRL_EMPTY);
+}
 
-/* -----------------------------------------------------------------------------
- * Expand the larger hash table by one bucket, and split one bucket
- * from the smaller table into two parts.  Only the bucket referenced
- * by @table->split@ is affected by the expansion.
- * -------------------------------------------------------------------------- */
+STATIC_INLINE BitMask
+matchEmptyOrDeleted(const int8_t *ctrl)
+{
+    /* only EMPTY and DELETED have their top bit set */
+    return (BitMask) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+}
 
-STATIC_INLINE void
-expand(HashTable *table, HashFunction f)
-{
-    int oldsegment;
-    int oldindex;
-    int newbucket;
-    int newsegment;
-    int newindex;
-    HashList *hl;
-    HashList *next;
-    HashList *old, *new;
-
-    if (table->split + table->max >= HDIRSIZE * HSEGSIZE)
-        /* Wow!  That's big.  Too big, so don't expand. */
-        return;
+STATIC_INLINE int
+lowestMatch(BitMask m)
+{
+    return __builtin_ctz(m);
+}
 
-    /* Calculate indices of bucket to split */
-    oldsegment = table->split / HSEGSIZE;
-    oldindex = table->split % HSEGSIZE;
+/* number of slots before the first match, counting from the end */
+STATIC_INLINE int
+leadingNonMatches(BitMask m)
+{
+    return m == 0 ? GROUP_SIZE : __builtin_clz(m) - (32 - GROUP_SIZE);
+}
 
-    newbucket = table->max + table->split;
+#else
 
-    /* And the indices of the new bucket */
-    newsegment = newbucket / HSEGSIZE;
-    newindex = newbucket % HSEGSIZE;
+#define LSBS UINT64_C(0x0101010101010101)
+#define MSBS UINT64_C(0x8080808080808080)
 
-    if (newindex == 0)
-        allocSegment(table, newsegment);
+STATIC_INLINE uint64_t
+loadGroup(const int8_t *ctrl)
+{
+    uint64_t group;
+    memcpy(&group, ctrl, sizeof(group));
+#if defined(WORDS_BIGENDIAN)
+    group = __builtin_bswap64(group);
+#endif
+    return group;
+}
+
+STATIC_INLINE BitMask
+matchByte(const int8_t *ctrl, int8_t h2)
+{
+    /* May report a false positive in the byte after a real match, which is
+       harmless since we compare the keys anyway. */
+    uint64_t x = loadGroup(ctrl) ^ (LSBS * (uint8_t) h2);
+    return (x - LSBS) & ~x & MSBS;
+}
+
+STATIC_INLINE BitMask
+matchEmpty(const int8_t *ctrl)
+{
+    /* EMPTY is the only control byte with bit 7 set and bit 1 clear */
+    uint64_t group = loadGroup(ctrl);
+    return group & ~(group << 6) & MSBS;
+}
+
+STATIC_INLINE BitMask
+matchEmptyOrDeleted(const int8_t *ctrl)
+{
+    return loadGroup(ctrl) & MSBS;
+}
+
+STATIC_INLINE int
+lowestMatch(BitMask m)
+{
+    return __builtin_ctzll(m) >> 3;
+}
+
+STATIC_INLINE int
+leadingNonMatches(BitMask m)
+{
+    return m == 0 ? GROUP_SIZE : __builtin_clzll(m) >> 3;
+}
 
-    if (++table->split == table->max) {
-        table->split = 0;
-        table->max *= 2;
-        table->mask1 = table->mask2;
-        table->mask2 = table->mask2 << 1 | 1;
+#endif
+
+STATIC_INLINE StgWord
+capacity(const HashTable *table)
+{
+    return table->mask + 1;
+}
+
+/* The most slots we fill before rehashing: 7/8 of the capacity */
+STATIC_INLINE int
+maxLoad(StgWord cap)
+{
+    return cap - cap / 8;
+}
+
+STATIC_INLINE void
+setCtrl(HashTable *table, StgWord i, int8_t c)
+{
+    table->ctrl[i] = c;
+    /* See Note [Hash table layout] for the mirrored bytes */
+    if (i < GROUP_SIZE - 1) {
+        table->ctrl[capacity(table) + i] = c;
     }
-    table->bcount++;
-
-    /* Split the bucket, paying no attention to the original order */
-
-    old = new = NULL;
-    for (hl = table->dir[oldsegment][oldindex]; hl != NULL; hl = next) {
-        next = hl->next;
-        if (f(table, hl->key) == newbucket) {
-            hl->next = new;
-            new = hl;
-        } else {
-            hl->next = old;
-            old = hl;
+}
+
+/* -----------------------------------------------------------------------------
+ * Allocate the slots and control bytes of a table of the given capacity.
+ * -------------------------------------------------------------------------- */
+
+STATIC_INLINE size_t
+tableBytes(StgWord cap)
+{
+    return cap * sizeof(HashSlot) + cap + GROUP_SIZE - 1;
+}
+
+static void
+allocSlots(HashTable *table, StgWord cap)
+{
+    table->slots = stgMallocBytes(tableBytes(cap), "allocSlots");
+    table->ctrl = (int8_t *) (table->slots + cap);
+    memset(table->ctrl, CTRL_EMPTY, cap + GROUP_SIZE - 1);
+    table->mask = cap - 1;
+    table->growth_left = maxLoad(cap) - table->kcount;
+}
+
+/* Find the slot of `key`, or return -1 */
+STATIC_INLINE long
+findSlot(const HashTable *table, StgWord key, StgWord32 h,
+         CompareFunction cmp)
+{
+    StgWord pos = H1(h) & table->mask;
+    StgWord stride = 0;
+
+    while (1) {
+        const int8_t *group = table->ctrl + pos;
+        for (BitMask m = matchByte(group, H2(h)); m != 0; m &= m - 1) {
+            StgWord i = (pos + lowestMatch(m)) & table->mask;
+            if (cmp(table->slots[i].key, key)) {
+                return i;
+            }
+        }
+        if (matchEmpty(group) != 0) {
+            /* It's not there */
+            return -1;
         }
+        stride += GROUP_SIZE;
+        pos = (pos + stride) & table->mask;
     }
-    table->dir[oldsegment][oldindex] = old;
-    table->dir[newsegment][newindex] = new;
+}
+
+/* Find an EMPTY or DELETED slot for a key with hash `h` */
+STATIC_INLINE StgWord
+findFreeSlot(const HashTable *table, StgWord32 h)
+{
+    StgWord pos = H1(h) & table->mask;
+    StgWord stride = 0;
 
-    return;
+    while (1) {
+        BitMask m = matchEmptyOrDeleted(table->ctrl + pos);
+        if (m != 0) {
+            return (pos + lowestMatch(m)) & table->mask;
+        }
+        stride += GROUP_SIZE;
+        pos = (pos + stride) & table->mask;
+    }
 }
 
-STATIC_INLINE void*
-lookupHashTable_inlined(const HashTable *table, StgWord key,
-                        HashFunction f, CompareFunction cmp)
+/* -----------------------------------------------------------------------------
+ * Move the entries into a fresh array, dropping the DELETED slots, and
+ * doubling the capacity if the table is getting full.
+ * -------------------------------------------------------------------------- */
+
+static void
+rehash(HashTable *table, HashFunction f)
 {
-    int bucket;
-    int segment;
-    int index;
+    HashSlot *old_slots = table->slots;
+    int8_t *old_ctrl = table->ctrl;
+    StgWord old_cap = capacity(table);
+    StgWord new_cap = old_cap;
 
-    HashList *hl;
+    if ((StgWord) table->kcount * 16 > old_cap * 7) {
+        new_cap = old_cap * 2;
+    }
 
-    bucket = f(table, key);
-    segment = bucket / HSEGSIZE;
-    index = bucket % HSEGSIZE;
+    allocSlots(table, new_cap);
 
-    for (hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-        if (cmp(hl->key, key))
-            return (void *) hl->data;
+    for (StgWord i = 0; i < old_cap; i++) {
+        if (old_ctrl[i] >= 0) {
+            StgWord key = old_slots[i].key;
+            StgWord32 h = f(table, key);
+            StgWord j = findFreeSlot(table, h);
+            setCtrl(table, j, H2(h));
+            table->slots[j] = old_slots[i];
+        }
     }
 
-    /* It's not there */
-    return NULL;
+    stgFree(old_slots);
+}
+
+STATIC_INLINE void*
+lookupHashTable_inlined(const HashTable *table, StgWord key,
+                        HashFunction f, CompareFunction cmp)
+{
+    long i = findSlot(table, key, f(table, key), cmp);
+    return i < 0 ? NULL : (void *) table->slots[i].data;
 }
 
 void *
@@ -248,159 +393,92 @@ lookupStrHashTable(const StrHashTable* table, const char* key)
 // If the table is modified concurrently, the function behavior is undefined.
 //
 int keysHashTable(HashTable *table, StgWord keys[], int szKeys) {
-    int segment, index;
     int k = 0;
-    HashList *hl;
+    StgWord cap = capacity(table);
 
-
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    segment = (table->max + table->split - 1) / HSEGSIZE;
-    index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0 && k < szKeys) {
-        while (index >= 0 && k < szKeys) {
-            hl = table->dir[segment][index];
-            while (hl && k < szKeys) {
-                keys[k] = hl->key;
-                k += 1;
-                hl = hl->next;
-            }
-            index--;
+    for (StgWord i = 0; i < cap && k < szKeys; i++) {
+        if (table->ctrl[i] >= 0) {
+            keys[k++] = table->slots[i].key;
         }
-        segment--;
-        index = HSEGSIZE - 1;
     }
     return k;
 }
 
-/* -----------------------------------------------------------------------------
- * We allocate the hashlist cells in large chunks to cut down on malloc
- * overhead.  Although we keep a free list of hashlist cells, we make
- * no effort to actually return the space to the malloc arena. Eventually
- * they will all be freed when we free the HashListChunks.
- * -------------------------------------------------------------------------- */
-
-static HashList *
-allocHashList (HashTable *table)
-{
-    if (table->freeList != NULL) {
-        HashList *hl = table->freeList;
-        table->freeList = hl->next;
-        return hl;
-    } else {
-        /* We allocate one block of memory which contains:
-         *
-         *  1. A HashListChunk, which gets linked onto HashTable.chunks.
-         *     This forms a list of all chunks associated with the HashTable
-         *     and is what we will free when we free the HashTable.
-         *
-         *  2. Several HashLists. One of these will get returned. The rest are
-         *     placed on the freeList.
-         *
-         */
-        HashListChunk *cl = stgMallocBytes(sizeof(HashListChunk) + HCHUNK * sizeof(HashList), "allocHashList");
-        HashList *hl = (HashList *) &cl[1];
-        cl->next = table->chunks;
-        table->chunks = cl;
-
-        table->freeList = hl + 1;
-        HashList *p = table->freeList;
-        for (; p < hl + HCHUNK - 1; p++)
-            p->next = p + 1;
-        p->next = NULL;
-        return hl;
-    }
-}
-
-static void
-freeHashList (HashTable *table, HashList *hl)
-{
-    // We place the HashList on the freeList. We make no attempt to bound the
-    // size of the free list for the time being. The HashLists on the freeList
-    // are freed when the HashTable itself is freed as a result of freeing the
-    // HashListChunks.
-    hl->next = table->freeList;
-    table->freeList = hl;
-}
-
 STATIC_INLINE void
 insertHashTable_inlined(HashTable *table, StgWord key,
-                        const void *data, HashFunction f)
+                        const void *data, HashFunction f, CompareFunction cmp)
 {
-    int bucket;
-    int segment;
-    int index;
-    HashList *hl;
-
-    // Disable this assert; sometimes it's useful to be able to
-    // overwrite entries in the hash table.
-    // ASSERT(lookupHashTable(table, key) == NULL);
-
-    /* When the average load gets too high, we expand the table */
-    if (++table->kcount >= HLOAD * table->bcount)
-        expand(table, f);
+    StgWord32 h = f(table, key);
 
-    bucket = f(table, key);
-    segment = bucket / HSEGSIZE;
-    index = bucket % HSEGSIZE;
+    /* Inserting a key that is already there replaces its entry */
+    long i = findSlot(table, key, h, cmp);
+    if (i >= 0) {
+        table->slots[i].key = key;
+        table->slots[i].data = data;
+        return;
+    }
 
-    hl = allocHashList(table);
+    if (table->growth_left == 0) {
+        rehash(table, f);
+    }
 
-    hl->key = key;
-    hl->data = data;
-    hl->next = table->dir[segment][index];
-    table->dir[segment][index] = hl;
+    StgWord j = findFreeSlot(table, h);
+    if (table->ctrl[j] == CTRL_EMPTY) {
+        table->growth_left--;
+    }
+    setCtrl(table, j, H2(h));
+    table->slots[j].key = key;
+    table->slots[j].data = data;
+    table->kcount++;
 }
 
 void
 insertHashTable_(HashTable *table, StgWord key,
-                 const void *data, HashFunction f)
+                 const void *data, HashFunction f, CompareFunction cmp)
 {
-    return insertHashTable_inlined(table, key, data, f);
+    insertHashTable_inlined(table, key, data, f, cmp);
 }
 
 void
 insertHashTable(HashTable *table, StgWord key, const void *data)
 {
-    insertHashTable_inlined(table, key, data, hashWord);
+    insertHashTable_inlined(table, key, data, hashWord, compareWord);
 }
 
 void
 insertStrHashTable(StrHashTable *table, const char * key, const void *data)
 {
-    insertHashTable_inlined(&table->table, (StgWord) key, data, hashStr);
+    insertHashTable_inlined(&table->table, (StgWord) key, data,
+                            hashStr, compareStr);
 }
 
 STATIC_INLINE void*
 removeHashTable_inlined(HashTable *table, StgWord key, const void *data,
                         HashFunction f, CompareFunction cmp)
 {
-    int bucket;
-    int segment;
-    int index;
-    HashList *hl;
-    HashList *prev = NULL;
-
-    bucket = f(table, key);
-    segment = bucket / HSEGSIZE;
-    index = bucket % HSEGSIZE;
-
-    for (hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-        if (cmp(hl->key, key) && (data == NULL || hl->data == data)) {
-            if (prev == NULL)
-                table->dir[segment][index] = hl->next;
-            else
-                prev->next = hl->next;
-            freeHashList(table,hl);
-            table->kcount--;
-            return (void *) hl->data;
-        }
-        prev = hl;
+    long i = findSlot(table, key, f(table, key), cmp);
+
+    if (i < 0 || (data != NULL && table->slots[i].data != data)) {
+        /* It's not there */
+        ASSERT(data == NULL);
+        return NULL;
     }
 
-    /* It's not there */
-    ASSERT(data == NULL);
-    return NULL;
+    /* If the slot has never been part of a full group, no lookup can have
+       probed past it, so it can go back to EMPTY. See
+       Note [Hash table layout]. */
+    StgWord before = (i - GROUP_SIZE) & table->mask;
+    int empty_before = leadingNonMatches(matchEmpty(table->ctrl + before));
+    BitMask empty_after = matchEmpty(table->ctrl + i);
+    int n_after = empty_after == 0 ? GROUP_SIZE : lowestMatch(empty_after);
+    if (empty_before + n_after < GROUP_SIZE) {
+        setCtrl(table, i, CTRL_EMPTY);
+        table->growth_left++;
+    } else {
+        setCtrl(table, i, CTRL_DELETED);
+    }
+    table->kcount--;
+    return (void *) table->slots[i].data;
 }
 
 void*
@@ -432,34 +510,16 @@ removeStrHashTable(StrHashTable *table, const char * key, const void *data)
 void
 freeHashTable(HashTable *table, void (*freeDataFun)(void *) )
 {
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    long segment = (table->max + table->split - 1) / HSEGSIZE;
-    long index = (table->max + table->split - 1) % HSEGSIZE;
-
-    /* Free table segments */
-    while (segment >= 0) {
-        while (index >= 0) {
-            HashList *next;
-            for (HashList *hl = table->dir[segment][index]; hl != NULL; hl = next) {
-                next = hl->next;
-                if (freeDataFun != NULL)
-                    (*freeDataFun)((void *) hl->data);
+    if (freeDataFun != NULL) {
+        StgWord cap = capacity(table);
+        for (StgWord i = 0; i < cap; i++) {
+            if (table->ctrl[i] >= 0) {
+                (*freeDataFun)((void *) table->slots[i].data);
             }
-            index--;
         }
-        stgFree(table->dir[segment]);
-        segment--;
-        index = HSEGSIZE - 1;
-    }
-
-    /* Free chunks */
-    HashListChunk *cl = table->chunks;
-    while (cl != NULL) {
-        HashListChunk *old = cl;
-        cl = cl->next;
-        stgFree(old);
     }
 
+    stgFree(table->slots);
     stgFree(table);
 }
 
@@ -470,88 +530,51 @@ freeHashTable(HashTable *table, void (*freeDataFun)(void *) )
 void
 mapHashTable(HashTable *table, void *data, MapHashFn fn)
 {
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    long segment = (table->max + table->split - 1) / HSEGSIZE;
-    long index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0) {
-        while (index >= 0) {
-            for (HashList *hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-                fn(data, hl->key, hl->data);
-            }
-            index--;
+    StgWord cap = capacity(table);
+    for (StgWord i = 0; i < cap; i++) {
+        if (table->ctrl[i] >= 0) {
+            fn(data, table->slots[i].key, table->slots[i].data);
         }
-        segment--;
-        index = HSEGSIZE - 1;
     }
 }
 
 void
 mapHashTableKeys(HashTable *table, void *data, MapHashFnKeys fn)
 {
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    long segment = (table->max + table->split - 1) / HSEGSIZE;
-    long index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0) {
-        while (index >= 0) {
-            for (HashList *hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-                fn(data, &hl->key, hl->data);
-            }
-            index--;
+    StgWord cap = capacity(table);
+    for (StgWord i = 0; i < cap; i++) {
+        if (table->ctrl[i] >= 0) {
+            fn(data, &table->slots[i].key, table->slots[i].data);
         }
-        segment--;
-        index = HSEGSIZE - 1;
     }
 }
 
 void
 iterHashTable(HashTable *table, void *data, IterHashFn fn)
 {
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    long segment = (table->max + table->split - 1) / HSEGSIZE;
-    long index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0) {
-        while (index >= 0) {
-            for (HashList *hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-                if (!fn(data, hl->key, hl->data)) {
-                    return;
-                }
+    StgWord cap = capacity(table);
+    for (StgWord i = 0; i < cap; i++) {
+        if (table->ctrl[i] >= 0) {
+            if (!fn(data, table->slots[i].key, table->slots[i].data)) {
+                return;
             }
-            index--;
         }
-        segment--;
-        index = HSEGSIZE - 1;
     }
 }
 
 /* -----------------------------------------------------------------------------
- * When we initialize a hash table, we set up the first segment as well,
- * initializing all of the first segment's hash buckets to NULL.
+ * When we initialize a hash table, we allocate room for HMINSIZE slots, all
+ * of them EMPTY.
  * -------------------------------------------------------------------------- */
 
 HashTable *
 allocHashTable(void)
 {
     HashTable *table;
-    HashList **hb;
 
     table = stgMallocBytes(sizeof(HashTable),"allocHashTable");
-
-    allocSegment(table, 0);
-
-    for (hb = table->dir[0]; hb < table->dir[0] + HSEGSIZE; hb++)
-        *hb = NULL;
-
-    table->split = 0;
-    table->max = HSEGSIZE;
-    table->mask1 = HSEGSIZE - 1;
-    table->mask2 = 2 * HSEGSIZE - 1;
     table->kcount = 0;
-    table->bcount = HSEGSIZE;
-    table->freeList = NULL;
-    table->chunks = NULL;
+    allocSlots(table, HMINSIZE);
 
     return table;
 }
@@ -560,3 +583,8 @@ int keyCountHashTable (HashTable *table)
 {
     return table->kcount;
 }
+
+size_t memoryUsageHashTable (const HashTable *table)
+{
+    return sizeof(HashTable) + tableBytes(capacity(table));
+}
@@ -18,6 +18,9 @@ typedef struct strhashtable StrHashTable;
  * but when the value is looked up or removed, the value is returned without the
  * `const` so that calling function can mutate what the pointer points to if it
  * needs to.
+ *
+ * Keys are unique: inserting a key that is already in the table replaces
+ * both the stored key and its value.
  */
 HashTable * allocHashTable  ( void );
 void        insertHashTable ( HashTable *table, StgWord key, const void *data );
@@ -26,6 +29,9 @@ void *      removeHashTable ( HashTable *table, StgWord key, const void *data );
 
 int keyCountHashTable (HashTable *table);
 
+// The number of bytes allocated for the table
+size_t memoryUsageHashTable (const HashTable *table);
+
 // Puts up to szKeys keys of the hash table into the given array. Returns the
 // actual amount of keys that have been retrieved.
 //
@@ -66,13 +72,17 @@ void *      removeStrHashTable ( StrHashTable *table, const char * key,
  * it's not guaranteed. Either way, the functions are parameters
  * as the types should be statically known and thus
  * storing them is unnecessary.
+ *
+ * The HashFunction should return a hash with all of its 32 bits well
+ * mixed; hashWord can be used to finish off a hash of a compound key.
  */
 typedef int HashFunction(const HashTable *table, StgWord key);
 typedef int CompareFunction(StgWord key1, StgWord key2);
 int hashWord(const HashTable *table, StgWord key);
 int hashStr(const HashTable *table, StgWord w);
 void        insertHashTable_ ( HashTable *table, StgWord key,
-                               const void *data, HashFunction f );
+                               const void *data, HashFunction f,
+                               CompareFunction cmp );
 void *      lookupHashTable_ ( const HashTable *table, StgWord key,
                                HashFunction f, CompareFunction cmp );
 void *      removeHashTable_ ( HashTable *table, StgWord key,
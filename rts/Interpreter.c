@@ -50,6 +50,53 @@
 
 /* #define INTERP_STATS */
 
+/* Note [Threaded dispatch in the interpreter]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   interpretBCO decodes each instruction with a switch on its opcode, and
+   every instruction ends by jumping back to the switch. A switch compiles
+   to a bounds check and a single indirect jump shared by all instructions,
+   which the branch predictor has little chance of predicting.
+
+   So when the C compiler supports labels as values, each instruction
+   instead ends with NEXT_INSTRUCTION, which fetches the next opcode and
+   jumps straight to its label through the jumptable in interpretBCO. Each
+   instruction then has an indirect jump of its own, whose target depends on
+   the instruction that follows it, and which is much easier to predict.
+   INSTRUCTION(op) gives each case of the switch both its case label and
+   the label used by the jumptable, so the switch is still used for the
+   first instruction of a BCO and by compilers without labels as values.
+
+   DEBUG and INTERP_STATS builds always go back to the switch, at nextInsn,
+   where they trace the instruction or count it.
+
+   The jumptable only has entries for the opcodes in rts/Bytecodes.h, so it
+   must be extended when an instruction is added. Any other opcode, e.g. from
+   a corrupt BCO, jumps to the default case of the switch, which barfs.
+
+   The bytecode assembler also fuses a few common pairs of instructions into
+   one, saving a dispatch (see the peephole optimisation in mkProtoBCO in
+   GHC.StgToByteCode):
+
+     PUSH_L o; ENTER          ==> PUSH_L_ENTER o
+     SLIDE n by; ENTER        ==> SLIDE_ENTER n by
+*/
+
+#if defined(__GNUC__) && !defined(DEBUG) && !defined(INTERP_STATS)
+#define INTERP_THREADED_DISPATCH 1
+#endif
+
+#if defined(INTERP_THREADED_DISPATCH)
+#define INSTRUCTION(op) case op: lbl_##op
+#define NEXT_INSTRUCTION                        \
+    do {                                        \
+        bci = BCO_NEXT;                         \
+        goto *jumptable[bci & 0xFF];            \
+    } while (0)
+#else
+#define INSTRUCTION(op) case op
+#define NEXT_INSTRUCTION goto nextInsn
+#endif
+
 
 /* Sp points to the lowest live word on the stack. */
 
@@ -1016,11 +1063,95 @@ run_BCO:
         int bcoSize = bco->instrs->bytes / sizeof(StgWord16);
         IF_DEBUG(interpreter,debugBelch("bcoSize = %d\n", bcoSize));
 
+#if defined(INTERP_THREADED_DISPATCH)
+        // See Note [Threaded dispatch in the interpreter]
+#define JUMP_TARGET(op) [op] = &&lbl_##op
+        static const void *const jumptable[256] = {
+            // unknown opcodes, including 0 and 37 (was
+            // bci_PUSH_APPLY_PPPPPPP), go to the default case of the switch
+            [0 ... 255] = &&lbl_default,
+            JUMP_TARGET(bci_STKCHECK),
+            JUMP_TARGET(bci_PUSH_L),
+            JUMP_TARGET(bci_PUSH_LL),
+            JUMP_TARGET(bci_PUSH_LLL),
+            JUMP_TARGET(bci_PUSH8),
+            JUMP_TARGET(bci_PUSH16),
+            JUMP_TARGET(bci_PUSH32),
+            JUMP_TARGET(bci_PUSH8_W),
+            JUMP_TARGET(bci_PUSH16_W),
+            JUMP_TARGET(bci_PUSH32_W),
+            JUMP_TARGET(bci_PUSH_G),
+            JUMP_TARGET(bci_PUSH_ALTS),
+            JUMP_TARGET(bci_PUSH_ALTS_P),
+            JUMP_TARGET(bci_PUSH_ALTS_N),
+            JUMP_TARGET(bci_PUSH_ALTS_F),
+            JUMP_TARGET(bci_PUSH_ALTS_D),
+            JUMP_TARGET(bci_PUSH_ALTS_L),
+            JUMP_TARGET(bci_PUSH_ALTS_V),
+            JUMP_TARGET(bci_PUSH_PAD8),
+            JUMP_TARGET(bci_PUSH_PAD16),
+            JUMP_TARGET(bci_PUSH_PAD32),
+            JUMP_TARGET(bci_PUSH_UBX8),
+            JUMP_TARGET(bci_PUSH_UBX16),
+            JUMP_TARGET(bci_PUSH_UBX32),
+            JUMP_TARGET(bci_PUSH_UBX),
+            JUMP_TARGET(bci_PUSH_APPLY_N),
+            JUMP_TARGET(bci_PUSH_APPLY_F),
+            JUMP_TARGET(bci_PUSH_APPLY_D),
+            JUMP_TARGET(bci_PUSH_APPLY_L),
+            JUMP_TARGET(bci_PUSH_APPLY_V),
+            JUMP_TARGET(bci_PUSH_APPLY_P),
+            JUMP_TARGET(bci_PUSH_APPLY_PP),
+            JUMP_TARGET(bci_PUSH_APPLY_PPP),
+            JUMP_TARGET(bci_PUSH_APPLY_PPPP),
+            JUMP_TARGET(bci_PUSH_APPLY_PPPPP),
+            JUMP_TARGET(bci_PUSH_APPLY_PPPPPP),
+            JUMP_TARGET(bci_SLIDE),
+            JUMP_TARGET(bci_ALLOC_AP),
+            JUMP_TARGET(bci_ALLOC_AP_NOUPD),
+            JUMP_TARGET(bci_ALLOC_PAP),
+            JUMP_TARGET(bci_MKAP),
+            JUMP_TARGET(bci_MKPAP),
+            JUMP_TARGET(bci_UNPACK),
+            JUMP_TARGET(bci_PACK),
+            JUMP_TARGET(bci_TESTLT_I),
+            JUMP_TARGET(bci_TESTEQ_I),
+            JUMP_TARGET(bci_TESTLT_F),
+            JUMP_TARGET(bci_TESTEQ_F),
+            JUMP_TARGET(bci_TESTLT_D),
+            JUMP_TARGET(bci_TESTEQ_D),
+            JUMP_TARGET(bci_TESTLT_P),
+            JUMP_TARGET(bci_TESTEQ_P),
+            JUMP_TARGET(bci_CASEFAIL),
+            JUMP_TARGET(bci_JMP),
+            JUMP_TARGET(bci_CCALL),
+            JUMP_TARGET(bci_SWIZZLE),
+            JUMP_TARGET(bci_ENTER),
+            JUMP_TARGET(bci_RETURN),
+            JUMP_TARGET(bci_RETURN_P),
+            JUMP_TARGET(bci_RETURN_N),
+            JUMP_TARGET(bci_RETURN_F),
+            JUMP_TARGET(bci_RETURN_D),
+            JUMP_TARGET(bci_RETURN_L),
+            JUMP_TARGET(bci_RETURN_V),
+            JUMP_TARGET(bci_BRK_FUN),
+            JUMP_TARGET(bci_TESTLT_W),
+            JUMP_TARGET(bci_TESTEQ_W),
+            JUMP_TARGET(bci_RETURN_T),
+            JUMP_TARGET(bci_PUSH_ALTS_T),
+            JUMP_TARGET(bci_PUSH_L_ENTER),
+            JUMP_TARGET(bci_SLIDE_ENTER),
+        };
+#undef JUMP_TARGET
+#endif
+
 #if defined(INTERP_STATS)
         it_lastopc = 0; /* no opcode */
 #endif
 
+#if !defined(INTERP_THREADED_DISPATCH)
     nextInsn:
+#endif
         ASSERT(bciPtr < bcoSize);
         IF_DEBUG(interpreter,
                  //if (do_print_stack) {
@@ -1058,7 +1189,7 @@ run_BCO:
     switch (bci & 0xFF) {
 
         /* check for a breakpoint on the beginning of a let binding */
-        case bci_BRK_FUN:
+        INSTRUCTION(bci_BRK_FUN):
         {
             int arg1_brk_array, arg2_array_index, arg3_module_uniq;
 #if defined(PROFILING)
@@ -1180,10 +1311,10 @@ run_BCO:
             cap->r.rCurrentTSO->flags &= ~TSO_STOPPED_ON_BREAKPOINT;
 
             // continue normal execution of the byte code instructions
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_STKCHECK: {
+        INSTRUCTION(bci_STKCHECK): {
             // Explicit stack check at the beginning of a function
             // *only* (stack checks in case alternatives are
             // propagated to the enclosing function).
@@ -1194,27 +1325,27 @@ run_BCO:
                 SpW(0) = (W_)&stg_apply_interp_info;
                 RETURN_TO_SCHEDULER(ThreadInterpret, StackOverflow);
             } else {
-                goto nextInsn;
+                NEXT_INSTRUCTION;
             }
         }
 
-        case bci_PUSH_L: {
+        INSTRUCTION(bci_PUSH_L): {
             int o1 = BCO_NEXT;
             SpW(-1) = SpW(o1);
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_LL: {
+        INSTRUCTION(bci_PUSH_LL): {
             int o1 = BCO_NEXT;
             int o2 = BCO_NEXT;
             SpW(-1) = SpW(o1);
             SpW(-2) = SpW(o2);
             Sp_subW(2);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_LLL: {
+        INSTRUCTION(bci_PUSH_LLL): {
             int o1 = BCO_NEXT;
             int o2 = BCO_NEXT;
             int o3 = BCO_NEXT;
@@ -1222,59 +1353,59 @@ run_BCO:
             SpW(-2) = SpW(o2);
             SpW(-3) = SpW(o3);
             Sp_subW(3);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH8: {
+        INSTRUCTION(bci_PUSH8): {
             int off = BCO_NEXT;
             Sp_subB(1);
             *(StgWord8*)Sp = *(StgWord8*)(Sp_plusB(off+1));
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH16: {
+        INSTRUCTION(bci_PUSH16): {
             int off = BCO_NEXT;
             Sp_subB(2);
             *(StgWord16*)Sp = *(StgWord16*)(Sp_plusB(off+2));
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH32: {
+        INSTRUCTION(bci_PUSH32): {
             int off = BCO_NEXT;
             Sp_subB(4);
             *(StgWord32*)Sp = *(StgWord32*)(Sp_plusB(off+4));
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH8_W: {
+        INSTRUCTION(bci_PUSH8_W): {
             int off = BCO_NEXT;
             *(StgWord*)(Sp_minusW(1)) = *(StgWord8*)(Sp_plusB(off));
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH16_W: {
+        INSTRUCTION(bci_PUSH16_W): {
             int off = BCO_NEXT;
             *(StgWord*)(Sp_minusW(1)) = *(StgWord16*)(Sp_plusB(off));
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH32_W: {
+        INSTRUCTION(bci_PUSH32_W): {
             int off = BCO_NEXT;
             *(StgWord*)(Sp_minusW(1)) = *(StgWord32*)(Sp_plusB(off));
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_G: {
+        INSTRUCTION(bci_PUSH_G): {
             int o1 = BCO_GET_LARGE_ARG;
             SpW(-1) = BCO_PTR(o1);
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS: {
+        INSTRUCTION(bci_PUSH_ALTS): {
             int o_bco  = BCO_GET_LARGE_ARG;
             Sp_subW(2);
             SpW(1) = BCO_PTR(o_bco);
@@ -1284,10 +1415,10 @@ run_BCO:
             SpW(1) = (W_)cap->r.rCCCS;
             SpW(0) = (W_)&stg_restore_cccs_info;
 #endif
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS_P: {
+        INSTRUCTION(bci_PUSH_ALTS_P): {
             int o_bco  = BCO_GET_LARGE_ARG;
             SpW(-2) = (W_)&stg_ctoi_R1unpt_info;
             SpW(-1) = BCO_PTR(o_bco);
@@ -1297,10 +1428,10 @@ run_BCO:
             SpW(1) = (W_)cap->r.rCCCS;
             SpW(0) = (W_)&stg_restore_cccs_info;
 #endif
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS_N: {
+        INSTRUCTION(bci_PUSH_ALTS_N): {
             int o_bco  = BCO_GET_LARGE_ARG;
             SpW(-2) = (W_)&stg_ctoi_R1n_info;
             SpW(-1) = BCO_PTR(o_bco);
@@ -1310,10 +1441,10 @@ run_BCO:
             SpW(1) = (W_)cap->r.rCCCS;
             SpW(0) = (W_)&stg_restore_cccs_info;
 #endif
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS_F: {
+        INSTRUCTION(bci_PUSH_ALTS_F): {
             int o_bco  = BCO_GET_LARGE_ARG;
             SpW(-2) = (W_)&stg_ctoi_F1_info;
             SpW(-1) = BCO_PTR(o_bco);
@@ -1323,10 +1454,10 @@ run_BCO:
             SpW(1) = (W_)cap->r.rCCCS;
             SpW(0) = (W_)&stg_restore_cccs_info;
 #endif
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS_D: {
+        INSTRUCTION(bci_PUSH_ALTS_D): {
             int o_bco  = BCO_GET_LARGE_ARG;
             SpW(-2) = (W_)&stg_ctoi_D1_info;
             SpW(-1) = BCO_PTR(o_bco);
@@ -1336,10 +1467,10 @@ run_BCO:
             SpW(1) = (W_)cap->r.rCCCS;
             SpW(0) = (W_)&stg_restore_cccs_info;
 #endif
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS_L: {
+        INSTRUCTION(bci_PUSH_ALTS_L): {
             int o_bco  = BCO_GET_LARGE_ARG;
             SpW(-2) = (W_)&stg_ctoi_L1_info;
             SpW(-1) = BCO_PTR(o_bco);
@@ -1349,10 +1480,10 @@ run_BCO:
             SpW(1) = (W_)cap->r.rCCCS;
             SpW(0) = (W_)&stg_restore_cccs_info;
 #endif
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS_V: {
+        INSTRUCTION(bci_PUSH_ALTS_V): {
             int o_bco  = BCO_GET_LARGE_ARG;
             SpW(-2) = (W_)&stg_ctoi_V_info;
             SpW(-1) = BCO_PTR(o_bco);
@@ -1362,10 +1493,10 @@ run_BCO:
             SpW(1) = (W_)cap->r.rCCCS;
             SpW(0) = (W_)&stg_restore_cccs_info;
 #endif
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_ALTS_T: {
+        INSTRUCTION(bci_PUSH_ALTS_T): {
             int o_bco = BCO_GET_LARGE_ARG;
             W_ tuple_info = (W_)BCO_LIT(BCO_GET_LARGE_ARG);
             int o_tuple_bco = BCO_GET_LARGE_ARG;
@@ -1456,83 +1587,83 @@ run_BCO:
 
             SpW(-4) = ctoi_t_offset;
             Sp_subW(4);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_APPLY_N:
+        INSTRUCTION(bci_PUSH_APPLY_N):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_n_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_V:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_V):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_v_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_F:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_F):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_f_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_D:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_D):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_d_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_L:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_L):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_l_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_P:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_P):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_p_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_PP:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_PP):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_pp_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_PPP:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_PPP):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_ppp_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_PPPP:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_PPPP):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_pppp_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_PPPPP:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_PPPPP):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_ppppp_info;
-            goto nextInsn;
-        case bci_PUSH_APPLY_PPPPPP:
+            NEXT_INSTRUCTION;
+        INSTRUCTION(bci_PUSH_APPLY_PPPPPP):
             Sp_subW(1); SpW(0) = (W_)&stg_ap_pppppp_info;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
 
-        case bci_PUSH_PAD8: {
+        INSTRUCTION(bci_PUSH_PAD8): {
             Sp_subB(1);
             *(StgWord8*)Sp = 0;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_PAD16: {
+        INSTRUCTION(bci_PUSH_PAD16): {
             Sp_subB(2);
             *(StgWord16*)Sp = 0;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_PAD32: {
+        INSTRUCTION(bci_PUSH_PAD32): {
             Sp_subB(4);
             *(StgWord32*)Sp = 0;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_UBX8: {
+        INSTRUCTION(bci_PUSH_UBX8): {
             int o_lit = BCO_GET_LARGE_ARG;
             Sp_subB(1);
             *(StgWord8*)Sp = *(StgWord8*)(literals+o_lit);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_UBX16: {
+        INSTRUCTION(bci_PUSH_UBX16): {
             int o_lit = BCO_GET_LARGE_ARG;
             Sp_subB(2);
             *(StgWord16*)Sp = *(StgWord16*)(literals+o_lit);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_UBX32: {
+        INSTRUCTION(bci_PUSH_UBX32): {
             int o_lit = BCO_GET_LARGE_ARG;
             Sp_subB(4);
             *(StgWord32*)Sp = *(StgWord32*)(literals+o_lit);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PUSH_UBX: {
+        INSTRUCTION(bci_PUSH_UBX): {
             int i;
             int o_lits = BCO_GET_LARGE_ARG;
             int n_words = BCO_NEXT;
@@ -1540,10 +1671,10 @@ run_BCO:
             for (i = 0; i < n_words; i++) {
                 SpW(i) = (W_)BCO_LIT(o_lits+i);
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_SLIDE: {
+        INSTRUCTION(bci_SLIDE): {
             int n  = BCO_NEXT;
             int by = BCO_NEXT;
             /* a_1, .. a_n, b_1, .. b_by, s => a_1, .. a_n, s */
@@ -1552,10 +1683,10 @@ run_BCO:
             }
             Sp_addW(by);
             INTERP_TICK(it_slides);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_ALLOC_AP: {
+        INSTRUCTION(bci_ALLOC_AP): {
             int n_payload = BCO_NEXT;
             StgAP *ap = (StgAP*)allocate(cap, AP_sizeW(n_payload));
             SpW(-1) = (W_)ap;
@@ -1565,10 +1696,10 @@ run_BCO:
             // visible only from our stack
             SET_HDR(ap, &stg_AP_info, cap->r.rCCCS)
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_ALLOC_AP_NOUPD: {
+        INSTRUCTION(bci_ALLOC_AP_NOUPD): {
             int n_payload = BCO_NEXT;
             StgAP *ap = (StgAP*)allocate(cap, AP_sizeW(n_payload));
             SpW(-1) = (W_)ap;
@@ -1578,10 +1709,10 @@ run_BCO:
             // visible only from our stack
             SET_HDR(ap, &stg_AP_NOUPD_info, cap->r.rCCCS)
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_ALLOC_PAP: {
+        INSTRUCTION(bci_ALLOC_PAP): {
             StgPAP* pap;
             int arity = BCO_NEXT;
             int n_payload = BCO_NEXT;
@@ -1593,10 +1724,10 @@ run_BCO:
             // visible only from our stack
             SET_HDR(pap, &stg_PAP_info, cap->r.rCCCS)
             Sp_subW(1);
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_MKAP: {
+        INSTRUCTION(bci_MKAP): {
             int i;
             int stkoff = BCO_NEXT;
             int n_payload = BCO_NEXT;
@@ -1617,10 +1748,10 @@ run_BCO:
                      debugBelch("\tBuilt ");
                      printObj((StgClosure*)ap);
                 );
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_MKPAP: {
+        INSTRUCTION(bci_MKPAP): {
             int i;
             int stkoff = BCO_NEXT;
             int n_payload = BCO_NEXT;
@@ -1644,10 +1775,10 @@ run_BCO:
                      debugBelch("\tBuilt ");
                      printObj((StgClosure*)pap);
                 );
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_UNPACK: {
+        INSTRUCTION(bci_UNPACK): {
             /* Unpack N ptr words from t.o.s constructor */
             int i;
             int n_words = BCO_NEXT;
@@ -1656,10 +1787,10 @@ run_BCO:
             for (i = 0; i < n_words; i++) {
                 SpW(i) = (W_)con->payload[i];
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_PACK: {
+        INSTRUCTION(bci_PACK): {
             int i;
             int o_itbl         = BCO_GET_LARGE_ARG;
             int n_words        = BCO_NEXT;
@@ -1696,40 +1827,40 @@ run_BCO:
                      debugBelch("\tBuilt ");
                      printObj((StgClosure*)tagged_con);
                 );
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTLT_P: {
+        INSTRUCTION(bci_TESTLT_P): {
             unsigned int discr  = BCO_NEXT;
             int failto = BCO_GET_LARGE_ARG;
             StgClosure* con = (StgClosure*)SpW(0);
             if (GET_TAG(con) >= discr) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTEQ_P: {
+        INSTRUCTION(bci_TESTEQ_P): {
             unsigned int discr  = BCO_NEXT;
             int failto = BCO_GET_LARGE_ARG;
             StgClosure* con = (StgClosure*)SpW(0);
             if (GET_TAG(con) != discr) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTLT_I: {
+        INSTRUCTION(bci_TESTLT_I): {
             // There should be an Int at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
             I_ stackInt = (I_)SpW(1);
             if (stackInt >= (I_)BCO_LIT(discr))
                 bciPtr = failto;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTEQ_I: {
+        INSTRUCTION(bci_TESTEQ_I): {
             // There should be an Int at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
@@ -1737,20 +1868,20 @@ run_BCO:
             if (stackInt != (I_)BCO_LIT(discr)) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTLT_W: {
+        INSTRUCTION(bci_TESTLT_W): {
             // There should be an Int at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
             W_ stackWord = (W_)SpW(1);
             if (stackWord >= (W_)BCO_LIT(discr))
                 bciPtr = failto;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTEQ_W: {
+        INSTRUCTION(bci_TESTEQ_W): {
             // There should be an Int at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
@@ -1758,10 +1889,10 @@ run_BCO:
             if (stackWord != (W_)BCO_LIT(discr)) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTLT_D: {
+        INSTRUCTION(bci_TESTLT_D): {
             // There should be a Double at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
@@ -1771,10 +1902,10 @@ run_BCO:
             if (stackDbl >= discrDbl) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTEQ_D: {
+        INSTRUCTION(bci_TESTEQ_D): {
             // There should be a Double at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
@@ -1784,10 +1915,10 @@ run_BCO:
             if (stackDbl != discrDbl) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTLT_F: {
+        INSTRUCTION(bci_TESTLT_F): {
             // There should be a Float at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
@@ -1797,10 +1928,10 @@ run_BCO:
             if (stackFlt >= discrFlt) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_TESTEQ_F: {
+        INSTRUCTION(bci_TESTEQ_F): {
             // There should be a Float at SpW(1), and an info table at SpW(0).
             int discr   = BCO_GET_LARGE_ARG;
             int failto  = BCO_GET_LARGE_ARG;
@@ -1810,11 +1941,30 @@ run_BCO:
             if (stackFlt != discrFlt) {
                 bciPtr = failto;
             }
-            goto nextInsn;
+            NEXT_INSTRUCTION;
+        }
+
+        INSTRUCTION(bci_PUSH_L_ENTER): {
+            int o1 = BCO_NEXT;
+            SpW(-1) = SpW(o1);
+            Sp_subW(1);
+            goto do_enter;
+        }
+
+        INSTRUCTION(bci_SLIDE_ENTER): {
+            int n  = BCO_NEXT;
+            int by = BCO_NEXT;
+            while(--n >= 0) {
+                SpW(n+by) = SpW(n);
+            }
+            Sp_addW(by);
+            INTERP_TICK(it_slides);
+            goto do_enter;
         }
 
         // Control-flow ish things
-        case bci_ENTER:
+        INSTRUCTION(bci_ENTER):
+        do_enter:
             // Context-switch check.  We put it here to ensure that
             // the interpreter has done at least *some* work before
             // context switching: sometimes the scheduler can invoke
@@ -1826,50 +1976,50 @@ run_BCO:
             }
             goto eval;
 
-        case bci_RETURN:
+        INSTRUCTION(bci_RETURN):
             tagged_obj = (StgClosure *)SpW(0);
             Sp_addW(1);
             goto do_return;
 
-        case bci_RETURN_P:
+        INSTRUCTION(bci_RETURN_P):
             Sp_subW(1);
             SpW(0) = (W_)&stg_ret_p_info;
             goto do_return_unlifted;
-        case bci_RETURN_N:
+        INSTRUCTION(bci_RETURN_N):
             Sp_subW(1);
             SpW(0) = (W_)&stg_ret_n_info;
             goto do_return_unlifted;
-        case bci_RETURN_F:
+        INSTRUCTION(bci_RETURN_F):
             Sp_subW(1);
             SpW(0) = (W_)&stg_ret_f_info;
             goto do_return_unlifted;
-        case bci_RETURN_D:
+        INSTRUCTION(bci_RETURN_D):
             Sp_subW(1);
             SpW(0) = (W_)&stg_ret_d_info;
             goto do_return_unlifted;
-        case bci_RETURN_L:
+        INSTRUCTION(bci_RETURN_L):
             Sp_subW(1);
             SpW(0) = (W_)&stg_ret_l_info;
             goto do_return_unlifted;
-        case bci_RETURN_V:
+        INSTRUCTION(bci_RETURN_V):
             Sp_subW(1);
             SpW(0) = (W_)&stg_ret_v_info;
             goto do_return_unlifted;
-        case bci_RETURN_T: {
+        INSTRUCTION(bci_RETURN_T): {
             /* tuple_info and tuple_bco must already be on the stack */
             Sp_subW(1);
             SpW(0) = (W_)&stg_ret_t_info;
             goto do_return_unlifted;
         }
 
-        case bci_SWIZZLE: {
+        INSTRUCTION(bci_SWIZZLE): {
             int stkoff = BCO_NEXT;
             signed short n = (signed short)(BCO_NEXT);
             SpW(stkoff) += (W_)n;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_CCALL: {
+        INSTRUCTION(bci_CCALL): {
             void *tok;
             int stk_offset            = BCO_NEXT;
             int o_itbl                = BCO_GET_LARGE_ARG;
@@ -2025,21 +2175,24 @@ run_BCO:
             memcpy(Sp, ret, sizeof(W_) * ret_size);
 #endif
 
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_JMP: {
+        INSTRUCTION(bci_JMP): {
             /* BCO_NEXT modifies bciPtr, so be conservative. */
             int nextpc = BCO_GET_LARGE_ARG;
             bciPtr     = nextpc;
-            goto nextInsn;
+            NEXT_INSTRUCTION;
         }
 
-        case bci_CASEFAIL:
+        INSTRUCTION(bci_CASEFAIL):
             barf("interpretBCO: hit a CASEFAIL");
 
             // Errors
         default:
+#if defined(INTERP_THREADED_DISPATCH)
+        lbl_default:
+#endif
             barf("interpretBCO: unknown or unimplemented opcode %d",
                  (int)(bci & 0xFF));
 
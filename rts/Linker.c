@@ -160,6 +160,46 @@
 
    2) The number of duplicate symbols, since now only symbols that are
       true duplicates will display the error.
+
+   Note [Parallel object resolution]
+   ---------------------------------
+   Resolving an ObjectCode is mostly applying its relocations, which only
+   writes to the object's own sections and only reads `symhash`. With
+   +RTS --linker-threads, resolveObjs on ELF platforms therefore resolves
+   the objects that need it on a pool of OS threads, in three steps:
+
+   - Collect. With resolve_phase set to RESOLVE_COLLECTING, we check each
+     OBJECT_NEEDED object for duplicate symbols (ocInsertSymbols) and look up
+     every symbol its relocations refer to (ocLookupDependencies_ELF). Any
+     archive member these lookups need is loaded (see Note [Lazy archive
+     loading] in LoadArchive.c) and moved to OBJECT_NEEDED by loadSymbol,
+     which queues it instead of resolving it right away, so that its own
+     dependencies are collected in turn. At the end of this step every
+     object that needs resolving is in resolve_queue and no lookup made while
+     resolving them will change `symhash`.
+
+   - Resolve. With resolve_phase set to RESOLVE_PARALLEL, the worker
+     threads and the thread calling resolveObjs take objects off the queue
+     and call ocResolve on them. The calling thread holds linker_mutex on
+     behalf of all of them, so lookupDependentSymbol doesn't insist that
+     its caller holds the lock in this phase. `symhash` isn't modified: it
+     is only read, which StrHashTable supports concurrently. The dependency
+     sets that lookups update belong to the object being resolved.
+
+   - Initialise. Back on the calling thread alone, we set up page protections
+     and run the initialisers of every object (ocRunInit). Objects loaded on
+     demand come first, latest first, then the others in `objects` order, so
+     that as with on-demand loading an object's dependencies are
+     initialised before it.
+
+   If resolving an object fails we report the error, as the sequential loop
+   would, but still initialise the objects that were resolved: their
+   relocations have been applied and their pages protected, so they must not
+   be resolved again by the next resolveObjs. They become OBJECT_RESOLVED and
+   only the objects that failed stay OBJECT_NEEDED, to be retried once, say,
+   the object defining a missing symbol has been loaded. Any symbol of a failed
+   object that a resolved object refers to keeps its address when the failed
+   object is retried.
  */
 StrHashTable *symhash;
 
@@ -168,6 +208,25 @@ StrHashTable *symhash;
 Mutex linker_mutex;
 #endif
 
+/* See Note [Parallel object resolution] */
+typedef enum {
+    RESOLVE_ON_DEMAND,   /* resolve objects as soon as they are needed */
+    RESOLVE_COLLECTING,  /* queue the objects that need resolving */
+    RESOLVE_PARALLEL,    /* worker threads are resolving queued objects */
+} ResolvePhase;
+
+static ResolvePhase resolve_phase = RESOLVE_ON_DEMAND;
+
+#if defined(THREADED_RTS) && defined(OBJFORMAT_ELF)
+static ObjectCode **resolve_queue = NULL;
+static uint32_t resolve_queue_len = 0;
+static uint32_t resolve_queue_size = 0;
+static StgWord resolve_next = 0;
+static bool resolve_failed = false;
+
+static void enqueueResolve (ObjectCode *oc);
+#endif
+
 /* Generic wrapper function to try and Resolve and RunInit oc files */
 int ocTryLoad( ObjectCode* oc );
 
@@ -276,9 +335,28 @@ int ghciInsertSymbolTable(
       pinfo->value = data;
       pinfo->owner = owner;
       pinfo->strength = strength;
+      pinfo->member = NULL;
       insertStrHashTable(table, key, pinfo);
       return 1;
    }
+   else if (pinfo->member != NULL)
+   {
+       /* The symbol is only known from the index of an archive whose member
+          hasn't been loaded yet (see Note [Lazy archive loading] in
+          LoadArchive.c). A real definition takes its place, unless it is
+          just an undefined weak reference. */
+       if (data || strength != STRENGTH_WEAK) {
+           /* Re-insert with our own key: the placeholder's key belongs to
+              the archive's symbol index, which may be freed before us. */
+           removeStrHashTable(table, key, NULL);
+           pinfo->value = data;
+           pinfo->owner = owner;
+           pinfo->strength = strength;
+           pinfo->member = NULL;
+           insertStrHashTable(table, key, pinfo);
+       }
+       return 1;
+   }
    else if (pinfo->strength == STRENGTH_STRONG)
    {
        /* The existing symbol is strong meaning we must never override it */
@@ -514,6 +592,7 @@ exitLinker( void ) {
 #endif
    if (linker_init_done == 1) {
        freeStrHashTable(symhash, free);
+       freeLazyArchives();
        exitUnloadCheck();
    }
 #if defined(THREADED_RTS)
@@ -858,7 +937,11 @@ SymbolAddr* lookupDependentSymbol (SymbolName* lbl, ObjectCode *dependent)
 
 SymbolAddr* lookupDependentSymbol (SymbolName* lbl, ObjectCode *dependent)
 {
-    ASSERT_LOCK_HELD(&linker_mutex);
+    // The linker's worker threads look symbols up on behalf of the thread
+    // holding the lock, see Note [Parallel object resolution].
+    if (resolve_phase != RESOLVE_PARALLEL) {
+        ASSERT_LOCK_HELD(&linker_mutex);
+    }
     IF_DEBUG(linker, debugBelch("lookupSymbol: looking up '%s'\n", lbl));
 
     ASSERT(symhash != NULL);
@@ -875,7 +958,15 @@ SymbolAddr* lookupDependentSymbol (SymbolName* lbl, ObjectCode *dependent)
         }
     }
 
-    if (!ghciLookupSymbolInfo(symhash, lbl, &pinfo)) {
+    ghciLookupSymbolInfo(symhash, lbl, &pinfo);
+    if (pinfo != NULL && pinfo->member != NULL) {
+        // Only known from an archive's symbol index: load the member that
+        // defines it. See Note [Lazy archive loading] in LoadArchive.c.
+        ASSERT(resolve_phase != RESOLVE_PARALLEL);
+        pinfo = loadLazySymbol(lbl, pinfo);
+    }
+
+    if (pinfo == NULL) {
         IF_DEBUG(linker, debugBelch("lookupSymbol: symbol '%s' not found, trying dlsym\n", lbl));
 
 #       if defined(OBJFORMAT_ELF)
@@ -955,7 +1046,16 @@ SymbolAddr* loadSymbol(SymbolName *lbl, RtsSymbolInfo *pinfo) {
     /* Symbol can be found during linking, but hasn't been relocated. Do so now.
         See Note [runtime-linker-phases] */
     if (oc && lbl && oc->status == OBJECT_LOADED) {
+        ASSERT(resolve_phase != RESOLVE_PARALLEL);
         oc->status = OBJECT_NEEDED;
+#if defined(THREADED_RTS) && defined(OBJFORMAT_ELF)
+        if (resolve_phase == RESOLVE_COLLECTING) {
+            // resolveObjs will resolve it with the others, see
+            // Note [Parallel object resolution]
+            enqueueResolve(oc);
+            return pinfo->value;
+        }
+#endif
         IF_DEBUG(linker, debugBelch("lookupSymbol: on-demand "
                                     "loading symbol '%s'\n", lbl));
         int r = ocTryLoad(oc);
@@ -1316,7 +1416,10 @@ freePreloadObjectFile (ObjectCode *oc)
 #else
 
     if (RTS_LINKER_USE_MMAP && oc->imageMapped) {
-        munmapForLinker(oc->image, oc->fileSize, "freePreloadObjectFile");
+        // an archive member's mapping starts at the page holding its image
+        size_t slop = oc->imageFileOffset % getPageSize();
+        munmapForLinker(oc->image - slop, oc->fileSize + slop,
+                        "freePreloadObjectFile");
     }
     else {
         stgFree(oc->image);
@@ -1484,6 +1587,7 @@ mkOc( ObjectType type, pathchar *path, char *image, int imageSize,
    oc->imageMapped       = mapped;
 
    oc->misalignment      = misalignment;
+   oc->imageFileOffset   = 0;
    oc->extraInfos        = NULL;
 
    /* chain it onto the list of objects */
@@ -1778,19 +1882,12 @@ HsInt loadOc (ObjectCode* oc)
 }
 
 /* -----------------------------------------------------------------------------
-* try to load and initialize an ObjectCode into memory
-*
-* Returns: 1 if ok, 0 on error.
-*/
-int ocTryLoad (ObjectCode* oc) {
-    int r;
-
-    if (oc->status != OBJECT_NEEDED) {
-        return 1;
-    }
-
-    /*  Check for duplicate symbols by looking into `symhash`.
-        Duplicate symbols are any symbols which exist
+ * Check for duplicate symbols by looking into `symhash`.
+ *
+ * Returns: 1 if ok, 0 on error.
+ */
+static int ocInsertSymbols (ObjectCode* oc) {
+    /*  Duplicate symbols are any symbols which exist
         in different ObjectCodes that have both been loaded, or
         are to be loaded by this call.
 
@@ -1811,17 +1908,29 @@ int ocTryLoad (ObjectCode* oc) {
             return 0;
         }
     }
+    return 1;
+}
 
+static int ocResolve (ObjectCode* oc) {
 #   if defined(OBJFORMAT_ELF)
-    r = ocResolve_ELF ( oc );
+    return ocResolve_ELF ( oc );
 #   elif defined(OBJFORMAT_PEi386)
-    r = ocResolve_PEi386 ( oc );
+    return ocResolve_PEi386 ( oc );
 #   elif defined(OBJFORMAT_MACHO)
-    r = ocResolve_MachO ( oc );
+    return ocResolve_MachO ( oc );
 #   else
     barf("ocTryLoad: not implemented on this platform");
 #   endif
-    if (!r) { return r; }
+}
+
+/* -----------------------------------------------------------------------------
+ * Set up the page protections of a resolved ObjectCode and run its
+ * initializers.
+ *
+ * Returns: 1 if ok, 0 on error.
+ */
+static int ocRunInit (ObjectCode* oc) {
+    int r;
 
 #if defined(NEED_SYMBOL_EXTRAS)
     ocProtectExtras(oc);
@@ -1858,6 +1967,156 @@ int ocTryLoad (ObjectCode* oc) {
     return 1;
 }
 
+/* -----------------------------------------------------------------------------
+* try to load and initialize an ObjectCode into memory
+*
+* Returns: 1 if ok, 0 on error.
+*/
+int ocTryLoad (ObjectCode* oc) {
+    if (oc->status != OBJECT_NEEDED) {
+        return 1;
+    }
+
+    if (!ocInsertSymbols(oc) || !ocResolve(oc)) {
+        return 0;
+    }
+
+    return ocRunInit(oc);
+}
+
+#if defined(THREADED_RTS) && defined(OBJFORMAT_ELF)
+static void enqueueResolve (ObjectCode *oc)
+{
+    if (resolve_queue_len == resolve_queue_size) {
+        resolve_queue_size = resolve_queue_size * 2 + 64;
+        resolve_queue = stgReallocBytes(resolve_queue,
+                                        resolve_queue_size * sizeof(ObjectCode *),
+                                        "enqueueResolve");
+    }
+    resolve_queue[resolve_queue_len++] = oc;
+}
+
+static void *resolveWorker (void *arg STG_UNUSED)
+{
+    StgWord i;
+    while ((i = atomic_inc(&resolve_next, 1) - 1) < resolve_queue_len) {
+        ObjectCode *oc = resolve_queue[i];
+        if (!ocResolve(oc)) {
+            errorBelch("Could not load Object Code %" PATH_FMT ".\n",
+                       OC_INFORMATIVE_FILENAME(oc));
+            RELAXED_STORE(&resolve_failed, true);
+            // Don't initialise it, see Note [Parallel object resolution]
+            resolve_queue[i] = NULL;
+        }
+    }
+    return NULL;
+}
+
+/* Run the initialisers of an object resolved by resolveWorker, unless it
+ * failed to resolve.
+ *
+ * Returns: 1 if ok, 0 on error.
+ */
+static HsInt initResolved (ObjectCode *oc)
+{
+    if (oc == NULL) {
+        return 1;
+    }
+    if (!ocRunInit(oc)) {
+        errorBelch("Could not load Object Code %" PATH_FMT ".\n",
+                   OC_INFORMATIVE_FILENAME(oc));
+        return 0;
+    }
+    return 1;
+}
+
+/* Resolve the objects that need it on RtsFlags.MiscFlags.linkerThreads
+ * threads. See Note [Parallel object resolution].
+ *
+ * Returns: 1 if ok, 0 on error.
+ */
+static HsInt resolveObjsParallel (void)
+{
+    HsInt r = 1;
+    uint32_t n_initial, i;
+
+    // Collect
+    resolve_phase = RESOLVE_COLLECTING;
+    for (ObjectCode *oc = objects; oc; oc = oc->next) {
+        if (oc->status == OBJECT_NEEDED) {
+            enqueueResolve(oc);
+        }
+    }
+    n_initial = resolve_queue_len;
+    for (i = 0; i < resolve_queue_len; i++) {
+        ObjectCode *oc = resolve_queue[i];
+        if (!ocInsertSymbols(oc)) {
+            errorBelch("Could not load Object Code %" PATH_FMT ".\n",
+                       OC_INFORMATIVE_FILENAME(oc));
+            r = 0;
+            goto done;
+        }
+        ocLookupDependencies_ELF(oc);
+    }
+
+    // With a single object there's nothing to gain, leave it to the
+    // sequential loop in resolveObjs_.
+    if (resolve_queue_len < 2) {
+        goto done;
+    }
+
+    // Resolve
+    IF_DEBUG(linker, debugBelch("resolveObjs: resolving %" FMT_Word32
+                                " objects in parallel\n", resolve_queue_len));
+    resolve_phase = RESOLVE_PARALLEL;
+    resolve_next = 0;
+    resolve_failed = false;
+
+    uint32_t n_workers = stg_min(RtsFlags.MiscFlags.linkerThreads,
+                                 resolve_queue_len) - 1;
+    OSThreadId *workers = stgMallocBytes((n_workers + 1) * sizeof(OSThreadId),
+                                         "resolveObjsParallel");
+    uint32_t started;
+    for (started = 0; started < n_workers; started++) {
+        if (createOSThread(&workers[started], "ghc_linker",
+                           resolveWorker, NULL) != 0) {
+            break;
+        }
+    }
+    resolveWorker(NULL);
+    for (i = 0; i < started; i++) {
+        joinOSThread(workers[i]);
+    }
+    stgFree(workers);
+    resolve_phase = RESOLVE_ON_DEMAND;
+
+    if (resolve_failed) {
+        r = 0;
+    }
+
+    // Initialise, even if some objects failed to resolve, so that none of
+    // the others is left relocated but OBJECT_NEEDED.
+    for (i = resolve_queue_len; i > n_initial; i--) {
+        if (!initResolved(resolve_queue[i - 1])) {
+            r = 0;
+        }
+    }
+    for (i = 0; i < n_initial; i++) {
+        if (!initResolved(resolve_queue[i])) {
+            r = 0;
+        }
+    }
+
+done:
+    resolve_phase = RESOLVE_ON_DEMAND;
+    stgFree(resolve_queue);
+    resolve_queue = NULL;
+    resolve_queue_len = 0;
+    resolve_queue_size = 0;
+    return r;
+}
+#endif
+
 /* -----------------------------------------------------------------------------
  * resolve all the currently unlinked objects in memory
  *
@@ -1867,6 +2126,15 @@ static HsInt resolveObjs_ (void)
 {
     IF_DEBUG(linker, debugBelch("resolveObjs: start\n"));
 
+#if defined(THREADED_RTS) && defined(OBJFORMAT_ELF)
+    // Anything this leaves OBJECT_NEEDED is resolved by the loop below.
+    if (RtsFlags.MiscFlags.linkerThreads > 1 && !resolveObjsParallel()) {
+        IF_DEBUG(linker, printLoadedObjects());
+        fflush(stderr);
+        return 0;
+    }
+#endif
+
     for (ObjectCode *oc = objects; oc; oc = oc->next) {
         int r = ocTryLoad(oc);
         if (!r)
@@ -1934,6 +2202,12 @@ static HsInt unloadObj_ (pathchar *path, bool just_purge)
         }
     }
 
+    // Forget the members of an archive that we never needed to load, see
+    // Note [Lazy archive loading] in LoadArchive.c.
+    if (unloadLazyArchive(path)) {
+        unloadedAnyObj = true;
+    }
+
     if (unloadedAnyObj) {
         return 1;
     } else {
@@ -1976,6 +2250,45 @@ OStatus getObjectLoadStatus (pathchar *path)
     return r;
 }
 
+/* -----------------------------------------------------------------------------
+ * Is [addr, addr + size) in the code or data of an object we have loaded?
+ * Used to check the info pointers of a compact file before looking at them
+ * (see Note [Compact files] in CompactFile.c).
+ */
+bool
+isObjectCodeRange (const void *addr, size_t size)
+{
+    const char *start = addr;
+    bool r = false;
+
+    ACQUIRE_LOCK(&linker_mutex);
+    for (ObjectCode *oc = objects; oc && !r; oc = oc->next) {
+        if (oc->type == DYNAMIC_OBJECT) {
+            for (NativeCodeRange *ncr = oc->nc_ranges; ncr; ncr = ncr->next) {
+                if (start >= (char *)ncr->start
+                    && start + size <= (char *)ncr->end) {
+                    r = true;
+                    break;
+                }
+            }
+            continue;
+        }
+        for (int i = 0; i < oc->n_sections; i++) {
+            Section *s = &oc->sections[i];
+            if ((s->kind == SECTIONKIND_CODE_OR_RODATA
+                 || s->kind == SECTIONKIND_RWDATA)
+                && s->start != NULL
+                && start >= (char *)s->start
+                && start + size <= (char *)s->start + s->size) {
+                r = true;
+                break;
+            }
+        }
+    }
+    RELEASE_LOCK(&linker_mutex);
+    return r;
+}
+
 /* -----------------------------------------------------------------------------
  * Sanity checking.  For each ObjectCode, maintain a list of address ranges
  * which may be prodded during relocation, and abort if we try and write
@@ -242,6 +242,11 @@ struct _ObjectCode {
        after allocation, so that we can use realloc */
     int        misalignment;
 
+    /* if imageMapped, the offset of image in the file fileName. Non-zero
+       for archive members mapped straight from the archive, see
+       Note [Mapping archive members] in LoadArchive.c */
+    StgWord    imageFileOffset;
+
     /* The section-kind entries for this object module. An array. */
     int n_sections;
     Section* sections;
@@ -363,10 +368,19 @@ typedef enum _SymStrength {
    A weak symbol that has been used will still be marked as weak
    in the `ObjectCode` but in the `RtsSymbolInfo` it won't be.
 */
+/* An object file in an archive that hasn't been loaded yet, see
+   Note [Lazy archive loading] in LoadArchive.c */
+typedef struct _ArchiveMember ArchiveMember;
+
 typedef struct _RtsSymbolInfo {
     SymbolAddr* value;
     ObjectCode *owner;
     SymStrength strength;
+    /* If not NULL, the symbol is only known from the symbol index of an
+       archive, and 'member' is the archive member that defines it, which
+       hasn't been loaded yet. 'value' and 'owner' are NULL. See
+       Note [Lazy archive loading] in LoadArchive.c. */
+    ArchiveMember *member;
 } RtsSymbolInfo;
 
 void exitLinker( void );
@@ -434,7 +448,12 @@ resolveSymbolAddr (pathchar* buffer, int size,
 #endif
 
 HsInt isAlreadyLoaded( pathchar *path );
+/* See Note [Lazy archive loading] in LoadArchive.c */
+RtsSymbolInfo *loadLazySymbol( SymbolName *lbl, RtsSymbolInfo *pinfo );
+bool unloadLazyArchive( pathchar *path );
+void freeLazyArchives( void );
 OStatus getObjectLoadStatus_ (pathchar *path);
+bool isObjectCodeRange (const void *addr, size_t size);
 HsInt loadOc( ObjectCode* oc );
 ObjectCode* mkOc( ObjectType type, pathchar *path, char *image, int imageSize,
                   bool mapped, pathchar *archiveMemberName,
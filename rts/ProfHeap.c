@@ -23,6 +23,7 @@
 #include "Printer.h"
 #include "Trace.h"
 #include "sm/GCThread.h"
+#include "sm/GC.h"
 
 #include <fs_rts.h>
 #include <string.h>
@@ -144,6 +145,13 @@ initLDVCtr( counter *ctr )
 static Census *censuses = NULL;
 static uint32_t n_censuses = 0;
 
+// The last complete census of the nonmoving heap,
+// see Note [Nonmoving heap census]
+static Census *nonmoving_census = NULL;
+#if defined(THREADED_RTS)
+static Mutex nonmoving_census_mutex;
+#endif
+
 #if defined(PROFILING)
 static void aggregateCensusInfo( void );
 #endif
@@ -419,6 +427,10 @@ initHeapProfiling(void)
     init_prof_locale();
     set_prof_locale();
 
+#if defined(THREADED_RTS)
+    initMutex(&nonmoving_census_mutex);
+#endif
+
     char *prog;
 
     prog = stgMallocBytes(strlen(prog_name) + 1, "initHeapProfiling");
@@ -563,6 +575,14 @@ endHeapProfiling(void)
 
     stgFree(censuses);
 
+    if (nonmoving_census != NULL) {
+        freeNonmovingCensus(nonmoving_census);
+        nonmoving_census = NULL;
+    }
+#if defined(THREADED_RTS)
+    closeMutex(&nonmoving_census_mutex);
+#endif
+
     RTSStats stats;
     getRTSStats(&stats);
     Time mut_time = stats.mutator_cpu_ns;
@@ -1058,15 +1078,155 @@ static void heapProfObject(Census *census, StgClosure *p, size_t size,
 // so we don't need the loop.
 //
 // See Note [Compact Normal Forms] for details.
+static void
+heapCensusCompactBlock(Census *census, bdescr *bd)
+{
+    StgCompactNFDataBlock *block = (StgCompactNFDataBlock*)bd->start;
+    StgCompactNFData *str = block->owner;
+    heapProfObject(census, (StgClosure*)str,
+                   compact_nfdata_full_sizeW(str), true);
+}
+
 static void
 heapCensusCompactList(Census *census, bdescr *bd)
 {
     for (; bd != NULL; bd = bd->link) {
-        StgCompactNFDataBlock *block = (StgCompactNFDataBlock*)bd->start;
-        StgCompactNFData *str = block->owner;
-        heapProfObject(census, (StgClosure*)str,
-                       compact_nfdata_full_sizeW(str), true);
+        heapCensusCompactBlock(census, bd);
+    }
+}
+
+/*
+ * The size of a heap closure, in words, and whether it counts as "prim"
+ * (inherently used) for biographical profiling.
+ */
+static size_t
+heapCensusClosureSize(StgClosure *p, const StgInfoTable *info, bool *prim)
+{
+    size_t size;
+
+    *prim = false;
+
+    switch (info->type) {
+
+    case THUNK:
+        size = thunk_sizeW_fromITBL(info);
+        break;
+
+    case THUNK_1_1:
+    case THUNK_0_2:
+    case THUNK_2_0:
+        size = sizeofW(StgThunkHeader) + 2;
+        break;
+
+    case THUNK_1_0:
+    case THUNK_0_1:
+    case THUNK_SELECTOR:
+        size = sizeofW(StgThunkHeader) + 1;
+        break;
+
+    case FUN:
+    case BLACKHOLE:
+    case BLOCKING_QUEUE:
+    case FUN_1_0:
+    case FUN_0_1:
+    case FUN_1_1:
+    case FUN_0_2:
+    case FUN_2_0:
+    case CONSTR:
+    case CONSTR_NOCAF:
+    case CONSTR_1_0:
+    case CONSTR_0_1:
+    case CONSTR_1_1:
+    case CONSTR_0_2:
+    case CONSTR_2_0:
+        size = sizeW_fromITBL(info);
+        break;
+
+    case IND:
+        // Special case/Delicate Hack: INDs don't normally
+        // appear, since we're doing this heap census right
+        // after GC.  However, GarbageCollect() also does
+        // resurrectThreads(), which can update some
+        // blackholes when it calls raiseAsync() on the
+        // resurrected threads.  So we know that any IND will
+        // be the size of a BLACKHOLE.
+        size = BLACKHOLE_sizeW();
+        break;
+
+    case BCO:
+        *prim = true;
+        size = bco_sizeW((StgBCO *)p);
+        break;
+
+    case MVAR_CLEAN:
+    case MVAR_DIRTY:
+    case TVAR:
+    case WEAK:
+    case PRIM:
+    case MUT_PRIM:
+    case MUT_VAR_CLEAN:
+    case MUT_VAR_DIRTY:
+        *prim = true;
+        size = sizeW_fromITBL(info);
+        break;
+
+    case AP:
+        size = ap_sizeW((StgAP *)p);
+        break;
+
+    case PAP:
+        size = pap_sizeW((StgPAP *)p);
+        break;
+
+    case AP_STACK:
+        size = ap_stack_sizeW((StgAP_STACK *)p);
+        break;
+
+    case ARR_WORDS:
+        *prim = true;
+        size = arr_words_sizeW((StgArrBytes*)p);
+        break;
+
+    case MUT_ARR_PTRS_CLEAN:
+    case MUT_ARR_PTRS_DIRTY:
+    case MUT_ARR_PTRS_FROZEN_CLEAN:
+    case MUT_ARR_PTRS_FROZEN_DIRTY:
+        *prim = true;
+        size = mut_arr_ptrs_sizeW((StgMutArrPtrs *)p);
+        break;
+
+    case SMALL_MUT_ARR_PTRS_CLEAN:
+    case SMALL_MUT_ARR_PTRS_DIRTY:
+    case SMALL_MUT_ARR_PTRS_FROZEN_CLEAN:
+    case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
+        *prim = true;
+        size = small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs *)p);
+        break;
+
+    case TSO:
+        *prim = true;
+        size = sizeofW(StgTSO);
+        break;
+
+    case STACK:
+        *prim = true;
+        size = stack_sizeW((StgStack*)p);
+        break;
+
+    case TREC_CHUNK:
+        *prim = true;
+        size = sizeofW(StgTRecChunk);
+        break;
+
+    case COMPACT_NFDATA:
+        barf("heapCensus, found compact object in the wrong list");
+        break;
+
+    default:
+        barf("heapCensus, unknown object: %d", info->type);
     }
+
+    return size;
 }
 
 /*
@@ -1086,128 +1246,8 @@ heapCensusBlock(Census *census, bdescr *bd)
 
     while (p < bd->free) {
         const StgInfoTable *info = get_itbl((const StgClosure *)p);
-        bool prim = false;
-        size_t size;
-
-        switch (info->type) {
-
-        case THUNK:
-            size = thunk_sizeW_fromITBL(info);
-            break;
-
-        case THUNK_1_1:
-        case THUNK_0_2:
-        case THUNK_2_0:
-            size = sizeofW(StgThunkHeader) + 2;
-            break;
-
-        case THUNK_1_0:
-        case THUNK_0_1:
-        case THUNK_SELECTOR:
-            size = sizeofW(StgThunkHeader) + 1;
-            break;
-
-        case FUN:
-        case BLACKHOLE:
-        case BLOCKING_QUEUE:
-        case FUN_1_0:
-        case FUN_0_1:
-        case FUN_1_1:
-        case FUN_0_2:
-        case FUN_2_0:
-        case CONSTR:
-        case CONSTR_NOCAF:
-        case CONSTR_1_0:
-        case CONSTR_0_1:
-        case CONSTR_1_1:
-        case CONSTR_0_2:
-        case CONSTR_2_0:
-            size = sizeW_fromITBL(info);
-            break;
-
-        case IND:
-            // Special case/Delicate Hack: INDs don't normally
-            // appear, since we're doing this heap census right
-            // after GC.  However, GarbageCollect() also does
-            // resurrectThreads(), which can update some
-            // blackholes when it calls raiseAsync() on the
-            // resurrected threads.  So we know that any IND will
-            // be the size of a BLACKHOLE.
-            size = BLACKHOLE_sizeW();
-            break;
-
-        case BCO:
-            prim = true;
-            size = bco_sizeW((StgBCO *)p);
-            break;
-
-        case MVAR_CLEAN:
-        case MVAR_DIRTY:
-        case TVAR:
-        case WEAK:
-        case PRIM:
-        case MUT_PRIM:
-        case MUT_VAR_CLEAN:
-        case MUT_VAR_DIRTY:
-            prim = true;
-            size = sizeW_fromITBL(info);
-            break;
-
-        case AP:
-            size = ap_sizeW((StgAP *)p);
-            break;
-
-        case PAP:
-            size = pap_sizeW((StgPAP *)p);
-            break;
-
-        case AP_STACK:
-            size = ap_stack_sizeW((StgAP_STACK *)p);
-            break;
-
-        case ARR_WORDS:
-            prim = true;
-            size = arr_words_sizeW((StgArrBytes*)p);
-            break;
-
-        case MUT_ARR_PTRS_CLEAN:
-        case MUT_ARR_PTRS_DIRTY:
-        case MUT_ARR_PTRS_FROZEN_CLEAN:
-        case MUT_ARR_PTRS_FROZEN_DIRTY:
-            prim = true;
-            size = mut_arr_ptrs_sizeW((StgMutArrPtrs *)p);
-            break;
-
-        case SMALL_MUT_ARR_PTRS_CLEAN:
-        case SMALL_MUT_ARR_PTRS_DIRTY:
-        case SMALL_MUT_ARR_PTRS_FROZEN_CLEAN:
-        case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
-            prim = true;
-            size = small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs *)p);
-            break;
-
-        case TSO:
-            prim = true;
-            size = sizeofW(StgTSO);
-            break;
-
-        case STACK:
-            prim = true;
-            size = stack_sizeW((StgStack*)p);
-            break;
-
-        case TREC_CHUNK:
-            prim = true;
-            size = sizeofW(StgTRecChunk);
-            break;
-
-        case COMPACT_NFDATA:
-            barf("heapCensus, found compact object in the wrong list");
-            break;
-
-        default:
-            barf("heapCensus, unknown object: %d", info->type);
-        }
+        bool prim;
+        size_t size = heapCensusClosureSize((StgClosure *)p, info, &prim);
 
         heapProfObject(census,(StgClosure*)p,size,prim);
 
@@ -1234,33 +1274,294 @@ heapCensusBlock(Census *census, bdescr *bd)
 /* -----------------------------------------------------------------------------
  * Code to perform a heap census.
  * -------------------------------------------------------------------------- */
+static void
+heapCensusBlockGroup( Census *census, bdescr *bd )
+{
+    // When we shrink a large ARR_WORDS, we do not adjust the free pointer
+    // of the associated block descriptor, thus introducing slop at the end
+    // of the object.  This slop remains after GC, violating the assumption
+    // of the loop below that all slop has been eliminated (#11627).
+    // The slop isn't always zeroed (e.g. in non-profiling mode, cf
+    // OVERWRITING_CLOSURE_OFS).
+    // Consequently, we handle large ARR_WORDS objects as a special case.
+    if (bd->flags & BF_LARGE) {
+        StgPtr p = bd->start;
+        // There may be some initial zeros due to object alignment.
+        while (p < bd->free && !*p) p++;
+        if (get_itbl((StgClosure *)p)->type == ARR_WORDS) {
+            size_t size = arr_words_sizeW((StgArrBytes *)p);
+            bool prim = true;
+            heapProfObject(census, (StgClosure *)p, size, prim);
+            return;
+        }
+    }
+
+    heapCensusBlock(census, bd);
+}
+
 static void
 heapCensusChain( Census *census, bdescr *bd )
 {
     for (; bd != NULL; bd = bd->link) {
-        // When we shrink a large ARR_WORDS, we do not adjust the free pointer
-        // of the associated block descriptor, thus introducing slop at the end
-        // of the object.  This slop remains after GC, violating the assumption
-        // of the loop below that all slop has been eliminated (#11627).
-        // The slop isn't always zeroed (e.g. in non-profiling mode, cf
-        // OVERWRITING_CLOSURE_OFS).
-        // Consequently, we handle large ARR_WORDS objects as a special case.
-        if (bd->flags & BF_LARGE) {
-            StgPtr p = bd->start;
-            // There may be some initial zeros due to object alignment.
-            while (p < bd->free && !*p) p++;
-            if (get_itbl((StgClosure *)p)->type == ARR_WORDS) {
-                size_t size = arr_words_sizeW((StgArrBytes *)p);
-                bool prim = true;
-                heapProfObject(census, (StgClosure *)p, size, prim);
-                continue;
-            }
+        heapCensusBlockGroup(census, bd);
+    }
+}
+
+// Add the counts from src into dst.
+static void
+mergeCensus( Census *dst, Census *src )
+{
+    counter *c, *d;
+
+    for (c = src->ctrs; c != NULL; c = c->next) {
+        d = lookupHashTable(dst->hash, (StgWord)c->identity);
+        if (d == NULL) {
+            d = heapInsertNewCounter(dst, (StgWord)c->identity);
+        }
+#if defined(PROFILING)
+        if (RtsFlags.ProfFlags.bioSelector != NULL) {
+            d->c.ldv.prim     += c->c.ldv.prim;
+            d->c.ldv.not_used += c->c.ldv.not_used;
+            d->c.ldv.used     += c->c.ldv.used;
+        } else
+#endif
+        {
+            d->c.resid += c->c.resid;
         }
+    }
+
+    dst->prim     += src->prim;
+    dst->not_used += src->not_used;
+    dst->used     += src->used;
+}
+
+/* -----------------------------------------------------------------------------
+ * Census of the nonmoving heap
+ *
+ * Note [Nonmoving heap census]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * With the nonmoving collector the old generation lives in nonmoving
+ * segments, which heapCensus() can't walk: it has no way to tell live
+ * blocks of a segment from free ones other than the mark bitmap of the
+ * last collection.  Instead we take the census of the old generation
+ * as part of marking it.  When heap profiling is on, nonmovingCollect()
+ * gives the mark queue a fresh Census (newNonmovingCensus()), and
+ * mark_closure() counts every object of the snapshot as it marks it
+ * (nonmovingCensusClosure(), nonmovingCensusCompact()).  Each marking
+ * thread has its own mark queue and hence its own Census, so counting
+ * needs no synchronisation.
+ *
+ * When the mark is complete the census is published with
+ * publishNonmovingCensus(), replacing the one from the previous cycle.
+ * Each heap census then walks the younger generations and the objects
+ * promoted into the oldest generation's block lists as usual, and adds
+ * the counts of the last published nonmoving census.
+ *
+ * So the old generation part of a sample describes the heap as it was
+ * at the start of the last completed nonmoving collection, not at the
+ * time of the sample; objects allocated into nonmoving segments since
+ * then are not counted until the next cycle.  In exchange the old
+ * generation costs nothing extra to profile.
+ *
+ * This doesn't work for retainer or biographical profiling, which need
+ * information the mark doesn't maintain, so those are still rejected
+ * with the nonmoving collector (see procRtsOpts).
+ * -------------------------------------------------------------------------- */
+
+Census *
+newNonmovingCensus( void )
+{
+    Census *census = stgCallocBytes(1, sizeof(Census), "newNonmovingCensus");
+    initEra(census);
+    return census;
+}
+
+void
+freeNonmovingCensus( Census *census )
+{
+    freeEra(census);
+    stgFree(census);
+}
+
+void
+nonmovingCensusClosure( Census *census, StgClosure *p,
+                        const StgInfoTable *info )
+{
+    bool prim;
+    size_t size = heapCensusClosureSize(p, info, &prim);
+    heapProfObject(census, p, size, prim);
+}
+
+void
+nonmovingCensusCompact( Census *census, StgCompactNFData *str )
+{
+    heapProfObject(census, (StgClosure*)str,
+                   compact_nfdata_full_sizeW(str), true);
+}
+
+void
+publishNonmovingCensus( Census *census )
+{
+    Census *old;
+
+    ACQUIRE_LOCK(&nonmoving_census_mutex);
+    old = nonmoving_census;
+    nonmoving_census = census;
+    RELEASE_LOCK(&nonmoving_census_mutex);
 
-        heapCensusBlock(census, bd);
+    if (old != NULL) {
+        freeNonmovingCensus(old);
     }
 }
 
+static void
+mergeNonmovingCensus( Census *census )
+{
+    ACQUIRE_LOCK(&nonmoving_census_mutex);
+    if (nonmoving_census != NULL) {
+        mergeCensus(census, nonmoving_census);
+    }
+    RELEASE_LOCK(&nonmoving_census_mutex);
+}
+
+/* -----------------------------------------------------------------------------
+ * Parallel heap census
+ *
+ * Note [Parallel heap census]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * A census walks every block of the heap while all capabilities are
+ * stopped, so on a large heap it can dominate the pause time of the
+ * GC that performs it.  After a parallel GC we therefore split the
+ * walk over the GC threads, using runGcThreadsTask() (see Note [GC
+ * thread tasks] in GC.c).
+ *
+ * The leader first chops the block lists into segments of at most
+ * CENSUS_SEGMENT_BLOCKS block groups.  Following the links is cheap
+ * compared with scanning the objects in the blocks, so this is done
+ * sequentially.  Each thread then repeatedly claims the next segment
+ * with an atomic increment and counts its objects into a private
+ * Census (its own hash table, arena and totals), so no locking is
+ * needed while scanning.  Finally the leader merges the private
+ * censuses into the real one with mergeCensus().
+ *
+ * The output is the same as for a sequential census, except that the
+ * order of the bands may differ.  Everything the census reads
+ * (closureIdentity(), the retainer sets, the selectors) is read-only
+ * while the census is running; the only shared mutable state touched
+ * by the private censuses is the block allocator, via their arenas,
+ * which takes its own lock.
+ * -------------------------------------------------------------------------- */
+
+#if defined(THREADED_RTS)
+
+#define CENSUS_SEGMENT_BLOCKS 64
+
+typedef struct {
+    bdescr  *bd;        // first block group of the segment
+    uint32_t n_blocks;  // number of block groups in the segment
+    bool     compact;   // part of a compact_objects list
+} CensusSegment;
+
+typedef struct {
+    CensusSegment *segs;
+    uint32_t       n_segs;
+    uint32_t       max_segs;
+    StgWord        next_seg;  // next segment to claim, updated atomically
+    Census        *censuses;  // private censuses, indexed by GC thread
+} ParCensus;
+
+static void
+addCensusSegments( ParCensus *pc, bdescr *bd, bool compact )
+{
+    while (bd != NULL) {
+        if (pc->n_segs == pc->max_segs) {
+            pc->max_segs = pc->max_segs == 0 ? 64 : pc->max_segs * 2;
+            pc->segs = stgReallocBytes(pc->segs,
+                                       pc->max_segs * sizeof(CensusSegment),
+                                       "addCensusSegments");
+        }
+        CensusSegment *seg = &pc->segs[pc->n_segs++];
+        seg->bd = bd;
+        seg->compact = compact;
+        seg->n_blocks = 0;
+        while (bd != NULL && seg->n_blocks < CENSUS_SEGMENT_BLOCKS) {
+            seg->n_blocks++;
+            bd = bd->link;
+        }
+    }
+}
+
+static void
+heapCensusSegment( Census *census, const CensusSegment *seg )
+{
+    bdescr *bd = seg->bd;
+    for (uint32_t i = 0; i < seg->n_blocks; i++, bd = bd->link) {
+        if (seg->compact) {
+            heapCensusCompactBlock(census, bd);
+        } else {
+            heapCensusBlockGroup(census, bd);
+        }
+    }
+}
+
+static void
+heapCensusWorker( uint32_t thread_index, void *arg )
+{
+    ParCensus *pc = (ParCensus *)arg;
+    Census *census = &pc->censuses[thread_index];
+    StgWord i;
+
+    initEra(census);
+
+    while ((i = atomic_inc(&pc->next_seg, 1) - 1) < pc->n_segs) {
+        heapCensusSegment(census, &pc->segs[i]);
+    }
+}
+
+static void
+heapCensusParallel( Census *census )
+{
+    ParCensus pc;
+    uint32_t g, n;
+    gen_workspace *ws;
+
+    pc.segs = NULL;
+    pc.n_segs = 0;
+    pc.max_segs = 0;
+    pc.next_seg = 0;
+    pc.censuses = stgCallocBytes(n_capabilities, sizeof(Census),
+                                 "heapCensusParallel");
+
+    // The same lists as the sequential census in heapCensus()
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        addCensusSegments(&pc, generations[g].blocks, false);
+        addCensusSegments(&pc, generations[g].large_objects, false);
+        addCensusSegments(&pc, generations[g].compact_objects, true);
+
+        for (n = 0; n < n_capabilities; n++) {
+            ws = &gc_threads[n]->gens[g];
+            addCensusSegments(&pc, ws->todo_bd, false);
+            addCensusSegments(&pc, ws->part_list, false);
+            addCensusSegments(&pc, ws->scavd_list, false);
+        }
+    }
+
+    runGcThreadsTask(heapCensusWorker, &pc);
+
+    // Idle GC threads don't take part, and leave their census empty
+    for (n = 0; n < n_capabilities; n++) {
+        if (pc.censuses[n].hash != NULL) {
+            mergeCensus(census, &pc.censuses[n]);
+            freeEra(&pc.censuses[n]);
+        }
+    }
+
+    stgFree(pc.censuses);
+    stgFree(pc.segs);
+}
+
+#endif /* THREADED_RTS */
+
 // Time is process CPU time of beginning of current GC and is used as
 // the mutator CPU time reported as the census timestamp.
 void heapCensus (Time t)
@@ -1285,22 +1586,37 @@ void heapCensus (Time t)
   stat_startHeapCensus();
 #endif
 
-  // Traverse the heap, collecting the census info
-  for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
-      heapCensusChain( census, generations[g].blocks );
-      // Are we interested in large objects?  might be
-      // confusing to include the stack in a heap profile.
-      heapCensusChain( census, generations[g].large_objects );
-      heapCensusCompactList ( census, generations[g].compact_objects );
-
-      for (n = 0; n < n_capabilities; n++) {
-          ws = &gc_threads[n]->gens[g];
-          heapCensusChain(census, ws->todo_bd);
-          heapCensusChain(census, ws->part_list);
-          heapCensusChain(census, ws->scavd_list);
+  // Traverse the heap, collecting the census info.  After a parallel
+  // GC we share the work with the other GC threads,
+  // see Note [Parallel heap census].
+#if defined(THREADED_RTS)
+  if (n_gc_threads > 1) {
+      heapCensusParallel(census);
+  } else
+#endif
+  {
+      for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+          heapCensusChain( census, generations[g].blocks );
+          // Are we interested in large objects?  might be
+          // confusing to include the stack in a heap profile.
+          heapCensusChain( census, generations[g].large_objects );
+          heapCensusCompactList ( census, generations[g].compact_objects );
+
+          for (n = 0; n < n_capabilities; n++) {
+              ws = &gc_threads[n]->gens[g];
+              heapCensusChain(census, ws->todo_bd);
+              heapCensusChain(census, ws->part_list);
+              heapCensusChain(census, ws->scavd_list);
+          }
       }
   }
 
+  // The nonmoving heap is counted while it is marked,
+  // see Note [Nonmoving heap census]
+  if (RtsFlags.GcFlags.useNonmoving) {
+      mergeNonmovingCensus(census);
+  }
+
   // dump out the census info
 #if defined(PROFILING)
     // We can't generate any info for LDV profiling until
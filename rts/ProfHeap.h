@@ -16,6 +16,17 @@ void        endHeapProfiling   (void);
 void        freeHeapProfiling  (void);
 bool        strMatchesSelector (const char* str, const char* sel);
 
+// Census of the nonmoving heap, taken while marking it.
+// See Note [Nonmoving heap census] in ProfHeap.c
+struct _Census;
+struct _Census *newNonmovingCensus     (void);
+void            freeNonmovingCensus    (struct _Census *census);
+void            nonmovingCensusClosure (struct _Census *census, StgClosure *p,
+                                        const StgInfoTable *info);
+void            nonmovingCensusCompact (struct _Census *census,
+                                        StgCompactNFData *str);
+void            publishNonmovingCensus (struct _Census *census);
+
 #if defined(PROFILING)
 // doingRetainerProfiling: `-hr` or `-hr<cc> -h<x>`
 bool doingRetainerProfiling(void);
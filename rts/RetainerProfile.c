@@ -20,6 +20,7 @@
 #include "StablePtr.h" /* markStablePtrTable */
 #include "StableName.h" /* rememberOldStableNameAddresses */
 #include "sm/Storage.h"
+#include "sm/GCThread.h" /* n_gc_threads */
 
 /* Note [What is a retainer?]
    ~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -91,6 +92,7 @@ retainerStackBlocks(void)
 void
 initRetainerProfiling( void )
 {
+    initRetainerSetLock();
     initializeAllRetainerSet();
     retainerGeneration = 0;
 }
@@ -102,6 +104,7 @@ void
 endRetainerProfiling( void )
 {
     outputAllRetainerSet(prof_file);
+    freeRetainerSetLock();
 }
 
 /* -----------------------------------------------------------------------------
@@ -347,6 +350,57 @@ retainVisitClosure( StgClosure *c, const StgClosure *cp, const stackData data, c
     return 1; // do process children
 }
 
+#if defined(THREADED_RTS)
+/* -----------------------------------------------------------------------------
+ *  The visit callback of a parallel traversal, see Note [Parallel heap
+ *  traversal] in TraverseHeap.c.
+ *
+ *  retainVisitClosure() relies on the order in which a sequential traversal
+ *  visits closures: it may give *c the whole retainer set of its parent, on
+ *  the grounds that every retainer that reaches the parent will also reach
+ *  *c through it. With several workers that no longer holds, as another
+ *  worker may be about to propagate one of those retainers from the parent
+ *  and would then stop at *c. So here we only ever add the retainer r that
+ *  we are propagating, and we add it with a CAS, as another worker may be
+ *  updating the retainer set of *c at the same time. The resulting retainer
+ *  sets are the same, but they may be created in a different order, so the
+ *  set ids can differ from a sequential traversal.
+ * -------------------------------------------------------------------------- */
+static bool
+retainVisitClosureParallel( StgClosure *c, const StgClosure *cp, const stackData data, const bool first_visit, stackAccum *acc, stackData *out_data )
+{
+    (void) cp;
+    (void) first_visit;
+    (void) acc;
+
+    retainer r = data.c_child_r;
+    RetainerSet *s, *retainerSetOfc;
+
+    do {
+        retainerSetOfc = retainerSetOf(c);
+        if (retainerSetOfc == NULL) {
+            s = singleton(r);
+        } else if (isMember(r, retainerSetOfc)) {
+            return 0;          // no need to process children
+        } else {
+            s = addElement(r, retainerSetOfc);
+        }
+    } while (!casTravData(&g_retainerTraverseState, c,
+                          (StgWord)retainerSetOfc, (StgWord)s));
+
+    if (retainerSetOfc == NULL) {
+        // We made the first visit to *c.
+        out_data->c_child_r = isRetainer(c) ? getRetainerFrom(c) : r;
+    } else {
+        if (isRetainer(c))
+            return 0;          // no need to process children
+        out_data->c_child_r = r;
+    }
+
+    return 1; // do process children
+}
+#endif
+
 /**
  *  Push every object reachable from *tl onto the traversal work stack.
  */
@@ -408,7 +462,18 @@ computeRetainerSet( traverseState *ts )
     // Remember old stable name addresses.
     rememberOldStableNameAddresses ();
 
-    traverseWorkStack(ts, &retainVisitClosure);
+    // After a parallel GC, share the traversal with the other GC threads.
+#if defined(THREADED_RTS)
+    if (n_gc_threads > 1) {
+        traverseWorkStackParallel(ts, &retainVisitClosureParallel);
+        // The parallel visitor keeps no statistics of its own.
+        numObjectVisited = ts->firstVisits;
+        timesAnyObjectVisited = ts->visits;
+    } else
+#endif
+    {
+        traverseWorkStack(ts, &retainVisitClosure);
+    }
 }
 
 /* -----------------------------------------------------------------------------
@@ -29,6 +29,25 @@ static Arena *arena;            // arena in which we store retainer sets
 
 static int nextId;              // id of next retainer set
 
+/* -----------------------------------------------------------------------------
+ * Note [Concurrent retainer set creation]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * A parallel retainer profile (see Note [Parallel heap traversal] in
+ * TraverseHeap.c) calls singleton() and addElement() from several threads at
+ * once. Almost all of those calls find an existing set, so lookups take no
+ * lock: a retainer set never changes once it is in hashTable[], and a new set
+ * is published by a release store of its bucket head, after its fields have
+ * been filled in.
+ *
+ * Creating a set takes retainer_set_mutex, which protects the arena, nextId
+ * and the bucket heads. Another thread may have created the same set since
+ * our lookup, so the bucket is searched again under the lock before we add a
+ * new set; this keeps every retainer set unique (see RetainerSet.h).
+ * -------------------------------------------------------------------------- */
+#if defined(THREADED_RTS)
+static Mutex retainer_set_mutex;
+#endif
+
 /* -----------------------------------------------------------------------------
  * rs_MANY is a distinguished retainer set, such that
  *
@@ -57,6 +76,25 @@ sizeofRetainerSet( int elems )
     return (sizeof(RetainerSet) + elems * sizeof(retainer));
 }
 
+/* -----------------------------------------------------------------------------
+ * Initializes and frees the lock protecting hashTable[].
+ * -------------------------------------------------------------------------- */
+void
+initRetainerSetLock(void)
+{
+#if defined(THREADED_RTS)
+    initMutex(&retainer_set_mutex);
+#endif
+}
+
+void
+freeRetainerSetLock(void)
+{
+#if defined(THREADED_RTS)
+    closeMutex(&retainer_set_mutex);
+#endif
+}
+
 /* -----------------------------------------------------------------------------
  * Creates the first pool and initializes hashTable[].
  * Frees all pools if any.
@@ -85,6 +123,17 @@ closeAllRetainerSet(void)
 /* -----------------------------------------------------------------------------
  *  Finds or creates if needed a singleton retainer set.
  * -------------------------------------------------------------------------- */
+STATIC_INLINE RetainerSet *
+findSingleton(retainer r, StgWord hk)
+{
+    RetainerSet *rs;
+
+    for (rs = ACQUIRE_LOAD(&hashTable[hash(hk)]); rs != NULL; rs = rs->link)
+        if (rs->num == 1 &&  rs->element[0] == r) return rs;    // found it
+
+    return NULL;
+}
+
 RetainerSet *
 singleton(retainer r)
 {
@@ -92,8 +141,16 @@ singleton(retainer r)
     StgWord hk;
 
     hk = hashKeySingleton(r);
-    for (rs = hashTable[hash(hk)]; rs != NULL; rs = rs->link)
-        if (rs->num == 1 &&  rs->element[0] == r) return rs;    // found it
+    rs = findSingleton(r, hk);
+    if (rs != NULL) return rs;
+
+    // See Note [Concurrent retainer set creation]
+    ACQUIRE_LOCK(&retainer_set_mutex);
+    rs = findSingleton(r, hk);
+    if (rs != NULL) {
+        RELEASE_LOCK(&retainer_set_mutex);
+        return rs;
+    }
 
     // create it
     rs = arenaAlloc( arena, sizeofRetainerSet(1) );
@@ -104,11 +161,51 @@ singleton(retainer r)
     rs->element[0] = r;
 
     // The new retainer set is placed at the head of the linked list.
-    hashTable[hash(hk)] = rs;
+    RELEASE_STORE(&hashTable[hash(hk)], rs);
+    RELEASE_LOCK(&retainer_set_mutex);
 
     return rs;
 }
 
+/* -----------------------------------------------------------------------------
+ *   Finds the existing retainer set *rs augmented with r, if any, where nl is
+ *   the number of retainers in *rs less than r and hk the hash key of the new
+ *   set.
+ * -------------------------------------------------------------------------- */
+static RetainerSet *
+findAddElement(retainer r, RetainerSet *rs, uint32_t nl, StgWord hk)
+{
+    uint32_t i;
+    RetainerSet *nrs;
+
+    // Compare the first nl retainers, then r itself, and finally the
+    // remaining (rs->num - nl) retainers.
+    for (nrs = ACQUIRE_LOAD(&hashTable[hash(hk)]); nrs != NULL; nrs = nrs->link) {
+        // test *rs and *nrs for equality
+
+        // check their size
+        if (rs->num + 1 != nrs->num) continue;
+
+        // compare the first nl retainers and find the first non-matching one.
+        for (i = 0; i < nl; i++)
+            if (rs->element[i] != nrs->element[i]) break;
+        if (i < nl) continue;
+
+        // compare r itself
+        if (r != nrs->element[i]) continue;       // i == nl
+
+        // compare the remaining retainers
+        for (; i < rs->num; i++)
+            if (rs->element[i] != nrs->element[i + 1]) break;
+        if (i < rs->num) continue;
+
+        // The set we are seeking already exists!
+        return nrs;
+    }
+
+    return NULL;
+}
+
 /* -----------------------------------------------------------------------------
  *   Finds or creates a retainer set *rs augmented with r.
  *   Invariants:
@@ -142,32 +239,16 @@ addElement(retainer r, RetainerSet *rs)
         if (r < rs->element[nl]) break;
     // Now nl is the index for r into the new set.
     // Also it denotes the number of retainers less than r in *rs.
-    // Thus, compare the first nl retainers, then r itself, and finally the
-    // remaining (rs->num - nl) retainers.
 
     hk = hashKeyAddElement(r, rs);
-    for (nrs = hashTable[hash(hk)]; nrs != NULL; nrs = nrs->link) {
-        // test *rs and *nrs for equality
-
-        // check their size
-        if (rs->num + 1 != nrs->num) continue;
-
-        // compare the first nl retainers and find the first non-matching one.
-        for (i = 0; i < nl; i++)
-            if (rs->element[i] != nrs->element[i]) break;
-        if (i < nl) continue;
-
-        // compare r itself
-        if (r != nrs->element[i]) continue;       // i == nl
-
-        // compare the remaining retainers
-        for (; i < rs->num; i++)
-            if (rs->element[i] != nrs->element[i + 1]) break;
-        if (i < rs->num) continue;
-
-        // debugBelch("%p\n", nrs);
-
-        // The set we are seeking already exists!
+    nrs = findAddElement(r, rs, nl, hk);
+    if (nrs != NULL) return nrs;
+
+    // See Note [Concurrent retainer set creation]
+    ACQUIRE_LOCK(&retainer_set_mutex);
+    nrs = findAddElement(r, rs, nl, hk);
+    if (nrs != NULL) {
+        RELEASE_LOCK(&retainer_set_mutex);
         return nrs;
     }
 
@@ -185,7 +266,8 @@ addElement(retainer r, RetainerSet *rs)
         nrs->element[i + 1] = rs->element[i];
     }
 
-    hashTable[hash(hk)] = nrs;
+    RELEASE_STORE(&hashTable[hash(hk)], nrs);
+    RELEASE_LOCK(&retainer_set_mutex);
 
     // debugBelch("%p\n", nrs);
     return nrs;
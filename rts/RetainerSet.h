@@ -53,6 +53,10 @@ typedef struct _RetainerSet {
 } RetainerSet;
 
 
+// Initializes and frees the lock used by singleton() and addElement().
+void initRetainerSetLock(void);
+void freeRetainerSetLock(void);
+
 // Creates the first pool and initializes a hash table. Frees all pools if any.
 void initializeAllRetainerSet(void);
 
@@ -60,6 +64,8 @@ void initializeAllRetainerSet(void);
 void closeAllRetainerSet(void);
 
 // Finds or creates if needed a singleton retainer set.
+// This and addElement() may be called by several threads at once, see
+// Note [Concurrent retainer set creation] in RetainerSet.c.
 RetainerSet *singleton(retainer r);
 
 extern RetainerSet rs_MANY;
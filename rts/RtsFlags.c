@@ -173,6 +173,10 @@ void initRtsFlagsDefaults(void)
     RtsFlags.GcFlags.sweep              = false;
     RtsFlags.GcFlags.idleGCDelayTime    = USToTime(300000); // 300ms
     RtsFlags.GcFlags.interIdleGCWait    = 0;
+    RtsFlags.GcFlags.pauseTarget        = 0;    /* off by default */
+    RtsFlags.GcFlags.cgroupMemoryLimit  = true;
+    RtsFlags.GcFlags.returnMemoryRate   = (256 * 1024 * 1024) / MBLOCK_SIZE;
+    RtsFlags.GcFlags.returnMemoryDelay  = USToTime(1000000); // 1s
 #if defined(THREADED_RTS)
     RtsFlags.GcFlags.doIdleGC           = true;
 #else
@@ -249,6 +253,7 @@ void initRtsFlagsDefaults(void)
     RtsFlags.MiscFlags.tickInterval     = DEFAULT_TICK_INTERVAL;
 #endif
     RtsFlags.ConcFlags.ctxtSwitchTime   = USToTime(20000); // 20ms
+    RtsFlags.ConcFlags.adaptiveCtxtSwitch = false;
 
     RtsFlags.MiscFlags.install_signal_handlers = true;
     RtsFlags.MiscFlags.install_seh_handlers    = true;
@@ -257,8 +262,11 @@ void initRtsFlagsDefaults(void)
     RtsFlags.MiscFlags.machineReadable         = false;
     RtsFlags.MiscFlags.disableDelayedOsMemoryReturn = false;
     RtsFlags.MiscFlags.internalCounters        = false;
+    RtsFlags.MiscFlags.threadAccounting        = false;
     RtsFlags.MiscFlags.linkerAlwaysPic         = DEFAULT_LINKER_ALWAYS_PIC;
     RtsFlags.MiscFlags.linkerMemBase           = 0;
+    RtsFlags.MiscFlags.linkerThreads           = 1;
+    RtsFlags.MiscFlags.finalizerThreads        = 0;
 #if defined(DEFAULT_NATIVE_IO_MANAGER)
     RtsFlags.MiscFlags.ioManager               = IO_MNGR_NATIVE;
 #else
@@ -350,6 +358,19 @@ usage_text[] = {
 #if defined(THREADED_RTS)
 "  -I<sec>  Perform full GC after <sec> idle time (default: 0.3, 0 == off)",
 #endif
+"  --gc-pause-target=<sec>",
+"           Adapt the allocation area and old generation sizes to keep GC",
+"           pauses under <sec>, within the maximum heap size (default: 0, off)",
+"  --cgroup-memory-limit=<yes|no>",
+"           Derive a soft heap limit from the memory limits of the cgroup",
+"           of the process, and collect harder under memory pressure",
+"           (default: yes)",
+"  --return-memory-rate=<size>",
+"           Return free memory to the OS in the background, at most <size>",
+"           bytes per second (0 = at the end of the GC, default: 256m)",
+"  --return-memory-delay=<sec>",
+"           Wait <sec> after a GC before returning memory to the OS in the",
+"           background (default: 1)",
 "",
 "  -T         Collect GC statistics (useful for in-program statistics access)",
 "  -t[<file>] One-line GC statistics (if <file> omitted, uses stderr)",
@@ -438,6 +459,10 @@ usage_text[] = {
 "  -C<secs>  Context-switch interval in seconds.",
 "            0 or no argument means switch as often as possible.",
 "            Default: 0.02 sec.",
+"  --adaptive-context-switch=<yes|no>",
+"            Adapt the context-switch interval of each capability to its",
+"            threads, and don't switch when no other thread can run",
+"            (default: no)",
 "  -V<secs>  Master tick interval in seconds (0 == disable timer).",
 "            This sets the resolution for -C and the heap profile timer -i,",
 "            and is the frequency of time profile samples.",
@@ -511,6 +536,9 @@ usage_text[] = {
 #endif
 "  --io-manager=<native|posix>",
 "            The I/O manager subsystem to use. (default: posix)",
+"  --thread-accounting",
+"            Count the allocation and CPU time of each Haskell thread",
+"            (default: off)",
 #if defined(THREADED_RTS)
 #if defined(mingw32_HOST_OS)
 "  --io-manager-threads=<num>",
@@ -518,6 +546,11 @@ usage_text[] = {
 "            handle completion events. (default: num cores)",
 #endif
 "  -e<n>     Maximum number of outstanding local sparks (default: 4096)",
+"  --linker-threads[=<n>]",
+"            Resolve the objects loaded by the runtime linker on <n> threads",
+"            (default: 1, or the number of processors if <n> is omitted)",
+"  --finalizer-threads=<n>",
+"            Run C finalizers on <n> threads (default: one per capability)",
 #endif
 #if defined(x86_64_HOST_ARCH)
 #if !DEFAULT_LINKER_ALWAYS_PIC
@@ -935,6 +968,16 @@ error = true;
                       OPTION_UNSAFE;
                       RtsFlags.MiscFlags.install_signal_handlers = false;
                   }
+                  else if (strequal("adaptive-context-switch=yes",
+                               &rts_argv[arg][2])) {
+                      OPTION_UNSAFE;
+                      RtsFlags.ConcFlags.adaptiveCtxtSwitch = true;
+                  }
+                  else if (strequal("adaptive-context-switch=no",
+                               &rts_argv[arg][2])) {
+                      OPTION_UNSAFE;
+                      RtsFlags.ConcFlags.adaptiveCtxtSwitch = false;
+                  }
                   else if (strequal("install-seh-handlers=yes",
                               &rts_argv[arg][2])) {
                       OPTION_UNSAFE;
@@ -980,6 +1023,11 @@ error = true;
                       OPTION_SAFE;
                       RtsFlags.MiscFlags.internalCounters = true;
                   }
+                  else if (strequal("thread-accounting",
+                                    &rts_argv[arg][2])) {
+                      OPTION_SAFE;
+                      RtsFlags.MiscFlags.threadAccounting = true;
+                  }
                   else if (strequal("io-manager=native",
                                &rts_argv[arg][2])) {
                       OPTION_UNSAFE;
@@ -1016,6 +1064,48 @@ error = true;
                       OPTION_SAFE;
                       RtsFlags.GcFlags.useNonmoving = true;
                   }
+                  else if (strequal("cgroup-memory-limit=yes",
+                               &rts_argv[arg][2])) {
+                      OPTION_UNSAFE;
+                      RtsFlags.GcFlags.cgroupMemoryLimit = true;
+                  }
+                  else if (strequal("cgroup-memory-limit=no",
+                               &rts_argv[arg][2])) {
+                      OPTION_UNSAFE;
+                      RtsFlags.GcFlags.cgroupMemoryLimit = false;
+                  }
+                  else if (!strncmp("return-memory-rate=",
+                               &rts_argv[arg][2], 19)) {
+                      OPTION_UNSAFE;
+                      StgWord64 rate = decodeSize(rts_argv[arg], 21, 0,
+                                                  HS_WORD64_MAX);
+                      RtsFlags.GcFlags.returnMemoryRate =
+                          rate == 0 ? 0
+                                    : (uint32_t)stg_min(stg_max(1, rate / MBLOCK_SIZE),
+                                                        UINT32_MAX);
+                  }
+                  else if (!strncmp("return-memory-delay=",
+                               &rts_argv[arg][2], 20)) {
+                      OPTION_UNSAFE;
+                      double delaySeconds = parseDouble(rts_argv[arg]+22, &error);
+                      if (error || delaySeconds < 0) {
+                          errorBelch("bad value for --return-memory-delay");
+                          error = true;
+                      }
+                      RtsFlags.GcFlags.returnMemoryDelay =
+                          fsecondsToTime(delaySeconds);
+                  }
+                  else if (!strncmp("gc-pause-target=",
+                               &rts_argv[arg][2], 16)) {
+                      OPTION_SAFE;
+                      double pauseSeconds = parseDouble(rts_argv[arg]+18, &error);
+                      if (error || pauseSeconds < 0) {
+                          errorBelch("bad value for --gc-pause-target");
+                          error = true;
+                      }
+                      RtsFlags.GcFlags.pauseTarget =
+                          fsecondsToTime(pauseSeconds);
+                  }
 #if defined(THREADED_RTS)
 #if defined(mingw32_HOST_OS)
                   else if (!strncmp("io-manager-threads",
@@ -1042,6 +1132,41 @@ error = true;
                       RtsFlags.MiscFlags.numIoWorkerThreads = num;
                   }
 #endif
+                  else if (!strncmp("linker-threads",
+                                    &rts_argv[arg][2], 14)) {
+                      OPTION_SAFE;
+                      if (rts_argv[arg][16] == '\0') {
+                          RtsFlags.MiscFlags.linkerThreads =
+                              getNumberOfProcessors();
+                      } else if (rts_argv[arg][16] == '=') {
+                          int num = strtol(rts_argv[arg]+17,
+                                           (char **) NULL, 10);
+                          if (num < 1) {
+                              errorBelch("%s: Expected a positive number of "
+                                         "threads.", rts_argv[arg]);
+                              error = true;
+                              break;
+                          }
+                          RtsFlags.MiscFlags.linkerThreads = num;
+                      } else {
+                          bad_option( rts_argv[arg] );
+                      }
+                  }
+                  else if (!strncmp("finalizer-threads=",
+                                    &rts_argv[arg][2], 18)) {
+                      OPTION_SAFE;
+                      THREADED_BUILD_ONLY(
+                          int num = strtol(rts_argv[arg]+20,
+                                           (char **) NULL, 10);
+                          if (num < 1) {
+                              errorBelch("%s: Expected a positive number of "
+                                         "threads.", rts_argv[arg]);
+                              error = true;
+                              break;
+                          }
+                          RtsFlags.MiscFlags.finalizerThreads = num;
+                      )
+                  }
                   else if (!strncmp("numa", &rts_argv[arg][2], 4)) {
                       if (!osBuiltWithNumaSupport()) {
                           errorBelch("%s: This GHC build was compiled without NUMA support.",
@@ -1912,9 +2037,15 @@ static void normaliseRtsOpts (void)
     }
 #endif
 
-    if (RtsFlags.ProfFlags.doHeapProfile != NO_HEAP_PROFILING &&
+    // The nonmoving heap is profiled as it is marked, which can't maintain
+    // the retainer sets or biographies. See Note [Nonmoving heap census].
+    if ((RtsFlags.ProfFlags.doHeapProfile == HEAP_BY_RETAINER ||
+         RtsFlags.ProfFlags.doHeapProfile == HEAP_BY_LDV ||
+         RtsFlags.ProfFlags.retainerSelector != NULL ||
+         RtsFlags.ProfFlags.bioSelector != NULL) &&
             RtsFlags.GcFlags.useNonmoving) {
-        barf("The non-moving collector doesn't support profiling");
+        barf("The non-moving collector doesn't support retainer or "
+             "biographical profiling");
     }
 
     if (RtsFlags.GcFlags.compact && RtsFlags.GcFlags.useNonmoving) {
@@ -313,6 +313,9 @@ hs_init_ghc(int *argc, char **argv[], RtsConfig rts_config)
     /* initialise the stable name table */
     initStableNameTable();
 
+    /* initialise the finalizer queue */
+    initFinalizers();
+
     /* Add some GC roots for things in the base package that the RTS
      * knows about.  We don't know whether these turn out to be CAFs
      * or refer to CAFs, but we have to assume that they might.
@@ -462,6 +465,9 @@ hs_exit_(bool wait_foreign)
         runAllCFinalizers(generations[g].weak_ptr_list);
     }
 
+    /* stop the finalizer threads, now that there is nothing left for them */
+    exitFinalizers();
+
 #if defined(RTS_USER_SIGNALS)
     if (RtsFlags.MiscFlags.install_signal_handlers) {
         freeSignalHandlers();
@@ -666,6 +666,8 @@
       SymI_HasProto(getOrSetLibHSghcFastStringTable)                    \
       SymI_HasProto(getRTSStats)                                        \
       SymI_HasProto(getRTSStatsEnabled)                                 \
+      SymI_HasProto(getPauseHistogramQuantile)                          \
+      SymI_HasProto(getPauseHistogramBucketBound)                       \
       SymI_HasProto(getOrSetLibHSghcGlobalHasPprDebug)                  \
       SymI_HasProto(getOrSetLibHSghcGlobalHasNoDebugOutput)             \
       SymI_HasProto(getOrSetLibHSghcGlobalHasNoStateHack)               \
@@ -842,6 +844,7 @@
       SymI_HasProto(rts_setInCallCapability)                            \
       SymI_HasProto(rts_enableThreadAllocationLimit)                    \
       SymI_HasProto(rts_disableThreadAllocationLimit)                   \
+      SymI_HasProto(rts_getThreadAccounting)                            \
       SymI_HasProto(rts_setMainThread)                                  \
       SymI_HasProto(setProgArgv)                                        \
       SymI_HasProto(startupHaskell)                                     \
@@ -969,6 +972,7 @@
       SymI_HasProto(stg_takeMVarzh)                                     \
       SymI_HasProto(stg_readMVarzh)                                     \
       SymI_HasProto(stg_threadStatuszh)                                 \
+      SymI_HasProto(stg_threadAccountingzh)                             \
       SymI_HasProto(stg_tryPutMVarzh)                                   \
       SymI_HasProto(stg_tryTakeMVarzh)                                  \
       SymI_HasProto(stg_tryReadMVarzh)                                  \
@@ -1012,6 +1016,14 @@
       SymI_HasProto(getMonotonicNSec)                                   \
       SymI_HasProto(lockFile)                                           \
       SymI_HasProto(unlockFile)                                         \
+      SymI_HasProto(compactFileWrite)                                   \
+      SymI_HasProto(compactFileOpen)                                    \
+      SymI_HasProto(compactFileBlockCount)                              \
+      SymI_HasProto(compactFileBlockAddress)                            \
+      SymI_HasProto(compactFileBlockSize)                               \
+      SymI_HasProto(compactFileRoot)                                    \
+      SymI_HasProto(compactFileLoadBlock)                               \
+      SymI_HasProto(compactFileClose)                                   \
       SymI_HasProto(startProfTimer)                                     \
       SymI_HasProto(stopProfTimer)                                      \
       SymI_HasProto(startHeapProfTimer)                                 \
@@ -48,6 +48,8 @@
 #include "TopHandler.h"
 #include "sm/NonMoving.h"
 #include "sm/NonMovingMark.h"
+#include "sm/MemoryLimit.h"
+#include "sm/BlockAlloc.h"
 
 #if defined(HAVE_SYS_TYPES_H)
 #include <sys/types.h>
@@ -462,11 +464,19 @@ run_thread:
         // wakeUpRts().
         break;
     default:
-        SEQ_CST_STORE(&recent_activity, ACTIVITY_YES);
+        // The ticker may be waiting for the RTS to become idle: wake it
+        // up. See Note [Tickless idle] in Timer.c
+        if (xchg((P_)&recent_activity, ACTIVITY_YES) == ACTIVITY_MAYBE_NO) {
+            wakeTimer();
+        }
     }
 
     traceEventRunThread(cap, t);
 
+    if (RTS_UNLIKELY(RtsFlags.MiscFlags.threadAccounting)) {
+        startThreadAccounting(cap, t);
+    }
+
     switch (prev_what_next) {
 
     case ThreadKilled:
@@ -499,6 +509,13 @@ run_thread:
     // happened.  So find the new location:
     t = cap->r.rCurrentTSO;
 
+    if (RTS_UNLIKELY(RtsFlags.MiscFlags.threadAccounting)) {
+        stopThreadAccounting(cap, t);
+        if (ret == ThreadFinished) {
+            traceThreadStats(cap, t);
+        }
+    }
+
     // cap->r.rCurrentTSO is charged for calls to allocate(), so we
     // don't want it set when not running a Haskell thread.
     cap->r.rCurrentTSO = NULL;
@@ -563,6 +580,8 @@ run_thread:
         break;
 
     case ThreadBlocked:
+        // See Note [Adaptive context switching] in Timer.c
+        RELAXED_STORE(&cap->n_blocked, cap->n_blocked + 1);
         scheduleHandleThreadBlocked(t);
         break;
 
@@ -1620,7 +1639,9 @@ scheduleDoGC (Capability **pcap, Task *task USED_IF_THREADS,
 
     // Figure out which generation we are collecting, so that we can
     // decide whether this is a parallel GC or not.
-    collect_gen = calcNeeded(force_major || heap_census, NULL);
+    // See Note [Memory limits] in sm/MemoryLimit.c
+    collect_gen = calcNeeded(force_major || heap_census || memoryPressure(),
+                             NULL);
     major_gc = (collect_gen == RtsFlags.GcFlags.generations-1);
 
 #if defined(THREADED_RTS)
@@ -1881,9 +1902,9 @@ delete_threads_and_gc:
     // emerge they don't immediately re-enter the GC.
     pending_sync = 0;
     signalCondition(&sync_finished_cond);
-    GarbageCollect(collect_gen, heap_census, is_overflow_gc, deadlock_detect, gc_type, cap, idle_cap);
+    GarbageCollect(collect_gen, heap_census, is_overflow_gc, deadlock_detect, force_major, gc_type, cap, idle_cap);
 #else
-    GarbageCollect(collect_gen, heap_census, is_overflow_gc, deadlock_detect, 0, cap, NULL);
+    GarbageCollect(collect_gen, heap_census, is_overflow_gc, deadlock_detect, force_major, 0, cap, NULL);
 #endif
 
     // If we're shutting down, don't leave any idle GC work to do.
@@ -2052,7 +2073,10 @@ forkProcess(HsStablePtr *entry
     ACQUIRE_LOCK(&sched_mutex);
     ACQUIRE_LOCK(&sm_mutex);
     ACQUIRE_LOCK(&stable_ptr_mutex);
-    ACQUIRE_LOCK(&stable_name_mutex);
+    stableNameLock();
+#if defined(THREADED_RTS)
+    finalizerLock();
+#endif
 
     for (i=0; i < n_capabilities; i++) {
         ACQUIRE_LOCK(&capabilities[i]->lock);
@@ -2080,7 +2104,10 @@ forkProcess(HsStablePtr *entry
         RELEASE_LOCK(&sched_mutex);
         RELEASE_LOCK(&sm_mutex);
         RELEASE_LOCK(&stable_ptr_mutex);
-        RELEASE_LOCK(&stable_name_mutex);
+        stableNameUnlock();
+#if defined(THREADED_RTS)
+        finalizerUnlock();
+#endif
         RELEASE_LOCK(&task->lock);
 
 #if defined(THREADED_RTS)
@@ -2108,7 +2135,9 @@ forkProcess(HsStablePtr *entry
         initMutex(&sched_mutex);
         initMutex(&sm_mutex);
         initMutex(&stable_ptr_mutex);
-        initMutex(&stable_name_mutex);
+        initStableNameLocks();
+        initFinalizers();
+        initMemoryReturn();
         initMutex(&task->lock);
 
         for (i=0; i < n_capabilities; i++) {
@@ -2478,6 +2507,10 @@ suspendThread (StgRegTable *reg, bool interruptible)
 
   traceEventStopThread(cap, tso, THREAD_SUSPENDED_FOREIGN_CALL, 0);
 
+  if (RTS_UNLIKELY(RtsFlags.MiscFlags.threadAccounting)) {
+      stopThreadAccounting(cap, tso);
+  }
+
   // XXX this might not be necessary --SDM
   tso->what_next = ThreadRunGHC;
 
@@ -2552,6 +2585,10 @@ resumeThread (void *task_)
 
     traceEventRunThread(cap, tso);
 
+    if (RTS_UNLIKELY(RtsFlags.MiscFlags.threadAccounting)) {
+        startThreadAccounting(cap, tso);
+    }
+
     /* Reset blocking status */
     tso->why_blocked  = NotBlocked;
 
@@ -24,24 +24,86 @@ static snEntry *stable_name_free = NULL;
 unsigned int SNT_size = 0;
 #define INIT_SNT_SIZE 64
 
+/* Old versions of the table, retained until the next GC, as for the stable
+ * pointer table (see Note [Enlarging the stable pointer table] in
+ * StablePtr.c).
+ */
+#if SIZEOF_VOID_P == 4
+#define MAX_N_OLD_SNTS 32
+#elif SIZEOF_VOID_P == 8
+#define MAX_N_OLD_SNTS 64
+#else
+#error unknown SIZEOF_VOID_P
+#endif
+
+static snEntry *old_SNTs[MAX_N_OLD_SNTS];
+static uint32_t n_old_SNTs = 0;
+
 #if defined(THREADED_RTS)
 Mutex stable_name_mutex;
 #endif
 
 static void enlargeStableNameTable(void);
 
-/*
- * This hash table maps Haskell objects to stable names, so that every
- * call to lookupStableName on a given object will return the same
- * stable name.
+/* Note [Concurrent stable name lookups]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * A hash table maps Haskell objects to stable names, so that every call to
+ * makeStableName on a given object returns the same stable name.  Programs
+ * using stable names for memoisation make many lookups, from several
+ * capabilities at once, so rather than one table protected by
+ * stable_name_mutex the hash table is split into SN_HASH_SHARDS shards,
+ * selected by a hash of the object's address, each with its own lock.
+ *
+ * A lookup of an object that already has a stable name only takes the lock
+ * of its shard.  It then reads the entry without stable_name_mutex, which
+ * is safe because:
+ *
+ *  - an entry is only freed with every lock held (stableNameLock()),
+ *  - an entry is complete, including its sn_obj, before it is added to its
+ *    shard, and its fields don't change outside GC,
+ *  - enlarging the table copies it and retains the old version until the
+ *    next GC, like the stable pointer table, so a stale table pointer still
+ *    refers to valid memory with the same contents.
+ *
+ * Creating a stable name also takes stable_name_mutex, which protects the
+ * free list and the table itself.  The lock order is: shards in increasing
+ * order, then stable_name_mutex.  The GC and the nonmoving sweep take every
+ * lock with stableNameLock().
+ *
+ * Outside GC, the `old` field of every entry in use is its key in the hash
+ * table.  After GC, updateStableNameTable() only re-hashes the entries
+ * whose object moved or died, first removing all of their old keys and
+ * then inserting the new ones, since with the compacting collector an
+ * object may move to the old address of another.
  */
+#define SN_HASH_SHARD_BITS 6
+#define SN_HASH_SHARDS (1 << SN_HASH_SHARD_BITS)
 
-static HashTable *addrToStableHash = NULL;
+typedef struct SnHashShard_ {
+    HashTable *hash;
+#if defined(THREADED_RTS)
+    Mutex lock;
+#endif
+} ATTRIBUTE_ALIGNED(64) SnHashShard;
+
+static SnHashShard addrToStableHash[SN_HASH_SHARDS];
+
+STATIC_INLINE SnHashShard *
+snHashShard(StgPtr p)
+{
+    StgWord32 h = hashWord(NULL, (StgWord)p);
+    return &addrToStableHash[h >> (32 - SN_HASH_SHARD_BITS)];
+}
 
 void
 stableNameLock(void)
 {
     initStableNameTable();
+#if defined(THREADED_RTS)
+    for (uint32_t i = 0; i < SN_HASH_SHARDS; i++) {
+        ACQUIRE_LOCK(&addrToStableHash[i].lock);
+    }
+#endif
     ACQUIRE_LOCK(&stable_name_mutex);
 }
 
@@ -49,6 +111,22 @@ void
 stableNameUnlock(void)
 {
     RELEASE_LOCK(&stable_name_mutex);
+#if defined(THREADED_RTS)
+    for (uint32_t i = 0; i < SN_HASH_SHARDS; i++) {
+        RELEASE_LOCK(&addrToStableHash[i].lock);
+    }
+#endif
+}
+
+void
+initStableNameLocks(void)
+{
+#if defined(THREADED_RTS)
+    initMutex(&stable_name_mutex);
+    for (uint32_t i = 0; i < SN_HASH_SHARDS; i++) {
+        initMutex(&addrToStableHash[i].lock);
+    }
+#endif
 }
 
 /* -----------------------------------------------------------------------------
@@ -60,7 +138,7 @@ initSnEntryFreeList(snEntry *table, uint32_t n, snEntry *free)
 {
   snEntry *p;
   for (p = table + n - 1; p >= table; p--) {
-    p->addr   = (P_)free;
+    RELAXED_STORE(&p->addr, (P_)free);
     p->old    = NULL;
     p->sn_obj = NULL;
     free = p;
@@ -80,28 +158,40 @@ initStableNameTable(void)
      * return NULL if an entry isn't found in the hash table.
      */
     initSnEntryFreeList(stable_name_table + 1,INIT_SNT_SIZE-1,NULL);
-    addrToStableHash = allocHashTable();
+    for (uint32_t i = 0; i < SN_HASH_SHARDS; i++) {
+        addrToStableHash[i].hash = allocHashTable();
+    }
 
-#if defined(THREADED_RTS)
-    initMutex(&stable_name_mutex);
-#endif
+    initStableNameLocks();
 }
 
 /* -----------------------------------------------------------------------------
  * Enlarging the tables
  * -------------------------------------------------------------------------- */
 
+// Must be holding stable_name_mutex
 static void
 enlargeStableNameTable(void)
 {
     uint32_t old_SNT_size = SNT_size;
+    snEntry *new_stable_name_table;
 
     // 2nd and subsequent times
     SNT_size *= 2;
-    stable_name_table =
-        stgReallocBytes(stable_name_table,
-                        SNT_size * sizeof(snEntry),
-                        "enlargeStableNameTable");
+
+    /* Lookups may still be reading the old version; see Note [Concurrent
+     * stable name lookups].
+     */
+    new_stable_name_table =
+        stgMallocBytes(SNT_size * sizeof(snEntry),
+                       "enlargeStableNameTable");
+    memcpy(new_stable_name_table,
+           stable_name_table,
+           old_SNT_size * sizeof(snEntry));
+    ASSERT(n_old_SNTs < MAX_N_OLD_SNTS);
+    old_SNTs[n_old_SNTs++] = stable_name_table;
+
+    RELEASE_STORE(&stable_name_table, new_stable_name_table);
 
     initSnEntryFreeList(stable_name_table + old_SNT_size, old_SNT_size, NULL);
 }
@@ -111,28 +201,48 @@ enlargeStableNameTable(void)
  * Freeing entries and tables
  * -------------------------------------------------------------------------- */
 
+static void
+freeOldSNTs(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < n_old_SNTs; i++) {
+        stgFree(old_SNTs[i]);
+    }
+    n_old_SNTs = 0;
+}
+
 void
 exitStableNameTable(void)
 {
-    if (addrToStableHash)
-        freeHashTable(addrToStableHash, NULL);
-    addrToStableHash = NULL;
+    for (uint32_t i = 0; i < SN_HASH_SHARDS; i++) {
+        if (addrToStableHash[i].hash)
+            freeHashTable(addrToStableHash[i].hash, NULL);
+        addrToStableHash[i].hash = NULL;
+#if defined(THREADED_RTS)
+        closeMutex(&addrToStableHash[i].lock);
+#endif
+    }
 
     if (stable_name_table)
         stgFree(stable_name_table);
     stable_name_table = NULL;
     SNT_size = 0;
 
+    freeOldSNTs();
+
 #if defined(THREADED_RTS)
     closeMutex(&stable_name_mutex);
 #endif
 }
 
+// Must be holding every stable name lock, see stableNameLock()
 void
 freeSnEntry(snEntry *sn)
 {
   ASSERT(sn->sn_obj == NULL);
-  removeHashTable(addrToStableHash, (W_)sn->old, NULL);
+  removeHashTable(snHashShard(sn->old)->hash, (W_)sn->old, NULL);
+  sn->old = NULL;
   sn->addr = (P_)stable_name_free;
   stable_name_free = sn;
 }
@@ -174,14 +284,12 @@ removeIndirections (StgClosure* p)
     }
 }
 
-StgWord
-lookupStableName (StgPtr p)
+StgClosure *
+makeStableName (Capability *cap, StgPtr p)
 {
-  stableNameLock();
+  StgClosure *sn_obj;
 
-  if (stable_name_free == NULL) {
-    enlargeStableNameTable();
-  }
+  initStableNameTable();
 
   /* removing indirections increases the likelihood
    * of finding a match in the stable name hash table.
@@ -191,27 +299,52 @@ lookupStableName (StgPtr p)
   // register the untagged pointer.  This just makes things simpler.
   p = (StgPtr)UNTAG_CLOSURE((StgClosure*)p);
 
-  StgWord sn = (StgWord)lookupHashTable(addrToStableHash,(W_)p);
+  // See Note [Concurrent stable name lookups]
+  SnHashShard *shard = snHashShard(p);
+  ACQUIRE_LOCK(&shard->lock);
+
+  StgWord sn = (StgWord)lookupHashTable(shard->hash, (W_)p);
 
   if (sn != 0) {
-    ASSERT(stable_name_table[sn].addr == p);
+    const snEntry *snt = ACQUIRE_LOAD(&stable_name_table);
+    ASSERT(snt[sn].addr == p);
+    sn_obj = ACQUIRE_LOAD(&snt[sn].sn_obj);
+    ASSERT(sn_obj != NULL);
     debugTrace(DEBUG_stable, "cached stable name %ld at %p",sn,p);
-    stableNameUnlock();
-    return sn;
+    RELEASE_LOCK(&shard->lock);
+    return sn_obj;
+  }
+
+  ACQUIRE_LOCK(&stable_name_mutex);
+
+  if (stable_name_free == NULL) {
+    enlargeStableNameTable();
   }
 
   sn = stable_name_free - stable_name_table;
   stable_name_free  = (snEntry*)(stable_name_free->addr);
   stable_name_table[sn].addr = p;
-  stable_name_table[sn].sn_obj = NULL;
+  stable_name_table[sn].old = p;
   /* debugTrace(DEBUG_stable, "new stable name %d at %p\n",sn,p); */
 
+  // Until it has a StableName object, the entry looks free to the GC (see
+  // gcStableNameTable()), so we must not GC here: use allocate(), which
+  // does not call GC.  This caused #15906.
+  sn_obj = (StgClosure *)allocate(cap, sizeofW(StgStableName));
+  SET_HDR(sn_obj, &stg_STABLE_NAME_info, cap->r.rCCCS);
+  ((StgStableName *)sn_obj)->sn = sn;
+  // This will make the StableName# object visible to other threads;
+  // be sure that its completely visible to other cores.
+  // See Note [Heap memory barriers] in SMP.h.
+  RELEASE_STORE(&stable_name_table[sn].sn_obj, sn_obj);
+
   /* add the new stable name to the hash table */
-  insertHashTable(addrToStableHash, (W_)p, (void *)sn);
+  insertHashTable(shard->hash, (W_)p, (void *)sn);
 
-  stableNameUnlock();
+  RELEASE_LOCK(&stable_name_mutex);
+  RELEASE_LOCK(&shard->lock);
 
-  return sn;
+  return sn_obj;
 }
 
 /* -----------------------------------------------------------------------------
@@ -266,6 +399,12 @@ gcStableNameTable( void )
     // We must take the stable name lock lest we race with the nonmoving
     // collector (namely nonmovingSweepStableNameTable).
     stableNameLock();
+
+    /* No mutator can be reading the old versions of the table now; see
+     * Note [Concurrent stable name lookups].
+     */
+    freeOldSNTs();
+
     FOR_EACH_STABLE_NAME(
         p, {
             // FOR_EACH_STABLE_NAME traverses free entries too, so
@@ -295,38 +434,37 @@ gcStableNameTable( void )
 /* -----------------------------------------------------------------------------
  * Update the StableName hash table
  *
- * The boolean argument 'full' indicates that a major collection is
- * being done, so we might as well throw away the hash table and build
- * a new one.  For a minor collection, we just re-hash the elements
- * that changed.
+ * Only the entries whose object moved or died are re-hashed, see Note
+ * [Concurrent stable name lookups].  The boolean argument 'full', which
+ * indicates a major collection, makes no difference.
  * -------------------------------------------------------------------------- */
 
 void
-updateStableNameTable(bool full)
+updateStableNameTable(bool full STG_UNUSED)
 {
-    if (full && addrToStableHash != NULL && 0 != keyCountHashTable(addrToStableHash)) {
-        freeHashTable(addrToStableHash,NULL);
-        addrToStableHash = allocHashTable();
-    }
+    // The nonmoving sweep may be using the table concurrently
+    stableNameLock();
+
+    // Remove the old keys first: with the compacting collector an object
+    // may move to the old address of another one.
+    FOR_EACH_STABLE_NAME(
+        p, {
+            if (p->sn_obj != NULL && p->addr != p->old) {
+                removeHashTable(snHashShard(p->old)->hash, (W_)p->old, NULL);
+            }
+        });
 
-    if(full) {
-        FOR_EACH_STABLE_NAME(
-            p, {
+    FOR_EACH_STABLE_NAME(
+        p, {
+            if (p->sn_obj != NULL && p->addr != p->old) {
+                /* Movement happened: */
                 if (p->addr != NULL) {
-                    // Target still alive, Re-hash this stable name
-                    insertHashTable(addrToStableHash, (W_)p->addr, (void *)(p - stable_name_table));
+                    insertHashTable(snHashShard(p->addr)->hash, (W_)p->addr,
+                                    (void *)(p - stable_name_table));
                 }
-            });
-    } else {
-        FOR_EACH_STABLE_NAME(
-            p, {
-                if (p->addr != p->old) {
-                    removeHashTable(addrToStableHash, (W_)p->old, NULL);
-                    /* Movement happened: */
-                    if (p->addr != NULL) {
-                        insertHashTable(addrToStableHash, (W_)p->addr, (void *)(p - stable_name_table));
-                    }
-                }
-            });
-    }
+                p->old = p->addr;
+            }
+        });
+
+    stableNameUnlock();
 }
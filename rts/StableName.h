@@ -13,7 +13,7 @@
 void    initStableNameTable   ( void );
 void    freeSnEntry           ( snEntry *sn );
 void    exitStableNameTable   ( void );
-StgWord lookupStableName      ( StgPtr p );
+StgClosure *makeStableName    ( Capability *cap, StgPtr p );
 
 void    rememberOldStableNameAddresses ( void );
 
@@ -24,6 +24,9 @@ void    updateStableNameTable ( bool full );
 void    stableNameLock            ( void );
 void    stableNameUnlock          ( void );
 
+// Reinitialise the locks, in the child after forkProcess()
+void    initStableNameLocks       ( void );
+
 extern unsigned int SNT_size;
 
 #define FOR_EACH_STABLE_NAME(p, CODE)                                   \
@@ -47,9 +50,4 @@ extern unsigned int SNT_size;
         }                                                               \
     } while(0)
 
-#if defined(THREADED_RTS)
-// needed by Schedule.c:forkProcess()
-extern Mutex stable_name_mutex;
-#endif
-
 #include "EndPrivate.h"
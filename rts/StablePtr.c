@@ -16,6 +16,8 @@
 #include "RtsUtils.h"
 #include "Trace.h"
 #include "StablePtr.h"
+#include "Capability.h"
+#include "Task.h"
 
 #include <string.h>
 
@@ -112,6 +114,11 @@ static uint32_t n_old_SPTs = 0;
 
 #if defined(THREADED_RTS)
 Mutex stable_ptr_mutex;
+
+/* Set while enlargeStablePtrTable() copies the table; see Note
+ * [Per-capability stable pointer caches].
+ */
+static bool enlarging_spt = false;
 #endif
 
 static void enlargeStablePtrTable(void);
@@ -183,11 +190,20 @@ enlargeStablePtrTable(void)
     new_stable_ptr_table =
         stgMallocBytes(SPT_size * sizeof(spEntry),
                        "enlargeStablePtrTable");
+    ASSERT(n_old_SPTs < MAX_N_OLD_SPTS);
+    old_SPTs[n_old_SPTs++] = stable_ptr_table;
+
+#if defined(THREADED_RTS)
+    /* Writes to the old table without the lock must not happen while we copy
+     * it; see Note [Per-capability stable pointer caches].
+     */
+    RELAXED_STORE(&enlarging_spt, true);
+    SEQ_CST_FENCE();
+#endif
+
     memcpy(new_stable_ptr_table,
            stable_ptr_table,
            old_SPT_size * sizeof(spEntry));
-    ASSERT(n_old_SPTs < MAX_N_OLD_SPTS);
-    old_SPTs[n_old_SPTs++] = stable_ptr_table;
 
     /* When using the threaded RTS, the update of stable_ptr_table is assumed to
      * be atomic, so that another thread simultaneously dereferencing a stable
@@ -195,6 +211,9 @@ enlargeStablePtrTable(void)
      * that the new table is visible to others.
      */
     RELEASE_STORE(&stable_ptr_table, new_stable_ptr_table);
+#if defined(THREADED_RTS)
+    RELEASE_STORE(&enlarging_spt, false);
+#endif
 
     initSpEntryFreeList(stable_ptr_table + old_SPT_size, old_SPT_size, NULL);
 }
@@ -214,6 +233,38 @@ enlargeStablePtrTable(void)
  * than that required to hold the current version.
  */
 
+/* Note [Per-capability stable pointer caches]
+ *
+ * FFI-heavy programs make and free a lot of stable pointers, often from
+ * several capabilities at once, and used to serialise on stable_ptr_mutex.
+ * Instead, each Capability keeps a small cache of free entries of the table
+ * (cap->free_stable_ptrs), which the Task running the Capability uses to
+ * make and free stable pointers without taking the lock.  Only when the
+ * cache runs empty or full do we take the lock, to move half a cache's
+ * worth of entries from or to the global free list.  Callers that don't
+ * own a Capability (foreign threads, code running before hs_init() or after
+ * hs_exit(), and freeStablePtrUnsafe() with the table locked) use the
+ * global free list as before.
+ *
+ * Entries in the caches are NULL, so markStablePtrTable() treats them as
+ * free.  Stable pointers are still indices into a single table, and we
+ * still enlarge it by copying (see Note [Enlarging the stable pointer
+ * table]), so deRefStablePtr() and stg_deRefStablePtrzh are unchanged.
+ *
+ * The one difficulty is that writing an entry without the lock races with
+ * enlargeStablePtrTable() copying the table, which could copy the entry
+ * before the write and then publish the new table: the write would be
+ * lost.  So the enlarger sets enlarging_spt before copying, and a lock-free
+ * writer checks, after its write, that the table is not being enlarged and
+ * hasn't moved; a full fence on both sides guarantees that either the
+ * writer sees the flag or the copy sees the write.  Otherwise the writer
+ * writes the entry again with the lock held, that is once the enlargement
+ * is done.  This is rare, since the table only doubles in size.
+ *
+ * The GC holds stable_ptr_mutex and has stopped every Capability, so it
+ * never runs concurrently with the lock-free paths.
+ */
+
 
 /* -----------------------------------------------------------------------------
  * Freeing entries and tables
@@ -252,6 +303,66 @@ freeSpEntry(spEntry *sp)
     stable_ptr_free = sp;
 }
 
+#if defined(THREADED_RTS)
+/* -----------------------------------------------------------------------------
+ * Per-capability caches of free entries
+ * See Note [Per-capability stable pointer caches].
+ * -------------------------------------------------------------------------- */
+
+/* The Capability that the calling Task is running, if any */
+STATIC_INLINE Capability *
+myStablePtrCap(void)
+{
+    if (!isTaskManagerInitialized()) return NULL;
+    Task *task = myTask();
+    if (task == NULL || task->cap == NULL) return NULL;
+    if (RELAXED_LOAD(&task->cap->running_task) != task) return NULL;
+    return task->cap;
+}
+
+/* Set an entry that we own, without holding stable_ptr_mutex */
+STATIC_INLINE void
+setSpEntryUnlocked(StgWord sp, StgPtr p)
+{
+    spEntry *spt = ACQUIRE_LOAD(&stable_ptr_table);
+    RELEASE_STORE(&spt[sp].addr, p);
+    SEQ_CST_FENCE();
+    if (RELAXED_LOAD(&enlarging_spt) ||
+        RELAXED_LOAD(&stable_ptr_table) != spt) {
+        // The table may have been copied before our write
+        stablePtrLock();
+        RELAXED_STORE(&stable_ptr_table[sp].addr, p);
+        stablePtrUnlock();
+    }
+}
+
+static void
+refillStablePtrCache(Capability *cap)
+{
+    stablePtrLock();
+    while (cap->n_free_stable_ptrs < STABLE_PTR_CACHE_SIZE / 2) {
+        if (!stable_ptr_free) enlargeStablePtrTable();
+        spEntry *entry = stable_ptr_free;
+        stable_ptr_free = (spEntry*)(entry->addr);
+        RELAXED_STORE(&entry->addr, NULL);
+        cap->free_stable_ptrs[cap->n_free_stable_ptrs++] =
+            entry - stable_ptr_table;
+    }
+    stablePtrUnlock();
+}
+
+static void
+spillStablePtrCache(Capability *cap)
+{
+    stablePtrLock();
+    while (cap->n_free_stable_ptrs > STABLE_PTR_CACHE_SIZE / 2) {
+        StgWord sp = cap->free_stable_ptrs[--cap->n_free_stable_ptrs];
+        freeSpEntry(&stable_ptr_table[sp]);
+    }
+    stablePtrUnlock();
+}
+#endif
+
 void
 freeStablePtrUnsafe(StgStablePtr sp)
 {
@@ -262,6 +373,19 @@ freeStablePtrUnsafe(StgStablePtr sp)
 void
 freeStablePtr(StgStablePtr sp)
 {
+#if defined(THREADED_RTS)
+    Capability *cap = myStablePtrCap();
+    if (cap != NULL) {
+        ASSERT((StgWord)sp < RELAXED_LOAD(&SPT_size));
+        if (cap->n_free_stable_ptrs == STABLE_PTR_CACHE_SIZE) {
+            spillStablePtrCache(cap);
+        }
+        setSpEntryUnlocked((StgWord)sp, NULL);
+        cap->free_stable_ptrs[cap->n_free_stable_ptrs++] = (StgWord)sp;
+        return;
+    }
+#endif
+
     stablePtrLock();
     freeStablePtrUnsafe(sp);
     stablePtrUnlock();
@@ -276,6 +400,18 @@ getStablePtr(StgPtr p)
 {
   StgWord sp;
 
+#if defined(THREADED_RTS)
+  Capability *cap = myStablePtrCap();
+  if (cap != NULL) {
+      if (cap->n_free_stable_ptrs == 0) {
+          refillStablePtrCache(cap);
+      }
+      sp = cap->free_stable_ptrs[--cap->n_free_stable_ptrs];
+      setSpEntryUnlocked(sp, p);
+      return (StgStablePtr)(sp);
+  }
+#endif
+
   stablePtrLock();
   if (!stable_ptr_free) enlargeStablePtrTable();
   sp = stable_ptr_free - stable_ptr_table;
@@ -18,6 +18,11 @@
 
 #include "BeginPrivate.h"
 
+/* The number of free entries each Capability caches; see Note
+ * [Per-capability stable pointer caches] in StablePtr.c.
+ */
+#define STABLE_PTR_CACHE_SIZE 64
+
 void    freeStablePtr         ( StgStablePtr sp );
 
 /* Use the "Unsafe" one after only when manually locking and
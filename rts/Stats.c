@@ -21,10 +21,12 @@
 
 // for spin/yield counters
 #include "sm/GC.h"
+#include "sm/MemoryLimit.h"
 #include "ThreadPaused.h"
 #include "Messages.h"
 
 #include <string.h> // for memset
+#include <math.h>   // for ceil
 
 #if defined(THREADED_RTS)
 // Protects all statistics below
@@ -68,11 +70,114 @@ static W_ GC_end_faults = 0;
 static Time *GC_coll_cpu = NULL;
 static Time *GC_coll_elapsed = NULL;
 static Time *GC_coll_max_pause = NULL;
+static PauseHistogram *GC_coll_pause_hist = NULL;
 
 static void statsPrintf( char *s, ... ) GNUC3_ATTRIBUTE(format (PRINTF, 1, 2));
 static void statsFlush( void );
 static void statsClose( void );
 
+/* -----------------------------------------------------------------------------
+   Pause time histograms
+   ------------------------------------------------------------------------- */
+
+/*
+ * Note [GC pause histograms]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Latency targets are usually stated in terms of tail percentiles (p99,
+ * p99.9) of pause times, which cannot be recovered from the cumulative and
+ * maximum pause times we track per generation. We therefore also record every
+ * stop-the-world pause (per generation) and every nonmoving sync pause in a
+ * PauseHistogram (see RtsAPI.h).
+ *
+ * The buckets are log-linear, in the style of HdrHistogram: a pause of t
+ * microseconds with 2^e <= t < 2^(e+1) is placed in one of
+ * PAUSE_HIST_SUB_BUCKETS equal-width buckets subdividing [2^e, 2^(e+1)).
+ * Pauses shorter than PAUSE_HIST_SUB_BUCKETS microseconds get a bucket each.
+ * With PAUSE_HIST_SUB_BITS = 3 this gives a relative error of at most 12.5%
+ * over the whole range from one microsecond to 2^32 microseconds (about 71
+ * minutes), in a fixed 240 buckets, so recording a pause is constant time
+ * and a histogram can be copied out by getRTSStats without allocation.
+ *
+ * Quantiles are reported as the upper bound of the bucket containing them,
+ * clamped to the longest pause seen, so they never underestimate a pause.
+ * They are shown by +RTS -s and -t --machine-readable, and the raw
+ * histograms are available in RTSStats.
+ */
+
+static uint32_t
+pauseHistBucket (Time t)
+{
+    StgWord64 us = t <= 0 ? 0 : (StgWord64) TimeToUS(t);
+    if (us < PAUSE_HIST_SUB_BUCKETS) {
+        return (uint32_t) us;
+    }
+
+    uint32_t e = PAUSE_HIST_SUB_BITS;
+    while (e < 63 && (us >> (e + 1)) != 0) {
+        e++;
+    }
+    if (e >= PAUSE_HIST_MAX_EXP) {
+        return PAUSE_HIST_BUCKETS - 1;
+    }
+
+    uint32_t sub = (us >> (e - PAUSE_HIST_SUB_BITS)) & (PAUSE_HIST_SUB_BUCKETS - 1);
+    return (e - PAUSE_HIST_SUB_BITS + 1) * PAUSE_HIST_SUB_BUCKETS + sub;
+}
+
+static void
+pauseHistRecord (PauseHistogram *h, Time t)
+{
+    h->buckets[pauseHistBucket(t)]++;
+    h->count++;
+    if (t > h->max_ns) {
+        h->max_ns = t;
+    }
+}
+
+Time
+getPauseHistogramBucketBound (uint32_t bucket)
+{
+    uint32_t block = bucket / PAUSE_HIST_SUB_BUCKETS;
+    uint32_t sub = bucket % PAUSE_HIST_SUB_BUCKETS;
+    if (block == 0) {
+        return USToTime(sub + 1);
+    }
+    StgWord64 lower = (StgWord64)(PAUSE_HIST_SUB_BUCKETS + sub) << (block - 1);
+    StgWord64 width = (StgWord64)1 << (block - 1);
+    return USToTime(lower + width);
+}
+
+Time
+getPauseHistogramQuantile (const PauseHistogram *h, double q)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+
+    // The rank (counting from 1) of the pause we are looking for.
+    uint64_t rank = (uint64_t) ceil(q * (double) h->count);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < PAUSE_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            return stg_min(getPauseHistogramBucketBound(i), h->max_ns);
+        }
+    }
+    return h->max_ns;
+}
+
+static void
+pauseHistQuantiles (const PauseHistogram *h, PauseQuantiles *qs)
+{
+    qs->p50_ns  = getPauseHistogramQuantile(h, 0.5);
+    qs->p90_ns  = getPauseHistogramQuantile(h, 0.9);
+    qs->p99_ns  = getPauseHistogramQuantile(h, 0.99);
+    qs->p999_ns = getPauseHistogramQuantile(h, 0.999);
+}
+
 /* -----------------------------------------------------------------------------
    Current elapsed time
    ------------------------------------------------------------------------- */
@@ -217,6 +322,10 @@ initStats1 (void)
         (Time *)stgMallocBytes(
             sizeof(Time)*RtsFlags.GcFlags.generations,
             "initStats");
+    GC_coll_pause_hist =
+        (PauseHistogram *)stgMallocBytes(
+            sizeof(PauseHistogram)*RtsFlags.GcFlags.generations,
+            "initStats");
     initGenerationStats();
 }
 
@@ -228,6 +337,8 @@ initGenerationStats()
         GC_coll_elapsed[i] = 0;
         GC_coll_max_pause[i] = 0;
     }
+    memset(GC_coll_pause_hist, 0,
+           sizeof(PauseHistogram)*RtsFlags.GcFlags.generations);
 }
 
 /* ---------------------------------------------------------------------------
@@ -340,6 +451,8 @@ stat_endNonmovingGcSync ()
     stats.nonmoving_gc_sync_max_elapsed_ns =
       stg_max(stats.gc.nonmoving_gc_sync_elapsed_ns,
               stats.nonmoving_gc_sync_max_elapsed_ns);
+    pauseHistRecord(&stats.nonmoving_gc_sync_pause_hist,
+                    stats.gc.nonmoving_gc_sync_elapsed_ns);
     Time sync_elapsed = stats.gc.nonmoving_gc_sync_elapsed_ns;
     RELEASE_LOCK(&stats_mutex);
 
@@ -528,6 +641,9 @@ stat_endGC (Capability *cap, gc_thread *initiating_gct, W_ live, W_ copied, W_ s
     if (GC_coll_max_pause[gen] < stats.gc.elapsed_ns) {
         GC_coll_max_pause[gen] = stats.gc.elapsed_ns;
     }
+    if (stats_enabled) {
+        pauseHistRecord(&GC_coll_pause_hist[gen], stats.gc.elapsed_ns);
+    }
 
     stats.copied_bytes += stats.gc.copied_bytes;
     if (par_n_threads > 1) {
@@ -877,6 +993,33 @@ static void report_summary(const RTSSummaryStats* sum)
                     TimeToSecondsDbl(stats.nonmoving_gc_max_elapsed_ns));
     }
 
+    /* Print pause time percentiles, see Note [GC pause histograms] */
+    statsPrintf("\n");
+    statsPrintf("                                     p50 pause  p90 pause  p99 pause  p99.9 pause\n");
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        const PauseQuantiles * qs =
+            &sum->gc_summary_stats[g].pause_quantiles;
+        statsPrintf("  Gen %2d     %5d colls"
+                    "             %3.4fs    %3.4fs    %3.4fs      %3.4fs\n",
+                    g,
+                    sum->gc_summary_stats[g].collections,
+                    TimeToSecondsDbl(qs->p50_ns),
+                    TimeToSecondsDbl(qs->p90_ns),
+                    TimeToSecondsDbl(qs->p99_ns),
+                    TimeToSecondsDbl(qs->p999_ns));
+    }
+    if (RtsFlags.GcFlags.useNonmoving) {
+        const PauseQuantiles * qs = &sum->nonmoving_sync_pause_quantiles;
+        statsPrintf("  Gen %2d     %5" FMT_Word64 " syncs"
+                    "             %3.4fs    %3.4fs    %3.4fs      %3.4fs\n",
+                    RtsFlags.GcFlags.generations-1,
+                    stats.nonmoving_gc_sync_pause_hist.count,
+                    TimeToSecondsDbl(qs->p50_ns),
+                    TimeToSecondsDbl(qs->p90_ns),
+                    TimeToSecondsDbl(qs->p99_ns),
+                    TimeToSecondsDbl(qs->p999_ns));
+    }
+
     statsPrintf("\n");
 
 #if defined(THREADED_RTS)
@@ -1029,6 +1172,21 @@ static void report_summary(const RTSSummaryStats* sum)
     }
 }
 
+// Print the non-empty buckets of a pause histogram as a comma-separated list
+// of <bucket upper bound in microseconds>:<count> pairs.
+static void report_pause_histogram(const PauseHistogram *h)
+{
+    bool first = true;
+    for (uint32_t i = 0; i < PAUSE_HIST_BUCKETS; i++) {
+        if (h->buckets[i] == 0) continue;
+        statsPrintf("%s%" FMT_Word64 ":%" FMT_Word64,
+                    first ? "" : ",",
+                    (StgWord64) TimeToUS(getPauseHistogramBucketBound(i)),
+                    h->buckets[i]);
+        first = false;
+    }
+}
+
 static void report_machine_readable (const RTSSummaryStats * sum)
 {
     // We should do no calculation, other than unit changes and formatting, and
@@ -1175,6 +1333,17 @@ static void report_machine_readable (const RTSSummaryStats * sum)
                     TimeToSecondsDbl(gc_sum->max_pause_ns));
         MR_STAT_GEN(g, "avg_pause_seconds", "f",
                     TimeToSecondsDbl(gc_sum->avg_pause_ns));
+        MR_STAT_GEN(g, "p50_pause_seconds", "f",
+                    TimeToSecondsDbl(gc_sum->pause_quantiles.p50_ns));
+        MR_STAT_GEN(g, "p90_pause_seconds", "f",
+                    TimeToSecondsDbl(gc_sum->pause_quantiles.p90_ns));
+        MR_STAT_GEN(g, "p99_pause_seconds", "f",
+                    TimeToSecondsDbl(gc_sum->pause_quantiles.p99_ns));
+        MR_STAT_GEN(g, "p99_9_pause_seconds", "f",
+                    TimeToSecondsDbl(gc_sum->pause_quantiles.p999_ns));
+        statsPrintf(" ,(\"gen_%" FMT_Word32 "_pause_histogram\", \"", g);
+        report_pause_histogram(&GC_coll_pause_hist[g]);
+        statsPrintf("\")\n");
 #if defined(THREADED_RTS) && defined(PROF_SPIN)
         MR_STAT_GEN(g, "sync_spin", FMT_Word64, gc_sum->sync_spin);
         MR_STAT_GEN(g, "sync_yield", FMT_Word64, gc_sum->sync_yield);
@@ -1189,6 +1358,17 @@ static void report_machine_readable (const RTSSummaryStats * sum)
                 TimeToSecondsDbl(stats.nonmoving_gc_sync_max_elapsed_ns));
         MR_STAT("nonmoving_sync_avg_pause_seconds", "f",
                 TimeToSecondsDbl(stats.nonmoving_gc_sync_elapsed_ns) / n_major_colls);
+        MR_STAT("nonmoving_sync_p50_pause_seconds", "f",
+                TimeToSecondsDbl(sum->nonmoving_sync_pause_quantiles.p50_ns));
+        MR_STAT("nonmoving_sync_p90_pause_seconds", "f",
+                TimeToSecondsDbl(sum->nonmoving_sync_pause_quantiles.p90_ns));
+        MR_STAT("nonmoving_sync_p99_pause_seconds", "f",
+                TimeToSecondsDbl(sum->nonmoving_sync_pause_quantiles.p99_ns));
+        MR_STAT("nonmoving_sync_p99_9_pause_seconds", "f",
+                TimeToSecondsDbl(sum->nonmoving_sync_pause_quantiles.p999_ns));
+        statsPrintf(" ,(\"nonmoving_sync_pause_histogram\", \"");
+        report_pause_histogram(&stats.nonmoving_gc_sync_pause_hist);
+        statsPrintf("\")\n");
 
         MR_STAT("nonmoving_concurrent_cpu_seconds", "f",
                 TimeToSecondsDbl(stats.nonmoving_gc_cpu_ns));
@@ -1420,11 +1600,16 @@ stat_exitReport (void)
                 gen_stats->max_pause_ns = GC_coll_max_pause[g];
                 gen_stats->avg_pause_ns = gen->collections == 0 ?
                     0 : (GC_coll_elapsed[g] / gen->collections);
+                pauseHistQuantiles(&GC_coll_pause_hist[g],
+                                   &gen_stats->pause_quantiles);
     #if defined(THREADED_RTS) && defined(PROF_SPIN)
                 gen_stats->sync_spin = gen->sync.spin;
                 gen_stats->sync_yield = gen->sync.yield;
     #endif // PROF_SPIN
             }
+
+            pauseHistQuantiles(&stats.nonmoving_gc_sync_pause_hist,
+                               &sum.nonmoving_sync_pause_quantiles);
         }
 
         // Now we generate the report
@@ -1460,6 +1645,10 @@ stat_exitReport (void)
       stgFree(GC_coll_max_pause);
       GC_coll_max_pause = NULL;
     }
+    if (GC_coll_pause_hist) {
+      stgFree(GC_coll_pause_hist);
+      GC_coll_pause_hist = NULL;
+    }
 
     RELEASE_LOCK(&all_tasks_mutex);
 }
@@ -1700,8 +1889,26 @@ void getRTSStats( RTSStats *s )
 
     ACQUIRE_LOCK(&stats_mutex);
     *s = stats;
+    s->gc_pause_hist_gens =
+        stg_min(RtsFlags.GcFlags.generations, PAUSE_HIST_MAX_GENS);
+    if (GC_coll_pause_hist != NULL) {
+        memcpy(s->gc_pause_hist, GC_coll_pause_hist,
+               s->gc_pause_hist_gens * sizeof(PauseHistogram));
+    }
     RELEASE_LOCK(&stats_mutex);
 
+    getMemoryLimitStats(s);
+
+    // The counts are per-capability; see Note [Stack chunk pool]
+    s->stack_overflows = 0;
+    s->stack_underflows = 0;
+    s->stack_chunks_reused = 0;
+    for (uint32_t i = 0; i < n_capabilities; i++) {
+        s->stack_overflows += capabilities[i]->stack_overflows;
+        s->stack_underflows += capabilities[i]->stack_underflows;
+        s->stack_chunks_reused += capabilities[i]->stack_chunks_reused;
+    }
+
     getProcessTimes(&current_cpu, &current_elapsed);
     s->cpu_ns = current_cpu - end_init_cpu;
     s->elapsed_ns = current_elapsed - end_init_elapsed;
@@ -69,6 +69,14 @@ void      statDescribeGens( void );
 Time      stat_getElapsedGCTime(void);
 Time      stat_getElapsedTime(void);
 
+// Quantiles of a PauseHistogram, see Note [GC pause histograms] in Stats.c
+typedef struct PauseQuantiles_ {
+    Time p50_ns;
+    Time p90_ns;
+    Time p99_ns;
+    Time p999_ns;
+} PauseQuantiles;
+
 typedef struct GenerationSummaryStats_ {
     uint32_t collections;
     uint32_t par_collections;
@@ -76,6 +84,7 @@ typedef struct GenerationSummaryStats_ {
     Time elapsed_ns;
     Time max_pause_ns;
     Time avg_pause_ns;
+    PauseQuantiles pause_quantiles;
 #if defined(THREADED_RTS) && defined(PROF_SPIN)
     uint64_t sync_spin;
     uint64_t sync_yield;
@@ -110,6 +119,8 @@ typedef struct RTSSummaryStats_ {
     double productivity_cpu_percent;
     double productivity_elapsed_percent;
 
+    PauseQuantiles nonmoving_sync_pause_quantiles;
+
     // one for each generation, 0 first
     GenerationSummaryStats* gc_summary_stats;
 } RTSSummaryStats;
@@ -83,6 +83,12 @@ initTaskManager (void)
     }
 }
 
+bool
+isTaskManagerInitialized (void)
+{
+    return tasksInitialized;
+}
+
 uint32_t
 freeTaskManager (void)
 {
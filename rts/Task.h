@@ -200,6 +200,10 @@ extern Mutex all_tasks_mutex;
 void initTaskManager (void);
 uint32_t  freeTaskManager (void);
 
+// Whether myTask() can be used: it can't before the task manager is
+// initialised, or after it has been freed.
+bool isTaskManagerInitialized (void);
+
 // Create a new Task for a bound thread. This Task must be released
 // by calling exitMyTask(). The Task is cached in
 // thread-local storage and will remain even after exitMyTask()
@@ -23,6 +23,7 @@
 #include "Printer.h"
 #include "sm/Sanity.h"
 #include "sm/Storage.h"
+#include "GetTime.h"
 
 #include <string.h>
 
@@ -110,6 +111,8 @@ createThread(Capability *cap, W_ size)
     tso->tot_stack_size = stack->stack_size;
 
     ASSIGN_Int64((W_*)&(tso->alloc_limit), 0);
+    ASSIGN_Word64((W_*)&(tso->alloc_bytes), 0);
+    ASSIGN_Int64((W_*)&(tso->cpu_time), 0);
 
     tso->trec = NO_TREC;
 
@@ -196,6 +199,109 @@ void rts_disableThreadAllocationLimit(StgPtr tso)
     ((StgTSO *)tso)->flags &= ~TSO_ALLOC_LIMIT;
 }
 
+/* ---------------------------------------------------------------------------
+ * Per-thread accounting
+ *
+ * Note [Per-thread accounting]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * With +RTS --thread-accounting, the scheduler keeps a running total of
+ * the bytes allocated and the CPU time used by each thread, in the
+ * alloc_bytes and cpu_time fields of the TSO.  This works in the
+ * non-profiled RTS, unlike the cost-centre profiler, and costs one
+ * getCurrentThreadCPUTime() call at either end of each time slice.
+ *
+ * We don't add a new allocation counter: the allocation limit
+ * (tso->alloc_limit) already counts down by the number of bytes the
+ * thread allocates, both in the nursery (see closeNursery in
+ * GHC.StgToCmm.Foreign) and via allocate().  So at the start of a
+ * time slice startThreadAccounting() records alloc_limit and the
+ * current thread CPU time in the Capability, and at the end
+ * stopThreadAccounting() adds the differences to the TSO.
+ *
+ * A slice starts when schedule() runs a thread and ends when the
+ * thread returns to the scheduler.  Safe foreign calls also end the
+ * slice (suspendThread) and start a new one (resumeThread), so time
+ * spent in foreign code is not charged to the thread, which is
+ * consistent with allocation: nothing allocated by foreign code is
+ * counted either.
+ *
+ * Two things can move alloc_limit other than allocation:
+ *
+ *  - setThreadAllocationCounter#, which compensates by adding the
+ *    change to alloc_bytes (see stg_setThreadAllocationCounterzh).
+ *
+ *  - the grace allowance given when the allocation limit is exceeded
+ *    (schedulePostRunThread), which only happens between slices and
+ *    so doesn't affect the accounting.
+ *
+ * The totals are available via rts_getThreadAccounting() and the
+ * threadAccounting# primop, and are posted in an EVENT_THREAD_STATS
+ * event when the thread finishes.
+ * ------------------------------------------------------------------------ */
+
+void
+startThreadAccounting (Capability *cap, StgTSO *tso)
+{
+    cap->run_start_alloc_limit = PK_Int64((W_*)&(tso->alloc_limit));
+    cap->run_start_cpu = getCurrentThreadCPUTime();
+}
+
+void
+stopThreadAccounting (Capability *cap, StgTSO *tso)
+{
+    StgInt64 allocated =
+        cap->run_start_alloc_limit - PK_Int64((W_*)&(tso->alloc_limit));
+    Time cpu = getCurrentThreadCPUTime() - cap->run_start_cpu;
+
+    ASSIGN_Word64((W_*)&(tso->alloc_bytes),
+                  PK_Word64((W_*)&(tso->alloc_bytes)) + allocated);
+    if (cpu > 0) {
+        ASSIGN_Int64((W_*)&(tso->cpu_time),
+                     PK_Int64((W_*)&(tso->cpu_time)) + TimeToNS(cpu));
+    }
+}
+
+// Read the accounting totals for a thread.  If the thread is in the
+// middle of a time slice on cap (i.e. it is the caller), the slice so
+// far is included; nursery_bytes is the allocation in the current
+// nursery block, which hasn't been deducted from alloc_limit yet.
+// Returns false, and zero totals, if accounting is disabled.
+StgBool
+getThreadAccounting (Capability *cap, StgTSO *tso, W_ nursery_bytes,
+                     StgWord64 *alloc_bytes, StgWord64 *cpu_ns)
+{
+    if (!RtsFlags.MiscFlags.threadAccounting) {
+        *alloc_bytes = 0;
+        *cpu_ns = 0;
+        return false;
+    }
+
+    StgWord64 alloc = PK_Word64((W_*)&(tso->alloc_bytes));
+    StgInt64 cpu = PK_Int64((W_*)&(tso->cpu_time));
+
+    if (cap != NULL && cap->r.rCurrentTSO == tso) {
+        alloc += cap->run_start_alloc_limit
+            - PK_Int64((W_*)&(tso->alloc_limit)) + nursery_bytes;
+        Time slice = getCurrentThreadCPUTime() - cap->run_start_cpu;
+        if (slice > 0) {
+            cpu += TimeToNS(slice);
+        }
+    }
+
+    *alloc_bytes = alloc;
+    *cpu_ns = (StgWord64)cpu;
+    return true;
+}
+
+StgBool
+rts_getThreadAccounting (StgPtr tso, StgWord64 *alloc_bytes,
+                         StgWord64 *cpu_ns)
+{
+    // Called from a foreign call, so the calling thread is not inside a
+    // time slice, and we can't see other Capabilities' slices.
+    return getThreadAccounting(NULL, (StgTSO *)tso, 0, alloc_bytes, cpu_ns);
+}
+
 /* -----------------------------------------------------------------------------
    Remove a thread from a queue.
    Fails fatally if the TSO is not on the queue.
@@ -528,6 +634,76 @@ isThreadBound(StgTSO* tso USED_IF_THREADS)
   return false;
 }
 
+/* -----------------------------------------------------------------------------
+   Stack chunk pool
+
+   Note [Stack chunk pool]
+   ~~~~~~~~~~~~~~~~~~~~~~~
+   A thread whose stack keeps growing and shrinking across the boundary
+   of a stack chunk overflows and underflows over and over again.  Each
+   overflow allocates a fresh chunk (of +RTS -kc words) and each underflow
+   drops it, so such a thread allocates a chunk per iteration, which brings
+   the next GC closer for nothing.
+
+   So each Capability keeps up to STACK_CHUNK_POOL_SIZE free chunks of the
+   default size in cap->stack_chunk_pool.  threadStackUnderflow puts the
+   chunk it empties in the pool, and threadStackOverflow takes a chunk from
+   the pool, rather than allocating one, when it needs one of the default
+   size.  The pool is a stack, so a thread that goes back over the boundary
+   gets back the chunk it has just left, which is still in the cache.
+
+   A chunk in the pool is not referenced by anything else: only the
+   underflow frame of the chunk above a chunk, or tso->stackobj, refers to
+   it, and neither survives the underflow.  We only pool chunks that are
+   in generation 0, which are never on a mutable list nor marked by the
+   nonmoving collector, so a pooled chunk can be reused as if it had just
+   been allocated.  The pool is not a GC root: the GC empties it instead
+   (see markCapability), as it does with the free lists of the STM.
+
+   Reusing a chunk is not charged to the allocation counter of the thread,
+   since nothing is allocated.
+
+   The overflows, underflows and reused chunks of each Capability are
+   counted, and posted in a STACK_CHUNK_STATS event after each GC with
+   +RTS -lg, to help with choosing -kc and -kb.  Their totals are also
+   available from getRTSStats().
+
+   We don't go as far as leaving the emptied chunk attached to the stack
+   after an underflow, in case the thread overflows into it again: the
+   chunk would have to stay behind an underflow frame that the thread has
+   returned through, and threadStackOverflow, the GC and the stack
+   walkers would all have to know about it.  Taking the chunk back from
+   the top of the pool gives the same reuse at the cost of a couple of
+   loads and stores.
+   -------------------------------------------------------------------------- */
+
+static StgStack *
+takePooledStackChunk (Capability *cap)
+{
+    if (cap->n_stack_chunk_pool == 0) {
+        return NULL;
+    }
+    cap->stack_chunks_reused++;
+    return cap->stack_chunk_pool[--cap->n_stack_chunk_pool];
+}
+
+static void
+poolStackChunk (Capability *cap, StgStack *stack)
+{
+    if (cap->n_stack_chunk_pool < STACK_CHUNK_POOL_SIZE
+        && stack->stack_size + sizeofW(StgStack)
+             == RtsFlags.GcFlags.stkChunkSize
+        && Bdescr((StgPtr)stack)->gen_no == 0) {
+        cap->stack_chunk_pool[cap->n_stack_chunk_pool++] = stack;
+    }
+}
+
+void
+clearStackChunkPool (Capability *cap)
+{
+    cap->n_stack_chunk_pool = 0;
+}
+
 /* -----------------------------------------------------------------------------
    Stack overflow
 
@@ -620,21 +796,33 @@ threadStackOverflow (Capability *cap, StgTSO *tso)
         chunk_size = RtsFlags.GcFlags.stkChunkSize;
     }
 
-    debugTraceCap(DEBUG_sched, cap,
-                  "allocating new stack chunk of size %d bytes",
-                  chunk_size * sizeof(W_));
+    cap->stack_overflows++;
 
-    // Charge the current thread for allocating stack.  Stack usage is
-    // non-deterministic, because the chunk boundaries might vary from
-    // run to run, but accounting for this is better than not
-    // accounting for it, since a deep recursion will otherwise not be
-    // subject to allocation limits.
-    cap->r.rCurrentTSO = tso;
-    new_stack = (StgStack*) allocate(cap, chunk_size);
-    cap->r.rCurrentTSO = NULL;
+    // See Note [Stack chunk pool]
+    new_stack = NULL;
+    if (chunk_size == RtsFlags.GcFlags.stkChunkSize) {
+        new_stack = takePooledStackChunk(cap);
+    }
+
+    if (new_stack == NULL) {
+        debugTraceCap(DEBUG_sched, cap,
+                      "allocating new stack chunk of size %d bytes",
+                      chunk_size * sizeof(W_));
+
+        // Charge the current thread for allocating stack.  Stack usage is
+        // non-deterministic, because the chunk boundaries might vary from
+        // run to run, but accounting for this is better than not
+        // accounting for it, since a deep recursion will otherwise not be
+        // subject to allocation limits.
+        cap->r.rCurrentTSO = tso;
+        new_stack = (StgStack*) allocate(cap, chunk_size);
+        cap->r.rCurrentTSO = NULL;
+        TICK_ALLOC_STACK(chunk_size);
+    } else {
+        debugTraceCap(DEBUG_sched, cap, "reusing stack chunk %p", new_stack);
+    }
 
     SET_HDR(new_stack, &stg_STACK_info, old_stack->header.prof.ccs);
-    TICK_ALLOC_STACK(chunk_size);
 
     new_stack->dirty = 0; // begin clean, we'll mark it dirty below
     new_stack->marking = 0;
@@ -760,6 +948,9 @@ threadStackUnderflow (Capability *cap, StgTSO *tso)
     // restore the stack parameters, and update tot_stack_size
     tso->tot_stack_size -= old_stack->stack_size;
 
+    cap->stack_underflows++;
+    poolStackChunk(cap, old_stack);
+
     // we're about to run it, better mark it dirty.
     //
     // N.B. the nonmoving collector may mark the stack, meaning that sp must
@@ -12,6 +12,10 @@
 
 #define END_BLOCKED_EXCEPTIONS_QUEUE ((MessageThrowTo*)END_TSO_QUEUE)
 
+// Maximum number of free stack chunks kept by each Capability.
+// See Note [Stack chunk pool] in Threads.c
+#define STACK_CHUNK_POOL_SIZE 8
+
 StgTSO * unblockOne (Capability *cap, StgTSO *tso);
 StgTSO * unblockOne_ (Capability *cap, StgTSO *tso, bool allow_migrate);
 
@@ -39,9 +43,16 @@ StgBool isThreadBound (StgTSO* tso);
 // Overflow/underflow
 void threadStackOverflow  (Capability *cap, StgTSO *tso);
 W_   threadStackUnderflow (Capability *cap, StgTSO *tso);
+void clearStackChunkPool  (Capability *cap);
 
 bool performTryPutMVar(Capability *cap, StgMVar *mvar, StgClosure *value);
 
+// Per-thread accounting, see Note [Per-thread accounting] in Threads.c
+void    startThreadAccounting (Capability *cap, StgTSO *tso);
+void    stopThreadAccounting  (Capability *cap, StgTSO *tso);
+StgBool getThreadAccounting   (Capability *cap, StgTSO *tso, W_ nursery_bytes,
+                               StgWord64 *alloc_bytes, StgWord64 *cpu_ns);
+
 #if defined(DEBUG)
 void printThreadBlockage (StgTSO *tso);
 void printThreadStatus (StgTSO *t);
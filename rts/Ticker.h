@@ -16,5 +16,6 @@ void initTicker  (Time interval, TickProc handle_tick);
 void startTicker (void);
 void stopTicker  (void);
 void exitTicker  (bool wait);
+void wakeTicker  (void);
 
 #include "EndPrivate.h"
@@ -25,6 +25,7 @@
 #include "Capability.h"
 #include "RtsSignals.h"
 #include "rts/EventLogWriter.h"
+#include "sm/MemoryLimit.h"
 
 // This global counter is used to allow multiple threads to stop the
 // timer temporarily with a stopTimer()/startTimer() pair.  If
@@ -35,12 +36,13 @@
 
 static StgWord timer_disabled;
 
-/* ticks left before next pre-emptive context switch */
-static int ticks_to_ctxt_switch = 0;
-
 /* ticks left before next next forced eventlog flush */
 static int ticks_to_eventlog_flush = 0;
 
+/* ticks left before we next read the memory limits of the cgroup,
+ * see Note [Memory limits] in sm/MemoryLimit.c */
+static int ticks_to_memory_limit_poll = 0;
+
 
 /*
  Note [GC During Idle Time]
@@ -94,6 +96,179 @@ static int idle_ticks_to_gc = 0;
 /* - countdown for minimum time *between* idle GCs (set by -Iw) */
 static int inter_gc_ticks_to_gc = 0;
 
+/* - has a whole tick passed without the scheduler running a thread? */
+static bool quiet_tick = false;
+
+/*
+ Note [Tickless idle]
+ --------------------
+
+ When the RTS has been idle for a while the ticker stops altogether (see
+ Note [GC During Idle Time]), but until then it keeps waking up the process
+ at every tick, only to count down idle_ticks_to_gc and inter_gc_ticks_to_gc.
+ A server that is idle most of the time but never for the whole -I or -Iw
+ delay is therefore woken up every 10ms, for nothing.
+
+ So, after each tick, a ticker that can sleep for longer than a tick asks
+ ticksToNextTimerEvent how many ticks it may sleep before handle_tick has
+ something to do.  That is 1 while any capability runs Haskell code, while
+ a profiler or the heap profile timer needs samples, or until a whole tick
+ has passed without the scheduler running a thread.  Once the RTS is quiet
+ it is the number of ticks until both idle GC countdowns expire, or until
+ the next eventlog flush or poll of the cgroup memory limits (see Note
+ [Memory limits] in sm/MemoryLimit.c) if sooner.  When the ticker wakes up it calls
+ handle_tick once for every tick it slept through, so that the countdowns
+ behave exactly as if it had not slept.
+
+ The scheduler sets recent_activity to ACTIVITY_YES whenever it runs a
+ thread.  If it was ACTIVITY_MAYBE_NO, the ticker may be asleep, so the
+ scheduler calls wakeTimer, which makes it tick periodically again: context
+ switches and the profilers need their ticks as soon as Haskell code runs.
+
+ Only the timerfd-based pthread ticker used on Linux can sleep; the other
+ tickers tick at every interval, and their wakeTicker does nothing.
+*/
+
+/*
+ Note [Adaptive context switching]
+ ---------------------------------
+
+ By default, every -C interval (ctxtSwitchTicks ticks) the timer sets the
+ context_switch flag of every capability, making the running thread stop at
+ its next heap check and go through the scheduler.  That is pointless for a
+ capability running a compute-bound thread with nothing else to run, and too
+ coarse for a capability whose threads keep blocking and waking up, where a
+ thread that has just been woken up has to wait up to a whole interval
+ behind a compute-bound one.
+
+ With --adaptive-context-switch=yes each capability has its own time
+ slice, ctxt_switch_quantum ticks long, and its own countdown,
+ ticks_to_ctxt_switch.  When the countdown of a capability runs out,
+ handleCtxtSwitchTick does one of three things:
+
+  * If no other thread could run on the capability (ctxtSwitchUseful), it
+    doesn't interrupt the capability at all, and looks again at the next
+    tick.  This is the "tickless" case: a lone compute-bound thread is never
+    preempted.  A thread that becomes runnable on the capability has to wait
+    one tick at most.  A task returning from a safe foreign call doesn't put
+    its thread on the run queue: it queues itself on the capability's
+    returning_tasks (newReturningTask in Capability.c) and waits for the
+    running thread to yield (see Note [Data race in shouldYieldCapability]
+    in Schedule.c), so we count it as something else to run too.  That is
+    also how a thread blocked in threadDelay or on I/O in the threaded RTS
+    gets to run, since the I/O manager that wakes it up returns from a safe
+    call first.  Messages from other capabilities and GC requests do
+    interrupt the capability themselves, so they don't depend on the timer.
+    Since the thread doesn't go through the scheduler, which is what records
+    that the RTS is busy, the timer records it instead, so that the thread
+    isn't taken for idleness (see Note [GC During Idle Time]).
+
+  * If one of the capability's threads has blocked since its last context
+    switch (the scheduler counts these in n_blocked), its threads are
+    interactive rather than compute-bound, and we give it a slice of half
+    the -C interval, so that woken threads get to run sooner.
+
+  * Otherwise its threads are compute-bound.  With at most one other
+    runnable thread we double the slice, up to ctxt_switch_max_factor times
+    the -C interval, since switching between two compute-bound threads more
+    often doesn't make either finish earlier.  With more runnable threads we
+    go back to the -C interval.
+
+ Heap profiling needs every capability to go through the scheduler to take a
+ census, so while one is pending we always switch.
+
+ The timer reads the run queue and the other counters of the capabilities
+ without synchronisation: a stale value only makes it take the wrong decision
+ for one tick or one slice.
+
+ Not preempting a lone thread has a cost with lazy blackholing (the
+ default, without -feager-blackholing): a thunk under evaluation is only
+ blackholed when threadPaused (ThreadPaused.c) walks the stack of its
+ thread, which happens at a context switch or a GC.  A thread that is never
+ switched out keeps its thunks unmarked until the next GC, so a thread on
+ another capability that demands one of them, a spark of a par for
+ instance, evaluates it again rather than blocking on it.  With many
+ capabilities sharing thunks, that duplicated work can cost more than the
+ context switches saved.  So this is opt-in, with
+ +RTS --adaptive-context-switch=yes; by default every capability is switched
+ at every -C interval, all at the same time.  -feager-blackholing avoids the
+ duplication for the code compiled with it.
+*/
+
+#define ctxt_switch_max_factor 4
+
+// Could a context switch run anything else than the current thread of
+// the capability?
+static bool
+ctxtSwitchUseful (Capability *cap)
+{
+    if (RELAXED_LOAD(&cap->n_run_queue) != 0) {
+        return true;
+    }
+#if defined(THREADED_RTS)
+    // a task returning from a safe foreign call is waiting for the
+    // capability, see Note [Adaptive context switching]
+    if (RELAXED_LOAD(&cap->n_returning_tasks) != 0) {
+        return true;
+    }
+    if (!emptySparkPoolCap(cap)) {
+        return true;
+    }
+#else
+    // the scheduler polls for I/O and wakes sleeping threads
+    if (!EMPTY_BLOCKED_QUEUE() || !EMPTY_SLEEPING_QUEUE()) {
+        return true;
+    }
+#endif
+    return RELAXED_LOAD(&performHeapProfile);
+}
+
+static int
+ctxtSwitchQuantum (Capability *cap)
+{
+    int ticks = RtsFlags.ConcFlags.ctxtSwitchTicks;
+    StgWord n_blocked = RELAXED_LOAD(&cap->n_blocked);
+
+    if (n_blocked != cap->n_blocked_at_switch) {
+        cap->n_blocked_at_switch = n_blocked;
+        return stg_max(ticks / 2, 1);
+    } else if (RELAXED_LOAD(&cap->n_run_queue) <= 1) {
+        return stg_min(cap->ctxt_switch_quantum * 2,
+                       ticks * ctxt_switch_max_factor);
+    } else {
+        return ticks;
+    }
+}
+
+// See Note [Adaptive context switching]
+static void
+handleCtxtSwitchTick (void)
+{
+    uint32_t i;
+
+    for (i = 0; i < n_capabilities; i++) {
+        Capability *cap = capabilities[i];
+
+        cap->ticks_to_ctxt_switch--;
+        if (cap->ticks_to_ctxt_switch > 0) {
+            continue;
+        }
+        if (RtsFlags.ConcFlags.adaptiveCtxtSwitch) {
+            if (!ctxtSwitchUseful(cap)) {
+                if (RELAXED_LOAD(&cap->in_haskell)) {
+                    cas((StgVolatilePtr)&recent_activity,
+                        ACTIVITY_MAYBE_NO, ACTIVITY_YES);
+                }
+                cap->ticks_to_ctxt_switch = 1;
+                continue;
+            }
+            cap->ctxt_switch_quantum = ctxtSwitchQuantum(cap);
+        }
+        cap->ticks_to_ctxt_switch = cap->ctxt_switch_quantum;
+        contextSwitchCapability(cap); /* schedule a context switch */
+    }
+}
+
 /*
  * Function: handle_tick()
  *
@@ -108,11 +283,7 @@ handle_tick(int unused STG_UNUSED)
   if (RtsFlags.ConcFlags.ctxtSwitchTicks > 0
       && SEQ_CST_LOAD(&timer_disabled) == 0)
   {
-      ticks_to_ctxt_switch--;
-      if (ticks_to_ctxt_switch <= 0) {
-          ticks_to_ctxt_switch = RtsFlags.ConcFlags.ctxtSwitchTicks;
-          contextSwitchAllCapabilities(); /* schedule a context switch */
-      }
+      handleCtxtSwitchTick();
   }
 
   if (eventLogStatus() == EVENTLOG_RUNNING
@@ -124,6 +295,15 @@ handle_tick(int unused STG_UNUSED)
       }
   }
 
+  if (RtsFlags.GcFlags.cgroupMemoryLimit) {
+      ticks_to_memory_limit_poll--;
+      if (ticks_to_memory_limit_poll <= 0) {
+          ticks_to_memory_limit_poll =
+              TIME_RESOLUTION / RtsFlags.MiscFlags.tickInterval;
+          pollMemoryLimit();
+      }
+  }
+
   /*
    * If we've been inactive for idleGCDelayTime (set by +RTS
    * -I), tell the scheduler to wake up and do a GC, to check
@@ -133,10 +313,12 @@ handle_tick(int unused STG_UNUSED)
   switch (SEQ_CST_LOAD(&recent_activity)) {
   case ACTIVITY_YES:
       SEQ_CST_STORE(&recent_activity, ACTIVITY_MAYBE_NO);
+      quiet_tick = false;
       idle_ticks_to_gc = RtsFlags.GcFlags.idleGCDelayTime /
                          RtsFlags.MiscFlags.tickInterval;
       break;
   case ACTIVITY_MAYBE_NO:
+      quiet_tick = true;
       if (idle_ticks_to_gc == 0 && inter_gc_ticks_to_gc == 0) {
           if (RtsFlags.GcFlags.doIdleGC) {
               SEQ_CST_STORE(&recent_activity, ACTIVITY_INACTIVE);
@@ -172,6 +354,49 @@ handle_tick(int unused STG_UNUSED)
   }
 }
 
+// See Note [Tickless idle]. Called by the ticker thread after each tick.
+uint32_t
+ticksToNextTimerEvent (void)
+{
+    uint32_t i;
+    int ticks;
+
+#if defined(PROFILING) || defined(TICKY_TICKY)
+    return 1;
+#endif
+    if (RtsFlags.ProfFlags.doHeapProfile) {
+        return 1;
+    }
+    for (i = 0; i < n_capabilities; i++) {
+        if (RELAXED_LOAD(&capabilities[i]->in_haskell)) {
+            return 1;
+        }
+    }
+    if (SEQ_CST_LOAD(&recent_activity) != ACTIVITY_MAYBE_NO || !quiet_tick) {
+        return 1;
+    }
+
+    // handle_tick does something at the first tick where both countdowns
+    // are zero
+    ticks = stg_max(idle_ticks_to_gc, inter_gc_ticks_to_gc) + 1;
+    if (eventLogStatus() == EVENTLOG_RUNNING
+        && RtsFlags.TraceFlags.eventlogFlushTicks > 0) {
+        ticks = stg_min(ticks, ticks_to_eventlog_flush);
+    }
+    if (RtsFlags.GcFlags.cgroupMemoryLimit) {
+        ticks = stg_min(ticks, ticks_to_memory_limit_poll);
+    }
+    return stg_max(ticks, 1);
+}
+
+void
+wakeTimer (void)
+{
+    if (RtsFlags.MiscFlags.tickInterval != 0) {
+        wakeTicker();
+    }
+}
+
 void
 initTimer(void)
 {
@@ -10,3 +10,7 @@
 
 RTS_PRIVATE void initTimer (void);
 RTS_PRIVATE void exitTimer (bool wait);
+
+// See Note [Tickless idle] in Timer.c
+RTS_PRIVATE void wakeTimer (void);
+RTS_PRIVATE uint32_t ticksToNextTimerEvent (void);
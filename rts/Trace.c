@@ -872,6 +872,25 @@ void traceThreadLabel_(Capability *cap,
     }
 }
 
+void traceThreadStats_(Capability *cap, StgTSO *tso)
+{
+    StgWord64 alloc_bytes = PK_Word64((W_*)&(tso->alloc_bytes));
+    StgWord64 cpu_ns = (StgWord64)PK_Int64((W_*)&(tso->cpu_time));
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        ACQUIRE_LOCK(&trace_utx);
+        tracePreface();
+        debugBelch("cap %d: thread %" FMT_Word " allocated %" FMT_Word64
+                   " bytes in %" FMT_Word64 "ns\n",
+                   cap->no, (W_)tso->id, alloc_bytes, cpu_ns);
+        RELEASE_LOCK(&trace_utx);
+    } else
+#endif
+    {
+        postThreadStats(cap, tso->id, alloc_bytes, cpu_ns);
+    }
+}
+
 void traceConcMarkBegin()
 {
     if (eventlog_enabled)
@@ -921,6 +940,24 @@ void traceNonmovingHeapCensus(uint32_t log_blk_size,
         postNonmovingHeapCensus(log_blk_size, census);
 }
 
+void traceFinalizersPending(StgWord32 c_finalizers, StgWord32 hs_finalizers)
+{
+    if (eventlog_enabled && TRACE_gc)
+        postFinalizersPending(c_finalizers, hs_finalizers);
+}
+
+void traceFinalizersRun(StgWord32 count, StgWord64 duration_ns)
+{
+    if (eventlog_enabled && TRACE_gc)
+        postFinalizersRun(count, duration_ns);
+}
+
+void traceStackChunkStats(Capability *cap)
+{
+    if (eventlog_enabled && TRACE_gc)
+        postStackChunkStats(cap);
+}
+
 void traceThreadStatus_ (StgTSO *tso USED_IF_DEBUG)
 {
 #if defined(DEBUG)
@@ -229,6 +229,11 @@ void traceThreadLabel_(Capability *cap,
                        StgTSO     *tso,
                        char       *label);
 
+/*
+ * Emit the per-thread accounting totals of a finished thread
+ */
+void traceThreadStats_(Capability *cap, StgTSO *tso);
+
 /*
  * Emit a debug message (only when DEBUG is defined)
  */
@@ -327,6 +332,11 @@ void traceConcUpdRemSetFlush(Capability *cap);
 void traceNonmovingHeapCensus(uint32_t log_blk_size,
                               const struct NonmovingAllocCensus *census);
 
+void traceFinalizersPending(StgWord32 c_finalizers, StgWord32 hs_finalizers);
+void traceFinalizersRun(StgWord32 count, StgWord64 duration_ns);
+
+void traceStackChunkStats(Capability *cap);
+
 void traceIPE(StgInfoTable *info,
                const char *table_name,
                const char *closure_desc,
@@ -360,6 +370,7 @@ void flushTrace(void);
 #define debugTraceCap(class, cap, str, ...) /* nothing */
 #define traceThreadStatus(class, tso) /* nothing */
 #define traceThreadLabel_(cap, tso, label) /* nothing */
+#define traceThreadStats_(cap, tso) /* nothing */
 #define traceCapEvent(cap, tag) /* nothing */
 #define traceCapsetEvent(tag, capset, info) /* nothing */
 #define traceWallClockTime_() /* nothing */
@@ -386,6 +397,11 @@ void flushTrace(void);
 #define traceConcUpdRemSetFlush(cap) /* nothing */
 #define traceNonmovingHeapCensus(blk_size, census) /* nothing */
 
+#define traceFinalizersPending(c_finalizers, hs_finalizers) /* nothing */
+#define traceFinalizersRun(count, duration_ns) /* nothing */
+
+#define traceStackChunkStats(cap) /* nothing */
+
 #define flushTrace() /* nothing */
 
 #endif /* TRACING */
@@ -673,6 +689,14 @@ INLINE_HEADER void traceThreadLabel(Capability *cap   STG_UNUSED,
     dtraceThreadLabel((EventCapNo)cap->no, (EventThreadID)tso->id, label);
 }
 
+INLINE_HEADER void traceThreadStats(Capability *cap STG_UNUSED,
+                                    StgTSO     *tso STG_UNUSED)
+{
+    if (RTS_UNLIKELY(TRACE_sched)) {
+        traceThreadStats_(cap, tso);
+    }
+}
+
 INLINE_HEADER void traceEventGcStart(Capability *cap STG_UNUSED)
 {
     traceGcEvent(cap, EVENT_GC_START);
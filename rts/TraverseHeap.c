@@ -12,7 +12,10 @@
 #include <string.h>
 #include "rts/PosixSource.h"
 #include "Rts.h"
+#include "RtsUtils.h"
 #include "sm/Storage.h"
+#include "sm/GC.h"
+#include "WSDeque.h"
 
 #include "TraverseHeap.h"
 
@@ -20,7 +23,7 @@ const stackData nullStackData;
 
 StgWord getTravData(const StgClosure *c)
 {
-    const StgWord hp_hdr = c->header.prof.hp.trav;
+    const StgWord hp_hdr = RELAXED_LOAD(&c->header.prof.hp.trav);
     return hp_hdr & (STG_WORD_MAX ^ 1);
 }
 
@@ -31,9 +34,22 @@ void setTravData(const traverseState *ts, StgClosure *c, StgWord w)
 
 bool isTravDataValid(const traverseState *ts, const StgClosure *c)
 {
-    return (c->header.prof.hp.trav & 1) == ts->flip;
+    return (RELAXED_LOAD(&c->header.prof.hp.trav) & 1) == ts->flip;
 }
 
+#if defined(THREADED_RTS)
+/**
+ * Atomically replace the (valid) traversal data 'old' of 'c' with 'w'.
+ * Returns false if another thread changed it first, in which case the caller
+ * should read the data again and retry.
+ */
+bool casTravData(const traverseState *ts, StgClosure *c, StgWord old, StgWord w)
+{
+    return cas((StgVolatilePtr)&c->header.prof.hp.trav,
+               old | ts->flip, w | ts->flip) == (old | ts->flip);
+}
+#endif
+
 #if defined(DEBUG)
 unsigned int g_traversalDebugLevel = 0;
 static void debug(const char *s, ...)
@@ -100,6 +116,8 @@ initializeTraverseStack( traverseState *ts )
 
     ts->stackSize = 0;
     ts->maxStackSize = 0;
+    ts->visits = 0;
+    ts->firstVisits = 0;
 
     newStackBlock(ts, ts->firstStack);
 }
@@ -132,6 +150,13 @@ getTraverseStackMaxSize(traverseState *ts)
 STATIC_INLINE bool
 isEmptyWorkStack( traverseState *ts )
 {
+#if defined(THREADED_RTS)
+    // A worker of a parallel traversal has no 'firstStack', but its stackTop
+    // only reaches stackLimit when its whole local stack is empty.
+    if (ts->pool != NULL) {
+        return ts->stackTop == ts->stackLimit;
+    }
+#endif
     return (ts->firstStack == ts->currentStack) && ts->stackTop == ts->stackLimit;
 }
 
@@ -220,6 +245,51 @@ find_srt( stackPos *info )
     return NULL;
 }
 
+#if defined(THREADED_RTS)
+/**
+ * Returns the block group that a worker of a parallel traversal continues on
+ * when its current one is full. The full block group is offered to the other
+ * workers as a segment that they may steal. See Note [Parallel heap
+ * traversal].
+ */
+static bdescr *
+pushSegment(traverseState *ts)
+{
+    bdescr *bd = ts->currentStack;
+    bdescr *nbd = ts->spare;
+
+    if (nbd != NULL) {
+        ts->spare = NULL;
+    } else {
+        nbd = allocGroup_lock(BLOCKS_IN_STACK);
+    }
+    nbd->link = NULL;
+
+    if (pushWSDeque(ts->segments, bd)) {
+        nbd->u.back = NULL;
+    } else {
+        // The deque is full: keep the block group to ourselves, below the
+        // new one.
+        nbd->u.back = bd;
+    }
+
+    return nbd;
+}
+
+/**
+ * Give up the empty block group 'bd' of a worker of a parallel traversal.
+ */
+static void
+releaseSegment(traverseState *ts, bdescr *bd)
+{
+    if (ts->spare == NULL) {
+        ts->spare = bd;
+    } else {
+        freeGroup_lock(bd);
+    }
+}
+#endif
+
 /**
  * Push a set of closures, represented by a single 'stackElement', onto the
  * traversal work-stack.
@@ -235,6 +305,11 @@ pushStackElement(traverseState *ts, const stackElement se)
         // to the next stack.
         ts->currentStack->free = (StgPtr)ts->stackTop;
 
+#if defined(THREADED_RTS)
+        if (ts->pool != NULL) {
+            nbd = pushSegment(ts);
+        } else
+#endif
         if (ts->currentStack->link == NULL) {
             nbd = allocGroup(BLOCKS_IN_STACK);
             nbd->link = NULL;
@@ -569,6 +644,30 @@ popStackElement(traverseState *ts) {
     ASSERT(ts->stackTop + 1 == ts->stackLimit);
     ASSERT(ts->stackBottom == (stackElement *)ts->currentStack->start);
 
+#if defined(THREADED_RTS)
+    if (ts->pool != NULL) {
+        // Continue with the block group below this one, or with the most
+        // recent segment that we offered to the other workers if nobody has
+        // stolen it yet.
+        pbd = ts->currentStack->u.back;
+        if (pbd == NULL) {
+            pbd = popWSDeque(ts->segments);
+        }
+        if (pbd != NULL) {
+            releaseSegment(ts, ts->currentStack);
+            returnToOldStack(ts, pbd);
+        } else {
+            // The local stack is completely empty.
+            ts->stackTop++;
+            ASSERT(ts->stackTop == ts->stackLimit);
+        }
+
+        ts->stackSize--;
+        debug("stackSize = %d\n", ts->stackSize);
+        return;
+    }
+#endif
+
     if (ts->firstStack == ts->currentStack) {
         // The stack is completely empty.
         ts->stackTop++;
@@ -872,6 +971,28 @@ traverseMaybeInitClosureData(const traverseState* ts, StgClosure *c)
     return false;
 }
 
+/**
+ * Like traverseMaybeInitClosureData(), for the closure about to be visited by
+ * the traversal. The workers of a parallel traversal may reach the same
+ * closure at the same time, in which case only one of them must see the first
+ * visit.
+ */
+STATIC_INLINE bool
+initClosureDataForVisit(const traverseState *ts, StgClosure *c)
+{
+#if defined(THREADED_RTS)
+    if (ts->pool != NULL) {
+        const StgWord hp_hdr = RELAXED_LOAD(&c->header.prof.hp.trav);
+        if ((hp_hdr & 1) == ts->flip) {
+            return false;
+        }
+        return cas((StgVolatilePtr)&c->header.prof.hp.trav,
+                   hp_hdr, ts->flip) == hp_hdr;
+    }
+#endif
+    return traverseMaybeInitClosureData(ts, c);
+}
+
 /**
  * Call traversePushClosure for each of the closures covered by a large bitmap.
  */
@@ -1206,11 +1327,14 @@ inner_loop:
     stackAccum accum = {};
 
     // If this is the first visit to c, initialize its data.
-    bool first_visit = traverseMaybeInitClosureData(ts, c);
+    bool first_visit = initClosureDataForVisit(ts, c);
     bool traverse_children = first_visit;
     if(visit_cb)
         traverse_children = visit_cb(c, cp, data, first_visit,
                                      &accum, &child_data);
+    ts->visits++;
+    if(first_visit)
+        ts->firstVisits++;
     if(!traverse_children)
         goto loop;
 
@@ -1331,6 +1455,250 @@ inner_loop:
     goto inner_loop;
 }
 
+/* -----------------------------------------------------------------------------
+ * Parallel traversal
+ *
+ * Note [Parallel heap traversal]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Traversing a large heap with traverseWorkStack() takes a long time, and
+ * the traversal is done while all capabilities are stopped. When it is
+ * started from a GC that used several GC threads, traverseWorkStackParallel()
+ * shares the traversal between those threads, using runGcThreadsTask() (see
+ * Note [GC thread tasks] in GC.c).
+ *
+ * Every worker has its own traverseState with its own work-stack, and runs the
+ * ordinary traverseWorkStack() loop on it. The work is shared out in units of
+ * block groups of the work-stack, which we call segments:
+ *
+ *  - When a worker's current block group is full, pushSegment() pushes it
+ *    onto the worker's 'segments' WSDeque instead of linking it below the
+ *    next one. The elements on a stack are self-contained when there is no
+ *    return_cb, so a full segment can be moved to another worker as it is.
+ *
+ *  - When a worker runs off the bottom of its current block group it takes
+ *    the most recent segment back from its own deque, just like a sequential
+ *    traversal would return to the previous block group.
+ *
+ *  - A worker with an empty stack steals the oldest segment from another
+ *    worker's deque. The oldest segments are the ones nearest to the roots,
+ *    so they tend to hold the most work.
+ *
+ * The work-stack built by the caller (the roots) is split into segments up
+ * front and put on a separate deque, 'roots', which all workers steal from.
+ * The workers count themselves in 'n_active' while they hold work, or are
+ * trying to steal some, in the same way as gc_running_threads works for the
+ * GC itself. Once a worker has no work, and there is no work in any deque and
+ * no active worker, the traversal is complete.
+ *
+ * Since several workers can reach the same closure at the same time the
+ * visited bit is set with a CAS (see initClosureDataForVisit()), and the visit
+ * callback must update the closure's data with casTravData().
+ *
+ * A parallel traversal does not support return_cb: a stackElement's 'sep'
+ * may live in another worker's stack, and the order in which the children of
+ * a closure are completed is not defined.
+ * -------------------------------------------------------------------------- */
+
+#if defined(THREADED_RTS)
+
+// Size of a worker's 'segments' deque. When it is full the worker keeps its
+// segments to itself, see pushSegment().
+#define TRAVERSE_SEGMENTS_SIZE 4096
+
+typedef struct traversePool_ {
+    traverseState *workers;   // indexed by GC thread
+    WSDeque *roots;           // segments of the initial work-stack
+    visitClosure_cb visit_cb;
+    StgWord n_active;         // workers holding or stealing work
+} traversePool;
+
+/**
+ * Number of stack elements in the segment 'bd', including the block groups
+ * below it.
+ */
+static int
+segmentElements(bdescr *bd)
+{
+    int n = 0;
+
+    for (; bd != NULL; bd = bd->u.back) {
+        n += (stackElement *)(bd->start + BLOCK_SIZE_W * bd->blocks)
+           - (stackElement *)bd->free;
+    }
+    return n;
+}
+
+static bdescr *
+stealSegment(traversePool *pool, uint32_t me)
+{
+    bdescr *bd;
+    uint32_t n;
+
+    bd = stealWSDeque(pool->roots);
+    if (bd != NULL) {
+        return bd;
+    }
+
+    for (n = 0; n < n_capabilities; n++) {
+        if (n == me) continue;
+        bd = stealWSDeque(pool->workers[n].segments);
+        if (bd != NULL) {
+            return bd;
+        }
+    }
+    return NULL;
+}
+
+static bool
+anyTraverseWork(traversePool *pool)
+{
+    uint32_t n;
+
+    if (!looksEmptyWSDeque(pool->roots)) {
+        return true;
+    }
+    for (n = 0; n < n_capabilities; n++) {
+        if (!looksEmptyWSDeque(pool->workers[n].segments)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Make the stolen segment 'bd' the work-stack of the worker 'ts', whose own
+ * stack is empty.
+ */
+static void
+adoptSegment(traverseState *ts, bdescr *bd)
+{
+    if (ts->currentStack != NULL) {
+        ASSERT(isEmptyWorkStack(ts));
+        releaseSegment(ts, ts->currentStack);
+    }
+    returnToOldStack(ts, bd);
+
+    ts->stackSize += segmentElements(bd);
+    if (ts->stackSize > ts->maxStackSize) ts->maxStackSize = ts->stackSize;
+}
+
+static void
+traverseWorker(uint32_t thread_index, void *arg)
+{
+    traversePool *pool = (traversePool *)arg;
+    traverseState *ts = &pool->workers[thread_index];
+    bdescr *bd;
+    uint32_t spin;
+
+    atomic_inc(&pool->n_active, 1);
+    for (;;) {
+        bd = stealSegment(pool, thread_index);
+        if (bd != NULL) {
+            adoptSegment(ts, bd);
+            traverseWorkStack(ts, pool->visit_cb);
+            continue;
+        }
+
+        // We are out of work: wait until some shows up in a deque, or until
+        // no worker could produce any more.
+        atomic_dec(&pool->n_active);
+        for (spin = 0; !anyTraverseWork(pool); spin++) {
+            if (SEQ_CST_LOAD(&pool->n_active) == 0) {
+                return;
+            }
+            if (spin % 1000 == 999) {
+                yieldThread();
+            } else {
+                busy_wait_nop();
+            }
+        }
+        atomic_inc(&pool->n_active, 1);
+    }
+}
+
+/**
+ * Like traverseWorkStack(), but shares the work between the GC threads. This
+ * must be called by the GC leader after a parallel GC (n_gc_threads > 1), and
+ * 'ts->return_cb' must be NULL. See Note [Parallel heap traversal].
+ *
+ * On return the work-stack of 'ts' is empty, and its statistics include those
+ * of all the workers.
+ */
+void
+traverseWorkStackParallel(traverseState *ts, visitClosure_cb visit_cb)
+{
+    traversePool pool;
+    traverseState *w;
+    bdescr *bd, *next;
+    uint32_t n;
+    int maxStackSize;
+    StgWord visits, firstVisits;
+
+    ASSERT(ts->return_cb == NULL);
+    ASSERT(ts->pool == NULL);
+
+    pool.visit_cb = visit_cb;
+    pool.n_active = 0;
+    pool.roots = newWSDeque(traverseWorkStackBlocks(ts));
+    pool.workers = stgCallocBytes(n_capabilities, sizeof(traverseState),
+                                  "traverseWorkStackParallel");
+    for (n = 0; n < n_capabilities; n++) {
+        w = &pool.workers[n];
+        w->flip = ts->flip;
+        w->return_cb = NULL;
+        w->pool = &pool;
+        w->segments = newWSDeque(TRAVERSE_SEGMENTS_SIZE);
+    }
+
+    // Split the initial work-stack into segments, one per block group. Block
+    // groups beyond currentStack, or below it but left empty, hold no
+    // elements.
+    ts->currentStack->free = (StgPtr)ts->stackTop;
+    for (bd = ts->firstStack; bd != NULL; bd = next) {
+        next = bd->link;
+        bd->link = NULL;
+        bd->u.back = NULL;
+        if (segmentElements(bd) > 0) {
+            pushWSDeque(pool.roots, bd);
+        } else {
+            freeGroup_lock(bd);
+        }
+    }
+    ts->firstStack = NULL;
+    maxStackSize = ts->maxStackSize;
+    visits = ts->visits;
+    firstVisits = ts->firstVisits;
+
+    runGcThreadsTask(traverseWorker, &pool);
+
+    for (n = 0; n < n_capabilities; n++) {
+        w = &pool.workers[n];
+        ASSERT(looksEmptyWSDeque(w->segments));
+        if (w->currentStack != NULL) {
+            freeGroup_lock(w->currentStack);
+        }
+        if (w->spare != NULL) {
+            freeGroup_lock(w->spare);
+        }
+        freeWSDeque(w->segments);
+
+        if (w->maxStackSize > maxStackSize) maxStackSize = w->maxStackSize;
+        visits += w->visits;
+        firstVisits += w->firstVisits;
+    }
+    ASSERT(looksEmptyWSDeque(pool.roots));
+    freeWSDeque(pool.roots);
+    stgFree(pool.workers);
+
+    // Leave an empty work-stack behind, as traverseWorkStack() does.
+    initializeTraverseStack(ts);
+    ts->maxStackSize = maxStackSize;
+    ts->visits = visits;
+    ts->firstVisits = firstVisits;
+}
+
+#endif /* THREADED_RTS */
+
 /**
  * This function flips the 'flip' bit and hence every closure's profiling data
  * will be reset to zero upon visiting. See Note [Profiling heap traversal
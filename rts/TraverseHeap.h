@@ -197,6 +197,31 @@ typedef struct traverseState_ {
      */
     void (*return_cb)(StgClosure *c, const stackAccum acc,
                       StgClosure *c_parent, stackAccum *acc_parent);
+
+    /**
+     * visits: number of calls to the visit callback.
+     * firstVisits: how many of those were the first visit to the closure in
+     *   the current pass.
+     */
+    StgWord visits, firstVisits;
+
+#if defined(THREADED_RTS)
+    /**
+     * Only used by the workers of traverseWorkStackParallel(), NULL
+     * otherwise. See Note [Parallel heap traversal].
+     *
+     *   pool: state shared by all the workers of the traversal.
+     *
+     *   segments: full block groups of this worker's work-stack, which
+     *   other workers may steal.
+     *
+     *   spare: an empty block group kept back, so that we don't go to the
+     *   block allocator every time the stack crosses a block boundary.
+     */
+    struct traversePool_ *pool;
+    struct WSDeque_ *segments;
+    bdescr *spare;
+#endif
 } traverseState;
 
 /**
@@ -210,6 +235,11 @@ typedef struct traverseState_ {
  * Returning 'false' will instruct the heap traversal code to skip processing
  * this closure's children. If you don't need to traverse any closure more than
  * once you can simply return 'first_visit'.
+ *
+ * Under traverseWorkStackParallel() the callback runs on several threads at
+ * once and may be called for the same closure concurrently, so it must update
+ * the closure's data with casTravData(). Exactly one of the concurrent visits
+ * sees 'first_visit'.
  */
 typedef bool (*visitClosure_cb) (
     StgClosure *c,
@@ -224,6 +254,10 @@ void setTravData(const traverseState *ts, StgClosure *c, StgWord w);
 bool isTravDataValid(const traverseState *ts, const StgClosure *c);
 
 void traverseWorkStack(traverseState *ts, visitClosure_cb visit_cb);
+#if defined(THREADED_RTS)
+void traverseWorkStackParallel(traverseState *ts, visitClosure_cb visit_cb);
+bool casTravData(const traverseState *ts, StgClosure *c, StgWord old, StgWord w);
+#endif
 void traversePushRoot(traverseState *ts, StgClosure *c, StgClosure *cp, stackData data);
 void traversePushClosure(traverseState *ts, StgClosure *c, StgClosure *cp, stackElement *sep, stackData data);
 bool traverseMaybeInitClosureData(const traverseState* ts, StgClosure *c);
@@ -20,9 +20,35 @@
 // List of dead weak pointers collected by the last GC
 static StgWeak *finalizer_list = NULL;
 
-// Count of the above list.
+// Count of the above list, plus the finalizers that have been taken off the
+// list but are still running.
 static uint32_t n_finalizers = 0;
 
+// Run this many finalizers at a time: see runSomeFinalizers() and
+// Note [Finalizer threads].
+static const uint32_t finalizer_chunk = 100;
+
+#if defined(THREADED_RTS)
+// Protects finalizer_list and the finalizer thread state below.
+static Mutex finalizer_mutex;
+
+// Signalled when finalizers are added to finalizer_list, or when the
+// finalizer threads should exit.
+static Condition finalizer_work_cond;
+
+// Signalled when n_finalizers_running drops to zero.
+static Condition finalizer_done_cond;
+
+// The number of finalizers taken off finalizer_list that are still running.
+static uint32_t n_finalizers_running = 0;
+
+static OSThreadId *finalizer_threads = NULL;
+static uint32_t n_finalizer_threads = 0;
+static bool finalizer_threads_exit = false;
+#endif
+
+static void queueFinalizers(StgWeak *list, uint32_t n);
+
 void
 runCFinalizers(StgCFinalizerList *list)
 {
@@ -38,9 +64,69 @@ runCFinalizers(StgCFinalizerList *list)
     }
 }
 
+// Find the chunk of up to finalizer_chunk weak pointers that starts the
+// list. Returns its length, and sets *rest to the rest of the list.
+static uint32_t
+splitFinalizerChunk(StgWeak *list, StgWeak **rest)
+{
+    StgWeak *w = list;
+    uint32_t count = 0;
+
+    while (w != NULL && count < finalizer_chunk) {
+        w = w->link;
+        count++;
+    }
+    *rest = w;
+    return count;
+}
+
+// Run the C finalizers of the first count weak pointers on the list.
+static void
+runFinalizerChunk(StgWeak *w, uint32_t count)
+{
+#if defined(TRACING)
+    StgWord64 start = getMonotonicNSec();
+#endif
+    for (uint32_t i = 0; i < count; i++) {
+        runCFinalizers((StgCFinalizerList *)w->cfinalizers);
+        w = w->link;
+    }
+#if defined(TRACING)
+    traceFinalizersRun(count, getMonotonicNSec() - start);
+#endif
+}
+
 void
 runAllCFinalizers(StgWeak *list)
 {
+#if defined(THREADED_RTS)
+    // Hand the finalizers to the finalizer threads, and help them until
+    // they are all done. The weak pointers are not needed after this, so we
+    // can reuse their link fields to queue them.
+    StgWeak *w, *next;
+    StgWeak *queue = NULL;
+    StgWeak **tl = &queue;
+    uint32_t n = 0;
+
+    for (w = list; w; w = next) {
+        next = w->link;
+        // DEAD_WEAKs are filtered out as in the non-threaded RTS below,
+        // see #7170.
+        const StgInfoTable *winfo = ACQUIRE_LOAD(&w->header.info);
+        if (winfo != &stg_DEAD_WEAK_info) {
+            SET_HDR(w, &stg_DEAD_WEAK_info, w->header.prof.ccs);
+            *tl = w;
+            tl = &w->link;
+            n++;
+        }
+    }
+    *tl = NULL;
+
+    if (n > 0) {
+        queueFinalizers(queue, n);
+        runSomeFinalizers(true);
+    }
+#else
     StgWeak *w;
     Task *task;
 
@@ -66,12 +152,60 @@ runAllCFinalizers(StgWeak *list)
     if (task != NULL) {
         task->running_finalizers = false;
     }
+#endif
+}
+
+// Create a thread running the Haskell finalizers of the weak pointers on the
+// list, up to n of them. Returns the rest of the list.
+static StgWeak *
+scheduleFinalizerBatch(Capability *cap, StgWeak *list, uint32_t n)
+{
+    StgWeak *w;
+    StgTSO *t;
+    StgMutArrPtrs *arr;
+    StgWord size;
+    uint32_t i;
+
+    size = n + mutArrPtrsCardTableSize(n);
+    arr = (StgMutArrPtrs *)allocate(cap, sizeofW(StgMutArrPtrs) + size);
+    TICK_ALLOC_PRIM(sizeofW(StgMutArrPtrs), n, 0);
+    // No write barrier needed here; this array is only going to referred to by this core.
+    SET_HDR(arr, &stg_MUT_ARR_PTRS_FROZEN_CLEAN_info, CCS_SYSTEM);
+    arr->ptrs = n;
+    arr->size = size;
+
+    i = 0;
+    for (w = list; i < n; w = w->link) {
+        if (w->finalizer != &stg_NO_FINALIZER_closure) {
+            arr->payload[i] = w->finalizer;
+            i++;
+        }
+    }
+    // set all the cards to 1
+    for (i = n; i < size; i++) {
+        arr->payload[i] = (StgClosure *)(W_)(-1);
+    }
+
+    t = createIOThread(cap,
+                       RtsFlags.GcFlags.initialStkSize,
+                       rts_apply(cap,
+                           rts_apply(cap,
+                               (StgClosure *)runFinalizerBatch_closure,
+                               rts_mkInt(cap,n)),
+                           (StgClosure *)arr)
+        );
+
+    scheduleThread(cap,t);
+    labelThread(cap, t, "weak finalizer thread");
+    return w;
 }
 
 /*
  * scheduleFinalizers() is called on the list of weak pointers found
  * to be dead after a garbage collection.  It overwrites each object
- * with DEAD_WEAK, and creates a new thread to run the pending finalizers.
+ * with DEAD_WEAK, queues their C finalizers to be run by
+ * runSomeFinalizers() or the finalizer threads, and creates new threads
+ * to run the pending Haskell finalizers.
  *
  * This function is called just after GC.  The weak pointers on the
  * argument list are those whose keys were found to be not reachable,
@@ -87,25 +221,13 @@ void
 scheduleFinalizers(Capability *cap, StgWeak *list)
 {
     StgWeak *w;
-    StgTSO *t;
-    StgMutArrPtrs *arr;
-    StgWord size;
-    uint32_t n, i;
+    uint32_t n, i, batches;
 
     // n_finalizers is not necessarily zero under non-moving collection
     // because non-moving collector does not wait for the list to be consumed
     // (by doIdleGcWork()) before appending the list with more finalizers.
     ASSERT(RtsFlags.GcFlags.useNonmoving || SEQ_CST_LOAD(&n_finalizers) == 0);
 
-    // Append finalizer_list with the new list. TODO: Perhaps cache tail of the
-    // list for faster append. NOTE: We can't append `list` here! Otherwise we
-    // end up traversing already visited weaks in the loops below.
-    StgWeak **tl = &finalizer_list;
-    while (*tl) {
-        tl = &(*tl)->link;
-    }
-    SEQ_CST_STORE(tl, list);
-
     // Traverse the list and
     //  * count the number of Haskell finalizers
     //  * overwrite all the weak pointers with DEAD_WEAK
@@ -139,44 +261,39 @@ scheduleFinalizers(Capability *cap, StgWeak *list)
         SET_HDR(w, &stg_DEAD_WEAK_info, w->header.prof.ccs);
     }
 
-    SEQ_CST_ADD(&n_finalizers, i);
+    // Only queue the list once we are done with it: the finalizer threads
+    // may start running it straight away.
+    if (i > 0) {
+        queueFinalizers(list, i);
+    }
+
+    traceFinalizersPending(SEQ_CST_LOAD(&n_finalizers), n);
 
     // No Haskell finalizers to run?
     if (n == 0) return;
 
-    debugTrace(DEBUG_weak, "weak: batching %d finalizers", n);
-
-    size = n + mutArrPtrsCardTableSize(n);
-    arr = (StgMutArrPtrs *)allocate(cap, sizeofW(StgMutArrPtrs) + size);
-    TICK_ALLOC_PRIM(sizeofW(StgMutArrPtrs), n, 0);
-    // No write barrier needed here; this array is only going to referred to by this core.
-    SET_HDR(arr, &stg_MUT_ARR_PTRS_FROZEN_CLEAN_info, CCS_SYSTEM);
-    arr->ptrs = n;
-    arr->size = size;
-
-    n = 0;
-    for (w = list; w; w = w->link) {
-        if (w->finalizer != &stg_NO_FINALIZER_closure) {
-            arr->payload[n] = w->finalizer;
-            n++;
-        }
-    }
-    // set all the cards to 1
-    for (i = n; i < size; i++) {
-        arr->payload[i] = (StgClosure *)(W_)(-1);
+    // Split the Haskell finalizers into as many batches as there are
+    // finalizer threads, but no smaller than finalizer_chunk. Each batch gets
+    // its own Haskell thread, which the scheduler can push to idle
+    // capabilities.
+#if defined(THREADED_RTS)
+    batches = (n + finalizer_chunk - 1) / finalizer_chunk;
+    if (batches > n_finalizer_threads) {
+        batches = n_finalizer_threads;
     }
+#else
+    batches = 1;
+#endif
 
-    t = createIOThread(cap,
-                       RtsFlags.GcFlags.initialStkSize,
-                       rts_apply(cap,
-                           rts_apply(cap,
-                               (StgClosure *)runFinalizerBatch_closure,
-                               rts_mkInt(cap,n)),
-                           (StgClosure *)arr)
-        );
+    debugTrace(DEBUG_weak, "weak: batching %d finalizers in %d threads",
+               n, batches);
 
-    scheduleThread(cap,t);
-    labelThread(cap, t, "weak finalizer thread");
+    w = list;
+    for (i = 0; i < batches; i++) {
+        // Spread the remainder over the first batches
+        uint32_t batch = n / batches + (i < n % batches ? 1 : 0);
+        w = scheduleFinalizerBatch(cap, w, batch);
+    }
 }
 
 /* -----------------------------------------------------------------------------
@@ -204,21 +321,215 @@ scheduleFinalizers(Capability *cap, StgWeak *list)
    4. like (3), but also run finalizers incrementally between GCs.
       - reduces the delay to run finalizers compared with (3)
 
-   For now we do (3). It would be easy to do (4) later by adding a
-   call to doIdleGCWork() in the scheduler loop, but I haven't found
-   that necessary so far.
+   5. Run finalizers on a pool of OS threads of their own.
+      + reduces pause to 0
+      + finalizers run as soon as the GC is done, in parallel, without
+        taking any capability away from the mutator
+
+   The non-threaded RTS does (3). The threaded RTS does (5), see
+   Note [Finalizer threads].
 
    -------------------------------------------------------------------------- */
 
-// Run this many finalizers before returning from
-// runSomeFinalizers(). This is so that we only tie up the capability
-// for a short time, and respond quickly if new work becomes
-// available.
-static const int32_t finalizer_chunk = 100;
+/* Note [Finalizer threads]
+   ~~~~~~~~~~~~~~~~~~~~~~~~
+   In the threaded RTS the C finalizers of the weak pointers found dead by
+   the GC are run by a pool of finalizer threads, which are OS threads
+   started by queueFinalizers() the first time there is something to do. The
+   number of threads is set by --finalizer-threads, and is the number of
+   capabilities by default.
+
+   The threads take chunks of finalizer_chunk weak pointers off
+   finalizer_list, holding finalizer_mutex, and run them without it. Each
+   finalizer thread has a Task with running_finalizers set, so that a
+   finalizer calling back into Haskell fails in the same way as it does on
+   a capability.
+
+   All the C finalizers queued by a GC must have run before the next GC,
+   because the DEAD_WEAK objects, and the StgCFinalizerList objects they
+   point to, are not roots: the GC would move or free them under the
+   finalizer threads' feet. So before each GC, doIdleGCWork() calls
+   runSomeFinalizers(true), which helps the finalizer threads with the
+   chunks that are left, and then waits until n_finalizers_running is zero.
+   At that point, all capabilities are stopped for the GC and nothing can
+   be added to finalizer_list until scheduleFinalizers() is called at the
+   end of it. runAllCFinalizers() uses the same mechanism when the RTS is
+   shut down; the threads are then stopped by exitFinalizers().
+
+   Otherwise the capabilities leave the C finalizers to the finalizer
+   threads: runSomeFinalizers(false) does nothing.
+
+   The Haskell finalizers are split into up to as many batches as there are
+   finalizer threads, each run by its own Haskell thread, so that they can
+   also run in parallel.
+
+   Because forkProcess() keeps the calling OS thread only, the child starts
+   with no finalizer threads, and with the chunks that were running in the
+   parent dropped from n_finalizers: see initFinalizers().
+*/
+
+#if defined(THREADED_RTS)
+// Take a chunk of finalizer_list and run it. finalizer_mutex must be held,
+// and is released while the finalizers run.
+static void
+takeAndRunFinalizerChunk(void)
+{
+    StgWeak *w = finalizer_list;
+    uint32_t count = splitFinalizerChunk(w, &finalizer_list);
+
+    n_finalizers_running += count;
+    RELEASE_LOCK(&finalizer_mutex);
+
+    runFinalizerChunk(w, count);
+
+    ACQUIRE_LOCK(&finalizer_mutex);
+    n_finalizers_running -= count;
+    SEQ_CST_ADD(&n_finalizers, -count);
+    if (n_finalizers_running == 0) {
+        broadcastCondition(&finalizer_done_cond);
+    }
+}
+
+static void *
+finalizerThread(void *arg STG_UNUSED)
+{
+    Task *task = getMyTask();
+    task->running_finalizers = true;
+
+    ACQUIRE_LOCK(&finalizer_mutex);
+    while (!finalizer_threads_exit) {
+        if (finalizer_list == NULL) {
+            waitCondition(&finalizer_work_cond, &finalizer_mutex);
+        } else {
+            takeAndRunFinalizerChunk();
+        }
+    }
+    RELEASE_LOCK(&finalizer_mutex);
+
+    task->running_finalizers = false;
+    freeMyTask();
+    return NULL;
+}
+
+// Start the finalizer threads, if they are not running already.
+// finalizer_mutex must be held.
+static void
+startFinalizerThreads(void)
+{
+    uint32_t n, i;
+
+    if (n_finalizer_threads > 0) return;
+
+    n = RtsFlags.MiscFlags.finalizerThreads;
+    if (n == 0) {
+        n = enabled_capabilities;
+    }
+
+    finalizer_threads = stgMallocBytes(n * sizeof(OSThreadId),
+                                       "startFinalizerThreads");
+    for (i = 0; i < n; i++) {
+        if (createOSThread(&finalizer_threads[i], "ghc_finalizer",
+                           finalizerThread, NULL) != 0) {
+            barf("startFinalizerThreads: failed to create a thread");
+        }
+    }
+    n_finalizer_threads = n;
+    debugTrace(DEBUG_weak, "weak: started %d finalizer threads", n);
+}
+#endif
+
+// Append the list of n DEAD_WEAKs to finalizer_list.
+static void
+queueFinalizers(StgWeak *list, uint32_t n)
+{
+#if defined(THREADED_RTS)
+    ACQUIRE_LOCK(&finalizer_mutex);
+#endif
+
+    // TODO: Perhaps cache tail of the list for faster append.
+    StgWeak **tl = &finalizer_list;
+    while (*tl) {
+        tl = &(*tl)->link;
+    }
+    SEQ_CST_STORE(tl, list);
+    SEQ_CST_ADD(&n_finalizers, n);
+
+#if defined(THREADED_RTS)
+    startFinalizerThreads();
+    broadcastCondition(&finalizer_work_cond);
+    RELEASE_LOCK(&finalizer_mutex);
+#endif
+}
+
+void
+initFinalizers(void)
+{
+#if defined(THREADED_RTS)
+    initMutex(&finalizer_mutex);
+    initCondition(&finalizer_work_cond);
+    initCondition(&finalizer_done_cond);
+
+    // In the child of forkProcess(), the finalizer threads are gone, and so
+    // are the chunks they were running. See Note [Finalizer threads].
+    SEQ_CST_ADD(&n_finalizers, -n_finalizers_running);
+    n_finalizers_running = 0;
+    if (finalizer_threads != NULL) {
+        stgFree(finalizer_threads);
+        finalizer_threads = NULL;
+    }
+    n_finalizer_threads = 0;
+    finalizer_threads_exit = false;
+#endif
+}
+
+void
+exitFinalizers(void)
+{
+#if defined(THREADED_RTS)
+    uint32_t i;
+
+    ACQUIRE_LOCK(&finalizer_mutex);
+    finalizer_threads_exit = true;
+    broadcastCondition(&finalizer_work_cond);
+    RELEASE_LOCK(&finalizer_mutex);
+
+    for (i = 0; i < n_finalizer_threads; i++) {
+        joinOSThread(finalizer_threads[i]);
+    }
+    if (finalizer_threads != NULL) {
+        stgFree(finalizer_threads);
+        finalizer_threads = NULL;
+    }
+    n_finalizer_threads = 0;
+    finalizer_threads_exit = false;
+
+    closeCondition(&finalizer_done_cond);
+    closeCondition(&finalizer_work_cond);
+    closeMutex(&finalizer_mutex);
+#endif
+}
+
+#if defined(THREADED_RTS)
+// Used by forkProcess(), so that the child does not inherit finalizer_mutex
+// held by a finalizer thread.
+void
+finalizerLock(void)
+{
+    ACQUIRE_LOCK(&finalizer_mutex);
+}
+
+void
+finalizerUnlock(void)
+{
+    RELEASE_LOCK(&finalizer_mutex);
+}
+#endif
 
+#if !defined(THREADED_RTS)
 // non-zero if a thread is already in runSomeFinalizers(). This
 // protects the globals finalizer_list and n_finalizers.
 static volatile StgWord finalizer_lock = 0;
+#endif
 
 //
 // Run some C finalizers.  Returns true if there's more work to do.
@@ -228,6 +539,40 @@ bool runSomeFinalizers(bool all)
     if (RELAXED_LOAD(&n_finalizers) == 0)
         return false;
 
+#if defined(THREADED_RTS)
+    // The finalizer threads take care of it, unless we have to wait for
+    // them. See Note [Finalizer threads].
+    if (!all) {
+        return false;
+    }
+
+    debugTrace(DEBUG_sched, "waiting for C finalizers, %d remaining",
+               n_finalizers);
+
+    Task *task = myTask();
+    if (task != NULL) {
+        task->running_finalizers = true;
+    }
+
+    ACQUIRE_LOCK(&finalizer_mutex);
+    while (true) {
+        if (finalizer_list != NULL) {
+            takeAndRunFinalizerChunk();
+        } else if (n_finalizers_running > 0) {
+            waitCondition(&finalizer_done_cond, &finalizer_mutex);
+        } else {
+            break;
+        }
+    }
+    ASSERT(SEQ_CST_LOAD(&n_finalizers) == 0);
+    RELEASE_LOCK(&finalizer_mutex);
+
+    if (task != NULL) {
+        task->running_finalizers = false;
+    }
+
+    return false;
+#else
     if (cas(&finalizer_lock, 0, 1) != 0) {
         // another capability is doing the work, it's safe to say
         // there's nothing to do, because the thread already in
@@ -243,12 +588,14 @@ bool runSomeFinalizers(bool all)
     }
 
     StgWeak *w = finalizer_list;
-    int32_t count = 0;
+    uint32_t count = 0;
     while (w != NULL) {
-        runCFinalizers((StgCFinalizerList *)w->cfinalizers);
-        w = w->link;
-        ++count;
-        if (!all && count >= finalizer_chunk) break;
+        StgWeak *rest;
+        uint32_t n = splitFinalizerChunk(w, &rest);
+        runFinalizerChunk(w, n);
+        w = rest;
+        count += n;
+        if (!all) break;
     }
 
     RELAXED_STORE(&finalizer_list, w);
@@ -262,4 +609,5 @@ bool runSomeFinalizers(bool all)
     bool ret = n_finalizers != 0;
     RELEASE_STORE(&finalizer_lock, 0);
     return ret;
+#endif
 }
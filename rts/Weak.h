@@ -20,5 +20,12 @@ void runAllCFinalizers(StgWeak *w);
 void scheduleFinalizers(Capability *cap, StgWeak *w);
 void markWeakList(void);
 bool runSomeFinalizers(bool all);
+void initFinalizers(void);
+void exitFinalizers(void);
+
+#if defined(THREADED_RTS)
+void finalizerLock(void);
+void finalizerUnlock(void);
+#endif
 
 #include "EndPrivate.h"
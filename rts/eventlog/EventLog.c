@@ -191,6 +191,10 @@ char *EventDesc[] = {
   [EVENT_TICKY_COUNTER_DEF]    = "Ticky-ticky entry counter definition",
   [EVENT_TICKY_COUNTER_BEGIN_SAMPLE] = "Ticky-ticky entry counter begin sample",
   [EVENT_TICKY_COUNTER_SAMPLE] = "Ticky-ticky entry counter sample",
+  [EVENT_THREAD_STATS]         = "Thread accounting statistics",
+  [EVENT_FINALIZERS_PENDING]   = "Finalizers pending",
+  [EVENT_FINALIZERS_RUN]       = "Finalizers run",
+  [EVENT_STACK_CHUNK_STATS]    = "Stack chunk statistics",
 };
 
 // Event type.
@@ -581,6 +585,22 @@ init_event_types(void)
             eventTypes[t].size = 8*4;
             break;
 
+        case EVENT_THREAD_STATS: // (thread, alloc_bytes, cpu_ns)
+            eventTypes[t].size = sizeof(EventThreadID) + 2 * sizeof(StgWord64);
+            break;
+
+        case EVENT_FINALIZERS_PENDING: // (c_finalizers, hs_finalizers)
+            eventTypes[t].size = 2 * sizeof(StgWord32);
+            break;
+
+        case EVENT_FINALIZERS_RUN: // (count, duration_ns)
+            eventTypes[t].size = sizeof(StgWord32) + sizeof(StgWord64);
+            break;
+
+        case EVENT_STACK_CHUNK_STATS: // (overflows, underflows, reused)
+            eventTypes[t].size = 3 * sizeof(StgWord64);
+            break;
+
         default:
             continue; /* ignore deprecated events */
         }
@@ -1421,6 +1441,19 @@ void postThreadLabel(Capability    *cap,
     postBuf(eb, (StgWord8*) label, strsize);
 }
 
+void postThreadStats(Capability    *cap,
+                     EventThreadID  id,
+                     StgWord64      alloc_bytes,
+                     StgWord64      cpu_ns)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_THREAD_STATS);
+    postEventHeader(eb, EVENT_THREAD_STATS);
+    postThreadID(eb, id);
+    postWord64(eb, alloc_bytes);
+    postWord64(eb, cpu_ns);
+}
+
 void postConcUpdRemSetFlush(Capability *cap)
 {
     EventsBuf *eb = &capEventBuf[cap->no];
@@ -1438,6 +1471,36 @@ void postConcMarkEnd(StgWord32 marked_obj_count)
     RELEASE_LOCK(&eventBufMutex);
 }
 
+void postFinalizersPending(StgWord32 c_finalizers, StgWord32 hs_finalizers)
+{
+    ACQUIRE_LOCK(&eventBufMutex);
+    ensureRoomForEvent(&eventBuf, EVENT_FINALIZERS_PENDING);
+    postEventHeader(&eventBuf, EVENT_FINALIZERS_PENDING);
+    postWord32(&eventBuf, c_finalizers);
+    postWord32(&eventBuf, hs_finalizers);
+    RELEASE_LOCK(&eventBufMutex);
+}
+
+void postFinalizersRun(StgWord32 count, StgWord64 duration_ns)
+{
+    ACQUIRE_LOCK(&eventBufMutex);
+    ensureRoomForEvent(&eventBuf, EVENT_FINALIZERS_RUN);
+    postEventHeader(&eventBuf, EVENT_FINALIZERS_RUN);
+    postWord32(&eventBuf, count);
+    postWord64(&eventBuf, duration_ns);
+    RELEASE_LOCK(&eventBufMutex);
+}
+
+void postStackChunkStats(Capability *cap)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_STACK_CHUNK_STATS);
+    postEventHeader(eb, EVENT_STACK_CHUNK_STATS);
+    postWord64(eb, cap->stack_overflows);
+    postWord64(eb, cap->stack_underflows);
+    postWord64(eb, cap->stack_chunks_reused);
+}
+
 void postNonmovingHeapCensus(int log_blk_size,
                              const struct NonmovingAllocCensus *census)
 {
@@ -124,6 +124,15 @@ void postThreadLabel(Capability    *cap,
                      EventThreadID  id,
                      char          *label);
 
+/*
+ * Post the accounting totals of a finished thread
+ * (see Note [Per-thread accounting] in Threads.c)
+ */
+void postThreadStats(Capability    *cap,
+                     EventThreadID  id,
+                     StgWord64      alloc_bytes,
+                     StgWord64      cpu_ns);
+
 /*
  * Various GC and heap events
  */
@@ -204,6 +213,9 @@ void postIPE(StgWord64 info,
 
 void postConcUpdRemSetFlush(Capability *cap);
 void postConcMarkEnd(StgWord32 marked_obj_count);
+void postFinalizersPending(StgWord32 c_finalizers, StgWord32 hs_finalizers);
+void postFinalizersRun(StgWord32 count, StgWord64 duration_ns);
+void postStackChunkStats(Capability *cap);
 void postNonmovingHeapCensus(int log_blk_size,
                              const struct NonmovingAllocCensus *census);
 
@@ -255,6 +267,12 @@ INLINE_HEADER void postThreadLabel(Capability    *cap   STG_UNUSED,
                                    char          *label STG_UNUSED)
 { /* nothing */ }
 
+INLINE_HEADER void postThreadStats(Capability    *cap         STG_UNUSED,
+                                   EventThreadID  id          STG_UNUSED,
+                                   StgWord64      alloc_bytes STG_UNUSED,
+                                   StgWord64      cpu_ns      STG_UNUSED)
+{ /* nothing */ }
+
 #endif
 
 #include "EndPrivate.h"
@@ -518,6 +518,9 @@ endif
 # inlining warnings happen in Compact
 rts/sm/Compact_CC_OPTS += -Wno-inline
 
+# the jumptable of interpretBCO overrides its default entries on purpose
+rts/Interpreter_CC_OPTS += -Wno-override-init
+
 # emits warnings about call-clobbered registers on x86_64
 rts/StgCRun_CC_OPTS += -w
 
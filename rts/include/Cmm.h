@@ -629,6 +629,14 @@
 #define mutArrPtrCardUp(i)   (((i) + mutArrCardMask) >> MUT_ARR_PTRS_CARD_BITS)
 #define mutArrPtrsCardWords(n) ROUNDUP_BYTES_TO_WDS(mutArrPtrCardUp(n))
 
+// See Note [Card marking for small arrays] in rts/sm/Scav.c
+#define smallMutArrCardMask ((1 << SMALL_MUT_ARR_PTRS_CARD_BITS) - 1)
+#define smallMutArrPtrCardDown(i) ((i) >> SMALL_MUT_ARR_PTRS_CARD_BITS)
+#define smallMutArrPtrCardUp(i)   (((i) + smallMutArrCardMask) >> SMALL_MUT_ARR_PTRS_CARD_BITS)
+#define smallMutArrHasCards(n)    ((n) >= SMALL_MUT_ARR_PTRS_CARD_THRESHOLD)
+#define smallMutArrPtrsCardWords(n) \
+    (smallMutArrHasCards(n) * ROUNDUP_BYTES_TO_WDS(smallMutArrPtrCardUp(n)))
+
 #if defined(PROFILING) || defined(DEBUG)
 #define OVERWRITING_CLOSURE_SIZE(c, size) foreign "C" overwritingClosureSize(c "ptr", size)
 #define OVERWRITING_CLOSURE(c) foreign "C" overwritingClosure(c "ptr")
@@ -879,6 +887,21 @@
     __cards = __end_card - __start_card + 1;                                     \
     prim %memset(__dst_cards_p + __start_card, (value), __cards, 1)
 
+/*
+ * Set the cards in the small array pointed to by arr, if it has a card
+ * table, for an update to n elements, starting at element dst_off.
+ */
+#define setSmallCards(arr, dst_off, n)                                         \
+    if (smallMutArrHasCards(StgSmallMutArrPtrs_ptrs(arr))) {                   \
+        W_ __start_card, __end_card, __dst_cards_p;                            \
+        __dst_cards_p = (arr) + SIZEOF_StgSmallMutArrPtrs                      \
+                              + WDS(StgSmallMutArrPtrs_ptrs(arr));             \
+        __start_card = smallMutArrPtrCardDown(dst_off);                        \
+        __end_card = smallMutArrPtrCardDown((dst_off) + (n) - 1);              \
+        prim %memset(__dst_cards_p + __start_card, 1,                          \
+                     __end_card - __start_card + 1, 1);                        \
+    }
+
 /* Complete function body for the clone family of small (mutable)
    array ops. Defined as a macro to avoid function call overhead or
    code duplication. */
@@ -888,9 +911,10 @@
                                                                \
     again: MAYBE_GC(again);                                    \
                                                                \
-    words = BYTES_TO_WDS(SIZEOF_StgSmallMutArrPtrs) + n;       \
+    size = n + smallMutArrPtrsCardWords(n);                    \
+    words = BYTES_TO_WDS(SIZEOF_StgSmallMutArrPtrs) + size;    \
     ("ptr" dst) = ccall allocate(MyCapability() "ptr", words); \
-    TICK_ALLOC_PRIM(SIZEOF_StgSmallMutArrPtrs, WDS(n), 0);     \
+    TICK_ALLOC_PRIM(SIZEOF_StgSmallMutArrPtrs, WDS(size), 0);  \
                                                                \
     SET_HDR(dst, info, CCCS);                                  \
     StgSmallMutArrPtrs_ptrs(dst) = n;                          \
@@ -241,6 +241,7 @@ void _assertFail(const char *filename, unsigned int linenum)
 #include "rts/BlockSignals.h"
 #include "rts/Hpc.h"
 #include "rts/Adjustor.h"
+#include "rts/CompactFile.h"
 #include "rts/FileLock.h"
 #include "rts/GetTime.h"
 #include "rts/Globals.h"
@@ -131,6 +131,34 @@ extern const RtsConfig defaultRtsConfig;
    Statistics
    -------------------------------------------------------------------------- */
 
+//
+// A log-linear ("HDR-style") histogram of pause times, used to report pause
+// percentiles. Pauses are recorded in microseconds: the first
+// PAUSE_HIST_SUB_BUCKETS buckets each cover a single microsecond, and after
+// that every power of two is split into PAUSE_HIST_SUB_BUCKETS equally sized
+// buckets, so a bucket is never wider than 1/PAUSE_HIST_SUB_BUCKETS of its
+// lower bound. Pauses longer than 2^PAUSE_HIST_MAX_EXP microseconds all go in
+// the last bucket. See Note [GC pause histograms] in rts/Stats.c.
+//
+#define PAUSE_HIST_SUB_BITS     3
+#define PAUSE_HIST_SUB_BUCKETS  (1 << PAUSE_HIST_SUB_BITS)
+#define PAUSE_HIST_MAX_EXP      32
+#define PAUSE_HIST_BUCKETS \
+    ((PAUSE_HIST_MAX_EXP - PAUSE_HIST_SUB_BITS + 1) * PAUSE_HIST_SUB_BUCKETS)
+
+typedef struct {
+    // Number of pauses recorded
+  uint64_t count;
+    // The longest pause recorded
+  Time max_ns;
+    // Number of pauses falling in each bucket
+  uint64_t buckets[PAUSE_HIST_BUCKETS];
+} PauseHistogram;
+
+// The number of generations for which RTSStats carries a pause histogram.
+// Collections of older generations are only reported by +RTS -s.
+#define PAUSE_HIST_MAX_GENS 4
+
 //
 // Stats about a single GC
 //
@@ -279,11 +307,55 @@ typedef struct _RTSStats {
     // The maximum time elapsed during the post-mark pause phase of the
     // concurrent nonmoving GC.
   Time nonmoving_gc_max_elapsed_ns;
+
+  // ----------------------------------
+  // Pause time histograms
+
+    // The number of valid entries in gc_pause_hist; this is the number of
+    // generations, capped at PAUSE_HIST_MAX_GENS.
+  uint32_t gc_pause_hist_gens;
+    // Histograms of the elapsed time of stop-the-world collections, indexed
+    // by generation.
+  PauseHistogram gc_pause_hist[PAUSE_HIST_MAX_GENS];
+    // Histogram of the post-mark pause phase of the concurrent nonmoving GC.
+  PauseHistogram nonmoving_gc_sync_pause_hist;
+
+  // ----------------------------------
+  // Memory limits, see Note [Memory limits] in rts/sm/MemoryLimit.c
+
+    // The memory.max and memory.high limits of the cgroup of the process,
+    // 0 if there are none.
+  uint64_t cgroup_memory_max_bytes;
+  uint64_t cgroup_memory_high_bytes;
+    // The soft heap limit derived from them, 0 if there is none.
+  uint64_t soft_heap_limit_bytes;
+    // The number of major GCs caused by memory pressure in the cgroup.
+  uint64_t memory_pressure_gcs;
+
+  // ----------------------------------
+  // Stack chunks, see Note [Stack chunk pool] in rts/Threads.c
+
+    // The number of stack overflows and underflows of all threads, each of
+    // which moves a thread to a new stack chunk.
+  uint64_t stack_overflows;
+  uint64_t stack_underflows;
+    // The number of stack overflows served by a chunk from a capability's
+    // pool of free chunks, rather than by allocating one.
+  uint64_t stack_chunks_reused;
 } RTSStats;
 
 void getRTSStats (RTSStats *s);
 int getRTSStatsEnabled (void);
 
+// Returns an upper bound for the given quantile (0 <= q <= 1) of the pauses
+// recorded in a histogram, e.g. q = 0.99 gives the p99 pause time. The result
+// is exact to within the width of a histogram bucket and never exceeds the
+// longest pause recorded. Returns 0 for an empty histogram.
+Time getPauseHistogramQuantile (const PauseHistogram *h, double q);
+
+// Returns the (exclusive) upper bound of the given histogram bucket.
+Time getPauseHistogramBucketBound (uint32_t bucket);
+
 // Returns the total number of bytes allocated since the start of the program.
 // TODO: can we remove this?
 uint64_t getAllocations (void);
@@ -94,6 +94,11 @@
 
 #define bci_RETURN_T                    69
 #define bci_PUSH_ALTS_T                 70
+
+/* Superinstructions, see Note [Threaded dispatch in the interpreter] in
+   rts/Interpreter.c */
+#define bci_PUSH_L_ENTER                71
+#define bci_SLIDE_ENTER                 72
 /* If you need to go past 255 then you will run into the flags */
 
 /* If you need to go below 0x0100 then you will run into the instructions */
@@ -0,0 +1,40 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2022
+ *
+ * Writing compact regions to files, and loading them back.
+ * See Note [Compact files] in rts/CompactFile.c.
+ *
+ * Do not #include this file directly: #include "Rts.h" instead.
+ *
+ * To understand the structure of the RTS headers, see the wiki:
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/source-tree/includes
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+typedef struct CompactFile_ CompactFile;
+
+// Write the compact starting with the given block, whose root is at the
+// given address, to a file. Returns 0 on success, or -1 with errno set.
+int compactFileWrite (StgCompactNFDataBlock *first, StgPtr root,
+                      const char *path);
+
+// Open a file written by compactFileWrite. Returns 0 and sets *file on
+// success, 1 if the file is not a compact region written by this program,
+// or -1 with errno set if the file could not be read.
+int compactFileOpen (const char *path, CompactFile **file);
+
+// The blocks of the compact, and its root, as they were when it was written
+StgWord compactFileBlockCount (CompactFile *file);
+StgPtr compactFileBlockAddress (CompactFile *file, StgWord i);
+StgWord compactFileBlockSize (CompactFile *file, StgWord i);
+StgPtr compactFileRoot (CompactFile *file);
+
+// Load the i-th block of the compact into a block returned by
+// compactAllocateBlock. Returns 0 on success, or -1 with errno set.
+int compactFileLoadBlock (CompactFile *file, StgWord i,
+                          StgCompactNFDataBlock *block);
+
+void compactFileClose (CompactFile *file);
@@ -74,6 +74,14 @@
  */
 #define MUT_ARR_PTRS_CARD_BITS 7
 
+/* An StgSmallMutArrPtrs with at least SMALL_MUT_ARR_PTRS_CARD_THRESHOLD
+ * elements has a card table too, each byte of which covers
+ * (1<<SMALL_MUT_ARR_PTRS_CARD_BITS) elements.  Smaller arrays have no card
+ * table.  See Note [Card marking for small arrays] in rts/sm/Scav.c.
+ */
+#define SMALL_MUT_ARR_PTRS_CARD_BITS 3
+#define SMALL_MUT_ARR_PTRS_CARD_THRESHOLD 16
+
 /* -----------------------------------------------------------------------------
    STG Registers.
 
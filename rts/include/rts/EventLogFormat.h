@@ -162,12 +162,23 @@
 #define EVENT_TICKY_COUNTER_SAMPLE         211
 #define EVENT_TICKY_COUNTER_BEGIN_SAMPLE   212
 
+/* Per-thread accounting */
+#define EVENT_THREAD_STATS                 213 /* (thread, alloc_bytes, cpu_ns) */
+
+/* Finalizers */
+#define EVENT_FINALIZERS_PENDING           214 /* (c_finalizers, hs_finalizers) */
+#define EVENT_FINALIZERS_RUN               215 /* (count, duration_ns) */
+
+/* Stack chunks */
+#define EVENT_STACK_CHUNK_STATS            216 /* (overflows, underflows,
+                                                  reused) */
+
 /*
  * The highest event code +1 that ghc itself emits. Note that some event
  * ranges higher than this are reserved but not currently emitted by ghc.
  * This must match the size of the EventDesc[] array in EventLog.c
  */
-#define NUM_GHC_EVENT_TAGS        213
+#define NUM_GHC_EVENT_TAGS        217
 
 #if 0  /* DEPRECATED EVENTS: */
 /* we don't actually need to record the thread, it's implicit */
@@ -68,6 +68,11 @@ typedef struct _GC_FLAGS {
     Time    interIdleGCWait;    /* units: TIME_RESOLUTION */
     bool doIdleGC;
 
+    Time    pauseTarget;        /* units: TIME_RESOLUTION, 0 = off */
+    bool cgroupMemoryLimit;     /* derive a soft heap limit from the cgroup */
+    uint32_t returnMemoryRate;  /* in *mblocks* per second, 0 = in the GC */
+    Time    returnMemoryDelay;  /* units: TIME_RESOLUTION */
+
     Time    longGCSync;         /* units: TIME_RESOLUTION */
 
     StgWord heapBase;           /* address to ask the OS for memory */
@@ -188,6 +193,7 @@ typedef struct _TRACE_FLAGS {
 typedef struct _CONCURRENT_FLAGS {
     Time ctxtSwitchTime;         /* units: TIME_RESOLUTION */
     int ctxtSwitchTicks;         /* derived */
+    bool adaptiveCtxtSwitch;     /* adapt the time slice of each capability */
 } CONCURRENT_FLAGS;
 
 /*
@@ -230,9 +236,15 @@ typedef struct _MISC_FLAGS {
                                           tasks in the future, we'd respect it
                                           there as well. */
     bool internalCounters;       /* See Note [Internal Counter Stats] */
+    bool threadAccounting;       /* See Note [Per-thread accounting] */
     bool linkerAlwaysPic;        /* Assume the object code is always PIC */
     StgWord linkerMemBase;       /* address to ask the OS for memory
                                   * for the linker, NULL ==> off */
+    uint32_t linkerThreads;      /* threads resolving objects in the linker,
+                                  * see Note [Parallel object resolution] */
+    uint32_t finalizerThreads;   /* threads running C finalizers, 0 ==> one
+                                  * per capability, see
+                                  * Note [Finalizer threads] */
     IO_MANAGER ioManager;        /* The I/O manager to use.  */
     uint32_t numIoWorkerThreads; /* Number of I/O worker threads to use.  */
 } MISC_FLAGS;
@@ -53,6 +53,12 @@ StgThreadID rts_getThreadId                  (StgPtr tso);
 void        rts_enableThreadAllocationLimit  (StgPtr tso);
 void        rts_disableThreadAllocationLimit (StgPtr tso);
 
+// Bytes allocated and CPU time (in nanoseconds) used by a thread, if
+// +RTS --thread-accounting is enabled; returns false otherwise.
+StgBool     rts_getThreadAccounting          (StgPtr tso,
+                                              StgWord64 *alloc_bytes,
+                                              StgWord64 *cpu_ns);
+
 #if !defined(mingw32_HOST_OS)
 pid_t  forkProcess     (HsStablePtr *entry);
 #else
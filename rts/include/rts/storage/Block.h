@@ -173,6 +173,8 @@ typedef struct bdescr_ {
  * onto nonmoving_large_objects. The mark phase ignores objects which aren't
  * so-flagged */
 #define BF_NONMOVING_SWEEPING 2048
+/* Block of a Compact mapped from a file (see CompactFile.c) */
+#define BF_COMPACT_MAPPED 4096
 /* Maximum flag value (do not define anything higher than this!) */
 #define BF_FLAG_MAX  (1 << 15)
 
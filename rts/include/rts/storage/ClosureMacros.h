@@ -292,6 +292,47 @@ EXTERN_INLINE StgOffset BLACKHOLE_sizeW ( void );
 EXTERN_INLINE StgOffset BLACKHOLE_sizeW ( void )
 { return sizeofW(StgInd); } // a BLACKHOLE is a kind of indirection
 
+/* -----------------------------------------------------------------------------
+   StgSmallMutArrPtrs macros
+
+   An StgSmallMutArrPtrs with at least SMALL_MUT_ARR_PTRS_CARD_THRESHOLD
+   elements has a card table directly after the array data, like an
+   StgMutArrPtrs (see below), where each byte covers
+   (1 << SMALL_MUT_ARR_PTRS_CARD_BITS) elements.  Smaller arrays have no
+   card table.  See Note [Card marking for small arrays] in rts/sm/Scav.c.
+   -------------------------------------------------------------------------- */
+
+// Does an array with this many elements have a card table?
+EXTERN_INLINE bool smallMutArrPtrsHasCards (W_ elems);
+EXTERN_INLINE bool smallMutArrPtrsHasCards (W_ elems)
+{
+    return elems >= SMALL_MUT_ARR_PTRS_CARD_THRESHOLD;
+}
+
+// The number of card bytes needed, zero if the array has no card table
+EXTERN_INLINE W_ smallMutArrPtrsCards (W_ elems);
+EXTERN_INLINE W_ smallMutArrPtrsCards (W_ elems)
+{
+    if (!smallMutArrPtrsHasCards(elems)) {
+        return 0;
+    }
+    return (W_)((elems + (1 << SMALL_MUT_ARR_PTRS_CARD_BITS) - 1)
+                           >> SMALL_MUT_ARR_PTRS_CARD_BITS);
+}
+
+// The number of words in the card table
+EXTERN_INLINE W_ smallMutArrPtrsCardTableSize (W_ elems);
+EXTERN_INLINE W_ smallMutArrPtrsCardTableSize (W_ elems)
+{
+    return ROUNDUP_BYTES_TO_WDS(smallMutArrPtrsCards(elems));
+}
+
+// The address of the card for a particular card number
+INLINE_HEADER StgWord8 *smallMutArrPtrsCard (StgSmallMutArrPtrs *a, W_ n)
+{
+    return ((StgWord8 *)&(a->payload[a->ptrs]) + n);
+}
+
 /* --------------------------------------------------------------------------
    Sizes of closures
    ------------------------------------------------------------------------*/
@@ -334,7 +375,8 @@ EXTERN_INLINE StgOffset mut_arr_ptrs_sizeW( StgMutArrPtrs* x )
 
 EXTERN_INLINE StgOffset small_mut_arr_ptrs_sizeW( StgSmallMutArrPtrs* x );
 EXTERN_INLINE StgOffset small_mut_arr_ptrs_sizeW( StgSmallMutArrPtrs* x )
-{ return sizeofW(StgSmallMutArrPtrs) + x->ptrs; }
+{ return sizeofW(StgSmallMutArrPtrs) + x->ptrs
+       + smallMutArrPtrsCardTableSize(x->ptrs); }
 
 EXTERN_INLINE StgWord stack_sizeW ( StgStack *stack );
 EXTERN_INLINE StgWord stack_sizeW ( StgStack *stack )
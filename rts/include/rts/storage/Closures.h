@@ -484,7 +484,7 @@ typedef struct StgCompactNFData_ {
     StgCompactNFDataBlock *last;
       // the last block of the chain (to know where to append new
       // blocks for resize)
-    struct hashtable *hash;
+    struct compacthash *hash;
       // the hash table for the current compaction, or NULL if
       // there's no (sharing-preserved) compaction in progress.
     StgClosure *result;
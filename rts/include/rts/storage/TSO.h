@@ -164,6 +164,18 @@ typedef struct StgTSO_ {
      */
     StgInt64  alloc_limit;     /* in bytes */
 
+    /*
+     * Per-thread accounting, maintained by the scheduler only when
+     * +RTS --thread-accounting is given: the total number of bytes
+     * allocated by this thread, and the CPU time it has spent running
+     * Haskell code.  See Note [Per-thread accounting] in Threads.c.
+     *
+     * Use only PK_Word64/ASSIGN_Word64 and PK_Int64/ASSIGN_Int64 to
+     * access these, for the same reason as alloc_limit.
+     */
+    StgWord64 alloc_bytes;
+    StgInt64  cpu_time;        /* in nanoseconds */
+
     /*
      * sum of the sizes of all stack chunks (in words), used to decide
      * whether to throw the StackOverflow exception when the stack
@@ -643,7 +643,7 @@ static SectionKind getSectionKind_ELF( Elf_Shdr *hdr, int *is_bss )
 #if !defined(NEED_PLT)
 
 static void *
-mapObjectFileSection (int fd, Elf_Word offset, Elf_Word size,
+mapObjectFileSection (int fd, StgWord offset, StgWord size,
                       void **mapped_start, StgWord *mapped_size,
                       StgWord *mapped_offset)
 {
@@ -811,9 +811,21 @@ ocGetNames_ELF ( ObjectCode* oc )
               if (start == NULL) goto fail;
               memcpy(start, oc->image + offset, size);
               alloc = SECTION_M32;
+          } else if (align > 1 && oc->imageFileOffset % align != 0) {
+              // The object is a member of an archive that doesn't sit at
+              // the alignment the section needs (see Note [Mapping archive
+              // members] in LoadArchive.c), so mapping the section from the
+              // file would misalign it: copy it instead.
+              start = mmapAnonForLinker(size);
+              if (start == NULL) goto fail;
+              memcpy(start, oc->image + offset, size);
+              alloc = SECTION_MMAP;
+              mapped_start = start;
+              mapped_size = roundUpToPage(size);
+              mapped_offset = 0;
           } else {
-              start = mapObjectFileSection(fd, offset, size,
-                                           &mapped_start, &mapped_size,
+              start = mapObjectFileSection(fd, oc->imageFileOffset + offset,
+                                           size, &mapped_start, &mapped_size,
                                            &mapped_offset);
               if (start == NULL) goto fail;
               alloc = SECTION_MMAP;
@@ -1978,6 +1990,96 @@ ocResolve_ELF ( ObjectCode* oc )
     return ocMprotect_Elf(oc);
 }
 
+/* Mark the symbols of the symbol table with section index `symtab` that a
+   relocation table refers to. */
+static void
+markRelocationSymbols ( ObjectCode *oc, Elf_Word symtab, bool **referenced,
+                        Elf_Word info )
+{
+    Elf_Word idx = ELF_R_SYM(info);
+    if (idx == 0) return;
+
+    int n = 0;
+    for (ElfSymbolTable *symTab = oc->info->symbolTables;
+         symTab != NULL; symTab = symTab->next, n++) {
+        if (symTab->index == symtab) {
+            if (idx < symTab->n_symbols) {
+                referenced[n][idx] = true;
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * Look up every global symbol that resolving `oc` will look up, without
+ * resolving it, so that any object defining one of them is loaded and
+ * marked as needed first. See Note [Parallel object resolution] in Linker.c.
+ */
+void
+ocLookupDependencies_ELF ( ObjectCode* oc )
+{
+    int n_tables = 0;
+    for (ElfSymbolTable *symTab = oc->info->symbolTables;
+         symTab != NULL; symTab = symTab->next) {
+        n_tables++;
+    }
+    if (n_tables == 0) return;
+
+    // Many relocations share a symbol: first find out which symbols are
+    // referred to, then look each of them up once.
+    bool **referenced = stgMallocBytes(n_tables * sizeof(bool *),
+                                       "ocLookupDependencies_ELF");
+    int n = 0;
+    for (ElfSymbolTable *symTab = oc->info->symbolTables;
+         symTab != NULL; symTab = symTab->next, n++) {
+        referenced[n] = stgCallocBytes(symTab->n_symbols + 1, sizeof(bool),
+                                       "ocLookupDependencies_ELF");
+    }
+
+    // like do_Elf_Rel(a)_relocations, skip relocations of sections we
+    // don't load
+    for (ElfRelocationTable *relTab = oc->info->relTable;
+         relTab != NULL; relTab = relTab->next) {
+        if (oc->sections[relTab->targetSectionIndex].kind
+              == SECTIONKIND_OTHER) continue;
+        for (size_t i = 0; i < relTab->n_relocations; i++) {
+            markRelocationSymbols(oc, relTab->sectionHeader->sh_link,
+                                  referenced, relTab->relocations[i].r_info);
+        }
+    }
+    for (ElfRelocationATable *relaTab = oc->info->relaTable;
+         relaTab != NULL; relaTab = relaTab->next) {
+        if (oc->sections[relaTab->targetSectionIndex].kind
+              == SECTIONKIND_OTHER) continue;
+        for (size_t i = 0; i < relaTab->n_relocations; i++) {
+            markRelocationSymbols(oc, relaTab->sectionHeader->sh_link,
+                                  referenced, relaTab->relocations[i].r_info);
+        }
+    }
+
+    n = 0;
+    for (ElfSymbolTable *symTab = oc->info->symbolTables;
+         symTab != NULL; symTab = symTab->next, n++) {
+        for (size_t i = 0; i < symTab->n_symbols; i++) {
+            ElfSymbol *symbol = &symTab->symbols[i];
+#if defined(NEED_GOT)
+            // fillGot looks these up too
+            if (needGotSlot(symbol->elf_sym)) {
+                referenced[n][i] = true;
+            }
+#endif
+            if (referenced[n][i]
+                && ELF_ST_BIND(symbol->elf_sym->st_info) != STB_LOCAL
+                && symbol->name != NULL && symbol->name[0] != '\0') {
+                lookupDependentSymbol(symbol->name, oc);
+            }
+        }
+        stgFree(referenced[n]);
+    }
+    stgFree(referenced);
+}
+
 int ocRunInit_ELF( ObjectCode *oc )
 {
    Elf_Word i;
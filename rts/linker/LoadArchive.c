@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stddef.h>
+#include <limits.h>
 #include <ctype.h>
 #include <fs_rts.h>
 
@@ -32,6 +33,97 @@
 
 #define DEBUG_LOG(...) IF_DEBUG(linker, debugBelch("loadArchive: " __VA_ARGS__))
 
+/* Note [Lazy archive loading]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   Linking against a big archive (say, the libHS*.a of a large package) used
+   to mean reading every object file in it, and running ocVerify and
+   ocGetNames on each of them, even if only a handful of them were ever
+   needed. For most archives we can do much better: `ar` puts a symbol index
+   at the start of the archive that maps every global symbol to the member
+   defining it, in one of two formats,
+
+     * the GNU/SysV index, member "/" (or "/SYM64/" with 64-bit offsets):
+       a big-endian count N, N big-endian member header offsets, then N
+       NUL-terminated symbol names;
+
+     * the BSD index, member "__.SYMDEF" or "__.SYMDEF SORTED" (or
+       "__.SYMDEF_64"): the size in bytes of an array of
+       {name offset, member header offset} pairs, the pairs, the size of
+       the string table and the string table, all in host byte order.
+
+   loadArchive_ therefore only records where each object member lives (an
+   ArchiveMember) and skips over its contents. Once the whole archive has
+   been scanned, every symbol of the index gets a placeholder RtsSymbolInfo
+   in symhash whose `member` field points at the ArchiveMember defining it
+   (addLazySymbol). The archive stays registered in `lazy_archives`.
+
+   When lookupDependentSymbol finds a placeholder it calls loadLazySymbol,
+   which reads the member from disk and loads it exactly as the eager code
+   would have (loadArchiveObject). ocGetNames then replaces the placeholders
+   of all of the member's symbols by their real definitions, see
+   ghciInsertSymbolTable. If the index lied and the member doesn't define
+   the symbol after all, the placeholder is dropped and the lookup carries
+   on as if the symbol had never been there.
+
+   A few details:
+
+     * Placeholders never win against a real definition: a symbol already in
+       symhash doesn't get a placeholder, and any later definition (except a
+       weak undefined reference) replaces one. This matches the eager
+       behaviour, where symbols of archive members lose to earlier objects.
+
+     * Loading a member may load further members recursively (the MachO
+       ocGetNames looks up weak symbols while it runs), and may replace or
+       free the very placeholder we started from; loadLazySymbol hence looks
+       the symbol up again afterwards.
+
+     * Thin archives (whose members are separate files anyway), archives
+       without a usable index, and all archives on Windows (where import
+       libraries need the eager treatment, see Note [MSVC import files (ext
+       .lib)]) are still loaded eagerly.
+
+     * unloadObj on the archive's path also forgets the placeholders of
+       members that were never loaded (unloadLazyArchive).
+*/
+
+typedef struct _LazyArchive LazyArchive;
+
+/* An object file in an archive that is only loaded when one of its symbols
+   is first needed. See Note [Lazy archive loading]. */
+struct _ArchiveMember {
+    LazyArchive *archive;
+    long header_offset;     /* from the start of the archive, as in the index */
+    long offset;            /* file offset of the member's contents */
+    int size;
+    char *fileName;
+    bool loaded;
+};
+
+struct _LazyArchive {
+    pathchar *path;
+    ArchiveMember *members;   /* sorted by header_offset */
+    int n_members;
+    int max_members;
+    char *index;              /* contents of the symbol index, which own the
+                                 keys of the placeholders in symhash */
+    int index_size;
+    SymbolName **symbols;     /* symbols that got a placeholder */
+    int n_symbols;
+    struct _LazyArchive *next;
+};
+
+typedef enum {
+    NO_SYMBOL_INDEX,
+    GNU_SYMBOL_INDEX,        /* "/" */
+    GNU_SYMBOL_INDEX_64,     /* "/SYM64/" */
+    BSD_SYMBOL_INDEX,        /* "__.SYMDEF", "__.SYMDEF SORTED" */
+    BSD_SYMBOL_INDEX_64,     /* "__.SYMDEF_64" */
+} SymbolIndexKind;
+
+/* Archives with members that haven't all been loaded yet.
+   Protected by linker_mutex. */
+static LazyArchive *lazy_archives = NULL;
+
 #if defined(darwin_HOST_OS) || defined(ios_HOST_OS)
 /* Read 4 bytes and convert to host byte order */
 static uint32_t read4Bytes(const char buf[static 4])
@@ -240,9 +332,429 @@ lookupGNUArchiveIndex(int gnuFileIndexSize, char **fileName_,
     return true;
 }
 
-static HsInt loadArchive_ (pathchar *path)
+#if defined(OBJFORMAT_ELF) && RTS_LINKER_USE_MMAP
+/* Note [Mapping archive members]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   A plain object file is mapped into memory by preloadObjectFile, and
+   ocGetNames_ELF then maps its larger sections straight from the file too,
+   so only the small sections (which go to the m32 allocator) and the ones
+   needing writable stub space get copied. Archive members used to be read
+   into the heap instead, which meant ocGetNames_ELF had to copy every
+   section, and the symbol and string tables stayed in the heap copy for as
+   long as the object was loaded.
+
+   So we map the member privately from the archive. The mapping has to
+   start at a page boundary, which the member generally isn't at: image
+   then points into the first page of the mapping, and
+   ObjectCode.imageFileOffset records the member's offset in the archive so
+   that ocGetNames_ELF can map sections from the right place and
+   freePreloadObjectFile can unmap the whole thing.
+
+   `ar` only aligns members to 2 bytes, so:
+
+     * we only map members whose offset is word-aligned, as the linker
+       reads the ELF headers and symbol tables in place, and read the others
+       into the heap as before;
+
+     * a section whose alignment the member's offset doesn't respect is
+       copied rather than mapped from the file by ocGetNames_ELF;
+
+     * when the sections are laid out inside the image itself
+       (USE_CONTIGUOUS_MMAP or -xp) they would inherit the member's
+       misalignment, so we always read the member into the heap then.
+*/
+static char *mapArchiveMember(FILE *f, long offset, int memberSize)
+{
+    size_t slop = offset % getPageSize();
+    char *p = mmapForLinker(memberSize + slop, PROT_READ | PROT_WRITE, 0,
+                            fileno(f), offset - slop);
+    return p == NULL ? NULL : p + slop;
+}
+#endif
+
+/* Load the object file `fileName` of the archive `path`, whose contents of
+   memberSize bytes start at the current position of `f` (or, in a thin
+   archive, live in a file of their own). */
+static HsInt loadArchiveObject(pathchar *path, FILE *f, int isThin,
+                               char *fileName, size_t thisFileNameSize,
+                               int memberSize)
 {
     char *image = NULL;
+    pathchar *archiveMemberName;
+    int misalignment = 0;
+    bool mapped = false;
+    StgWord fileOffset = 0;
+    int n;
+
+    DEBUG_LOG("Member is an object file...loading...\n");
+
+#if defined(OBJFORMAT_ELF) && RTS_LINKER_USE_MMAP
+    /* See Note [Mapping archive members] */
+    long offset = ftell(f);
+    if (!isThin && !USE_CONTIGUOUS_MMAP
+        && !RtsFlags.MiscFlags.linkerAlwaysPic
+        && offset >= 0 && offset <= INT_MAX
+        && offset % sizeof(StgWord) == 0) {
+        image = mapArchiveMember(f, offset, memberSize);
+        if (image != NULL) {
+            if (fseek(f, memberSize, SEEK_CUR) != 0) {
+                errorBelch("loadArchive: error whilst seeking by %d in `%"
+                           PATH_FMT "'", memberSize, path);
+                munmapForLinker(image - offset % getPageSize(),
+                                memberSize + offset % getPageSize(),
+                                "loadArchiveObject");
+                return 0;
+            }
+            mapped = true;
+            fileOffset = offset;
+        }
+    }
+    if (!mapped)
+#endif
+    {
+#if defined(darwin_HOST_OS) || defined(ios_HOST_OS)
+        if (RTS_LINKER_USE_MMAP)
+            image = mmapAnonForLinker(memberSize);
+        else {
+            /* See loadObj() */
+            misalignment = machoGetMisalignment(f);
+            image = stgMallocBytes(memberSize + misalignment,
+                                    "loadArchive(image)");
+            image += misalignment;
+        }
+
+#else // not darwin
+        image = stgMallocBytes(memberSize, "loadArchive(image)");
+#endif
+        if (isThin) {
+            if (!readThinArchiveMember(0, memberSize, path,
+                    fileName, image)) {
+                return 0;
+            }
+        }
+        else
+        {
+            n = fread ( image, 1, memberSize, f );
+            if (n != memberSize) {
+                errorBelch("loadArchive: error whilst reading `%" PATH_FMT "'",
+                           path);
+                return 0;
+            }
+        }
+    }
+
+    int size = pathlen(path) + thisFileNameSize + 3;
+    archiveMemberName = stgMallocBytes(size * pathsize,
+                                       "loadArchive(file)");
+    pathprintf(archiveMemberName, size, WSTR("%" PATH_FMT "(%.*s)"),
+               path, (int)thisFileNameSize, fileName);
+
+    ObjectCode *oc = mkOc(STATIC_OBJECT, path, image, memberSize, mapped,
+                          archiveMemberName, misalignment);
+    oc->imageFileOffset = fileOffset;
+#if defined(OBJFORMAT_MACHO)
+    ocInit_MachO( oc );
+#endif
+#if defined(OBJFORMAT_ELF)
+    ocInit_ELF( oc );
+#endif
+
+    stgFree(archiveMemberName);
+
+    if (0 == loadOc(oc)) {
+        return 0;
+    }
+    insertOCSectionIndices(oc); // also adds the object to `objects` list
+    oc->next_loaded_object = loaded_objects;
+    loaded_objects = oc;
+    return 1;
+}
+
+static void freeLazyArchive(LazyArchive *archive)
+{
+    for (int i = 0; i < archive->n_members; i++) {
+        stgFree(archive->members[i].fileName);
+    }
+    stgFree(archive->members);
+    if (archive->index != NULL) {
+        stgFree(archive->index);
+    }
+    if (archive->symbols != NULL) {
+        stgFree(archive->symbols);
+    }
+    stgFree(archive->path);
+    stgFree(archive);
+}
+
+static LazyArchive *findLazyArchive(pathchar *path)
+{
+    for (LazyArchive *a = lazy_archives; a != NULL; a = a->next) {
+        if (0 == pathcmp(a->path, path)) {
+            return a;
+        }
+    }
+    return NULL;
+}
+
+static void addArchiveMember(LazyArchive *archive, long header_offset,
+                             long offset, int size, char *fileName,
+                             size_t fileNameSize)
+{
+    if (archive->n_members == archive->max_members) {
+        archive->max_members = archive->max_members * 2 + 16;
+        archive->members =
+            stgReallocBytes(archive->members,
+                            archive->max_members * sizeof(ArchiveMember),
+                            "addArchiveMember");
+    }
+    ArchiveMember *member = &archive->members[archive->n_members++];
+    member->archive = archive;
+    member->header_offset = header_offset;
+    member->offset = offset;
+    member->size = size;
+    member->fileName = stgMallocBytes(fileNameSize + 1, "addArchiveMember");
+    memcpy(member->fileName, fileName, fileNameSize);
+    member->fileName[fileNameSize] = '\0';
+    member->loaded = false;
+}
+
+static ArchiveMember *findArchiveMember(LazyArchive *archive,
+                                        uint64_t header_offset)
+{
+    int lo = 0, hi = archive->n_members;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        uint64_t o = (uint64_t)archive->members[mid].header_offset;
+        if (o == header_offset) {
+            return &archive->members[mid];
+        } else if (o < header_offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+/* Give `name` a placeholder pointing at `member`, unless it is defined
+   already. */
+static void addLazySymbol(LazyArchive *archive, SymbolName *name,
+                          ArchiveMember *member)
+{
+    if (lookupStrHashTable(symhash, name) != NULL) {
+        return;
+    }
+    RtsSymbolInfo *pinfo = stgMallocBytes(sizeof(RtsSymbolInfo),
+                                          "addLazySymbol");
+    pinfo->value = NULL;
+    pinfo->owner = NULL;
+    pinfo->strength = STRENGTH_NORMAL;
+    pinfo->member = member;
+    insertStrHashTable(symhash, name, pinfo);
+    archive->symbols[archive->n_symbols++] = name;
+}
+
+static uint64_t readIndexWord(const unsigned char *p, int width,
+                              bool big_endian)
+{
+    uint64_t w = 0;
+    for (int i = 0; i < width; i++) {
+        w = (w << 8) | p[big_endian ? i : width - 1 - i];
+    }
+    return w;
+}
+
+/* Parse the archive's symbol index. If `insert` is false only check that it
+   is well formed and that all the members it refers to exist, otherwise
+   add a placeholder for each of its symbols. */
+static bool readSymbolIndex(LazyArchive *archive, SymbolIndexKind kind,
+                            bool insert)
+{
+    unsigned char *index = (unsigned char *)archive->index;
+    uint64_t size = archive->index_size;
+
+    if (kind == GNU_SYMBOL_INDEX || kind == GNU_SYMBOL_INDEX_64) {
+        int width = kind == GNU_SYMBOL_INDEX ? 4 : 8;
+        if (size < (uint64_t)width) return false;
+        uint64_t n = readIndexWord(index, width, true);
+        if (n > (size - width) / width) return false;
+        uint64_t names = width + n * width;
+        if (insert) {
+            archive->symbols = stgMallocBytes((n + 1) * sizeof(SymbolName *),
+                                              "readSymbolIndex");
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t off = readIndexWord(index + width + i * width,
+                                         width, true);
+            ArchiveMember *member = findArchiveMember(archive, off);
+            // the index buffer is NUL-terminated, so this is a C string
+            if (member == NULL || names >= size) return false;
+            SymbolName *name = (SymbolName *)(index + names);
+            names += strlen(name) + 1;
+            if (insert) addLazySymbol(archive, name, member);
+        }
+    } else {
+        int width = kind == BSD_SYMBOL_INDEX ? 4 : 8;
+#if defined(WORDS_BIGENDIAN)
+        const bool big_endian = true;
+#else
+        const bool big_endian = false;
+#endif
+        if (size < (uint64_t)width) return false;
+        uint64_t ranlibs_size = readIndexWord(index, width, big_endian);
+        if (ranlibs_size > size - 2 * width) return false;
+        uint64_t strtab_size = readIndexWord(index + width + ranlibs_size,
+                                             width, big_endian);
+        uint64_t strtab = 2 * width + ranlibs_size;
+        if (strtab_size > size - strtab) return false;
+        uint64_t n = ranlibs_size / (2 * width);
+        if (insert) {
+            archive->symbols = stgMallocBytes((n + 1) * sizeof(SymbolName *),
+                                              "readSymbolIndex");
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            const unsigned char *ranlib = index + width + i * 2 * width;
+            uint64_t strx = readIndexWord(ranlib, width, big_endian);
+            uint64_t off = readIndexWord(ranlib + width, width, big_endian);
+            ArchiveMember *member = findArchiveMember(archive, off);
+            if (member == NULL || strx >= strtab_size) return false;
+            if (insert) {
+                addLazySymbol(archive,
+                              (SymbolName *)(index + strtab + strx), member);
+            }
+        }
+    }
+    return true;
+}
+
+/* Read and load a member of a lazy archive. */
+static void loadArchiveMember(ArchiveMember *member)
+{
+    pathchar *path = member->archive->path;
+    FILE *f;
+
+    DEBUG_LOG("loading member `%s' of `%" PATH_FMT "' on demand\n",
+              member->fileName, path);
+    f = pathopen(path, WSTR("rb"));
+    if (!f) {
+        errorBelch("loadArchive: can't read `%" PATH_FMT "'", path);
+        return;
+    }
+    if (fseek(f, member->offset, SEEK_SET) != 0) {
+        errorBelch("loadArchive: error whilst seeking to %ld in `%"
+                   PATH_FMT "'", member->offset, path);
+    } else if (!loadArchiveObject(path, f, 0, member->fileName,
+                                  strlen(member->fileName), member->size)) {
+        errorBelch("loadArchive: failed to load `%s' from `%" PATH_FMT "'",
+                   member->fileName, path);
+    }
+    fclose(f);
+}
+
+/* Load the member defining the lazy symbol `lbl`. Returns its real symbol
+   info, or NULL if the member didn't define it after all.
+   See Note [Lazy archive loading]. */
+RtsSymbolInfo *
+loadLazySymbol( SymbolName *lbl, RtsSymbolInfo *pinfo )
+{
+    while (pinfo != NULL && pinfo->member != NULL) {
+        ArchiveMember *member = pinfo->member;
+        if (member->loaded) {
+            // The index lied: forget about the symbol.
+            IF_DEBUG(linker,
+                     debugBelch("loadLazySymbol: `%s' not defined by `%s'\n",
+                                lbl, member->fileName));
+            removeStrHashTable(symhash, lbl, NULL);
+            stgFree(pinfo);
+            return NULL;
+        }
+        member->loaded = true;
+        loadArchiveMember(member);
+        // Loading may have replaced or freed pinfo
+        pinfo = lookupStrHashTable(symhash, lbl);
+    }
+    return pinfo;
+}
+
+/* Forget the archive `path` and the placeholders of its members that were
+   never loaded. Returns true if there was such an archive. */
+bool unloadLazyArchive( pathchar *path )
+{
+    LazyArchive *archive = findLazyArchive(path);
+    if (archive == NULL) {
+        return false;
+    }
+
+    LazyArchive **prev = &lazy_archives;
+    while (*prev != archive) {
+        prev = &(*prev)->next;
+    }
+    *prev = archive->next;
+
+    for (int i = 0; i < archive->n_symbols; i++) {
+        SymbolName *name = archive->symbols[i];
+        RtsSymbolInfo *pinfo = lookupStrHashTable(symhash, name);
+        if (pinfo != NULL && pinfo->member != NULL
+            && pinfo->member->archive == archive) {
+            removeStrHashTable(symhash, name, NULL);
+            stgFree(pinfo);
+        }
+    }
+    freeLazyArchive(archive);
+    return true;
+}
+
+void freeLazyArchives( void )
+{
+    while (lazy_archives != NULL) {
+        LazyArchive *next = lazy_archives->next;
+        freeLazyArchive(lazy_archives);
+        lazy_archives = next;
+    }
+}
+
+/* Called once the whole archive has been scanned: either register it as a
+   lazy archive, or, if it has no usable symbol index, load all of its
+   object members now. */
+static HsInt finishLazyArchive(LazyArchive *archive, SymbolIndexKind kind,
+                               FILE *f)
+{
+    if (archive->n_members == 0) {
+        freeLazyArchive(archive);
+        return 1;
+    }
+
+    if (kind != NO_SYMBOL_INDEX && readSymbolIndex(archive, kind, false)) {
+        DEBUG_LOG("deferring the loading of %d members of `%" PATH_FMT "'\n",
+                  archive->n_members, archive->path);
+        readSymbolIndex(archive, kind, true);
+        archive->next = lazy_archives;
+        lazy_archives = archive;
+        return 1;
+    }
+
+    DEBUG_LOG("no usable symbol index, loading all members\n");
+    HsInt r = 1;
+    for (int i = 0; i < archive->n_members; i++) {
+        ArchiveMember *member = &archive->members[i];
+        if (fseek(f, member->offset, SEEK_SET) != 0) {
+            errorBelch("loadArchive: error whilst seeking to %ld in `%"
+                       PATH_FMT "'", member->offset, archive->path);
+            r = 0;
+            break;
+        }
+        if (!loadArchiveObject(archive->path, f, 0, member->fileName,
+                               strlen(member->fileName), member->size)) {
+            r = 0;
+            break;
+        }
+    }
+    freeLazyArchive(archive);
+    return r;
+}
+
+static HsInt loadArchive_ (pathchar *path)
+{
     HsInt retcode = 0;
     int memberSize;
     FILE *f = NULL;
@@ -254,14 +766,17 @@ static HsInt loadArchive_ (pathchar *path)
     char tmp[20];
     char *gnuFileIndex;
     int gnuFileIndexSize;
-    int misalignment = 0;
+    long archiveStart, memberStart;
+    bool lazy;
+    LazyArchive *archive = NULL;
+    SymbolIndexKind indexKind = NO_SYMBOL_INDEX, thisIndexKind;
 
     DEBUG_LOG("start\n");
     DEBUG_LOG("Loading archive `%" PATH_FMT "'\n", path);
 
     /* Check that we haven't already loaded this archive.
        Ignore requests to load multiple times */
-    if (isAlreadyLoaded(path)) {
+    if (isAlreadyLoaded(path) || findLazyArchive(path) != NULL) {
         IF_DEBUG(linker,
                  debugBelch("ignoring repeated load of %" PATH_FMT "\n", path));
         return 1; /* success */
@@ -327,10 +842,23 @@ static HsInt loadArchive_ (pathchar *path)
         if (!success)
             goto fail;
     }
+    archiveStart = ftell(f) - 8;
+
+    /* See Note [Lazy archive loading] */
+#if defined(OBJFORMAT_PEi386)
+    lazy = false;
+#else
+    lazy = !isThin;
+#endif
+    if (lazy) {
+        archive = stgCallocBytes(1, sizeof(LazyArchive), "loadArchive");
+        archive->path = pathdup(path);
+    }
     DEBUG_LOG("loading archive contents\n");
 
     while (1) {
-        DEBUG_LOG("reading at %ld\n", ftell(f));
+        memberStart = ftell(f);
+        DEBUG_LOG("reading at %ld\n", memberStart);
         n = fread ( fileName, 1, 16, f );
         if (n != 16) {
             if (feof(f)) {
@@ -378,6 +906,7 @@ static HsInt loadArchive_ (pathchar *path)
                  path, ftell(f), tmp[0], tmp[1]);
 
         isGnuIndex = 0;
+        thisIndexKind = NO_SYMBOL_INDEX;
         /* Check for BSD-variant large filenames */
         if (0 == strncmp(fileName, "#1/", 3)) {
             size_t n = 0;
@@ -419,6 +948,17 @@ static HsInt loadArchive_ (pathchar *path)
             thisFileNameSize = 0;
             isGnuIndex = 1;
         }
+        /* Check for the GNU symbol index */
+        else if (0 == strncmp(fileName, "/               ", 16)) {
+            fileName[0] = '\0';
+            thisFileNameSize = 0;
+            thisIndexKind = GNU_SYMBOL_INDEX;
+        }
+        else if (0 == strncmp(fileName, "/SYM64/         ", 16)) {
+            fileName[0] = '\0';
+            thisFileNameSize = 0;
+            thisIndexKind = GNU_SYMBOL_INDEX_64;
+        }
         /* Check for a file in the GNU file index */
         else if (fileName[0] == '/') {
             if (!lookupGNUArchiveIndex(gnuFileIndexSize, &fileName,
@@ -458,6 +998,13 @@ static HsInt loadArchive_ (pathchar *path)
 
         DEBUG_LOG("Found member file `%s'\n", fileName);
 
+        /* Check for the BSD symbol index */
+        if (0 == strncmp(fileName, "__.SYMDEF_64", 12)) {
+            thisIndexKind = BSD_SYMBOL_INDEX_64;
+        } else if (0 == strncmp(fileName, "__.SYMDEF", 9)) {
+            thisIndexKind = BSD_SYMBOL_INDEX;
+        }
+
         /* TODO: Stop relying on file extensions to determine input formats.
                  Instead try to match file headers. See #13103.  */
         isObject = (thisFileNameSize >= 2 && strncmp(fileName + thisFileNameSize - 2, ".o"  , 2) == 0)
@@ -482,65 +1029,33 @@ static HsInt loadArchive_ (pathchar *path)
         DEBUG_LOG("\tthisFileNameSize = %d\n", (int)thisFileNameSize);
         DEBUG_LOG("\tisObject = %d\n", isObject);
 
-        if (isObject) {
-            pathchar *archiveMemberName;
-
-            DEBUG_LOG("Member is an object file...loading...\n");
-
-#if defined(darwin_HOST_OS) || defined(ios_HOST_OS)
-            if (RTS_LINKER_USE_MMAP)
-                image = mmapAnonForLinker(memberSize);
-            else {
-                /* See loadObj() */
-                misalignment = machoGetMisalignment(f);
-                image = stgMallocBytes(memberSize + misalignment,
-                                        "loadArchive(image)");
-                image += misalignment;
-            }
-
-#else // not darwin
-            image = stgMallocBytes(memberSize, "loadArchive(image)");
-#endif
-            if (isThin) {
-                if (!readThinArchiveMember(n, memberSize, path,
-                        fileName, image)) {
-                    goto fail;
-                }
-            }
-            else
-            {
-                n = fread ( image, 1, memberSize, f );
-                if (n != memberSize) {
-                    FAIL("error whilst reading `%" PATH_FMT "'", path);
-                }
+        if (isObject && lazy) {
+            DEBUG_LOG("Member is an object file...deferring...\n");
+            addArchiveMember(archive, memberStart - archiveStart, ftell(f),
+                             memberSize, fileName, thisFileNameSize);
+            n = fseek(f, memberSize, SEEK_CUR);
+            if (n != 0)
+                FAIL("error whilst seeking by %d in `%" PATH_FMT "'",
+                     memberSize, path);
+        }
+        else if (isObject) {
+            if (!loadArchiveObject(path, f, isThin, fileName,
+                                   thisFileNameSize, memberSize)) {
+                goto fail;
             }
-
-            int size = pathlen(path) + thisFileNameSize + 3;
-            archiveMemberName = stgMallocBytes(size * pathsize,
-                                               "loadArchive(file)");
-            pathprintf(archiveMemberName, size, WSTR("%" PATH_FMT "(%.*s)"),
-                       path, (int)thisFileNameSize, fileName);
-
-            ObjectCode *oc = mkOc(STATIC_OBJECT, path, image, memberSize, false, archiveMemberName,
-                                  misalignment);
-#if defined(OBJFORMAT_MACHO)
-            ocInit_MachO( oc );
-#endif
-#if defined(OBJFORMAT_ELF)
-            ocInit_ELF( oc );
-#endif
-
-            stgFree(archiveMemberName);
-
-            if (0 == loadOc(oc)) {
-                stgFree(fileName);
-                fclose(f);
-                return 0;
-            } else {
-                insertOCSectionIndices(oc); // also adds the object to `objects` list
-                oc->next_loaded_object = loaded_objects;
-                loaded_objects = oc;
+        }
+        else if (thisIndexKind != NO_SYMBOL_INDEX && lazy
+                 && indexKind == NO_SYMBOL_INDEX) {
+            DEBUG_LOG("Found symbol index\n");
+            archive->index = stgMallocBytes(memberSize + 1,
+                                            "loadArchive(index)");
+            n = fread ( archive->index, 1, memberSize, f );
+            if (n != memberSize) {
+                FAIL("error whilst reading `%" PATH_FMT "'", path);
             }
+            archive->index[memberSize] = '\0';
+            archive->index_size = memberSize;
+            indexKind = thisIndexKind;
         }
         else if (isGnuIndex) {
             if (gnuFileIndex != NULL) {
@@ -604,8 +1119,16 @@ while reading filename from `%" PATH_FMT "'", path);
         }
         DEBUG_LOG("reached end of archive loading while loop\n");
     }
+    if (lazy) {
+        HsInt r = finishLazyArchive(archive, indexKind, f);
+        archive = NULL;
+        if (!r)
+            goto fail;
+    }
     retcode = 1;
 fail:
+    if (archive != NULL)
+        freeLazyArchive(archive);
     if (f != NULL)
         fclose(f);
 
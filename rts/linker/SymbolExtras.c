@@ -85,10 +85,13 @@ int ocAllocateExtras(ObjectCode* oc, int count, int first, int bssSize)
       if (new) {
           memcpy(new, oc->image, oc->fileSize);
           if (oc->imageMapped) {
-              munmapForLinker(oc->image, n, "ocAllocateExtras");
+              size_t slop = oc->imageFileOffset % getPageSize();
+              munmapForLinker(oc->image - slop, oc->fileSize + slop,
+                              "ocAllocateExtras");
           }
           oc->image = new;
           oc->imageMapped = true;
+          oc->imageFileOffset = 0;
           oc->fileSize = allocated_size;
           oc->symbol_extras = (SymbolExtra *) (oc->image + n + bssSize);
           oc->bssBegin = oc->image + n;
@@ -455,6 +455,191 @@ StgWord64 getPhysicalMemorySize (void)
     return physMemSize;
 }
 
+#if defined(linux_HOST_OS)
+
+/* The directory of the cgroup (v2) of the process, or "" if it isn't in
+ * one we can find, e.g. because the system uses cgroup v1.  The line of
+ * /proc/self/cgroup for the unified hierarchy reads "0::<path>", where the
+ * path is relative to the mount point of cgroup2, which we assume is
+ * /sys/fs/cgroup, as it is on all current distributions and container
+ * runtimes. */
+#define CGROUP_MOUNT "/sys/fs/cgroup"
+static char cgroup_dir[256];
+static bool cgroup_dir_known = false;
+
+/* Read a small file into buf, as a NUL-terminated string.  We use open()
+ * and read() rather than stdio, which allocates, since this is called by
+ * the ticker. */
+static bool readSmallFile (const char *path, char *buf, size_t len)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    ssize_t n;
+
+    if (fd == -1) {
+        return false;
+    }
+    n = read(fd, buf, len - 1);
+    close(fd);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    return true;
+}
+
+/* Find the directory of the cgroup v2 of the process under mount, given
+ * the contents of /proc/self/cgroup, and put it in dir, without a trailing
+ * slash.  Returns false if there is none, or it doesn't fit in len bytes.
+ * Not static, so that it can be tested (testsuite/tests/rts/testcgroup.c). */
+bool parseCGroupFile (const char *proc_cgroup, const char *mount,
+                      char *dir, size_t len)
+{
+    const char *line, *end;
+    size_t mount_len = strlen(mount);
+
+    for (line = proc_cgroup; *line != '\0'; line = end + 1) {
+        end = strchr(line, '\n');
+        if (end == NULL) {
+            end = line + strlen(line);
+        }
+        if (strncmp(line, "0::/", 4) == 0) {
+            size_t n = end - (line + 3);
+            // "0::/" in the root cgroup, or in a cgroup namespace
+            while (n > 0 && line[3 + n - 1] == '/') {
+                n--;
+            }
+            if (mount_len + n >= len) {
+                return false;
+            }
+            memcpy(dir, mount, mount_len);
+            memcpy(dir + mount_len, line + 3, n);
+            dir[mount_len + n] = '\0';
+            return true;
+        }
+        if (*end == '\0') {
+            break;
+        }
+    }
+    return false;
+}
+
+static const char *findCGroupDir (void)
+{
+    char buf[1024];
+
+    if (cgroup_dir_known) {
+        return cgroup_dir;
+    }
+    cgroup_dir_known = true;
+    if (!readSmallFile("/proc/self/cgroup", buf, sizeof(buf))
+        || !parseCGroupFile(buf, CGROUP_MOUNT, cgroup_dir, sizeof(cgroup_dir))) {
+        cgroup_dir[0] = '\0';
+    }
+    return cgroup_dir;
+}
+
+/* Read a cgroup interface file holding a number of bytes, or "max".
+ * Returns 0 for "max". */
+static bool readCGroupBytes (const char *dir, const char *file,
+                             StgWord64 *bytes)
+{
+    char path[sizeof(cgroup_dir) + 32];
+    char buf[32];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    if (!readSmallFile(path, buf, sizeof(buf))) {
+        return false;
+    }
+    if (strncmp(buf, "max", 3) == 0) {
+        *bytes = 0;
+    } else {
+        *bytes = strtoull(buf, NULL, 10);
+    }
+    return true;
+}
+
+/* The smallest memory.max and memory.high limits of the cgroup in dir and
+ * of its ancestors, up to and including mount: in a cgroup namespace, the
+ * cgroup at the mount point is the container's own, and is limited.  The
+ * root cgroup has no limit files, which is fine.  Not static, so that it
+ * can be tested (testsuite/tests/rts/testcgroup.c). */
+void cgroupMemoryLimits (const char *mount, const char *cgroup,
+                         StgWord64 *max, StgWord64 *high)
+{
+    char dir[sizeof(cgroup_dir)];
+    size_t mount_len = strlen(mount);
+    StgWord64 m, h;
+    char *slash;
+
+    strncpy(dir, cgroup, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = '\0';
+    *max = 0;
+    *high = 0;
+    for (;;) {
+        if (readCGroupBytes(dir, "memory.max", &m) && m != 0) {
+            *max = *max == 0 ? m : stg_min(*max, m);
+        }
+        if (readCGroupBytes(dir, "memory.high", &h) && h != 0) {
+            *high = *high == 0 ? h : stg_min(*high, h);
+        }
+        if (strlen(dir) <= mount_len
+            || (slash = strrchr(dir, '/')) == NULL
+            || (size_t)(slash - dir) < mount_len) {
+            break;
+        }
+        *slash = '\0';
+    }
+}
+
+#endif /* linux_HOST_OS */
+
+/* The memory.max and memory.high limits of the cgroup of the process, in
+ * bytes, 0 if unlimited.  The limits of the ancestors of the cgroup apply
+ * too, so we take the smallest limits on the path to the root.  Returns
+ * false if the process isn't in a cgroup v2 hierarchy. */
+bool osCGroupMemoryLimits (StgWord64 *max, StgWord64 *high)
+{
+#if defined(linux_HOST_OS)
+    if (findCGroupDir()[0] == '\0') {
+        return false;
+    }
+    cgroupMemoryLimits(CGROUP_MOUNT, cgroup_dir, max, high);
+    return true;
+#else
+    (void)max;
+    (void)high;
+    return false;
+#endif
+}
+
+/* The total time, in microseconds, for which some process of the cgroup of
+ * the process was stalled waiting for memory, from the "some" line of
+ * memory.pressure (see the kernel's PSI documentation).  Returns false if
+ * it isn't available. */
+bool osCGroupMemoryStall (StgWord64 *stall_us)
+{
+#if defined(linux_HOST_OS)
+    char path[sizeof(cgroup_dir) + 32];
+    char buf[256];
+    const char *total;
+
+    if (findCGroupDir()[0] == '\0') {
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s/memory.pressure", cgroup_dir);
+    if (!readSmallFile(path, buf, sizeof(buf))
+        || strncmp(buf, "some ", 5) != 0
+        || (total = strstr(buf, "total=")) == NULL) {
+        return false;
+    }
+    *stall_us = strtoull(total + 6, NULL, 10);
+    return true;
+#else
+    (void)stall_us;
+    return false;
+#endif
+}
+
 void setExecutable (void *p, W_ len, bool exec)
 {
     StgWord pageSize = getPageSize();
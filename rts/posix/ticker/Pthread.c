@@ -39,6 +39,7 @@
 #include "Rts.h"
 
 #include "Ticker.h"
+#include "Timer.h"
 #include "RtsUtils.h"
 #include "Proftimer.h"
 #include "Schedule.h"
@@ -99,30 +100,89 @@ static Condition start_cond;
 static Mutex mutex;
 static OSThreadId thread;
 
-static void *itimer_thread_func(void *_handle_tick)
-{
-    TickProc handle_tick = _handle_tick;
-    uint64_t nticks;
-    int timerfd = -1;
+static int timerfd = -1;
 
-#if defined(USE_TIMERFD_FOR_ITIMER) && USE_TIMERFD_FOR_ITIMER
+#if USE_TIMERFD_FOR_ITIMER
+// Whether the timerfd fires at every tick, rather than once after
+// sleep_ticks ticks, counting from sleep_start.  Writers to these must
+// hold the mutex above.
+// See Note [Tickless idle] in Timer.c
+static bool timerfd_periodic = true;
+static uint32_t sleep_ticks = 0;
+static StgWord64 sleep_start = 0;
+
+// Set by the ticker thread when it considers not ticking for a while,
+// and cleared by wakeTicker.
+static bool ticker_sleeping = false;
+
+// Make the timerfd fire after the given number of ticks, and then at
+// every tick if that is one.  Must be called with the mutex held.
+static void armTimerfd(uint32_t ticks)
+{
     struct itimerspec it;
-    it.it_value.tv_sec  = TimeToSeconds(itimer_interval);
-    it.it_value.tv_nsec = TimeToNS(itimer_interval) % 1000000000;
-    it.it_interval = it.it_value;
+    Time t = itimer_interval * ticks;
 
-    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
-    if (timerfd == -1) {
-        barf("timerfd_create: %s", strerror(errno));
-    }
-    if (!TFD_CLOEXEC) {
-        fcntl(timerfd, F_SETFD, FD_CLOEXEC);
+    it.it_value.tv_sec  = TimeToSeconds(t);
+    it.it_value.tv_nsec = TimeToNS(t) % 1000000000;
+    if (ticks == 1) {
+        it.it_interval = it.it_value;
+    } else {
+        it.it_interval.tv_sec = 0;
+        it.it_interval.tv_nsec = 0;
     }
     if (timerfd_settime(timerfd, 0, &it, NULL)) {
         barf("timerfd_settime: %s", strerror(errno));
     }
+    timerfd_periodic = ticks == 1;
+}
+
+// After handling a tick, arm the timerfd for the next tick that will have
+// something to do.
+static void planNextTick(void)
+{
+    uint32_t ticks;
+
+    SEQ_CST_STORE(&ticker_sleeping, true);
+    ticks = ticksToNextTimerEvent();
+
+    OS_ACQUIRE_LOCK(&mutex);
+    if (ticks > 1 && SEQ_CST_LOAD(&ticker_sleeping)) {
+        armTimerfd(ticks);
+        sleep_ticks = ticks;
+        sleep_start = getMonotonicNSec();
+    } else {
+        SEQ_CST_STORE(&ticker_sleeping, false);
+        if (!timerfd_periodic) {
+            armTimerfd(1);
+        }
+    }
+    OS_RELEASE_LOCK(&mutex);
+}
+
+// The number of ticks that have passed since the ticker last handled a
+// tick: one, unless it was sleeping.
+static uint32_t ticksElapsed(void)
+{
+    uint32_t ticks = 1;
+
+    OS_ACQUIRE_LOCK(&mutex);
+    if (sleep_ticks != 0) {
+        StgWord64 slept = getMonotonicNSec() - sleep_start;
+        ticks = slept / TimeToNS(itimer_interval);
+        ticks = stg_max(1, stg_min(ticks, sleep_ticks));
+        sleep_ticks = 0;
+    }
+    OS_RELEASE_LOCK(&mutex);
+    return ticks;
+}
 #endif
 
+static void *itimer_thread_func(void *_handle_tick)
+{
+    TickProc handle_tick = _handle_tick;
+    uint64_t nticks;
+    uint32_t ticks;
+
     // Relaxed is sufficient: If we don't see that exited was set in one iteration we will
     // see it next time.
     while (!RELAXED_LOAD(&exited)) {
@@ -156,12 +216,22 @@ static void *itimer_thread_func(void *_handle_tick)
             }
             OS_RELEASE_LOCK(&mutex);
         } else {
-            handle_tick(0);
+            ticks = 1;
+#if USE_TIMERFD_FOR_ITIMER
+            ticks = ticksElapsed();
+#endif
+            for (; ticks > 0; ticks--) {
+                handle_tick(0);
+            }
+#if USE_TIMERFD_FOR_ITIMER
+            planNextTick();
+#endif
         }
     }
 
-    if (USE_TIMERFD_FOR_ITIMER)
-        close(timerfd);
+#if USE_TIMERFD_FOR_ITIMER
+    close(timerfd);
+#endif
     return NULL;
 }
 
@@ -180,6 +250,17 @@ initTicker (Time interval, TickProc handle_tick)
     initCondition(&start_cond);
     initMutex(&mutex);
 
+#if USE_TIMERFD_FOR_ITIMER
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerfd == -1) {
+        barf("timerfd_create: %s", strerror(errno));
+    }
+    if (!TFD_CLOEXEC) {
+        fcntl(timerfd, F_SETFD, FD_CLOEXEC);
+    }
+    armTimerfd(1);
+#endif
+
     /*
      * We can't use the RTS's createOSThread here as we need to remain attached
      * to the thread we create so we can later join to it if requested
@@ -225,10 +306,35 @@ startTicker(void)
 {
     OS_ACQUIRE_LOCK(&mutex);
     RELAXED_STORE(&stopped, false);
+#if USE_TIMERFD_FOR_ITIMER
+    // the ticks we slept through while stopped don't count
+    sleep_ticks = 0;
+    if (!timerfd_periodic) {
+        SEQ_CST_STORE(&ticker_sleeping, false);
+        armTimerfd(1);
+    }
+#endif
     signalCondition(&start_cond);
     OS_RELEASE_LOCK(&mutex);
 }
 
+/* Make the ticker tick at the next tick interval, if it was waiting for
+ * longer.  See Note [Tickless idle] in Timer.c */
+void
+wakeTicker(void)
+{
+#if USE_TIMERFD_FOR_ITIMER
+    if (SEQ_CST_LOAD(&ticker_sleeping)) {
+        OS_ACQUIRE_LOCK(&mutex);
+        if (SEQ_CST_LOAD(&ticker_sleeping)) {
+            SEQ_CST_STORE(&ticker_sleeping, false);
+            armTimerfd(1);
+        }
+        OS_RELEASE_LOCK(&mutex);
+    }
+#endif
+}
+
 /* There may be at most one additional tick fired after a call to this */
 void
 stopTicker(void)
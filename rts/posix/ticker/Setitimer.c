@@ -78,6 +78,14 @@ exitTicker (bool wait STG_UNUSED)
     return;
 }
 
+// This ticker ticks at every interval.  See Note [Tickless idle] in
+// Timer.c
+void
+wakeTicker (void)
+{
+    return;
+}
+
 int
 rtsTimerSignal(void)
 {
@@ -85,6 +85,14 @@ exitTicker (bool wait STG_UNUSED)
     // ignore errors - we don't really care if it fails.
 }
 
+// This ticker ticks at every interval.  See Note [Tickless idle] in
+// Timer.c
+void
+wakeTicker (void)
+{
+    return;
+}
+
 int
 rtsTimerSignal(void)
 {
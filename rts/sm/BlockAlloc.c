@@ -161,6 +161,13 @@ static void  initMBlock(void *mblock, uint32_t node);
 static bdescr *free_list[MAX_NUMA_NODES][NUM_FREE_LISTS];
 static bdescr *free_mblock_list[MAX_NUMA_NODES];
 
+#if defined(THREADED_RTS)
+// See Note [Returning memory in the background]
+static W_ mblocks_to_return = 0;  // megablocks left to return
+static W_ n_mblocks_returning = 0; // megablocks being returned
+static bool memory_return_restart = false; // start the delay again
+#endif
+
 W_ n_alloc_blocks;   // currently allocated blocks
 W_ hw_alloc_blocks;  // high-water allocated blocks
 
@@ -182,6 +189,7 @@ void initBlockAllocator(void)
     }
     n_alloc_blocks = 0;
     hw_alloc_blocks = 0;
+    initMemoryReturn();
 }
 
 /* -----------------------------------------------------------------------------
@@ -423,6 +431,14 @@ alloc_mega_group (uint32_t node, StgWord mblocks)
         } else {
             mblock = getMBlocks(mblocks);
         }
+#if defined(THREADED_RTS)
+        // We need more memory than the GC thought, see
+        // Note [Returning memory in the background]
+        if (mblocks_to_return > 0) {
+            mblocks_to_return -= stg_min(mblocks_to_return, mblocks);
+            memory_return_restart = true;
+        }
+#endif
         initMBlock(mblock, node); // only need to init the 1st one
         bd = FIRST_BDESCR(mblock);
     }
@@ -1034,6 +1050,215 @@ uint32_t returnMemoryToOS(uint32_t n /* megablocks */)
     return (init_n - n);
 }
 
+/* -----------------------------------------------------------------------------
+   Returning memory in the background
+
+   Note [Returning memory in the background]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   At the end of a major GC we return the free megablocks that we don't
+   expect to need to the OS (see Note [Scaling retained memory] in GC.c).
+   That takes a system call (madvise() or munmap()) per group of
+   megablocks, and after a GC that freed a lot of memory these add
+   noticeably to the pause.
+
+   So in the threaded RTS a GC only records how many megablocks it would
+   like to return, in mblocks_to_return, and a background thread, started
+   the first time there is something to return, returns them:
+
+    * It first waits for --return-memory-delay seconds, from the time the
+      target became non-zero.  A program that allocates in bursts is likely
+      to need the memory again shortly, and would have to get it back from
+      the OS at a cost.
+
+    * It then returns the megablocks at no more than --return-memory-rate
+      bytes a second, in steps of MEMORY_RETURN_STEP.  In each step it
+      takes a group of megablocks off free_mblock_list, holding the SM lock,
+      and releases the lock during the system call (see releaseMBlocks() in
+      MBlock.c), so that the mutators are only held up for the bookkeeping.
+
+    * Whenever alloc_mega_group() has to get new megablocks from the OS, the
+      program needs more memory than the GC thought, and we return
+      correspondingly fewer, rather than churning megablocks between the OS
+      and the heap.  Each major GC replaces the target with its own
+      estimate.
+
+    * The delay starts again (memory_return_restart) when alloc_mega_group()
+      gets new megablocks from the OS, or when a GC lowers the target: the
+      program's memory use has just gone up.  Otherwise a GC doesn't
+      restart it, or a program doing a major GC more often than every
+      --return-memory-delay seconds would never get to return anything.
+      The rate limit holds across GCs too.
+
+   The SM lock protects all of this, and is the mutex of memory_return_cond.
+   A group that is being returned is on no free list, so memInventory()
+   finds it in n_mblocks_returning.
+
+   Major GCs which are forced (performMajorGC, idle and shutdown GCs) or
+   caused by memory pressure (see Note [Memory limits] in MemoryLimit.c),
+   all GCs with --return-memory-rate=0, and all GCs in the non-threaded
+   RTS still return memory themselves.  The MEM_RETURN event counts the
+   megablocks returned by the GC itself.
+   -------------------------------------------------------------------------- */
+
+#if defined(THREADED_RTS)
+#define MEMORY_RETURN_STEP USToTime(10000) // 10ms
+
+static Condition memory_return_cond;
+static OSThreadId memory_return_thread;
+static bool memory_return_thread_started = false;
+static bool memory_return_exit = false;
+
+// Take a group of at most n megablocks off the free megablock lists.
+// Returns the number of megablocks, and their address in *addr.
+static uint32_t
+takeFreeMBlocks (uint32_t n, void **addr)
+{
+    bdescr *bd;
+    uint32_t node;
+    StgWord size;
+
+    for (node = 0; node < n_numa_nodes; node++) {
+        bd = free_mblock_list[node];
+        if (bd == NULL) {
+            continue;
+        }
+        size = BLOCKS_TO_MBLOCKS(bd->blocks);
+        if (size > n) {
+            // take the end of the group
+            StgWord newSize = size - n;
+            char *freeAddr = MBLOCK_ROUND_DOWN(bd->start);
+            freeAddr += newSize * MBLOCK_SIZE;
+            bd->blocks = MBLOCK_GROUP_BLOCKS(newSize);
+            *addr = freeAddr;
+            return n;
+        } else {
+            free_mblock_list[node] = bd->link;
+            *addr = MBLOCK_ROUND_DOWN(bd->start);
+            return size;
+        }
+    }
+    return 0;
+}
+
+// Wait until the given time, with the SM lock held.  Returns false if we
+// have to start the delay again, there is nothing left to return or the
+// thread has to exit in the meantime.
+static bool
+waitToReturnMemory (Time until)
+{
+    Time now;
+
+    while (!memory_return_exit && !memory_return_restart
+           && mblocks_to_return > 0) {
+        now = NSToTime(getMonotonicNSec());
+        if (now >= until) {
+            return true;
+        }
+        // woken up by every GC: wait for what is left
+        timedWaitCondition(&memory_return_cond, &sm_mutex, until - now);
+    }
+    return false;
+}
+
+static void *
+memoryReturnThread (void *arg STG_UNUSED)
+{
+    const uint32_t step_mblocks =
+        stg_max(1, RtsFlags.GcFlags.returnMemoryRate
+                   * TimeToUS(MEMORY_RETURN_STEP) / 1000000);
+    uint32_t n;
+    void *addr;
+
+    ACQUIRE_SM_LOCK;
+    while (!memory_return_exit) {
+        if (mblocks_to_return == 0) {
+            waitCondition(&memory_return_cond, &sm_mutex);
+            continue;
+        }
+
+        memory_return_restart = false;
+        if (!waitToReturnMemory(NSToTime(getMonotonicNSec())
+                                + RtsFlags.GcFlags.returnMemoryDelay)) {
+            continue;
+        }
+
+        do {
+            n = takeFreeMBlocks(stg_min(mblocks_to_return, step_mblocks),
+                                &addr);
+            if (n == 0) {
+                mblocks_to_return = 0;
+                break;
+            }
+            mblocks_to_return -= n;
+            n_mblocks_returning += n;
+            releaseMBlocks(addr, n);
+            n_mblocks_returning -= n;
+        } while (waitToReturnMemory(NSToTime(getMonotonicNSec())
+                                    + MEMORY_RETURN_STEP));
+        releaseFreeMemory();
+    }
+    RELEASE_SM_LOCK;
+    return NULL;
+}
+#endif
+
+// Return n megablocks to the OS in the background, or now if this is the
+// non-threaded RTS or --return-memory-rate=0.  The SM lock must be held.
+// Returns the number of megablocks returned now.
+uint32_t
+returnMemoryToOSLater (uint32_t n)
+{
+#if defined(THREADED_RTS)
+    if (RtsFlags.GcFlags.returnMemoryRate > 0) {
+        if (n < mblocks_to_return) {
+            memory_return_restart = true;
+        }
+        mblocks_to_return = n;
+        if (n > 0 && !memory_return_thread_started) {
+            if (createOSThread(&memory_return_thread, "ghc_memory_return",
+                               memoryReturnThread, NULL) != 0) {
+                barf("returnMemoryToOSLater: failed to create a thread");
+            }
+            memory_return_thread_started = true;
+        }
+        signalCondition(&memory_return_cond);
+        return 0;
+    }
+#endif
+    return n > 0 ? returnMemoryToOS(n) : 0;
+}
+
+void
+initMemoryReturn (void)
+{
+#if defined(THREADED_RTS)
+    // In the child of forkProcess() the thread is gone: it will be started
+    // again when needed. The megablocks it was returning are lost.
+    initCondition(&memory_return_cond);
+    memory_return_thread_started = false;
+    memory_return_exit = false;
+    memory_return_restart = false;
+    mblocks_to_return = 0;
+#endif
+}
+
+void
+exitMemoryReturn (void)
+{
+#if defined(THREADED_RTS)
+    ACQUIRE_SM_LOCK;
+    memory_return_exit = true;
+    signalCondition(&memory_return_cond);
+    RELEASE_SM_LOCK;
+
+    if (memory_return_thread_started) {
+        joinOSThread(memory_return_thread);
+        memory_return_thread_started = false;
+    }
+    closeCondition(&memory_return_cond);
+#endif
+}
+
 /* -----------------------------------------------------------------------------
    Debugging
    -------------------------------------------------------------------------- */
@@ -1148,6 +1373,9 @@ countFreeList(void)
           // block descriptors from *every* mblock.
       }
   }
+#if defined(THREADED_RTS)
+  total_blocks += BLOCKS_PER_MBLOCK * n_mblocks_returning;
+#endif
   return total_blocks;
 }
 
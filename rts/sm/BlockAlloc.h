@@ -13,6 +13,14 @@
 bdescr *allocLargeChunk (W_ min, W_ max);
 bdescr *allocLargeChunkOnNode (uint32_t node, W_ min, W_ max);
 
+// See Note [Returning memory in the background] in BlockAlloc.c
+uint32_t returnMemoryToOSLater (uint32_t n);
+void initMemoryReturn (void);
+void exitMemoryReturn (void);
+
+// Implemented in MBlock.c
+void releaseMBlocks (void *addr, uint32_t n);
+
 /* Debugging  -------------------------------------------------------------- */
 
 extern W_ countBlocks       (bdescr *bd);
@@ -18,7 +18,7 @@
 #include "GC.h"
 #include "Storage.h"
 #include "CNF.h"
-#include "Hash.h"
+#include "CompactFile.h"
 #include "HeapAlloc.h"
 #include "BlockAlloc.h"
 #include "Trace.h"
@@ -89,9 +89,10 @@
   * The data inside a CNF block is ordinary closures
 
   * During compaction (with sharing enabled) the hash field points to
-    a HashTable mapping heap addresses outside the compact to
+    a CompactHash mapping heap addresses outside the compact to
     addresses within it.  If a GC strikes during compaction, this
-    HashTable must be scanned by the GC.
+    CompactHash must be scanned by the GC (see Note [Sharing-preserving
+    compaction]).
 
   Invariants
   ~~~~~~~~~~
@@ -144,6 +145,12 @@
   This works by constructing a temporary binary search table (in the C heap)
   of the old block addresses (which are known from the block header), and
   then searching for each pointer in the table, and adjusting it.
+  In the threaded RTS, large compacts are fixed up on several threads,
+  each taking whole blocks in turn (see fixup_blocks_parallel()): blocks
+  are fixed up independently, since the fixup only reads the table and the
+  bdescrs of the blocks pointed to.
+  If every block was imported at the address it was serialized from, no
+  fixup is needed at all (see any_needs_fixup()).
   It relies on ABI compatibility and static linking (or no ASLR) because it
   does not attempt to reconstruct info tables, and uses info tables to detect
   pointers. In practice this means only the exact same binary should be
@@ -280,6 +287,10 @@ compactFree(StgCompactNFData *str)
             // When using the non-moving collector we leave compact object
             // evacuated to the oldset gen as BF_EVACUATED to avoid evacuating
             // objects in the non-moving heap.
+        if (bd->flags & BF_COMPACT_MAPPED) {
+            // See Note [Compact files] in CompactFile.c
+            compactFileUnmapBlock(bd);
+        }
         freeGroup(bd);
     }
 }
@@ -528,12 +539,162 @@ allocateForCompact (Capability *cap,
 }
 
 
+/* -----------------------------------------------------------------------------
+   Note [Sharing-preserving compaction]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   compactAddWithSharing# records, for every object it copies into the
+   compact, where the copy went, so that an object reachable along several
+   paths is only copied once.  Every object is looked up before it is
+   copied and inserted after, so this map is on the critical path of the
+   whole compaction.
+
+   The map is a CompactHash: an open addressing table with linear probing,
+   keyed by the (untagged) address of the original object.  Entries are
+   never removed, since the whole table is freed when the compaction
+   finishes, so there are no tombstones; and the table is kept at most half
+   full, so that the lookups of objects not seen before, which are the
+   common case, stop after a probe or two.
+
+   We do not mark the original objects as forwarded (as the copying GC does)
+   instead of keeping a table: they still belong to the mutator, and other
+   threads may be reading them while we compact.
+
+   The keys point outside the compact, so if a GC strikes during
+   compaction they must be updated:
+
+     * The copying GC evacuates the keys in place (scavenge_compact() in
+       Scav.c), and only re-hashes the table if one of them actually moved.
+       When the GC that strikes is a minor one and the structure being
+       compacted is in the old generation, nothing moves.
+
+     * The compacting GC threads the keys, and re-hashes the table after
+       compaction (see Note [CNFs in compacting GC] in Compact.c).
+
+   Re-hashing keeps the size of the table.  Two keys may be updated to the
+   same address (e.g. when the GC short-cuts an indirection); we keep either
+   value, since both are copies of the same object.
+   -------------------------------------------------------------------------- */
+
+// log2 of the initial number of entries
+#define COMPACT_HASH_INIT_LOG_SIZE 8
+
+STATIC_INLINE StgWord
+compactHashSlot (const CompactHash *hash, const StgClosure *p)
+{
+    // Fibonacci hashing: the top bits of the product depend on every bit
+    // of the address
+#if SIZEOF_VOID_P == 8
+    return ((StgWord)p * UINT64_C(0x9E3779B97F4A7C15)) >> hash->shift;
+#else
+    return ((StgWord)p * UINT32_C(0x9E3779B9)) >> hash->shift;
+#endif
+}
+
+static void
+initCompactHashEntries (CompactHash *hash, uint32_t log_size)
+{
+    StgWord size = (StgWord)1 << log_size;
+
+    hash->entries = stgCallocBytes(size, sizeof(CompactHashEntry),
+                                   "initCompactHashEntries");
+    hash->mask = size - 1;
+    hash->shift = WORD_SIZE_IN_BITS - log_size;
+    hash->count = 0;
+}
+
+// Add an entry to a table known to have room for it.  If the key is
+// already present, its value is replaced.
+static void
+addCompactHashEntry (CompactHash *hash, StgClosure *p, StgClosure *to)
+{
+    StgWord i = compactHashSlot(hash, p);
+    CompactHashEntry *e;
+
+    while (true) {
+        e = &hash->entries[i];
+        if (e->key == p) {
+            e->value = to;
+            return;
+        }
+        if (e->key == NULL) {
+            break;
+        }
+        i = (i + 1) & hash->mask;
+    }
+    e->key = p;
+    e->value = to;
+    hash->count++;
+}
+
+// Re-insert all the entries of the table into a fresh array of 2^log_size
+// entries.
+static void
+resizeCompactHash (CompactHash *hash, uint32_t log_size)
+{
+    CompactHashEntry *old = hash->entries;
+    StgWord old_size = hash->mask + 1;
+
+    initCompactHashEntries(hash, log_size);
+    for (StgWord i = 0; i < old_size; i++) {
+        if (old[i].key != NULL) {
+            addCompactHashEntry(hash, old[i].key, old[i].value);
+        }
+    }
+    stgFree(old);
+}
+
+CompactHash *
+allocCompactHash (void)
+{
+    CompactHash *hash = stgMallocBytes(sizeof(CompactHash), "allocCompactHash");
+    initCompactHashEntries(hash, COMPACT_HASH_INIT_LOG_SIZE);
+    return hash;
+}
+
+void
+freeCompactHash (CompactHash *hash)
+{
+    stgFree(hash->entries);
+    stgFree(hash);
+}
+
+StgClosure *
+lookupCompactHash (CompactHash *hash, StgClosure *p)
+{
+    StgWord i = compactHashSlot(hash, p);
+
+    while (true) {
+        const CompactHashEntry *e = &hash->entries[i];
+        if (e->key == p) {
+            return e->value;
+        }
+        if (e->key == NULL) {
+            return NULL;
+        }
+        i = (i + 1) & hash->mask;
+    }
+}
+
+// Called by the GC after it updated the keys of the table.
+void
+rehashCompactHash (CompactHash *hash)
+{
+    resizeCompactHash(hash, WORD_SIZE_IN_BITS - hash->shift);
+}
+
 void
 insertCompactHash (Capability *cap,
                    StgCompactNFData *str,
                    StgClosure *p, StgClosure *to)
 {
-    insertHashTable(str->hash, (StgWord)p, (const void*)to);
+    CompactHash *hash = str->hash;
+
+    if (2 * (hash->count + 1) > hash->mask + 1) {
+        resizeCompactHash(hash, WORD_SIZE_IN_BITS - hash->shift + 1);
+    }
+    addCompactHashEntry(hash, p, to);
+
     const StgInfoTable **strinfo = &str->header.info;
     if (*strinfo == &stg_COMPACT_NFDATA_CLEAN_info) {
         *strinfo = &stg_COMPACT_NFDATA_DIRTY_info;
@@ -730,7 +891,7 @@ verify_consistency_block (StgCompactNFData *str, StgCompactNFDataBlock *block)
             for (i = 0; i < arr->ptrs; i++)
                 check_object_in_compact(str, UNTAG_CLOSURE(arr->payload[i]));
 
-            p += sizeofW(StgSmallMutArrPtrs) + arr->ptrs;
+            p += small_mut_arr_ptrs_sizeW(arr);
             break;
         }
 
@@ -980,7 +1141,7 @@ fixup_block(StgCompactNFDataBlock *block, StgWord *fixup_table, uint32_t count)
                     return false;
             }
 
-            p += sizeofW(StgSmallMutArrPtrs) + arr->ptrs;
+            p += small_mut_arr_ptrs_sizeW(arr);
             break;
         }
 
@@ -1014,11 +1175,14 @@ cmp_fixup_table_item (const void *e1, const void *e2)
     else return 0;
 }
 
+// Also returns the blocks in list order in *pblocks
 static StgWord *
-build_fixup_table (StgCompactNFDataBlock *block, uint32_t *pcount)
+build_fixup_table (StgCompactNFDataBlock *block,
+                   StgCompactNFDataBlock ***pblocks, uint32_t *pcount)
 {
     uint32_t count;
     StgCompactNFDataBlock *tmp;
+    StgCompactNFDataBlock **blocks;
     StgWord *table;
 
     count = 0;
@@ -1029,42 +1193,120 @@ build_fixup_table (StgCompactNFDataBlock *block, uint32_t *pcount)
     } while(tmp && tmp->owner);
 
     table = stgMallocBytes(sizeof(StgWord) * 2 * count, "build_fixup_table");
+    blocks = stgMallocBytes(sizeof(StgCompactNFDataBlock *) * count,
+                            "build_fixup_table");
 
     count = 0;
     do {
         table[count * 2] = (W_)block->self;
         table[count * 2 + 1] = (W_)block;
+        blocks[count] = block;
         count++;
         block = block->next;
     } while(block && block->owner);
 
     qsort(table, count, sizeof(StgWord) * 2, cmp_fixup_table_item);
 
+    *pblocks = blocks;
     *pcount = count;
     return table;
 }
 
+#if defined(THREADED_RTS)
+// Below this many blocks, fixing up on one thread is cheaper than starting
+// more.
+#define PARALLEL_FIXUP_MIN_BLOCKS 16
+
+typedef struct {
+    StgCompactNFDataBlock **blocks;
+    StgWord *fixup_table;
+    uint32_t count;
+    StgWord next;       // the next block to fix up
+    bool failed;
+} FixupWork;
+
+static void *
+fixup_worker (void *arg)
+{
+    FixupWork *work = arg;
+    StgWord i;
+
+    while ((i = atomic_inc(&work->next, 1) - 1) < work->count) {
+        if (RELAXED_LOAD(&work->failed)) {
+            break;
+        }
+        if (!fixup_block(work->blocks[i], work->fixup_table, work->count)) {
+            RELAXED_STORE(&work->failed, true);
+        }
+    }
+    return NULL;
+}
+
+// Fix up the blocks on up to n_capabilities threads, the calling one
+// included.  See Note [Compact Normal Forms].
+static bool
+fixup_blocks_parallel (StgCompactNFDataBlock **blocks, StgWord *fixup_table,
+                       uint32_t count)
+{
+    FixupWork work = {
+        .blocks = blocks,
+        .fixup_table = fixup_table,
+        .count = count,
+        .next = 0,
+        .failed = false,
+    };
+    uint32_t n_workers = stg_min(n_capabilities, count) - 1;
+    OSThreadId *workers = stgMallocBytes(n_workers * sizeof(OSThreadId),
+                                         "fixup_blocks_parallel");
+    uint32_t started, i;
+
+    IF_DEBUG(compact, debugBelch("Fixing up %" FMT_Word32 " compact blocks "
+                                 "on %" FMT_Word32 " threads\n",
+                                 count, n_workers + 1));
+
+    for (started = 0; started < n_workers; started++) {
+        if (createOSThread(&workers[started], "ghc_cnf_fixup",
+                           fixup_worker, &work) != 0) {
+            break;
+        }
+    }
+    fixup_worker(&work);
+    for (i = 0; i < started; i++) {
+        joinOSThread(workers[i]);
+    }
+    stgFree(workers);
+
+    return !work.failed;
+}
+#endif
+
 static bool
 fixup_loop(StgCompactNFDataBlock *block, StgClosure **proot)
 {
     StgWord *table;
+    StgCompactNFDataBlock **blocks;
     bool ok;
-    uint32_t count;
+    uint32_t count, i;
 
-    table = build_fixup_table (block, &count);
+    table = build_fixup_table (block, &blocks, &count);
 
-    do {
-        if (!fixup_block(block, table, count)) {
-            ok = false;
-            goto out;
+#if defined(THREADED_RTS)
+    if (count >= PARALLEL_FIXUP_MIN_BLOCKS && n_capabilities > 1) {
+        ok = fixup_blocks_parallel(blocks, table, count);
+    } else
+#endif
+    {
+        ok = true;
+        for (i = 0; i < count && ok; i++) {
+            ok = fixup_block(blocks[i], table, count);
         }
+    }
 
-        block = block->next;
-    } while(block && block->owner);
-
-    ok = fixup_one_pointer(table, count, proot);
+    if (ok) {
+        ok = fixup_one_pointer(table, count, proot);
+    }
 
- out:
+    stgFree(blocks);
     stgFree(table);
     return ok;
 }
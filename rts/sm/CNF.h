@@ -70,6 +70,27 @@ extern void *allocateForCompact (Capability *cap,
                                  StgCompactNFData *str,
                                  StgWord sizeW);
 
+// The map from heap objects to their copies that compactAddWithSharing
+// builds. See Note [Sharing-preserving compaction] in CNF.c.
+typedef struct {
+    StgClosure *key;            // NULL if the entry is free
+    StgClosure *value;
+} CompactHashEntry;
+
+struct compacthash {
+    CompactHashEntry *entries;
+    StgWord mask;               // number of entries - 1
+    uint32_t shift;             // WORD_SIZE_IN_BITS - log2(number of entries)
+    StgWord count;              // number of keys
+};
+
+typedef struct compacthash CompactHash;
+
+extern CompactHash *allocCompactHash (void);
+extern void freeCompactHash (CompactHash *hash);
+extern StgClosure *lookupCompactHash (CompactHash *hash, StgClosure *p);
+extern void rehashCompactHash (CompactHash *hash);
+
 extern void insertCompactHash (Capability *cap,
                                StgCompactNFData *str,
                                StgClosure *p, StgClosure *to);
@@ -27,7 +27,7 @@
 #include "MarkWeak.h"
 #include "StablePtr.h"
 #include "StableName.h"
-#include "Hash.h"
+#include "CNF.h"
 
 // Turn off inlining when debugging - it obfuscates things
 #if defined(DEBUG)
@@ -484,24 +484,12 @@ thread_TSO (StgTSO *tso)
     hash tables for re-hashing. The list `nfdata_chain` is used for that
     purpose. When we thread keys of a CNF we add the CNF to the list. After
     compacting is done we re-visit the CNFs in the list and re-hash their
-    tables. See also #17937 for more details.
+    tables. See also #17937 for more details, and Note [Sharing-preserving
+    compaction] in CNF.c for the hash tables themselves.
    ------------------------------------------------------------------------- */
 
 static StgCompactNFData *nfdata_chain = NULL;
 
-static void
-thread_nfdata_hash_key(void *data STG_UNUSED, StgWord *key, const void *value STG_UNUSED)
-{
-    thread_((void *)key);
-}
-
-static void
-add_hash_entry(void *data, StgWord key, const void *value)
-{
-    HashTable *new_hash = (HashTable *)data;
-    insertHashTable(new_hash, key, value);
-}
-
 static void
 rehash_CNFs(void)
 {
@@ -510,10 +498,7 @@ rehash_CNFs(void)
         nfdata_chain = str->link;
         str->link = NULL;
 
-        HashTable *new_hash = allocHashTable();
-        mapHashTable(str->hash, (void*)new_hash, add_hash_entry);
-        freeHashTable(str->hash, NULL);
-        str->hash = new_hash;
+        rehashCompactHash(str->hash);
     }
 }
 
@@ -527,7 +512,12 @@ update_fwd_cnf( bdescr *bd )
         // Thread hash table keys. Values won't be moved as those are inside the
         // CNF, and the CNF is a large object and so won't ever move.
         if (str->hash) {
-            mapHashTableKeys(str->hash, NULL, thread_nfdata_hash_key);
+            CompactHash *hash = str->hash;
+            for (StgWord i = 0; i <= hash->mask; i++) {
+                if (hash->entries[i].key != NULL) {
+                    thread_((void *)&hash->entries[i].key);
+                }
+            }
             ASSERT(str->link == NULL);
             str->link = nfdata_chain;
             nfdata_chain = str;
@@ -53,6 +53,7 @@
 #include "CNF.h"
 #include "RtsFlags.h"
 #include "NonMoving.h"
+#include "MemoryLimit.h"
 #include "Ticky.h"
 
 #include <string.h> // for memset()
@@ -120,6 +121,14 @@ bool unload_mark_needed;
  */
 static W_ g0_pcnt_kept = 30; // percentage of g0 live at last minor GC
 
+/* Data used for pause-targeted heap sizing, see
+ * Note [Pause-targeted heap sizing].
+ */
+static Time minor_gc_pause = 0;    // average pause of recent minor GCs
+static Time major_gc_pause = 0;    // average pause of recent major GCs
+static uint32_t nursery_pcnt = 100;      // nursery size, in % of -A
+static uint32_t old_gen_factor_pcnt = 100; // old gen factor, in % of -F
+
 static int consec_idle_gcs = 0;
 
 /* Mut-list stats */
@@ -151,6 +160,12 @@ static StgInt n_gc_exited = 0;
 static Condition gc_exit_arrived_cv;
 static Condition gc_exit_leave_now_cv;
 
+// See Note [GC thread tasks]. Protected by gc_exit_mutex.
+static gc_task_fn gc_task = NULL;
+static void *gc_task_arg = NULL;
+static StgWord gc_task_seq = 0;
+static StgInt n_gc_task_done = 0;
+
 #else // THREADED_RTS
 // Must be aligned to 64-bytes to meet stated 64-byte alignment of gen_workspace
 StgWord8 the_gc_thread[sizeof(gc_thread) + 64 * sizeof(gen_workspace)]
@@ -201,6 +216,7 @@ static void prepare_collected_gen   (generation *gen);
 static void prepare_uncollected_gen (generation *gen);
 static void init_gc_thread          (gc_thread *t);
 static void resize_nursery          (void);
+static void update_pause_target     (bool major, Time pause);
 static void scavenge_until_all_done (void);
 static StgWord inc_running          (void);
 static StgWord dec_running          (void);
@@ -265,6 +281,7 @@ GarbageCollect (uint32_t collect_gen,
                 const bool do_heap_census,
                 const bool is_overflow_gc,
                 const bool deadlock_detect,
+                const bool force_major,
                 uint32_t gc_type USED_IF_THREADS,
                 Capability *cap,
                 bool idle_cap[])
@@ -993,6 +1010,13 @@ GarbageCollect (uint32_t collect_gen,
           ? RtsFlags.GcFlags.oldGenFactor / pow(2, (float) consec_idle_gcs / RtsFlags.GcFlags.returnDecayFactor)
           : RtsFlags.GcFlags.oldGenFactor;
 
+      // Under memory pressure, keep only what we can't do without, see
+      // Note [Memory limits] in MemoryLimit.c
+      bool pressure_gc = endMemoryPressureGC();
+      if (pressure_gc) {
+          scaled_factor = 0;
+      }
+
       debugTrace(DEBUG_gc, "factors: %f %d %f", RtsFlags.GcFlags.oldGenFactor, consec_idle_gcs, scaled_factor  );
 
       // Unavoidable need depends on GC strategy
@@ -1017,15 +1041,23 @@ GarbageCollect (uint32_t collect_gen,
       if (RtsFlags.GcFlags.maxHeapSize != 0) {
           need = stg_min(RtsFlags.GcFlags.maxHeapSize, need);
       }
+      if (softHeapLimit() != 0) {
+          need = stg_min(softHeapLimit(), need);
+      }
 
       need = BLOCKS_TO_MBLOCKS(need);
 
       got = mblocks_allocated;
       debugTrace(DEBUG_gc,"Returning: %d %d", got, need);
 
+      // See Note [Returning memory in the background] in BlockAlloc.c
       uint32_t returned = 0;
-      if (got > need) {
-          returned = returnMemoryToOS(got - need);
+      if (force_major || pressure_gc) {
+          if (got > need) {
+              returned = returnMemoryToOS(got - need);
+          }
+      } else {
+          returned = returnMemoryToOSLater(got > need ? got - need : 0);
       }
       traceEventMemReturn(cap, got, need, returned);
   }
@@ -1058,6 +1090,11 @@ GarbageCollect (uint32_t collect_gen,
              par_max_copied, par_balanced_copied,
              any_work, scav_find_work, max_n_todo_overflow);
 
+  if (RtsFlags.GcFlags.pauseTarget != 0) {
+      update_pause_target(major_gc,
+                          getProcessElapsedTime() - gct->gc_start_elapsed);
+  }
+
 #if defined(RTS_USER_SIGNALS)
   if (RtsFlags.MiscFlags.install_signal_handlers) {
     // unblock signals again
@@ -1402,8 +1439,20 @@ gcWorkerThread (Capability *cap)
     SEQ_CST_STORE(&gct->wakeup, GC_THREAD_WAITING_TO_CONTINUE);
     SEQ_CST_ADD(&n_gc_exited, 1);
     signalCondition(&gc_exit_arrived_cv);
+    StgWord seen_task_seq = gc_task_seq;
     while(SEQ_CST_LOAD(&n_gc_exited) != 0) {
         waitCondition(&gc_exit_leave_now_cv, &gc_exit_mutex);
+        // See Note [GC thread tasks]
+        if (gc_task_seq != seen_task_seq) {
+            gc_task_fn task = gc_task;
+            void *arg = gc_task_arg;
+            seen_task_seq = gc_task_seq;
+            RELEASE_LOCK(&gc_exit_mutex);
+            task(gct->thread_index, arg);
+            ACQUIRE_LOCK(&gc_exit_mutex);
+            n_gc_task_done++;
+            signalCondition(&gc_exit_arrived_cv);
+        }
     }
     RELEASE_LOCK(&gc_exit_mutex);
 
@@ -1538,6 +1587,61 @@ shutdown_gc_threads (uint32_t me USED_IF_THREADS USED_IF_DEBUG,
 #endif // THREADED_RTS
 }
 
+/* Note [GC thread tasks]
+ * ~~~~~~~~~~~~~~~~~~~~~~
+ * Some work done at the end of a GC, after the heap has been fully
+ * scavenged, can be split across threads just like the copying itself:
+ * a heap census is one example (see Note [Parallel heap census] in
+ * ProfHeap.c).  Rather than starting new OS threads for this, we reuse
+ * the GC threads, which at this point have all finished scavenging and
+ * are waiting in gcWorkerThread() for releaseGCThreads().
+ *
+ * runGcThreadsTask() is called by the GC leader, between
+ * shutdown_gc_threads() and the end of GarbageCollect().  It publishes
+ * the task under gc_exit_mutex, bumps gc_task_seq and broadcasts
+ * gc_exit_leave_now_cv.  A waiting worker that sees a new gc_task_seq
+ * runs the task with the lock released, then counts itself in
+ * n_gc_task_done and goes back to waiting to be released; n_gc_exited
+ * is untouched, so the usual exit protocol is unaffected.  The leader
+ * runs the task too and then waits for all the other non-idle threads
+ * to finish.
+ *
+ * In a sequential GC (n_gc_threads == 1) the leader just runs the task
+ * by itself.  A task must not use the GC's own work-stealing machinery
+ * (gc_running_threads etc.), which has been shut down by this point.
+ */
+void
+runGcThreadsTask (gc_task_fn task, void *arg)
+{
+#if defined(THREADED_RTS)
+    if (n_gc_threads > 1) {
+        const StgInt n_threads =
+            (StgInt)n_gc_threads - 1 - (StgInt)n_gc_idle_threads;
+
+        ACQUIRE_LOCK(&gc_exit_mutex);
+        ASSERT(SEQ_CST_LOAD(&n_gc_exited) == n_threads);
+        gc_task = task;
+        gc_task_arg = arg;
+        n_gc_task_done = 0;
+        gc_task_seq++;
+        broadcastCondition(&gc_exit_leave_now_cv);
+        RELEASE_LOCK(&gc_exit_mutex);
+
+        task(gct->thread_index, arg);
+
+        ACQUIRE_LOCK(&gc_exit_mutex);
+        while (n_gc_task_done != n_threads) {
+            waitCondition(&gc_exit_arrived_cv, &gc_exit_mutex);
+        }
+        gc_task = NULL;
+        gc_task_arg = NULL;
+        RELEASE_LOCK(&gc_exit_mutex);
+        return;
+    }
+#endif
+    task(gct->thread_index, arg);
+}
+
 #if defined(THREADED_RTS)
 void
 releaseGCThreads (Capability *cap USED_IF_THREADS, bool idle_cap[])
@@ -1913,7 +2017,8 @@ resizeGenerations (void)
         oldest_gen->n_compact_blocks;
 
     // default max size for all generations except zero
-    size = stg_max(live * RtsFlags.GcFlags.oldGenFactor,
+    size = stg_max(live * RtsFlags.GcFlags.oldGenFactor
+                        * old_gen_factor_pcnt / 100,
                    RtsFlags.GcFlags.minOldGenSize);
 
     if (RtsFlags.GcFlags.heapSizeSuggestionAuto) {
@@ -1950,6 +2055,19 @@ resizeGenerations (void)
         oldest_gen->mark = 1;
     }
 
+    // Stay under the soft heap limit as far as the live data allows, see
+    // Note [Memory limits] in MemoryLimit.c
+    const W_ soft_max = softHeapLimit();
+    if (soft_max > min_alloc) {
+        W_ soft_size;
+        if (oldest_gen->compact || RtsFlags.GcFlags.useNonmoving) {
+            soft_size = (soft_max - min_alloc) / ((gens - 1) * 2 - 1);
+        } else {
+            soft_size = (soft_max - min_alloc) / ((gens - 1) * 2);
+        }
+        size = stg_min(size, stg_max(soft_size, live + live / 4));
+    }
+
     // if we're going to go over the maximum heap size, reduce the
     // size of the generations accordingly.  The calculation is
     // different if compaction is turned on, because we don't need
@@ -2100,6 +2218,35 @@ resize_nursery (void)
 
             resizeNurseries((W_)blocks);
         }
+        else if (RtsFlags.GcFlags.pauseTarget != 0)
+        {
+            // See Note [Pause-targeted heap sizing]
+            W_ blocks;
+            W_ max_blocks;
+            StgWord needed;
+
+            if (RtsFlags.GcFlags.nurseryChunkSize) {
+                blocks = RtsFlags.GcFlags.nurseryChunkSize;
+            } else {
+                blocks = RtsFlags.GcFlags.minAllocAreaSize;
+            }
+            max_blocks = blocks;
+            blocks = stg_max(blocks * nursery_pcnt / 100, 1);
+
+            // Only grow the nursery as far as the maximum heap size allows
+            if (blocks > max_blocks && RtsFlags.GcFlags.maxHeapSize != 0) {
+                calcNeeded(false, &needed);
+                if (needed < RtsFlags.GcFlags.maxHeapSize) {
+                    max_blocks = stg_max(max_blocks,
+                        (RtsFlags.GcFlags.maxHeapSize - needed)
+                        * (100 - RtsFlags.GcFlags.pcFreeHeap) / 100
+                        / n_nurseries);
+                }
+                blocks = stg_min(blocks, max_blocks);
+            }
+
+            resizeNurseries(blocks * n_nurseries);
+        }
         else
         {
             // we might have added extra blocks to the nursery, so
@@ -2109,6 +2256,84 @@ resize_nursery (void)
     }
 }
 
+/* -----------------------------------------------------------------------------
+   Pause-targeted heap sizing
+
+   Note [Pause-targeted heap sizing]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   By default the sizes of the nursery and of the old generations are fixed
+   factors (-A, -n, -F, -H) which have to be tuned by hand for a program to
+   meet a pause time goal.  With +RTS --gc-pause-target=<secs>, we instead
+   adjust them after each GC, from the average pause of the recent GCs:
+
+    * The pause of a minor GC is dominated by copying the live data of the
+      nursery, which is roughly proportional to the size of the nursery.
+      So if minor GCs take longer than the target, we shrink the nursery
+      (and each allocation area chunk, with -n) in proportion, down to
+      1/pause_nursery_min of -A.  If they take less than half the target,
+      we grow it by a quarter at a time, up to pause_nursery_max times -A,
+      to make fewer GCs.  The nursery never grows past the space left
+      under the maximum heap size (-M).
+
+    * The pause of a major GC is dominated by copying or marking the live
+      data of the whole heap, which the size of the nursery or of the old
+      generation doesn't change.  What we can change is how often they
+      happen: if major GCs take longer than the target, we raise the old
+      generation factor (-F) by a quarter at a time, up to
+      pause_old_gen_factor_max times -F, making them rarer.  When they are
+      back under half the target, we let the factor decay back to -F.
+      resizeGenerations still reduces the size of the old generation as
+      the maximum heap size (-M) approaches, which makes -M the memory
+      ceiling for the heap sizes we choose.
+
+   A suggested heap size (-H) takes precedence over the target for sizing
+   the nursery, and the two-space collector (-G1) isn't affected.
+
+   The average pause is an exponentially weighted moving average, in which
+   each new pause counts for half, so that we react to a change of
+   behaviour within a few GCs without oscillating on a single outlier.
+   The pause recorded for a GC is only used to size the heap at the next
+   GC.
+   -------------------------------------------------------------------------- */
+
+#define pause_nursery_min 8
+#define pause_nursery_max 4
+#define pause_old_gen_factor_max 4
+
+static void
+update_pause_target (bool major, Time pause)
+{
+    const Time target = RtsFlags.GcFlags.pauseTarget;
+    Time *avg = major ? &major_gc_pause : &minor_gc_pause;
+
+    *avg = *avg == 0 ? pause : (*avg + pause) / 2;
+
+    if (major) {
+        if (*avg > target) {
+            old_gen_factor_pcnt = stg_min(old_gen_factor_pcnt * 5 / 4,
+                                          100 * pause_old_gen_factor_max);
+        } else if (*avg < target / 2) {
+            old_gen_factor_pcnt = stg_max(old_gen_factor_pcnt * 4 / 5, 100);
+        }
+    } else {
+        if (*avg > target) {
+            // shrink in proportion to the excess, but at most by half
+            Time scale = stg_max(target * 100 / *avg, 50);
+            nursery_pcnt = stg_max(nursery_pcnt * scale / 100,
+                                   100 / pause_nursery_min);
+        } else if (*avg < target / 2) {
+            nursery_pcnt = stg_min(nursery_pcnt * 5 / 4,
+                                   100 * pause_nursery_max);
+        }
+    }
+
+    debugTrace(DEBUG_gc, "pause target: %s GC pause %" FMT_Word64 "us, "
+               "nursery %u%% of -A, old gen factor %u%% of -F",
+               major ? "major" : "minor",
+               (StgWord64)TimeToUS(*avg),
+               nursery_pcnt, old_gen_factor_pcnt);
+}
+
 /* -----------------------------------------------------------------------------
    Sanity code for CAF garbage collection.
 
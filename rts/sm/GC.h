@@ -21,6 +21,7 @@ void GarbageCollect (uint32_t collect_gen,
                      bool do_heap_census,
                      bool is_overflow_gc,
                      bool deadlock_detect,
+                     bool force_major,
                      uint32_t gc_type,
                      Capability *cap,
                      bool idle_cap[]);
@@ -74,6 +75,11 @@ void gcWorkerThread (Capability *cap);
 void initGcThreads (uint32_t from, uint32_t to);
 void freeGcThreads (void);
 
+// A task run on every GC thread taking part in the current collection,
+// see Note [GC thread tasks] in GC.c
+typedef void (*gc_task_fn)(uint32_t thread_index, void *arg);
+void runGcThreadsTask (gc_task_fn task, void *arg);
+
 void resizeGenerations (void);
 
 #if defined(THREADED_RTS)
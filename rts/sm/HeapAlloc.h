@@ -44,8 +44,8 @@
    Alternatively, the older implementation caches one 12-bit block map
    that describes 4096 megablocks or 4GB of memory. If HEAP_ALLOCED is
    called for an address that is not in the cache, it calls
-   slowIsHeapAlloced (see MBlock.c) which will find the block map for
-   the 4GB block in question.
+   HEAP_ALLOCED_miss (see MBlock.c) which will find the block map for
+   the 4GB block in question, see Note [Finding the block map of an address].
    -------------------------------------------------------------------------- */
 
 #if defined(USE_LARGE_ADDRESS_SPACE)
@@ -156,6 +156,7 @@ extern MbcCacheLine mblock_cache[];
 
 typedef struct {
     StgWord32    addrHigh32;
+    uint32_t     index;         // position in mblock_maps
     MBlockMapLine lines[MBLOCK_MAP_ENTRIES];
 } MBlockMap;
 
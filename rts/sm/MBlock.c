@@ -13,6 +13,7 @@
 
 #include "RtsUtils.h"
 #include "BlockAlloc.h"
+#include "Storage.h"
 #include "Trace.h"
 #include "OSMem.h"
 
@@ -220,14 +221,13 @@ static void *getCommittedMBlocks(uint32_t n)
     return p;
 }
 
-static void decommitMBlocks(char *addr, uint32_t n)
+// Add n decommitted mblocks to the free list
+static void addDecommittedMBlocks(char *addr, uint32_t n)
 {
     struct free_list *iter, *prev;
     W_ size = MBLOCK_SIZE * (W_)n;
     W_ address = (W_)addr;
 
-    osDecommitMemory(addr, size);
-
     prev = NULL;
     for (iter = free_list_head; iter != NULL; iter = iter->next)
     {
@@ -328,6 +328,12 @@ static void decommitMBlocks(char *addr, uint32_t n)
     }
 }
 
+static void decommitMBlocks(char *addr, uint32_t n)
+{
+    osDecommitMemory(addr, MBLOCK_SIZE * (W_)n);
+    addDecommittedMBlocks(addr, n);
+}
+
 void releaseFreeMemory(void)
 {
     // This function exists for releasing address space
@@ -352,6 +358,41 @@ setHeapAlloced(void *p, StgWord8 i)
 
 #elif SIZEOF_VOID_P == 8
 
+/* Note [Finding the block map of an address]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   On a miss in mblock_cache, HEAP_ALLOCED needs the MBlockMap describing the
+   4GB of address space around the address, i.e. the map whose addrHigh32 is
+   the high 32 bits of the address. The GC misses the cache often, and when
+   the heap is spread over many 4GB regions (for instance because the
+   address space is fragmented by other mappings) searching mblock_maps for
+   the right map on every miss made it much slower.
+
+   So the maps are also indexed by a three-level radix tree over addrHigh32:
+   the top MBLOCK_DIR_ROOT_BITS select an entry of mblock_map_dir, which
+   points to a node indexed by the next MBLOCK_DIR_NODE_BITS, which points to
+   a leaf indexed by the last MBLOCK_DIR_LEAF_BITS, which points to the map.
+   A lookup is three dependent loads whatever the number of maps. Nodes and
+   leaves are allocated when the first map below them is, and like the maps
+   themselves are only freed by freeAllMBlocks(). With 48-bit addresses,
+   e.g. on x86_64, there is only ever one node and one leaf.
+
+   mblock_maps still lists the maps in the order they were created, for
+   getFirstMBlock() and getNextMBlock().
+*/
+
+#define MBLOCK_DIR_ROOT_BITS  8
+#define MBLOCK_DIR_NODE_BITS  12
+#define MBLOCK_DIR_LEAF_BITS  12
+
+#define MBLOCK_DIR_ROOT_INDEX(hi) ((hi) >> (MBLOCK_DIR_NODE_BITS + MBLOCK_DIR_LEAF_BITS))
+#define MBLOCK_DIR_NODE_INDEX(hi) (((hi) >> MBLOCK_DIR_LEAF_BITS) & ((1 << MBLOCK_DIR_NODE_BITS) - 1))
+#define MBLOCK_DIR_LEAF_INDEX(hi) ((hi) & ((1 << MBLOCK_DIR_LEAF_BITS) - 1))
+
+typedef MBlockMap *MBlockMapLeaf[1 << MBLOCK_DIR_LEAF_BITS];
+typedef MBlockMapLeaf *MBlockMapNode[1 << MBLOCK_DIR_NODE_BITS];
+
+static MBlockMapNode *mblock_map_dir[1 << MBLOCK_DIR_ROOT_BITS];
+
 MBlockMap **mblock_maps = NULL;
 
 uint32_t mblock_map_count = 0;
@@ -361,16 +402,47 @@ MbcCacheLine mblock_cache[MBC_ENTRIES];
 static MBlockMap *
 findMBlockMap(const void *p)
 {
-    uint32_t i;
     StgWord32 hi = (StgWord32) (((StgWord)p) >> 32);
-    for( i = 0; i < mblock_map_count; i++ )
-    {
-        if(mblock_maps[i]->addrHigh32 == hi)
-        {
-            return mblock_maps[i];
-        }
+    MBlockMapNode *node;
+    MBlockMapLeaf *leaf;
+
+    node = mblock_map_dir[MBLOCK_DIR_ROOT_INDEX(hi)];
+    if (node == NULL) return NULL;
+    leaf = (*node)[MBLOCK_DIR_NODE_INDEX(hi)];
+    if (leaf == NULL) return NULL;
+    return (*leaf)[MBLOCK_DIR_LEAF_INDEX(hi)];
+}
+
+static MBlockMap *
+newMBlockMap(const void *p)
+{
+    StgWord32 hi = (StgWord32) (((StgWord)p) >> 32);
+    MBlockMapNode **node;
+    MBlockMapLeaf **leaf;
+    MBlockMap *map;
+
+    map = stgMallocBytes(sizeof(MBlockMap),"markHeapAlloced(2)");
+    memset(map,0,sizeof(MBlockMap));
+    map->addrHigh32 = hi;
+    map->index = mblock_map_count;
+
+    mblock_map_count++;
+    mblock_maps = stgReallocBytes(mblock_maps,
+                                  sizeof(MBlockMap*) * mblock_map_count,
+                                  "markHeapAlloced(1)");
+    mblock_maps[mblock_map_count-1] = map;
+
+    node = &mblock_map_dir[MBLOCK_DIR_ROOT_INDEX(hi)];
+    if (*node == NULL) {
+        *node = stgCallocBytes(1, sizeof(MBlockMapNode), "newMBlockMap(node)");
     }
-    return NULL;
+    leaf = &(**node)[MBLOCK_DIR_NODE_INDEX(hi)];
+    if (*leaf == NULL) {
+        *leaf = stgCallocBytes(1, sizeof(MBlockMapLeaf), "newMBlockMap(leaf)");
+    }
+    (**leaf)[MBLOCK_DIR_LEAF_INDEX(hi)] = map;
+
+    return map;
 }
 
 StgBool HEAP_ALLOCED_miss(StgWord mblock, const void *p)
@@ -402,14 +474,7 @@ setHeapAlloced(void *p, StgWord8 i)
     MBlockMap *map = findMBlockMap(p);
     if(map == NULL)
     {
-        mblock_map_count++;
-        mblock_maps = stgReallocBytes(mblock_maps,
-                                      sizeof(MBlockMap*) * mblock_map_count,
-                                      "markHeapAlloced(1)");
-        map = mblock_maps[mblock_map_count-1] =
-            stgMallocBytes(sizeof(MBlockMap),"markHeapAlloced(2)");
-        memset(map,0,sizeof(MBlockMap));
-        map->addrHigh32 = (StgWord32) (((StgWord)p) >> 32);
+        map = newMBlockMap(p);
     }
 
     map->lines[MBLOCK_MAP_LINE(p)] = i;
@@ -475,13 +540,10 @@ void * getNextMBlock(void **state STG_UNUSED, void *p)
     uint32_t line_no;
     MBlockMapLine line;
 
-    for (j = 0; j < mblock_map_count; j++)  {
-        map = mblock_maps[j];
-        if (map->addrHigh32 == (StgWord)p >> 32) break;
-    }
-    if (j == mblock_map_count) return NULL;
+    map = findMBlockMap(p);
+    if (map == NULL) return NULL;
 
-    for (; j < mblock_map_count; j++) {
+    for (j = map->index; j < mblock_map_count; j++) {
         map = mblock_maps[j];
         if (map->addrHigh32 == (StgWord)p >> 32) {
             line_no = MBLOCK_MAP_LINE(p);
@@ -614,6 +676,32 @@ freeMBlocks(void *addr, uint32_t n)
     decommitMBlocks(addr, n);
 }
 
+// Like freeMBlocks(), for mblocks that the caller has taken off the free
+// lists of the block allocator.  Called with the SM lock held, which is
+// released during the system call returning the memory to the OS when
+// that is safe: see Note [Returning memory in the background] in
+// BlockAlloc.c.
+void
+releaseMBlocks(void *addr, uint32_t n)
+{
+    debugTrace(DEBUG_gc, "releasing %d megablock(s) at %p",n,addr);
+
+#if defined(USE_LARGE_ADDRESS_SPACE)
+    // The mblocks are not on the free list yet, so nobody can commit them
+    // again while we decommit them
+    RELEASE_SM_LOCK;
+    osDecommitMemory(addr, MBLOCK_SIZE * (W_)n);
+    ACQUIRE_SM_LOCK;
+    mblocks_allocated -= n;
+    addDecommittedMBlocks(addr, n);
+#else
+    // The OS layer may keep its own data structures, which the SM lock
+    // protects, and the OS may hand the address range out again as soon
+    // as it is unmapped, so we must hold the lock throughout.
+    freeMBlocks(addr, n);
+#endif
+}
+
 void
 freeAllMBlocks(void)
 {
@@ -644,6 +732,22 @@ freeAllMBlocks(void)
         stgFree(mblock_maps[n]);
     }
     stgFree(mblock_maps);
+    mblock_maps = NULL;
+    mblock_map_count = 0;
+
+    for (n = 0; n < (1 << MBLOCK_DIR_ROOT_BITS); n++) {
+        MBlockMapNode *node = mblock_map_dir[n];
+        if (node != NULL) {
+            uint32_t m;
+            for (m = 0; m < (1 << MBLOCK_DIR_NODE_BITS); m++) {
+                if ((*node)[m] != NULL) {
+                    stgFree((*node)[m]);
+                }
+            }
+            stgFree(node);
+            mblock_map_dir[n] = NULL;
+        }
+    }
 #endif
 
 #endif
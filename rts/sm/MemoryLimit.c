@@ -0,0 +1,165 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2022
+ *
+ * Memory limits of the process, from the cgroup it runs in
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "rts/PosixSource.h"
+#include "Rts.h"
+
+#include "MemoryLimit.h"
+#include "OSMem.h"
+#include "GetTime.h"
+#include "Trace.h"
+
+/*
+  Note [Memory limits]
+  ~~~~~~~~~~~~~~~~~~~~
+  A process running in a container is usually limited by the memory.max
+  limit of its cgroup, beyond which the kernel kills it, and sometimes by a
+  memory.high limit, beyond which the kernel throttles it and reclaims its
+  memory aggressively.  The maximum heap size (-M) has to be set by hand to
+  stay under these, so by default the heap grows until the process is
+  killed.
+
+  So on Linux, unless --cgroup-memory-limit=no is given, we read the limits
+  of the cgroup v2 of the process, and of its ancestors, at startup and
+  then once a second from the timer, since they can be changed while the
+  process runs.  From the smaller of the two limits we derive a soft heap
+  limit, soft_heap_limit_pcnt percent of it, leaving the rest for memory
+  that isn't in the heap.  Unlike -M, the soft limit never raises a heap
+  overflow: it only makes the GC collect harder as the heap approaches it,
+
+   * resizeGenerations keeps the old generations small enough for the heap
+     to fit under the soft limit, which triggers major GCs earlier, but not
+     below 1.25 times the live data, so that we don't end up doing a major
+     GC at every GC;
+
+   * after a major GC we don't keep more memory than the soft limit allows
+     (see Note [Scaling retained memory] in GC.c).
+
+  The timer also reads memory.pressure, the time the processes of the
+  cgroup spent stalled waiting for memory.  If they were stalled for more
+  than memory_pressure_pcnt percent of the time since the last poll, we
+  record that the cgroup is under memory pressure.  The next GC is then a
+  major GC (see scheduleDoGC), which returns all the memory it doesn't
+  strictly need to the OS, rather than keeping some of it in anticipation.
+
+  The limits, the soft limit and the number of GCs caused by memory
+  pressure are available from RTSStats.
+
+  The timer and the GC access the limits without synchronisation: a stale
+  value only delays a decision by a GC.
+*/
+
+#define soft_heap_limit_pcnt 90
+#define memory_pressure_pcnt 5
+
+static StgWord64 cgroup_memory_max = 0;
+static StgWord64 cgroup_memory_high = 0;
+static W_ soft_heap_limit = 0;
+
+static StgWord64 last_stall_us = 0;
+static Time last_poll_time = 0;
+static bool memory_pressure = false;
+static StgWord64 memory_pressure_gcs = 0;
+
+static void
+updateMemoryLimits (void)
+{
+    StgWord64 max, high, limit;
+
+    if (!osCGroupMemoryLimits(&max, &high)) {
+        return;
+    }
+
+    limit = max;
+    if (high != 0 && (limit == 0 || high < limit)) {
+        limit = high;
+    }
+    if (max != RELAXED_LOAD(&cgroup_memory_max)
+        || high != RELAXED_LOAD(&cgroup_memory_high)) {
+        debugTrace(DEBUG_gc, "cgroup memory limits: max %" FMT_Word64
+                   ", high %" FMT_Word64, max, high);
+    }
+    RELAXED_STORE(&cgroup_memory_max, max);
+    RELAXED_STORE(&cgroup_memory_high, high);
+    RELAXED_STORE(&soft_heap_limit,
+                  (W_)(limit / 100 * soft_heap_limit_pcnt / BLOCK_SIZE));
+}
+
+void
+initMemoryLimit (void)
+{
+    if (!RtsFlags.GcFlags.cgroupMemoryLimit) {
+        return;
+    }
+    updateMemoryLimits();
+    if (osCGroupMemoryStall(&last_stall_us)) {
+        last_poll_time = getProcessElapsedTime();
+    }
+}
+
+// Called by the timer once a second
+void
+pollMemoryLimit (void)
+{
+    StgWord64 stall_us;
+    Time now;
+
+    if (!RtsFlags.GcFlags.cgroupMemoryLimit) {
+        return;
+    }
+    updateMemoryLimits();
+
+    if (!osCGroupMemoryStall(&stall_us)) {
+        return;
+    }
+    now = getProcessElapsedTime();
+    if (last_poll_time != 0 && now > last_poll_time
+        && stall_us > last_stall_us
+        && USToTime(stall_us - last_stall_us) * 100
+             >= (now - last_poll_time) * memory_pressure_pcnt) {
+        debugTrace(DEBUG_gc, "cgroup memory pressure: stalled %" FMT_Word64
+                   "us", stall_us - last_stall_us);
+        RELAXED_STORE(&memory_pressure, true);
+    }
+    last_stall_us = stall_us;
+    last_poll_time = now;
+}
+
+W_
+softHeapLimit (void)
+{
+    return RELAXED_LOAD(&soft_heap_limit);
+}
+
+bool
+memoryPressure (void)
+{
+    return RELAXED_LOAD(&memory_pressure);
+}
+
+// Called by a major GC, returns whether it was caused by memory pressure
+bool
+endMemoryPressureGC (void)
+{
+    if (!RELAXED_LOAD(&memory_pressure)) {
+        return false;
+    }
+    RELAXED_STORE(&memory_pressure, false);
+    memory_pressure_gcs++;
+    return true;
+}
+
+void
+getMemoryLimitStats (RTSStats *s)
+{
+    s->cgroup_memory_max_bytes = RELAXED_LOAD(&cgroup_memory_max);
+    s->cgroup_memory_high_bytes = RELAXED_LOAD(&cgroup_memory_high);
+    s->soft_heap_limit_bytes =
+        (uint64_t)RELAXED_LOAD(&soft_heap_limit) * BLOCK_SIZE;
+    s->memory_pressure_gcs = memory_pressure_gcs;
+}
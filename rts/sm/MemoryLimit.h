@@ -0,0 +1,26 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2022
+ *
+ * Memory limits of the process, from the cgroup it runs in
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+void initMemoryLimit (void);
+void pollMemoryLimit (void);
+
+// The soft heap limit, in blocks, or 0 if there is none
+W_ softHeapLimit (void);
+
+// Whether the cgroup is under memory pressure, in which case the next GC
+// should be a major GC, which calls endMemoryPressureGC
+bool memoryPressure (void);
+bool endMemoryPressureGC (void);
+
+void getMemoryLimitStats (RTSStats *s);
+
+#include "EndPrivate.h"
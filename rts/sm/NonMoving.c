@@ -27,6 +27,7 @@
 #include "StablePtr.h" // markStablePtrTable
 #include "Schedule.h" // markScheduler
 #include "Weak.h" // dead_weak_ptr_list
+#include "ProfHeap.h" // newNonmovingCensus
 
 struct NonmovingHeap nonmovingHeap;
 
@@ -1050,6 +1051,13 @@ static void nonmovingMark_(MarkQueue *mark_queue, StgWeak **dead_weaks, StgTSO *
     debugTrace(DEBUG_nonmoving_gc, "Starting mark...");
     stat_startNonmovingGc();
 
+    // Take a census of the heap as we mark it. Not worth it if we're
+    // exiting, and we may be holding sm_mutex in that case, which the
+    // census' arena needs. See Note [Nonmoving heap census] in ProfHeap.c.
+    if (RtsFlags.ProfFlags.doHeapProfile && sched_state == SCHED_RUNNING) {
+        mark_queue->census = newNonmovingCensus();
+    }
+
     // Walk the list of filled segments that we collected during preparation,
     // updated their snapshot pointers and move them to the sweep list.
     for (int alloca_idx = 0; alloca_idx < NONMOVING_ALLOCA_CNT; ++alloca_idx) {
@@ -1097,6 +1105,11 @@ static void nonmovingMark_(MarkQueue *mark_queue, StgWeak **dead_weaks, StgTSO *
         nonmoving_old_weak_ptr_list = NULL;
         nonmoving_weak_ptr_list = NULL;
 
+        if (mark_queue->census != NULL) {
+            freeNonmovingCensus(mark_queue->census);
+            mark_queue->census = NULL;
+        }
+
         goto finish;
     }
 
@@ -1192,6 +1205,12 @@ static void nonmovingMark_(MarkQueue *mark_queue, StgWeak **dead_weaks, StgTSO *
     nonmovingFinishFlush(task);
 #endif
 
+    // The census of the snapshot is complete
+    if (mark_queue->census != NULL) {
+        publishNonmovingCensus(mark_queue->census);
+        mark_queue->census = NULL;
+    }
+
     current_mark_queue = NULL;
     freeMarkQueue(mark_queue);
     stgFree(mark_queue);
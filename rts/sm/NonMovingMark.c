@@ -26,6 +26,7 @@
 #include "MarkWeak.h"
 #include "sm/Storage.h"
 #include "CNF.h"
+#include "ProfHeap.h"
 
 static bool check_in_nonmoving_heap(StgClosure *p);
 static void mark_closure (MarkQueue *queue, const StgClosure *p, StgClosure **origin);
@@ -516,9 +517,11 @@ void push_closure (MarkQueue *q,
     push(q, &ent);
 }
 
+// Push a MUT_ARR_PTRS, or a long SMALL_MUT_ARR_PTRS, whose elements from
+// start_index onwards are marked in chunks of MARK_ARRAY_CHUNK_LENGTH.
 static
 void push_array (MarkQueue *q,
-                 const StgMutArrPtrs *array,
+                 const StgClosure *array,
                  StgWord start_index)
 {
     // TODO: Push this into callers where they already have the Bdescr
@@ -527,7 +530,7 @@ void push_array (MarkQueue *q,
 
     MarkQueueEnt ent = {
         .mark_array = {
-            .array = (const StgMutArrPtrs *) TAG_CLOSURE(MARK_ARRAY, UNTAG_CLOSURE((StgClosure *) array)),
+            .array = TAG_CLOSURE(MARK_ARRAY, UNTAG_CLOSURE((StgClosure *) array)),
             .start_index = start_index,
         }
     };
@@ -790,7 +793,7 @@ void markQueuePushThunkSrt (MarkQueue *q, const StgInfoTable *info)
 }
 
 void markQueuePushArray (MarkQueue *q,
-                         const StgMutArrPtrs *array,
+                         const StgClosure *array,
                          StgWord start_index)
 {
     push_array(q, array, start_index);
@@ -884,6 +887,7 @@ static void init_mark_queue_ (MarkQueue *queue)
     queue->blocks = bd;
     queue->top = (MarkQueueBlock *) bd->start;
     queue->top->head = 0;
+    queue->census = NULL;
 #if MARK_PREFETCH_QUEUE_DEPTH > 0
     memset(&queue->prefetch_queue, 0, sizeof(queue->prefetch_queue));
     queue->prefetch_head = 0;
@@ -1303,6 +1307,9 @@ mark_closure (MarkQueue *queue, const StgClosure *p0, StgClosure **origin)
                 n_nonmoving_compact_blocks -= blocks;
                 n_nonmoving_marked_compact_blocks += blocks;
                 bd->flags |= BF_MARKED;
+                if (RTS_UNLIKELY(queue->census != NULL)) {
+                    nonmovingCensusCompact(queue->census, str);
+                }
             }
 
             // N.B. the object being marked is in a compact region so by
@@ -1554,7 +1561,7 @@ mark_closure (MarkQueue *queue, const StgClosure *p0, StgClosure **origin)
     case MUT_ARR_PTRS_DIRTY:
     case MUT_ARR_PTRS_FROZEN_CLEAN:
     case MUT_ARR_PTRS_FROZEN_DIRTY:
-        markQueuePushArray(queue, (StgMutArrPtrs *) p, 0);
+        markQueuePushArray(queue, p, 0);
         break;
 
     case SMALL_MUT_ARR_PTRS_CLEAN:
@@ -1562,6 +1569,13 @@ mark_closure (MarkQueue *queue, const StgClosure *p0, StgClosure **origin)
     case SMALL_MUT_ARR_PTRS_FROZEN_CLEAN:
     case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY: {
         StgSmallMutArrPtrs *arr = (StgSmallMutArrPtrs *) p;
+        if (arr->ptrs > MARK_ARRAY_CHUNK_LENGTH) {
+            // Small arrays aren't necessarily short: mark long ones in
+            // chunks, like MUT_ARR_PTRS.
+            // See Note [Card marking for small arrays] in Scav.c.
+            markQueuePushArray(queue, p, 0);
+            break;
+        }
         for (StgWord i = 0; i < arr->ptrs; i++) {
             StgClosure **field = &arr->payload[i];
             markQueuePushClosure(queue, *field, field);
@@ -1631,6 +1645,7 @@ mark_closure (MarkQueue *queue, const StgClosure *p0, StgClosure **origin)
          * mark a large object, we only set BF_MARKED on large objects in the
          * nonmoving heap while holding nonmoving_large_objects_mutex
          */
+        bool newly_marked = false;
         ACQUIRE_LOCK(&nonmoving_large_objects_mutex);
         if (! (bd->flags & BF_MARKED)) {
             // Remove the object from nonmoving_large_objects and link it to
@@ -1640,14 +1655,21 @@ mark_closure (MarkQueue *queue, const StgClosure *p0, StgClosure **origin)
             n_nonmoving_large_blocks -= bd->blocks;
             n_nonmoving_marked_large_blocks += bd->blocks;
             bd->flags |= BF_MARKED;
+            newly_marked = true;
         }
         RELEASE_LOCK(&nonmoving_large_objects_mutex);
+        if (RTS_UNLIKELY(queue->census != NULL) && newly_marked) {
+            nonmovingCensusClosure(queue->census, p, info);
+        }
     } else if (bd->flags & BF_NONMOVING) {
         // TODO: Kill repetition
         struct NonmovingSegment *seg = nonmovingGetSegment((StgPtr) p);
         nonmoving_block_idx block_idx = nonmovingGetBlockIdx((StgPtr) p);
         nonmovingSetMark(seg, block_idx);
         nonmoving_live_words += nonmovingSegmentBlockSize(seg) / sizeof(W_);
+        if (RTS_UNLIKELY(queue->census != NULL)) {
+            nonmovingCensusClosure(queue->census, p, info);
+        }
     }
 
     // If we found a indirection to shortcut keep going.
@@ -1689,18 +1711,32 @@ nonmovingMark (MarkQueue *queue)
             mark_closure(queue, ent.mark_closure.p, ent.mark_closure.origin);
             break;
         case MARK_ARRAY: {
-            const StgMutArrPtrs *arr = (const StgMutArrPtrs *)
-                UNTAG_CLOSURE((StgClosure *) ent.mark_array.array);
+            const StgClosure *arr = UNTAG_CONST_CLOSURE(ent.mark_array.array);
+            StgWord ptrs;
+            StgClosure *const *payload;
+            switch (get_itbl(arr)->type) {
+            case SMALL_MUT_ARR_PTRS_CLEAN:
+            case SMALL_MUT_ARR_PTRS_DIRTY:
+            case SMALL_MUT_ARR_PTRS_FROZEN_CLEAN:
+            case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
+                ptrs = ((const StgSmallMutArrPtrs *) arr)->ptrs;
+                payload = ((const StgSmallMutArrPtrs *) arr)->payload;
+                break;
+            default:
+                ptrs = ((const StgMutArrPtrs *) arr)->ptrs;
+                payload = ((const StgMutArrPtrs *) arr)->payload;
+                break;
+            }
             StgWord start = ent.mark_array.start_index;
             StgWord end = start + MARK_ARRAY_CHUNK_LENGTH;
-            if (end < arr->ptrs) {
+            if (end < ptrs) {
                 // There is more to be marked after this chunk.
                 markQueuePushArray(queue, arr, end);
             } else {
-                end = arr->ptrs;
+                end = ptrs;
             }
             for (StgWord i = start; i < end; i++) {
-                markQueuePushClosure_(queue, arr->payload[i]);
+                markQueuePushClosure_(queue, payload[i]);
             }
             break;
         }
@@ -53,7 +53,7 @@ typedef struct {
                                   // See Note [Origin references in the nonmoving collector]
         } mark_closure;
         struct {
-            const StgMutArrPtrs *array;
+            const StgClosure *array; // a MUT_ARR_PTRS or SMALL_MUT_ARR_PTRS
             StgWord start_index;  // start index is shifted to the left by 16 bits
         } mark_array;
     };
@@ -94,6 +94,10 @@ typedef struct MarkQueue_ {
     // Is this a mark queue or a capability-local update remembered set?
     bool is_upd_rem_set;
 
+    // If non-NULL, the census of the objects marked from this queue.
+    // See Note [Nonmoving heap census] in ProfHeap.c.
+    struct _Census *census;
+
 #if MARK_PREFETCH_QUEUE_DEPTH > 0
     // A ring-buffer of entries which we will mark next
     MarkQueueEnt prefetch_queue[MARK_PREFETCH_QUEUE_DEPTH];
@@ -174,7 +178,7 @@ void markQueuePushClosure(MarkQueue *q,
 void markQueuePushClosure_(MarkQueue *q, StgClosure *p);
 void markQueuePushThunkSrt(MarkQueue *q, const StgInfoTable *info);
 void markQueuePushFunSrt(MarkQueue *q, const StgInfoTable *info);
-void markQueuePushArray(MarkQueue *q, const StgMutArrPtrs *array, StgWord start_index);
+void markQueuePushArray(MarkQueue *q, const StgClosure *array, StgWord start_index);
 void updateRemembSetPushThunkEager(Capability *cap,
                                   const StgThunkInfoTable *orig_info,
                                   StgThunk *thunk);
@@ -17,6 +17,14 @@ void osReleaseFreeMemory(void);
 void osFreeAllMBlocks(void);
 size_t getPageSize (void);
 StgWord64 getPhysicalMemorySize (void);
+bool osCGroupMemoryLimits (StgWord64 *max, StgWord64 *high);
+bool osCGroupMemoryStall (StgWord64 *stall_us);
+#if defined(linux_HOST_OS)
+bool parseCGroupFile (const char *proc_cgroup, const char *mount,
+                      char *dir, size_t len);
+void cgroupMemoryLimits (const char *mount, const char *cgroup,
+                         StgWord64 *max, StgWord64 *high);
+#endif
 void setExecutable (void *p, W_ len, bool exec);
 bool osBuiltWithNumaSupport(void); // See #14956
 bool osNumaAvailable(void);
@@ -59,7 +59,7 @@
 #include "Capability.h"
 #include "LdvProfile.h"
 #include "HeapUtils.h"
-#include "Hash.h"
+#include "CNF.h"
 
 #include "sm/MarkWeak.h"
 #include "sm/NonMoving.h" // for nonmoving_set_closure_mark_bit
@@ -84,6 +84,7 @@ static void scavenge_large_bitmap (StgPtr p,
 # define scavenge_fun_srt(info) scavenge_fun_srt1(info)
 # define scavenge_thunk_srt(info) scavenge_thunk_srt1(info)
 # define scavenge_mut_arr_ptrs(info) scavenge_mut_arr_ptrs1(info)
+# define scavenge_small_mut_arr_ptrs(a) scavenge_small_mut_arr_ptrs1(a)
 # define scavenge_PAP(pap) scavenge_PAP1(pap)
 # define scavenge_AP(ap) scavenge_AP1(ap)
 # define scavenge_compact(str) scavenge_compact1(str)
@@ -155,30 +156,10 @@ scavengeTSO (StgTSO *tso)
    Scavenging compact objects
    ------------------------------------------------------------------------- */
 
-typedef struct {
-    // We must save gct when calling mapHashTable(), which is compiled
-    // without GCThread.h and so uses a different calling convention.
-    // See also GC.c:mark_root where we do a similar thing.
-    gc_thread *saved_gct;
-    HashTable *newHash;
-} MapHashData;
-
-static void
-evacuate_hash_entry(MapHashData *dat, StgWord key, const void *value)
-{
-    StgClosure *p = (StgClosure*)key;
-#if defined(THREADED_RTS)
-    gc_thread *old_gct = gct;
-#endif
-
-    SET_GCT(dat->saved_gct);
-    evacuate(&p);
-    insertHashTable(dat->newHash, (StgWord)p, value);
-    SET_GCT(old_gct);
-}
-
 /* Here we scavenge the sharing-preservation hash-table, which may contain keys
- * living in from-space.
+ * living in from-space. The keys are evacuated in place, and the table is
+ * only re-hashed if one of them moved. See Note [Sharing-preserving
+ * compaction] in CNF.c.
  */
 void
 scavenge_compact(StgCompactNFData *str)
@@ -188,13 +169,20 @@ scavenge_compact(StgCompactNFData *str)
     gct->eager_promotion = false;
 
     if (str->hash) {
-        MapHashData dat;
-        dat.saved_gct = gct;
-        HashTable *newHash = allocHashTable();
-        dat.newHash = newHash;
-        mapHashTable(str->hash, (void*)&dat, (MapHashFn)evacuate_hash_entry);
-        freeHashTable(str->hash, NULL);
-        str->hash = newHash;
+        CompactHash *hash = str->hash;
+        bool moved = false;
+
+        for (StgWord i = 0; i <= hash->mask; i++) {
+            CompactHashEntry *e = &hash->entries[i];
+            if (e->key != NULL) {
+                StgClosure *key = e->key;
+                evacuate(&e->key);
+                moved |= e->key != key;
+            }
+        }
+        if (moved) {
+            rehashCompactHash(hash);
+        }
     }
 
     debugTrace(DEBUG_compact,
@@ -284,6 +272,119 @@ static StgPtr scavenge_mut_arr_ptrs_marked (StgMutArrPtrs *a)
     return (StgPtr)a + mut_arr_ptrs_sizeW(a);
 }
 
+/* -----------------------------------------------------------------------------
+   Small mutable arrays of pointers
+   -------------------------------------------------------------------------- */
+
+/* Note [Card marking for small arrays]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   The card table of a MUT_ARR_PTRS lets a minor GC traverse only the parts of
+   a dirty array on the mutable list that were written to since the last GC
+   (scavenge_mut_arr_ptrs_marked). SmallArray#s were designed for arrays too
+   small for that to matter, so they used to have no card table, and a minor GC
+   traversed the whole of every dirty SMALL_MUT_ARR_PTRS on the mutable list.
+   That adds up for structures made of many long-lived, moderately sized small
+   arrays that are written to one element at a time, such as the nodes of a hash
+   array mapped trie.
+
+   A small array with at least SMALL_MUT_ARR_PTRS_CARD_THRESHOLD elements
+   therefore has a card table after its payload, each byte of which covers
+   (1 << SMALL_MUT_ARR_PTRS_CARD_BITS) elements; see the StgSmallMutArrPtrs
+   macros in ClosureMacros.h. The cards are finer than those of a MUT_ARR_PTRS,
+   so that arrays of a few dozen elements have several of them. Smaller arrays
+   have no card table and don't grow. Whether an array has a card table only
+   depends on its number of elements, so it needs no flag:
+
+     - writeSmallArray#, casSmallArray# and copy(Mutable)SmallArray# mark the
+       cards of the elements they write, if the array has a card table;
+
+     - scavenge_small_mut_arr_ptrs traverses the whole array and clears the
+       cards whose elements no longer point into a younger generation, like
+       scavenge_mut_arr_ptrs. It is used whenever the GC traverses a small
+       array other than from the mutable list, so an array has up-to-date cards
+       by the time it is on the mutable list of an old generation, and the card
+       table needn't be initialised when the array is allocated;
+
+     - scavenge_mutable_list traverses only the marked cards of a dirty small
+       array with a card table, with scavenge_small_mut_arr_ptrs_marked.
+
+   shrinkSmallMutableArray# moves the card table to the end of the smaller
+   payload, and marks all of its cards.
+
+   The non-moving collector doesn't use the cards, since it marks from a
+   snapshot of the heap rather than from the mutable lists, but like an
+   array with a card table, a small array may well have more than a few
+   elements: the non-moving mark pushes the elements of a long small array in
+   chunks, like those of a MUT_ARR_PTRS (see push_array in NonMovingMark.c),
+   rather than all at once.
+*/
+
+StgPtr scavenge_small_mut_arr_ptrs (StgSmallMutArrPtrs *a)
+{
+    W_ m;
+    bool any_failed;
+    StgPtr p, q, end;
+
+    p = (StgPtr)&a->payload[0];
+    end = (StgPtr)&a->payload[a->ptrs];
+
+    if (!smallMutArrPtrsHasCards(a->ptrs)) {
+        for (; p < end; p++) {
+            evacuate((StgClosure**)p);
+        }
+        return end;
+    }
+
+    any_failed = false;
+    for (m = 0; p < end; m++)
+    {
+        q = stg_min(p + (1 << SMALL_MUT_ARR_PTRS_CARD_BITS), end);
+        for (; p < q; p++) {
+            evacuate((StgClosure**)p);
+        }
+        if (gct->failed_to_evac) {
+            any_failed = true;
+            *smallMutArrPtrsCard(a,m) = 1;
+            gct->failed_to_evac = false;
+        } else {
+            *smallMutArrPtrsCard(a,m) = 0;
+        }
+    }
+
+    gct->failed_to_evac = any_failed;
+    return (StgPtr)a + small_mut_arr_ptrs_sizeW(a);
+}
+
+// scavenge only the marked areas of a SMALL_MUT_ARR_PTRS with a card table
+static StgPtr scavenge_small_mut_arr_ptrs_marked (StgSmallMutArrPtrs *a)
+{
+    W_ m;
+    StgPtr p, q;
+    bool any_failed;
+
+    any_failed = false;
+    for (m = 0; m < smallMutArrPtrsCards(a->ptrs); m++)
+    {
+        if (*smallMutArrPtrsCard(a,m) != 0) {
+            p = (StgPtr)&a->payload[m << SMALL_MUT_ARR_PTRS_CARD_BITS];
+            q = stg_min(p + (1 << SMALL_MUT_ARR_PTRS_CARD_BITS),
+                        (StgPtr)&a->payload[a->ptrs]);
+            for (; p < q; p++) {
+                evacuate((StgClosure**)p);
+            }
+            if (gct->failed_to_evac) {
+                any_failed = true;
+                gct->failed_to_evac = false;
+            } else {
+                *smallMutArrPtrsCard(a,m) = 0;
+            }
+        }
+    }
+
+    gct->failed_to_evac = any_failed;
+    return (StgPtr)a + small_mut_arr_ptrs_sizeW(a);
+}
+
 STATIC_INLINE StgPtr
 scavenge_small_bitmap (StgPtr p, StgWord size, StgWord bitmap)
 {
@@ -724,17 +825,12 @@ scavenge_block (bdescr *bd)
     case SMALL_MUT_ARR_PTRS_DIRTY:
         // follow everything
     {
-        StgPtr next;
-
         // We don't eagerly promote objects pointed to by a mutable
         // array, but if we find the array only points to objects in
         // the same or an older generation, we mark it "clean" and
         // avoid traversing it during minor GCs.
         gct->eager_promotion = false;
-        next = p + small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs*)p);
-        for (p = (P_)((StgSmallMutArrPtrs *)p)->payload; p < next; p++) {
-            evacuate((StgClosure **)p);
-        }
+        p = scavenge_small_mut_arr_ptrs((StgSmallMutArrPtrs*)p);
         gct->eager_promotion = saved_eager_promotion;
 
         if (gct->failed_to_evac) {
@@ -751,12 +847,7 @@ scavenge_block (bdescr *bd)
     case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
         // follow everything
     {
-        StgPtr next;
-
-        next = p + small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs*)p);
-        for (p = (P_)((StgSmallMutArrPtrs *)p)->payload; p < next; p++) {
-            evacuate((StgClosure **)p);
-        }
+        p = scavenge_small_mut_arr_ptrs((StgSmallMutArrPtrs*)p);
 
         if (gct->failed_to_evac) {
             RELEASE_STORE(&((StgClosure *) q)->header.info, &stg_SMALL_MUT_ARR_PTRS_FROZEN_DIRTY_info);
@@ -1118,7 +1209,6 @@ scavenge_mark_stack(void)
         case SMALL_MUT_ARR_PTRS_DIRTY:
             // follow everything
         {
-            StgPtr next;
             bool saved_eager;
 
             // We don't eagerly promote objects pointed to by a mutable
@@ -1127,10 +1217,7 @@ scavenge_mark_stack(void)
             // avoid traversing it during minor GCs.
             saved_eager = gct->eager_promotion;
             gct->eager_promotion = false;
-            next = p + small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs*)p);
-            for (p = (P_)((StgSmallMutArrPtrs *)p)->payload; p < next; p++) {
-                evacuate((StgClosure **)p);
-            }
+            scavenge_small_mut_arr_ptrs((StgSmallMutArrPtrs*)p);
             gct->eager_promotion = saved_eager;
 
             if (gct->failed_to_evac) {
@@ -1147,12 +1234,7 @@ scavenge_mark_stack(void)
         case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
             // follow everything
         {
-            StgPtr next, q = p;
-
-            next = p + small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs*)p);
-            for (p = (P_)((StgSmallMutArrPtrs *)p)->payload; p < next; p++) {
-                evacuate((StgClosure **)p);
-            }
+            scavenge_small_mut_arr_ptrs((StgSmallMutArrPtrs*)p);
 
             if (gct->failed_to_evac) {
                 RELEASE_STORE(&((StgClosure *)q)->header.info, &stg_SMALL_MUT_ARR_PTRS_FROZEN_DIRTY_info);
@@ -1435,7 +1517,6 @@ scavenge_one(StgPtr p)
     case SMALL_MUT_ARR_PTRS_CLEAN:
     case SMALL_MUT_ARR_PTRS_DIRTY:
     {
-        StgPtr next, q;
         bool saved_eager;
 
         // We don't eagerly promote objects pointed to by a mutable
@@ -1444,17 +1525,13 @@ scavenge_one(StgPtr p)
         // avoid traversing it during minor GCs.
         saved_eager = gct->eager_promotion;
         gct->eager_promotion = false;
-        q = p;
-        next = p + small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs*)p);
-        for (p = (P_)((StgSmallMutArrPtrs *)p)->payload; p < next; p++) {
-            evacuate((StgClosure **)p);
-        }
+        scavenge_small_mut_arr_ptrs((StgSmallMutArrPtrs *)p);
         gct->eager_promotion = saved_eager;
 
         if (gct->failed_to_evac) {
-            RELEASE_STORE(&((StgClosure *)q)->header.info, &stg_SMALL_MUT_ARR_PTRS_DIRTY_info);
+            RELEASE_STORE(&((StgClosure *)p)->header.info, &stg_SMALL_MUT_ARR_PTRS_DIRTY_info);
         } else {
-            RELEASE_STORE(&((StgClosure *)q)->header.info, &stg_SMALL_MUT_ARR_PTRS_CLEAN_info);
+            RELEASE_STORE(&((StgClosure *)p)->header.info, &stg_SMALL_MUT_ARR_PTRS_CLEAN_info);
         }
 
         gct->failed_to_evac = true;
@@ -1465,17 +1542,12 @@ scavenge_one(StgPtr p)
     case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
     {
         // follow everything
-        StgPtr next, q=p;
-
-        next = p + small_mut_arr_ptrs_sizeW((StgSmallMutArrPtrs*)p);
-        for (p = (P_)((StgSmallMutArrPtrs *)p)->payload; p < next; p++) {
-            evacuate((StgClosure **)p);
-        }
+        scavenge_small_mut_arr_ptrs((StgSmallMutArrPtrs *)p);
 
         if (gct->failed_to_evac) {
-            RELEASE_STORE(&((StgClosure *)q)->header.info, &stg_SMALL_MUT_ARR_PTRS_FROZEN_DIRTY_info);
+            RELEASE_STORE(&((StgClosure *)p)->header.info, &stg_SMALL_MUT_ARR_PTRS_FROZEN_DIRTY_info);
         } else {
-            RELEASE_STORE(&((StgClosure *)q)->header.info, &stg_SMALL_MUT_ARR_PTRS_FROZEN_CLEAN_info);
+            RELEASE_STORE(&((StgClosure *)p)->header.info, &stg_SMALL_MUT_ARR_PTRS_FROZEN_CLEAN_info);
         }
         break;
     }
@@ -1671,6 +1743,31 @@ scavenge_mutable_list(bdescr *bd, generation *gen)
                 recordMutableGen_GC((StgClosure *)p,gen_no);
                 continue;
             }
+            case SMALL_MUT_ARR_PTRS_DIRTY:
+            {
+                // See Note [Card marking for small arrays]
+                StgSmallMutArrPtrs *a = (StgSmallMutArrPtrs *)p;
+                if (!smallMutArrPtrsHasCards(a->ptrs)) {
+                    break;
+                }
+
+                bool saved_eager_promotion;
+                saved_eager_promotion = gct->eager_promotion;
+                gct->eager_promotion = false;
+
+                scavenge_small_mut_arr_ptrs_marked(a);
+
+                if (gct->failed_to_evac) {
+                    RELEASE_STORE(&((StgClosure *)p)->header.info, &stg_SMALL_MUT_ARR_PTRS_DIRTY_info);
+                } else {
+                    RELEASE_STORE(&((StgClosure *)p)->header.info, &stg_SMALL_MUT_ARR_PTRS_CLEAN_info);
+                }
+
+                gct->eager_promotion = saved_eager_promotion;
+                gct->failed_to_evac = false;
+                recordMutableGen_GC((StgClosure *)p,gen_no);
+                continue;
+            }
             default:
                 ;
             }
@@ -22,6 +22,7 @@ void    scavenge_stack (StgPtr p, StgPtr stack_end);
 void    scavenge_fun_srt (const StgInfoTable *info);
 void    scavenge_thunk_srt (const StgInfoTable *info);
 StgPtr  scavenge_mut_arr_ptrs (StgMutArrPtrs *a);
+StgPtr  scavenge_small_mut_arr_ptrs (StgSmallMutArrPtrs *a);
 StgPtr  scavenge_PAP (StgPAP *pap);
 StgPtr  scavenge_AP (StgAP *ap);
 void    scavenge_compact (StgCompactNFData *str);
@@ -34,6 +35,7 @@ void    scavenge_stack1 (StgPtr p, StgPtr stack_end);
 void    scavenge_fun_srt1 (const StgInfoTable *info);
 void    scavenge_thunk_srt1 (const StgInfoTable *info);
 StgPtr  scavenge_mut_arr_ptrs1 (StgMutArrPtrs *a);
+StgPtr  scavenge_small_mut_arr_ptrs1 (StgSmallMutArrPtrs *a);
 StgPtr  scavenge_PAP1 (StgPAP *pap);
 StgPtr  scavenge_AP1 (StgAP *ap);
 void    scavenge_compact1 (StgCompactNFData *str);
@@ -42,6 +42,7 @@
 #include "GC.h"
 #include "Evac.h"
 #include "NonMoving.h"
+#include "MemoryLimit.h"
 #if defined(ios_HOST_OS) || defined(darwin_HOST_OS)
 #include "Hash.h"
 #endif
@@ -258,6 +259,8 @@ initStorage (void)
   }
   storageAddCapabilities(0, n_capabilities);
 
+  initMemoryLimit();
+
   IF_DEBUG(gc, statDescribeGens());
 
   RELEASE_SM_LOCK;
@@ -339,6 +342,7 @@ void storageAddCapabilities (uint32_t from, uint32_t to)
 void
 exitStorage (void)
 {
+    exitMemoryReturn();
     nonmovingExit();
     updateNurseriesStats();
     stat_exitReport();
@@ -1561,7 +1565,8 @@ dirty_MVAR(StgRegTable *reg, StgClosure *p, StgClosure *old_val)
 //
 // Calculate the total allocated memory since the start of the
 // program.  Also emits events reporting the per-cap allocation
-// totals.
+// totals, and the per-cap stack chunk counts (see Note [Stack chunk
+// pool] in Threads.c).
 //
 uint64_t
 calcTotalAllocated (void)
@@ -1575,6 +1580,7 @@ calcTotalAllocated (void)
         traceEventHeapAllocated(capabilities[n],
                                 CAPSET_HEAP_DEFAULT,
                                 capabilities[n]->total_allocated * sizeof(W_));
+        traceStackChunkStats(capabilities[n]);
     }
 
     return tot_alloc;
@@ -423,6 +423,18 @@ StgWord64 getPhysicalMemorySize (void)
     return physMemSize;
 }
 
+/* There are no cgroups on Windows */
+bool osCGroupMemoryLimits (StgWord64 *max STG_UNUSED,
+                           StgWord64 *high STG_UNUSED)
+{
+    return false;
+}
+
+bool osCGroupMemoryStall (StgWord64 *stall_us STG_UNUSED)
+{
+    return false;
+}
+
 void setExecutable (void *p, W_ len, bool exec)
 {
     DWORD dwOldProtect = 0;
@@ -76,6 +76,14 @@ stopTicker(void)
     }
 }
 
+// This ticker ticks at every interval.  See Note [Tickless idle] in
+// rts/Timer.c
+void
+wakeTicker (void)
+{
+    return;
+}
+
 void
 exitTicker (bool wait)
 {
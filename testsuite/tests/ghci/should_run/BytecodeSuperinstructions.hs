@@ -0,0 +1,24 @@
+module Main where
+
+-- Scrutinising a local variable compiles to PUSH_L o; ENTER, which the
+-- peephole pass in mkProtoBCO fuses into PUSH_L_ENTER.
+len :: [a] -> Int
+len xs = case xs of
+  [] -> 0
+  (_:ys) -> 1 + len ys
+
+-- Tail calls and returns end with SLIDE n by; ENTER, which is fused into
+-- SLIDE_ENTER.
+pick :: Bool -> a -> a -> a
+pick b x y = if b then x else y
+
+sumTo :: Int -> Int -> Int
+sumTo acc 0 = acc
+sumTo acc n = sumTo (acc + n) (n - 1)
+
+main :: IO ()
+main = do
+  putStrLn ("result: " ++ show (len [1 .. 1000 :: Int]))
+  putStrLn ("result: " ++ show (pick True 'a' 'b', pick False 'a' 'b'))
+  putStrLn ("result: " ++ show (sumTo 0 100000))
+  putStrLn ("result: " ++ show (map (`pick` Just 'x') [True, False] <*> [Nothing]))
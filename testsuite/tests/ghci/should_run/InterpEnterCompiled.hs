@@ -0,0 +1,27 @@
+module Main where
+
+import Data.Char (toUpper, toLower, isDigit)
+import Data.List (foldl')
+
+-- Interpreted code calling compiled library functions. Each call site
+-- below is run many times, with the same compiled function each time, or
+-- with a different one each time round, and with arguments of different
+-- representations.
+apply :: (a -> b) -> a -> b
+apply f x = f x
+
+main :: IO ()
+main = do
+  -- the same compiled function, over and over
+  print (length (filter (== 'B')
+                 (map (apply toUpper) (concat (replicate 1000 "abc")))))
+  print (foldl' (\acc c -> if apply isDigit c then acc + 1 else acc)
+                (0 :: Int) (concat (replicate 1000 "a1b2")))
+  -- alternating compiled functions at the same call site
+  let fs = cycle [toUpper, toLower, succ, pred]
+  putStrLn (take 8 (zipWith apply fs "aBcDeFgH"))
+  print (sum (zipWith apply (cycle [negate, abs, (* 2), subtract 1])
+                            [1 .. 10000 :: Int]))
+  -- compiled and interpreted functions at the same call site
+  let gs = cycle [toUpper, \c -> c, toLower]
+  putStrLn (zipWith apply gs "abcABCabc")
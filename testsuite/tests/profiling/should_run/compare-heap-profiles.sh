@@ -0,0 +1,63 @@
+#! /bin/sh
+
+# Usage: compare-heap-profiles.sh A.hp B.hp [min-bytes]
+#
+# Check that two heap profiles of the same program, taken with different
+# RTS options (e.g. with and without parallel GC), contain the same
+# censuses with the same per-band totals. Bands with less than min-bytes
+# (default 100000) in both profiles are ignored, since a small amount of RTS
+# data (stacks, TSOs, ...) legitimately varies between runs.
+#
+# For retainer profiles the set ID is stripped from the band name, and the
+# retainers in each set are sorted, since IDs are numbered in the order in
+# which the sets happened to be created.
+
+min=${3:-100000}
+
+awk -F '\t' -v min="$min" '
+FNR == 1 { f++ ; n = 0 }
+/^BEGIN_SAMPLE/ { n++ ; censuses[f] = n ; in_sample = 1 ; next }
+/^END_SAMPLE/ { in_sample = 0 ; next }
+in_sample && NF == 2 {
+    band = $1
+    if (band ~ /^\([0-9]+\)/) {
+        sub(/^\([0-9]+\)/, "", band)
+        k = split(band, rs, ",")
+        # insertion sort of the retainer names
+        for (i = 2; i <= k; i++) {
+            x = rs[i]
+            for (j = i - 1; j >= 1 && rs[j] > x; j--) rs[j + 1] = rs[j]
+            rs[j + 1] = x
+        }
+        band = rs[1]
+        for (i = 2; i <= k; i++) band = band "," rs[i]
+    }
+    key = n SUBSEP band
+    total[f, key] += $2
+    keys[key] = 1
+}
+END {
+    if (censuses[1] != censuses[2]) {
+        print "census counts differ: " censuses[1] " vs " censuses[2]
+        exit 1
+    }
+    bad = 0
+    compared = 0
+    for (key in keys) {
+        a = total[1, key] + 0
+        b = total[2, key] + 0
+        if (a < min && b < min) continue
+        compared++
+        if (a != b) {
+            split(key, kb, SUBSEP)
+            print "census " kb[1] ", " kb[2] ": " a " vs " b
+            bad = 1
+        }
+    }
+    if (compared == 0) {
+        print "no bands of at least " min " bytes"
+        exit 1
+    }
+    if (!bad) print "heap profiles agree"
+    exit bad
+}' "$1" "$2"
@@ -0,0 +1,27 @@
+{-# LANGUAGE BangPatterns #-}
+module Main where
+
+import Control.Concurrent
+import Control.Exception
+import Control.Monad
+import System.Mem
+import GHC.Profiling
+
+-- Heap profiling with the nonmoving collector, which takes the census of
+-- the nonmoving heap while marking it (see Note [Nonmoving heap census]).
+-- The Makefile compares the resulting profile with one taken by the
+-- copying collector.
+main :: IO ()
+main = do
+  let !t = [0..200000] :: [Int]
+  evaluate (length t)
+  -- Move t into the old generation, and give the concurrent mark time to
+  -- finish, so that each census below counts it in the nonmoving heap.
+  replicateM_ 2 $ do
+    performMajorGC
+    threadDelay 100000
+  forM_ [1..5 :: Int] $ \_ -> do
+    requestHeapCensus
+    performMajorGC
+    evaluate (length t)
+  print (sum t)
@@ -0,0 +1,20 @@
+{-# LANGUAGE BangPatterns #-}
+module Main where
+
+import Control.Exception
+import Control.Monad
+import System.Mem
+import GHC.Profiling
+
+-- Take a number of heap censuses after parallel GCs, which share the
+-- census between the GC threads (see Note [Parallel heap census]). The
+-- Makefile compares the resulting profile with one taken by a sequential GC.
+main :: IO ()
+main = do
+  let !t = [0..500000] :: [Int]
+  evaluate (length t)
+  forM_ [1..5 :: Int] $ \_ -> do
+    requestHeapCensus
+    performGC
+    evaluate (length t)
+  print (sum t)
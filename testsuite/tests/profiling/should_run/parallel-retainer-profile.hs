@@ -0,0 +1,53 @@
+{-# LANGUAGE BangPatterns #-}
+module Main where
+
+import Control.Exception
+import Control.Monad
+import Data.Bits
+import Data.IORef
+import System.Mem
+import GHC.Profiling
+
+-- Retainer profile a heavily shared heap after parallel GCs, which share
+-- the traversal between the GC threads (see Note [Parallel heap
+-- traversal]). The Makefile compares the resulting profile with one taken
+-- by a sequential GC.
+--
+-- There are eight retainers, IORefs allocated by ret0 .. ret7, and 255
+-- chunks of data: retainer i holds chunk m when bit i of m is set. So each
+-- chunk is retained by a different set of retainers, which the GC threads
+-- build concurrently from the shared sets in the RetainerSet.c cache.
+main :: IO ()
+main = do
+  n <- evaluate 2000
+  let chunks = [ force [m * n .. m * n + n - 1] | m <- [1 .. 255] ]
+      held i = force [ c | (m, c) <- zip [1 :: Int ..] chunks, testBit m i ]
+  refs <- sequence [ ret0 (held 0), ret1 (held 1), ret2 (held 2)
+                   , ret3 (held 3), ret4 (held 4), ret5 (held 5)
+                   , ret6 (held 6), ret7 (held 7) ]
+  mapM_ (\ref -> readIORef ref >>= evaluate . sum . map sum) refs
+  forM_ [1..5 :: Int] $ \_ -> do
+    requestHeapCensus
+    performMajorGC
+  sums <- mapM (fmap (sum . map sum) . readIORef) refs
+  print (sum sums)
+  where
+    force xs = length xs `seq` xs
+
+ret0, ret1, ret2, ret3, ret4, ret5, ret6, ret7 :: a -> IO (IORef a)
+ret0 x = newIORef x
+{-# NOINLINE ret0 #-}
+ret1 x = newIORef x
+{-# NOINLINE ret1 #-}
+ret2 x = newIORef x
+{-# NOINLINE ret2 #-}
+ret3 x = newIORef x
+{-# NOINLINE ret3 #-}
+ret4 x = newIORef x
+{-# NOINLINE ret4 #-}
+ret5 x = newIORef x
+{-# NOINLINE ret5 #-}
+ret6 x = newIORef x
+{-# NOINLINE ret6 #-}
+ret7 x = newIORef x
+{-# NOINLINE ret7 #-}
@@ -0,0 +1,39 @@
+{-# LANGUAGE BangPatterns #-}
+-- One capability, a compute-bound thread that hardly allocates (so that it
+-- doesn't trigger GCs), and a thread that keeps sleeping, with threadDelay
+-- and with a safe foreign call.  Nothing else is on the run queue when the
+-- timer looks at the capability, yet the sleeping thread must get to run
+-- again soon after it wakes up.  See Note [Adaptive context switching] in
+-- rts/Timer.c.
+
+import Control.Concurrent
+import Control.Exception
+import Control.Monad
+import Foreign.C.Types
+import GHC.Clock
+
+foreign import ccall safe "usleep" c_usleep :: CUInt -> IO CInt
+
+spin :: Int -> Int -> Int
+spin !acc 0 = acc
+spin !acc n = spin (acc + n) (n - 1)
+
+-- The longest time it took to come back from a 10ms sleep
+worst :: IO () -> IO Double
+worst sleep = fmap maximum $ replicateM 20 $ do
+  t0 <- getMonotonicTime
+  sleep
+  t1 <- getMonotonicTime
+  return (t1 - t0)
+
+main :: IO ()
+main = do
+  _ <- forkIO $ forever $ void $ evaluate (spin 0 1000000)
+  yield
+  d <- worst (threadDelay 10000)
+  c <- worst (void (c_usleep 10000))
+  -- With a 20ms -C interval these should be well under 0.1s; leave room
+  -- for a loaded machine.
+  when (d > 1) $ putStrLn ("threadDelay took " ++ show d ++ "s")
+  when (c > 1) $ putStrLn ("safe call took " ++ show c ++ "s")
+  putStrLn "done"
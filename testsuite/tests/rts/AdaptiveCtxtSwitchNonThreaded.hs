@@ -0,0 +1,52 @@
+{-# LANGUAGE BangPatterns #-}
+-- The non-threaded version of AdaptiveCtxtSwitch: one compute-bound thread
+-- that hardly allocates, and a thread that keeps waiting, in threadDelay
+-- (on the sleeping queue) and for a pipe to become readable (on the
+-- blocked queue). Only the scheduler polls those queues, so the compute-bound
+-- thread must still be interrupted although nothing is on the run queue.
+-- See Note [Adaptive context switching] in rts/Timer.c.
+
+import Control.Concurrent
+import Control.Exception
+import Control.Monad
+import Foreign.C.Error
+import Foreign.C.Types
+import Foreign.Marshal.Array
+import Foreign.Ptr
+import GHC.Clock
+import System.Posix.Types
+
+foreign import ccall unsafe "pipe" c_pipe :: Ptr CInt -> IO CInt
+-- write a byte to the fd from another OS thread, 10ms from now
+foreign import ccall unsafe "write_later" c_write_later :: CInt -> IO ()
+foreign import ccall unsafe "read_byte" c_read_byte :: CInt -> IO ()
+
+spin :: Int -> Int -> Int
+spin !acc 0 = acc
+spin !acc n = spin (acc + n) (n - 1)
+
+-- The longest time it took to come back from a 10ms wait
+worst :: IO () -> IO Double
+worst wait = fmap maximum $ replicateM 20 $ do
+  t0 <- getMonotonicTime
+  wait
+  t1 <- getMonotonicTime
+  return (t1 - t0)
+
+main :: IO ()
+main = do
+  [r, w] <- allocaArray 2 $ \fds -> do
+    throwErrnoIfMinus1_ "pipe" (c_pipe fds)
+    peekArray 2 fds
+  _ <- forkIO $ forever $ void $ evaluate (spin 0 1000000)
+  yield
+  d <- worst (threadDelay 10000)
+  p <- worst $ do
+    c_write_later w
+    threadWaitRead (Fd r)
+    c_read_byte r
+  -- With a 20ms -C interval these should be well under 0.1s; leave room
+  -- for a loaded machine.
+  when (d > 1) $ putStrLn ("threadDelay took " ++ show d ++ "s")
+  when (p > 1) $ putStrLn ("threadWaitRead took " ++ show p ++ "s")
+  putStrLn "done"
@@ -0,0 +1,30 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+static void *writer(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    usleep(10000);
+    if (write(fd, "x", 1) != 1) {
+        _exit(1);
+    }
+    return NULL;
+}
+
+void write_later(int fd)
+{
+    pthread_t t;
+    if (pthread_create(&t, NULL, writer, (void *)(intptr_t)fd) != 0) {
+        _exit(1);
+    }
+    pthread_detach(t);
+}
+
+void read_byte(int fd)
+{
+    char c;
+    if (read(fd, &c, 1) != 1) {
+        _exit(1);
+    }
+}
@@ -0,0 +1,17 @@
+-- Run many C finalizers on the finalizer threads, and check that they have
+-- all run by the time the next GC starts.
+
+import Control.Monad
+import Foreign
+import System.Mem
+
+foreign import ccall "&count_finalizer" countFinalizer :: FinalizerPtr ()
+foreign import ccall "finalized_count" finalizedCount :: IO Word
+
+main :: IO ()
+main = do
+  forM_ [1 .. 100000 :: Int] $ \i ->
+    newForeignPtr countFinalizer (nullPtr `plusPtr` i)
+  performMajorGC
+  performMajorGC
+  finalizedCount >>= print
@@ -0,0 +1,11 @@
+#include <Rts.h>
+
+static StgWord finalized = 0;
+
+void count_finalizer(void *p STG_UNUSED) {
+  atomic_inc(&finalized, 1);
+}
+
+StgWord finalized_count(void) {
+  return RELAXED_LOAD(&finalized);
+}
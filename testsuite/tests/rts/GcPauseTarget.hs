@@ -0,0 +1,21 @@
+-- A program with a growing amount of live data, run by the Makefile with
+-- and without a pause target. A long target lets the allocation area grow,
+-- so there are fewer GCs than without one, and a very short one shrinks it,
+-- so there are more. The heap has to stay under the maximum heap size in
+-- any case. See Note [Pause-targeted heap sizing] in rts/sm/GC.c.
+
+import Data.List (foldl')
+import GHC.Stats
+import System.Environment
+
+main :: IO ()
+main = do
+  [out] <- getArgs
+  let live = [ [i .. i + 100] | i <- [1 .. 20000 :: Int] ]
+  print (foldl' (\acc xs -> acc + sum xs) 0 live)
+  print (length live)
+  stats <- getRTSStats
+  -- the Makefile passes -M256m
+  putStrLn $ "heap under -M: "
+    ++ show (max_mem_in_use_bytes stats <= 256 * 1024 * 1024)
+  writeFile out (show (gcs stats) ++ "\n")
@@ -0,0 +1,37 @@
+{-# LANGUAGE ForeignFunctionInterface #-}
+
+import Control.Monad
+import GHC.Stats
+import System.Mem
+
+-- Test that every GC pause is recorded in the pause histograms returned by
+-- getRTSStats, and that the reported quantiles are ordered. The histograms
+-- are checked both from C and through GHC.Stats.
+main :: IO ()
+main = do
+  replicateM_ 20 performMinorGC
+  replicateM_ 5 performMajorGC
+  c_check_pause_histograms
+
+  stats <- getRTSStats
+  let hists = gc_pause_hist stats
+      counts = map pause_hist_count hists
+  putStrLn $ "Haskell generations: " ++ show (length hists)
+  -- the stats are taken outside of a GC, so every GC so far is counted
+  putStrLn $ "Haskell pauses match gcs: "
+    ++ show (sum counts == fromIntegral (gcs stats))
+  putStrLn $ "Haskell major GCs match: "
+    ++ show (last counts == fromIntegral (major_gcs stats))
+  forM_ hists $ \h -> do
+    -- each count is the sum of its buckets
+    unless (sum (pause_hist_buckets h) == pause_hist_count h) $
+      putStrLn "bucket sum mismatch"
+    let qs = map (pauseHistogramQuantile h) [0.5, 0.9, 0.99, 0.999, 1]
+    unless (and (zipWith (<=) qs (tail qs))) $
+      putStrLn $ "quantiles out of order: " ++ show qs
+    unless (last qs == pause_hist_max_ns h) $
+      putStrLn "p100 is not the maximum pause"
+  print (pauseHistogramQuantile (PauseHistogram 0 0 []) 0.99)
+
+foreign import ccall unsafe "check_pause_histograms"
+  c_check_pause_histograms :: IO ()
@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <Rts.h>
+
+void check_pause_histograms(void) {
+  RTSStats s;
+  getRTSStats(&s);
+
+  printf("generations: %u\n", s.gc_pause_hist_gens);
+
+  uint64_t total = 0;
+  for (uint32_t g = 0; g < s.gc_pause_hist_gens; g++) {
+    const PauseHistogram *h = &s.gc_pause_hist[g];
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < PAUSE_HIST_BUCKETS; i++) {
+      count += h->buckets[i];
+    }
+    if (count != h->count) {
+      printf("gen %u: bucket sum %lu /= count %lu\n", g,
+             (unsigned long) count, (unsigned long) h->count);
+    }
+
+    Time p50 = getPauseHistogramQuantile(h, 0.5);
+    Time p99 = getPauseHistogramQuantile(h, 0.99);
+    Time p100 = getPauseHistogramQuantile(h, 1.0);
+    if (p50 > p99 || p99 > p100 || p100 != h->max_ns) {
+      printf("gen %u: quantiles out of order\n", g);
+    }
+    total += h->count;
+  }
+
+  printf("pauses recorded for every GC: %s\n",
+         total == s.gcs ? "yes" : "no");
+  printf("major GCs recorded: %s\n",
+         s.gc_pause_hist[s.gc_pause_hist_gens-1].count == s.major_gcs
+         ? "yes" : "no");
+  // the Haskell side prints next, through its own buffer
+  fflush(stdout);
+}
@@ -0,0 +1,38 @@
+-- Drop a lot of live data, then keep allocating, with every GC a major
+-- one (-G1).  The megablocks the GCs don't need any more must be returned
+-- to the OS in the background although a major GC happens far more often
+-- than every --return-memory-delay.  See Note [Returning memory in the
+-- background] in rts/sm/BlockAlloc.c.
+
+import Control.Exception
+import Control.Monad
+import Data.IORef
+import Data.Word
+import GHC.Clock
+import GHC.Stats
+import System.Environment
+
+memInUse :: IO (Word64, Word32)
+memInUse = do
+  s <- getRTSStats
+  return (gcdetails_mem_in_use_bytes (gc s), gcs s)
+
+main :: IO ()
+main = do
+  -- not a CAF, which could stay alive
+  args <- getArgs
+  big <- newIORef (replicate (4000000 + length args) ())
+  _ <- evaluate . length =<< readIORef big
+  writeIORef big []
+  (peak, gcs0) <- memInUse
+  t0 <- getMonotonicTime
+  let loop = do
+        replicateM_ 1000 (newIORef ())
+        (inUse, n) <- memInUse
+        t <- getMonotonicTime
+        if inUse < peak `div` 2 && n > gcs0 + 10
+          then putStrLn "returned"
+          else if t - t0 > 20
+            then putStrLn ("not returned: " ++ show (peak, inUse, n - gcs0))
+            else loop
+  loop
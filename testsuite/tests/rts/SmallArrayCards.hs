@@ -0,0 +1,46 @@
+{-# LANGUAGE MagicHash #-}
+{-# LANGUAGE UnboxedTuples #-}
+
+-- Check that minor collections see the writes to a small array with a card
+-- table in the old generation, whichever of its cards they fall in.
+-- See Note [Card marking for small arrays] in rts/sm/Scav.c.
+
+import Prelude hiding (read)
+import Control.Monad
+import GHC.Exts
+import GHC.IO
+import System.Mem
+
+data SmallArray = SA (SmallMutableArray# RealWorld [Int])
+
+main :: IO ()
+main = do
+    arr <- new 64 []
+    performMajorGC
+    forM_ [1..2000] $ \i -> do
+        write arr ((i * 7) `mod` 64) [i .. i + 10]
+        when (i `mod` 100 == 0) performMinorGC
+    src <- new 16 [1, 2, 3]
+    copy src 0 arr 40 16
+    performMinorGC
+    xs <- mapM (read arr) [0..63]
+    print (sum (map sum xs))
+    performMajorGC
+    ys <- mapM (read arr) [0..63]
+    print (xs == ys)
+
+new :: Int -> [Int] -> IO SmallArray
+new (I# n#) x = IO (\s -> case newSmallArray# n# x s of
+                            (# s', arr# #) -> (# s', SA arr# #))
+
+write :: SmallArray -> Int -> [Int] -> IO ()
+write (SA arr#) (I# i#) x = IO (\s -> case writeSmallArray# arr# i# x s of
+                                        s' -> (# s', () #))
+
+read :: SmallArray -> Int -> IO [Int]
+read (SA arr#) (I# i#) = IO (\s -> readSmallArray# arr# i# s)
+
+copy :: SmallArray -> Int -> SmallArray -> Int -> Int -> IO ()
+copy (SA src#) (I# src_off#) (SA dst#) (I# dst_off#) (I# n#) =
+    IO (\s -> case copySmallMutableArray# src# src_off# dst# dst_off# n# s of
+                s' -> (# s', () #))
@@ -0,0 +1,30 @@
+-- Make, dereference and free stable pointers from several capabilities at
+-- once, while the stable pointer table keeps growing, to exercise the
+-- per-capability caches of free stable pointer table entries.
+
+import Control.Concurrent
+import Control.Monad
+import Foreign.StablePtr
+
+main :: IO ()
+main = do
+    n <- getNumCapabilities
+    dones <- forM [0 .. n - 1] $ \i -> do
+        done <- newEmptyMVar
+        _ <- forkOn i $ worker i >>= putMVar done
+        return done
+    -- Keep some stable pointers alive, so that the table has to grow while
+    -- the workers run
+    kept <- forM [1 .. 100000 :: Int] newStablePtr
+    oks <- mapM takeMVar dones
+    kept' <- mapM deRefStablePtr kept
+    mapM_ freeStablePtr kept
+    print (and oks && kept' == [1 .. 100000])
+
+worker :: Int -> IO Bool
+worker i = fmap and $ forM [1 .. 200 :: Int] $ \j -> do
+    let xs = [i * 1000000 + j * 1000 .. i * 1000000 + j * 1000 + 999]
+    sps <- mapM newStablePtr xs
+    ys <- mapM deRefStablePtr sps
+    mapM_ freeStablePtr sps
+    return (xs == ys)
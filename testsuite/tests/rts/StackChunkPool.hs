@@ -0,0 +1,32 @@
+-- Threads whose stacks repeatedly grow and shrink across stack chunk
+-- boundaries, so that the chunks are reused from the capabilities' pools.
+-- See Note [Stack chunk pool] in rts/Threads.c.
+
+import Control.Concurrent
+import Control.Monad
+import GHC.Stats
+
+depth :: Int -> Int
+depth 0 = 0
+depth n = 1 + depth (n - 1)
+
+run :: Int -> Int
+run t = sum [ depth (2000 + (i * t) `mod` 300) | i <- [1 .. 5000] ]
+
+main :: IO ()
+main = do
+  mvs <- forM [1 .. 4] $ \t -> do
+    mv <- newEmptyMVar
+    _ <- forkIO $ putMVar mv $! run t
+    return mv
+  rs <- mapM takeMVar mvs
+  print (sum rs)
+  stats <- getRTSStats
+  -- Every thread crosses a chunk boundary on each call of depth, so most
+  -- overflows should have been served from the pool.
+  putStrLn $ "chunks reused: "
+    ++ show (stack_chunks_reused stats > 0)
+  putStrLn $ "most overflows reused a chunk: "
+    ++ show (2 * stack_chunks_reused stats > stack_overflows stats)
+  putStrLn $ "no more reuses than overflows: "
+    ++ show (stack_chunks_reused stats <= stack_overflows stats)
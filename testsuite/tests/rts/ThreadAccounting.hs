@@ -0,0 +1,38 @@
+import Control.Concurrent
+import Control.Monad
+import Data.IORef
+import GHC.Conc
+import System.CPUTime
+
+-- Checks the per-thread allocation and CPU counts maintained with
+-- +RTS --thread-accounting.
+main :: IO ()
+main = do
+  done <- newEmptyMVar
+  finished <- newEmptyMVar
+  ref <- newIORef (0 :: Int)
+  idle <- forkIO $ readMVar done
+  t <- forkIO $ do
+    forM_ [1..1000000] $ \i -> modifyIORef' ref (+ length (show (i :: Int)))
+    putMVar finished ()
+    readMVar done
+  takeMVar finished
+  readIORef ref >>= \n -> when (n == 0) $ putStrLn "worker didn't run"
+  Just (alloc, cpu) <- threadAccounting t
+  Just (idleAlloc, idleCpu) <- threadAccounting idle
+  print (alloc > 1000000)
+  print (alloc > idleAlloc)
+  -- the worker did all the work, and the process did at least that much
+  print (cpu > idleCpu)
+  processCpu <- getCPUTime
+  print (fromIntegral cpu <= processCpu `div` 1000)
+
+  -- the counts for the current thread include the running time slice
+  me <- myThreadId
+  Just (alloc1, _) <- threadAccounting me
+  let xs = [1..10000] :: [Int]
+  print (sum (map (* 2) xs) > 0)
+  Just (alloc2, _) <- threadAccounting me
+  print (alloc2 > alloc1)
+
+  putMVar done ()
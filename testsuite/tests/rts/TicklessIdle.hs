@@ -0,0 +1,31 @@
+-- An idle program, whose timer may sleep for many ticks at a time (see
+-- Note [Tickless idle] in rts/Timer.c), must still wake up in time for
+-- threadDelay and timeouts, and start ticking again when it runs.
+
+import Control.Concurrent
+import Control.Monad
+import GHC.Clock
+import System.Timeout
+
+timed :: IO a -> IO (a, Double)
+timed act = do
+  t0 <- getMonotonicTime
+  r <- act
+  t1 <- getMonotonicTime
+  return (r, t1 - t0)
+
+main :: IO ()
+main = forM_ [1 .. 3 :: Int] $ \_ -> do
+  -- Long enough for the RTS to become idle, after which the timer only
+  -- wakes up for the idle GC, 0.2s later, and then not for 10s (-Iw).
+  (_, d) <- timed (threadDelay 500000)
+  when (d < 0.5 || d > 2) $ putStrLn ("threadDelay took " ++ show d ++ "s")
+  -- a timeout that fires while the program is idle
+  (r1, t1) <- timed (timeout 300000 (threadDelay 10000000))
+  print r1
+  when (t1 < 0.3 || t1 > 2) $ putStrLn ("timeout took " ++ show t1 ++ "s")
+  -- and one that doesn't
+  (r2, _) <- timed (timeout 5000000 (threadDelay 100000))
+  print r2
+  -- some work straight after waking up
+  print (sum [1 .. 100000 :: Int])
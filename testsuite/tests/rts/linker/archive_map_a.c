@@ -0,0 +1,13 @@
+// More than a page of initialised data, so that the section is mapped from
+// the archive rather than copied
+int archive_map_table[4096] = { [0] = 1, [1000] = 2, [4095] = 3 };
+
+int archive_map_a(void)
+{
+    int i, sum = 0;
+
+    for (i = 0; i < 4096; i++) {
+        sum += archive_map_table[i];
+    }
+    return sum;
+}
@@ -0,0 +1,15 @@
+extern int archive_map_a(void);
+
+// A section with an alignment that the member's offset in the archive may
+// not respect, in which case it is copied rather than mapped
+const long archive_map_aligned[1024] __attribute__((aligned(64))) =
+    { [0] = 10, [1023] = 20 };
+
+int archive_map_b(void)
+{
+    if ((unsigned long)archive_map_aligned % 64 != 0) {
+        return -1;
+    }
+    return archive_map_aligned[0] + archive_map_aligned[1023]
+        + archive_map_a();
+}
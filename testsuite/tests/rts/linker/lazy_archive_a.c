@@ -0,0 +1,6 @@
+extern int lazy_archive_b(int);
+
+int lazy_archive_a(int x)
+{
+    return lazy_archive_b(x) + 1;
+}
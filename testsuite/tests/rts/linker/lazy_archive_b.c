@@ -0,0 +1,4 @@
+int lazy_archive_b(int x)
+{
+    return x * 3;
+}
@@ -0,0 +1,6 @@
+extern int lazy_archive_nowhere(int);
+
+int lazy_archive_unused(int x)
+{
+    return lazy_archive_nowhere(x);
+}
@@ -0,0 +1,51 @@
+#include "ghcconfig.h"
+#include "Rts.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Load an archive whose members are mapped from the archive when they are
+// suitably aligned in it, call into them, unload it and load it again.
+// See Note [Mapping archive members] in rts/linker/LoadArchive.c.
+
+typedef int testfun(void);
+
+static void loadAndCall (const char *archive)
+{
+    testfun *f;
+
+    if (!loadArchive((pathchar *) archive)) {
+        errorBelch("loadArchive(%s) failed", archive);
+        exit(1);
+    }
+    f = (testfun *) lookupSymbol("archive_map_b");
+    if (f == NULL) {
+        errorBelch("lookupSymbol failed");
+        exit(1);
+    }
+    if (!resolveObjs()) {
+        errorBelch("resolveObjs failed");
+        exit(1);
+    }
+    printf(" %d", f());
+}
+
+int main (int argc, char *argv[])
+{
+    int i;
+
+    hs_init(&argc, &argv);
+    initLinker_(0);
+
+    for (i = 1; i < argc; i++) {
+        printf("%s:", argv[i]);
+        loadAndCall(argv[i]);
+        unloadObj((pathchar *) argv[i]);
+        performMajorGC();
+        loadAndCall(argv[i]);
+        printf("\n");
+    }
+    fflush(stdout);
+
+    hs_exit();
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "ghcconfig.h"
+#include "Rts.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Load an archive and call a function of one of its members, which calls a
+// function of another member. With a symbol index, the members are only
+// loaded when one of their symbols is looked up, see Note [Lazy archive
+// loading] in rts/linker/LoadArchive.c. Without one, they are all loaded by
+// loadArchive. The archive also has a member referring to a symbol that is
+// defined nowhere, which must not get in the way.
+
+typedef int testfun(int);
+
+int main (int argc, char *argv[])
+{
+    pathchar *path;
+    testfun *f;
+
+    hs_init(&argc, &argv);
+    initLinker_(0);
+
+    if (argc != 2) {
+        errorBelch("usage: linker_lazy_archive <archive>");
+        exit(1);
+    }
+    path = (pathchar *) argv[1];
+
+    if (!loadArchive(path)) {
+        errorBelch("loadArchive(%s) failed", argv[1]);
+        exit(1);
+    }
+    printf("%s: members %s\n", argv[1],
+           getObjectLoadStatus(path) == OBJECT_NOT_LOADED
+               ? "not loaded yet" : "loaded");
+
+    f = (testfun *) lookupSymbol("lazy_archive_a");
+    if (f == NULL) {
+        errorBelch("lookupSymbol failed");
+        exit(1);
+    }
+    if (!resolveObjs()) {
+        errorBelch("resolveObjs failed");
+        exit(1);
+    }
+    printf("%d\n", f(10));
+    fflush(stdout);
+
+    hs_exit();
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "ghcconfig.h"
+#include "Rts.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Load several objects at once with +RTS --linker-threads, one of which
+// refers to a symbol that isn't defined anywhere yet, so that resolveObjs
+// fails. Then load the object defining the symbol and resolve again: the
+// objects that were resolved the first time must not be resolved twice.
+// See Note [Parallel object resolution] in rts/Linker.c.
+
+typedef int testfun(int);
+
+static void load (const char *obj)
+{
+    if (!loadObj((pathchar *) obj)) {
+        errorBelch("loadObj(%s) failed", obj);
+        exit(1);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    testfun *f;
+
+    hs_init(&argc, &argv);
+    initLinker_(0);
+
+    load("linker_parallel_a.o");
+    load("linker_parallel_b.o");
+    load("linker_parallel_c.o");
+    if (resolveObjs()) {
+        errorBelch("resolving an undefined symbol succeeded");
+        exit(1);
+    }
+    printf("resolveObjs failed\n");
+
+    load("linker_parallel_d.o");
+    if (!resolveObjs()) {
+        errorBelch("resolveObjs failed after loading the missing symbol");
+        exit(1);
+    }
+
+    f = (testfun *) lookupSymbol("linker_parallel_c");
+    if (f == NULL) {
+        errorBelch("lookupSymbol failed");
+        exit(1);
+    }
+    printf("%d\n", f(5));
+    fflush(stdout);
+
+    hs_exit();
+    return 0;
+}
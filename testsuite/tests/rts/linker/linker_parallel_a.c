@@ -0,0 +1,6 @@
+extern int linker_parallel_b(int);
+
+int linker_parallel_a(int x)
+{
+    return linker_parallel_b(x) + 1;
+}
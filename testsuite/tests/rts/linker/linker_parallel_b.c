@@ -0,0 +1,4 @@
+int linker_parallel_b(int x)
+{
+    return x * 2;
+}
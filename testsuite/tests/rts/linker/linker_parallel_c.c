@@ -0,0 +1,7 @@
+extern int linker_parallel_a(int);
+extern int linker_parallel_missing(int);
+
+int linker_parallel_c(int x)
+{
+    return linker_parallel_missing(linker_parallel_a(x));
+}
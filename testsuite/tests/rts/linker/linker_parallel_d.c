@@ -0,0 +1,4 @@
+int linker_parallel_missing(int x)
+{
+    return x + 100;
+}
@@ -0,0 +1,25 @@
+import Control.Concurrent
+import Control.Monad
+import System.Mem
+import System.Mem.StableName
+
+-- Make stable names for the same objects from several capabilities at
+-- once, with GCs in between, and check that each object keeps a single
+-- stable name.
+
+main = do
+  let xs = [ [i .. i + 10] | i <- [1 .. 20000 :: Int] ]
+  mapM_ (\x -> seq x (return ())) xs
+  n <- getNumCapabilities
+  dones <- forM [0 .. n - 1] $ \i -> do
+    done <- newEmptyMVar
+    _ <- forkOn i $ do
+      names <- forM [1 .. 4 :: Int] $ \r -> do
+        when (r == i + 1) performMajorGC
+        when (r == 3) performMinorGC
+        mapM makeStableName xs
+      putMVar done names
+    return done
+  names <- mapM takeMVar dones
+  let all_names = concat names
+  print (and [ a == b | ns <- all_names, (a, b) <- zip ns (head all_names) ])
@@ -0,0 +1,82 @@
+#include "Rts.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// The cgroup v2 helpers of rts/posix/OSMem.c, on a fake cgroup hierarchy
+// mounted at testcgroup.d. See Note [Memory limits] in rts/sm/MemoryLimit.c.
+
+bool parseCGroupFile (const char *proc_cgroup, const char *mount,
+                      char *dir, size_t len);
+void cgroupMemoryLimits (const char *mount, const char *cgroup,
+                         StgWord64 *max, StgWord64 *high);
+
+#define MOUNT "testcgroup.d"
+
+static void writeFile (const char *path, const char *contents)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fputs(contents, f);
+    fclose(f);
+}
+
+static void parse (const char *proc_cgroup)
+{
+    char dir[256];
+
+    if (parseCGroupFile(proc_cgroup, MOUNT, dir, sizeof(dir))) {
+        printf("%s\n", dir);
+    } else {
+        printf("no cgroup\n");
+    }
+}
+
+static void limits (const char *cgroup)
+{
+    StgWord64 max, high;
+
+    cgroupMemoryLimits(MOUNT, cgroup, &max, &high);
+    printf("%s: max %" FMT_Word64 ", high %" FMT_Word64 "\n",
+           cgroup, max, high);
+}
+
+int main (void)
+{
+    parse("0::/a/b\n");
+    parse("12:memory:/x\n1:name=systemd:/y\n0::/a\n");
+    parse("0::/\n");
+    parse("0::/a/b/");
+    parse("11:memory:/docker/abc\n");
+    parse("");
+
+    mkdir(MOUNT, 0755);
+    mkdir(MOUNT "/a", 0755);
+    mkdir(MOUNT "/a/b", 0755);
+    // The cgroup at the mount point is limited, as in a cgroup namespace
+    writeFile(MOUNT "/memory.max", "1000000000\n");
+    writeFile(MOUNT "/memory.high", "max\n");
+    writeFile(MOUNT "/a/memory.max", "max\n");
+    writeFile(MOUNT "/a/memory.high", "500000000\n");
+    writeFile(MOUNT "/a/b/memory.max", "2000000000\n");
+    writeFile(MOUNT "/a/b/memory.high", "600000000\n");
+
+    limits(MOUNT "/a/b");
+    limits(MOUNT "/a");
+    limits(MOUNT);
+
+    // No limits at all, and no files at the root
+    remove(MOUNT "/memory.max");
+    remove(MOUNT "/memory.high");
+    writeFile(MOUNT "/a/memory.high", "max\n");
+    writeFile(MOUNT "/a/b/memory.max", "max\n");
+    writeFile(MOUNT "/a/b/memory.high", "max\n");
+    limits(MOUNT "/a/b");
+    limits(MOUNT);
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include "Rts.h"
+#include "Hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Tests for the RTS hash tables (rts/Hash.c). Run with an argument, this
+// also reports the throughput of insertion, lookup and removal, and the
+// memory used by a table, for comparing implementations.
+
+#define N 200000
+
+static StgWord keys[N];
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        exit(1);
+    }
+}
+
+// Keys that look like the heap pointers the RTS often uses as keys
+static void initKeys(void)
+{
+    StgWord x = 0x42000000;
+    for (int i = 0; i < N; i++) {
+        x += 8 * (1 + (i * 7919) % 5);
+        keys[i] = x;
+    }
+}
+
+static void sumValues(void *data, StgWord key STG_UNUSED, const void *value)
+{
+    *(StgWord *) data += (StgWord) value;
+}
+
+static void testWordTable(void)
+{
+    HashTable *t = allocHashTable();
+
+    for (int i = 0; i < N; i++) {
+        insertHashTable(t, keys[i], (void *) (StgWord) (i + 1));
+    }
+    check(keyCountHashTable(t) == N, "key count after insert");
+
+    for (int i = 0; i < N; i++) {
+        check(lookupHashTable(t, keys[i]) == (void *) (StgWord) (i + 1),
+              "lookup after insert");
+    }
+    check(lookupHashTable(t, 1) == NULL, "lookup of a missing key");
+
+    // Remove every other key, and check the others survive
+    for (int i = 0; i < N; i += 2) {
+        check(removeHashTable(t, keys[i], NULL) == (void *) (StgWord) (i + 1),
+              "remove");
+    }
+    check(keyCountHashTable(t) == N / 2, "key count after remove");
+    for (int i = 0; i < N; i++) {
+        void *expected = i % 2 ? (void *) (StgWord) (i + 1) : NULL;
+        check(lookupHashTable(t, keys[i]) == expected, "lookup after remove");
+    }
+    check(removeHashTable(t, keys[0], NULL) == NULL, "remove a missing key");
+
+    // Removing with the right data
+    check(removeHashTable(t, keys[1], (void *) 2) == (void *) 2,
+          "remove with data");
+    insertHashTable(t, keys[1], (void *) 2);
+
+    // Inserting an existing key replaces its value
+    insertHashTable(t, keys[1], (void *) 42);
+    check(lookupHashTable(t, keys[1]) == (void *) 42, "overwrite");
+    check(keyCountHashTable(t) == N / 2, "key count after overwrite");
+    insertHashTable(t, keys[1], (void *) 2);
+
+    // Refill, reusing the removed slots
+    for (int i = 0; i < N; i += 2) {
+        insertHashTable(t, keys[i], (void *) (StgWord) (i + 1));
+    }
+    check(keyCountHashTable(t) == N, "key count after refill");
+
+    StgWord sum = 0;
+    mapHashTable(t, &sum, sumValues);
+    check(sum == (StgWord) N * (N + 1) / 2, "mapHashTable");
+
+    StgWord *ks = malloc(N * sizeof(StgWord));
+    check(keysHashTable(t, ks, N) == N, "keysHashTable");
+    sum = 0;
+    for (int i = 0; i < N; i++) {
+        sum += (StgWord) lookupHashTable(t, ks[i]);
+    }
+    check(sum == (StgWord) N * (N + 1) / 2, "keysHashTable keys");
+    free(ks);
+
+    // Churn: a small table with many insertions and removals must not
+    // fill up with deleted slots
+    HashTable *small = allocHashTable();
+    size_t usage = 0;
+    for (int i = 0; i < N; i++) {
+        insertHashTable(small, keys[i], (void *) 1);
+        if (i >= 8) {
+            check(removeHashTable(small, keys[i - 8], NULL) == (void *) 1,
+                  "churn remove");
+        }
+        if (i == 1000) {
+            usage = memoryUsageHashTable(small);
+        }
+    }
+    check(keyCountHashTable(small) == 8, "churn key count");
+    check(memoryUsageHashTable(small) == usage, "churn memory usage");
+    freeHashTable(small, NULL);
+
+    freeHashTable(t, NULL);
+    printf("word table: ok\n");
+}
+
+static void testStrTable(void)
+{
+    StrHashTable *t = allocStrHashTable();
+    static char names[1000][16];
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(names[i], sizeof(names[i]), "symbol_%d", i);
+        insertStrHashTable(t, names[i], (void *) (StgWord) (i + 1));
+    }
+    for (int i = 0; i < 1000; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "symbol_%d", i);
+        check(lookupStrHashTable(t, name) == (void *) (StgWord) (i + 1),
+              "string lookup");
+    }
+    check(lookupStrHashTable(t, "symbol_1000") == NULL,
+          "string lookup of a missing key");
+
+    // Replacing an entry also replaces its key
+    char other[16];
+    strcpy(other, "symbol_7");
+    insertStrHashTable(t, other, (void *) 7);
+    check(lookupStrHashTable(t, "symbol_7") == (void *) 7, "string overwrite");
+    strcpy(names[7], "gone");
+    check(lookupStrHashTable(t, "symbol_7") == (void *) 7,
+          "string overwrite key");
+
+    check(removeStrHashTable(t, "symbol_7", NULL) == (void *) 7,
+          "string remove");
+    check(lookupStrHashTable(t, "symbol_7") == NULL,
+          "string lookup after remove");
+
+    freeStrHashTable(t, NULL);
+    printf("string table: ok\n");
+}
+
+static double seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Time insertions, lookups (half of them of missing keys) and removals of
+// the keys, taken in the given order
+static void benchmark(const char *name, const int *order)
+{
+    const int rounds = 20;
+    volatile StgWord sink = 0;
+    clock_t start;
+    double t_insert = 0, t_lookup = 0, t_remove = 0;
+    size_t usage = 0;
+
+    for (int r = 0; r < rounds; r++) {
+        HashTable *t = allocHashTable();
+
+        start = clock();
+        for (int i = 0; i < N; i++) {
+            insertHashTable(t, keys[order[i]], (void *) (StgWord) i);
+        }
+        t_insert += seconds(start);
+        usage = memoryUsageHashTable(t);
+
+        start = clock();
+        for (int i = 0; i < N; i++) {
+            sink += (StgWord) lookupHashTable(t, keys[order[i]]);
+            sink += (StgWord) lookupHashTable(t, keys[order[i]] + 1);
+        }
+        t_lookup += seconds(start);
+
+        start = clock();
+        for (int i = 0; i < N; i++) {
+            removeHashTable(t, keys[order[i]], NULL);
+        }
+        t_remove += seconds(start);
+
+        freeHashTable(t, NULL);
+    }
+
+    double ops = (double) N * rounds / 1e6;
+    printf("%s keys:\n", name);
+    printf("  insert: %.1f Mops/s\n", ops / t_insert);
+    printf("  lookup: %.1f Mops/s\n", 2 * ops / t_lookup);
+    printf("  remove: %.1f Mops/s\n", ops / t_remove);
+    printf("  memory: %zu bytes for %d keys (%.1f bytes/key)\n",
+           usage, N, (double) usage / N);
+}
+
+static int order[N];
+
+int main (int argc, char *argv[])
+{
+    hs_init(&argc, &argv);
+
+    initKeys();
+    testWordTable();
+    testStrTable();
+
+    if (argc > 1) {
+        for (int i = 0; i < N; i++) {
+            order[i] = i;
+        }
+        benchmark("sequential", order);
+
+        srand(42);
+        for (int i = N - 1; i > 0; i--) {
+            int j = rand() % (i + 1);
+            int tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        benchmark("shuffled", order);
+    }
+
+    hs_exit();
+    return 0;
+}
@@ -447,6 +447,7 @@ wanteds os = concat
           ,closureField  C    "StgTSO"      "dirty"
           ,closureField  C    "StgTSO"      "bq"
           ,closureField  Both "StgTSO"      "alloc_limit"
+          ,closureField  C    "StgTSO"      "alloc_bytes"
           ,closureField_ Both "StgTSO_cccs" "StgTSO" "prof.cccs"
           ,closureField  Both "StgTSO"      "stackobj"
 
@@ -632,6 +633,8 @@ wanteds os = concat
           ,constantWord Haskell "MAX_CHARLIKE" "MAX_CHARLIKE"
 
           ,constantWord Haskell "MUT_ARR_PTRS_CARD_BITS" "MUT_ARR_PTRS_CARD_BITS"
+          ,constantWord Haskell "SMALL_MUT_ARR_PTRS_CARD_BITS" "SMALL_MUT_ARR_PTRS_CARD_BITS"
+          ,constantWord Haskell "SMALL_MUT_ARR_PTRS_CARD_THRESHOLD" "SMALL_MUT_ARR_PTRS_CARD_THRESHOLD"
 
           -- A section of code-generator-related MAGIC CONSTANTS.
           ,constantWord Haskell "MAX_Vanilla_REG"      "MAX_VANILLA_REG"